@@ -0,0 +1,138 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/generator.hpp"
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <iterator>
+#include <memory>
+
+using namespace cloudbus::detail;
+
+// GCC < 13 mistakes templated promise operator new for a placement form
+// that doesn't match the usual operator delete (GCC bug 109224).
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+namespace {
+/** @brief A hand-written forward iterator over [0, count). */
+struct counter {
+  struct iterator {
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+
+    int value;
+
+    auto operator*() const noexcept -> int { return value; }
+    auto operator++() noexcept -> iterator &
+    {
+      ++value;
+      return *this;
+    }
+    auto operator++(int) noexcept -> iterator
+    {
+      auto tmp = *this;
+      ++value;
+      return tmp;
+    }
+    auto operator==(const iterator &) const noexcept -> bool = default;
+  };
+
+  int count;
+
+  [[nodiscard]] auto begin() const noexcept -> iterator { return {0}; }
+  [[nodiscard]] auto end() const noexcept -> iterator { return {count}; }
+};
+
+auto iota(int count) -> generator<int>
+{
+  for (int i = 0; i < count; ++i)
+    co_yield i;
+}
+
+auto iota(std::allocator_arg_t, const std::allocator<std::byte> &,
+          int count) -> generator<int>
+{
+  for (int i = 0; i < count; ++i)
+    co_yield i;
+}
+} // namespace
+
+static void BM_IteratorYield(benchmark::State &state)
+{
+  const auto count = static_cast<int>(state.range(0));
+  for (auto _ : state)
+  {
+    for (int value : counter{count})
+      benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_IteratorYield)->Arg(1)->Arg(64)->Arg(4096);
+
+static void BM_GeneratorYield(benchmark::State &state)
+{
+  const auto count = static_cast<int>(state.range(0));
+  for (auto _ : state)
+  {
+    for (int value : iota(count))
+      benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GeneratorYield)->Arg(1)->Arg(64)->Arg(4096);
+
+static void BM_GeneratorNextBatch(benchmark::State &state)
+{
+  const auto count = static_cast<int>(state.range(0));
+  auto batch = std::array<int, 64>{};
+  for (auto _ : state)
+  {
+    auto gen = iota(count);
+    while (auto n = gen.next_batch(batch))
+    {
+      for (auto value : std::span(batch).first(n))
+        benchmark::DoNotOptimize(value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GeneratorNextBatch)->Arg(1)->Arg(64)->Arg(4096);
+
+// The cost of allocating and freeing a coroutine frame from the
+// thread-local frame pool and from the global heap.
+static void BM_GeneratorFramePool(benchmark::State &state)
+{
+  for (auto _ : state)
+  {
+    auto gen = iota(1);
+    benchmark::DoNotOptimize(gen);
+  }
+}
+BENCHMARK(BM_GeneratorFramePool);
+
+static void BM_GeneratorFrameHeap(benchmark::State &state)
+{
+  for (auto _ : state)
+  {
+    auto gen = iota(std::allocator_arg, std::allocator<std::byte>{}, 1);
+    benchmark::DoNotOptimize(gen);
+  }
+}
+BENCHMARK(BM_GeneratorFrameHeap);
+// NOLINTEND
@@ -0,0 +1,217 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/buffer_pool.hpp"
+#include "segment/detail/delimiter_parser.hpp"
+#include "segment/detail/frame_parser.hpp"
+#include "segment/detail/mux_frame.hpp"
+#include "segment/detail/pipeline.hpp"
+#include "segment/detail/write_queue.hpp"
+#include <benchmark/benchmark.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+namespace {
+/**
+ * @brief Builds a read buffer of length-prefixed frames.
+ * @param count The number of frames.
+ * @param size The payload size of each frame.
+ */
+auto prefixed_frames(std::size_t count,
+                     std::size_t size) -> std::vector<std::byte>
+{
+  auto buf = std::vector<std::byte>{};
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    for (unsigned shift = 24;; shift -= 8)
+    {
+      buf.push_back(std::byte(size >> shift));
+      if (!shift)
+        break;
+    }
+    buf.insert(buf.end(), size, std::byte{'x'});
+  }
+  return buf;
+}
+
+/**
+ * @brief Builds a read buffer of newline-delimited messages.
+ * @param count The number of messages.
+ * @param size The size of each message, including its delimiter.
+ */
+auto delimited_frames(std::size_t count,
+                      std::size_t size) -> std::vector<std::byte>
+{
+  auto buf = std::vector<std::byte>{};
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    buf.insert(buf.end(), size - 1, std::byte{'x'});
+    buf.push_back(std::byte{'\n'});
+  }
+  return buf;
+}
+} // namespace
+
+// The cost of the small per-message allocations of the message path, such
+// as multiplexing headers, from the buffer pool and from the global heap.
+static void BM_HeaderPoolAllocator(benchmark::State &state)
+{
+  using header_type = mux_frame::header_type;
+  for (auto _ : state)
+  {
+    auto header = std::allocate_shared<header_type>(
+        pool_allocator<header_type>{}, mux_frame::header(1, 64));
+    benchmark::DoNotOptimize(header);
+  }
+}
+BENCHMARK(BM_HeaderPoolAllocator);
+
+static void BM_HeaderStdAllocator(benchmark::State &state)
+{
+  using header_type = mux_frame::header_type;
+  for (auto _ : state)
+  {
+    auto header = std::make_shared<header_type>(mux_frame::header(1, 64));
+    benchmark::DoNotOptimize(header);
+  }
+}
+BENCHMARK(BM_HeaderStdAllocator);
+
+// Read buffers are allocated per read, at the size of a read.
+static void BM_BufferPoolAllocator(benchmark::State &state)
+{
+  const auto size = static_cast<std::size_t>(state.range(0));
+  for (auto _ : state)
+  {
+    auto buf = std::vector<std::byte, pool_allocator<std::byte>>(size);
+    benchmark::DoNotOptimize(buf.data());
+  }
+}
+BENCHMARK(BM_BufferPoolAllocator)->Arg(64)->Arg(4096)->Arg(65536);
+
+static void BM_BufferStdAllocator(benchmark::State &state)
+{
+  const auto size = static_cast<std::size_t>(state.range(0));
+  for (auto _ : state)
+  {
+    auto buf = std::vector<std::byte>(size);
+    benchmark::DoNotOptimize(buf.data());
+  }
+}
+BENCHMARK(BM_BufferStdAllocator)->Arg(64)->Arg(4096)->Arg(65536);
+
+// The cost per message of splitting a read buffer into frames and queuing
+// them for sending, as service() does.
+static void BM_PrefixedParseAndQueue(benchmark::State &state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto buf = prefixed_frames(count, 60);
+  auto owner = std::make_shared<int>();
+  auto parser = frame_parser{};
+  auto queue = write_queue{};
+
+  for (auto _ : state)
+  {
+    for (auto frame : parser.parse(buf))
+      queue.push_frame(owner, frame);
+    queue.consume(queue.bytes());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_PrefixedParseAndQueue)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_DelimitedParseAndQueue(benchmark::State &state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto size = static_cast<std::size_t>(state.range(1));
+  const auto buf = delimited_frames(count, size);
+  auto owner = std::make_shared<int>();
+  auto parser = delimiter_parser{};
+  auto queue = write_queue{};
+
+  for (auto _ : state)
+  {
+    for (auto frame : parser.parse(buf))
+      queue.push_frame(owner, frame);
+    queue.consume(queue.bytes());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_DelimitedParseAndQueue)
+    ->Args({16, 64})
+    ->Args({256, 64})
+    ->Args({4, 4096});
+// The message path of service() as a compile-time pipeline, and the same
+// stages chained through type-erased callbacks.
+static void BM_PrefixedPipeline(benchmark::State &state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto buf = prefixed_frames(count, 60);
+  auto owner = std::make_shared<int>();
+  auto parser = frame_parser{};
+  auto queue = write_queue{};
+  auto handle = pipeline(framing_stage(parser),
+                         counting_stage(metrics::counter::messages),
+                         enqueue_stage(queue));
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(handle(owner, buf));
+    queue.consume(queue.bytes());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_PrefixedPipeline)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_PrefixedCallbacks(benchmark::State &state)
+{
+  using stage_type =
+      std::function<void(write_queue::owner_type, const frame_view &)>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto buf = prefixed_frames(count, 60);
+  auto owner = std::make_shared<int>();
+  auto parser = frame_parser{};
+  auto queue = write_queue{};
+
+  auto send = stage_type([&](auto frame_owner, auto frame) {
+    queue.push_frame(std::move(frame_owner), frame);
+  });
+  auto counted = stage_type([&](auto frame_owner, auto frame) {
+    metrics::local().add(metrics::counter::messages);
+    send(std::move(frame_owner), frame);
+  });
+
+  for (auto _ : state)
+  {
+    for (const auto &frame : parser.parse(buf, owner))
+    {
+      auto head = write_queue::owner_type(parser.owner());
+      counted(head ? std::move(head) : owner, frame);
+    }
+    queue.consume(queue.bytes());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_PrefixedCallbacks)->Arg(1)->Arg(16)->Arg(256);
+// NOLINTEND
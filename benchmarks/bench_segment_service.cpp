@@ -0,0 +1,166 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/segment_service.hpp"
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+
+using namespace cloudbus::service;
+using namespace cloudbus::segment;
+
+namespace {
+/** @brief The port that the benchmarked segment listens on. */
+constexpr std::uint16_t port = 8096;
+
+/**
+ * @brief Starts an echoing segment on the loopback interface.
+ * @details The segment is started once and runs until the benchmarks
+ * exit.
+ * @return The address of the segment.
+ */
+auto start_segment() -> io::socket::socket_address<sockaddr_in>
+{
+  using namespace io::socket;
+
+  static auto services = std::list<async_service<segment_service>>{};
+  static auto mtx = std::mutex{};
+  static auto cvar = std::condition_variable{};
+
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(port);
+
+  if (services.empty())
+  {
+    auto &service = services.emplace_back();
+    service.start(mtx, cvar, addr,
+                  segment_options{.pipeline = true,
+                                  .max_outstanding_bytes = 1UL << 20U});
+
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+
+  addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+  return addr;
+}
+
+/**
+ * @brief Connects a client to the benchmarked segment.
+ * @return The connected socket.
+ */
+auto connect_client() -> io::socket::socket_handle
+{
+  using namespace io::socket;
+
+  auto addr = start_segment();
+  auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int enable = 1;
+  io::setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  if (io::connect(sock, addr))
+    throw std::system_error(errno, std::system_category(), "connect");
+
+  return sock;
+}
+
+/**
+ * @brief Receives exactly the size of a buffer.
+ * @param sock The socket to receive from.
+ * @param buf The buffer to fill.
+ * @return False if the connection failed.
+ */
+auto recv_all(io::socket::socket_handle &sock, std::span<char> buf) -> bool
+{
+  using namespace io::socket;
+  for (std::size_t received = 0; received < buf.size();)
+  {
+    auto msg = socket_message{.buffers = buf.subspan(received)};
+    auto len = io::recvmsg(sock, msg, 0);
+    if (len <= 0)
+      return false;
+    received += len;
+  }
+  return true;
+}
+} // namespace
+
+// One message per round trip: the cost of a read completion, the trip
+// through operator() and service(), and the sendmsg back.
+static void BM_SegmentRoundTrip(benchmark::State &state)
+{
+  using namespace io::socket;
+
+  auto sock = connect_client();
+  auto out = std::vector<char>(static_cast<std::size_t>(state.range(0)), 'x');
+  auto in = std::vector<char>(out.size());
+
+  for (auto _ : state)
+  {
+    if (io::sendmsg(sock, socket_message{.buffers = std::span(out)}, 0) !=
+            static_cast<std::ptrdiff_t>(out.size()) ||
+        !recv_all(sock, in))
+    {
+      state.SkipWithError("echo failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_SegmentRoundTrip)->Arg(64)->Arg(4096)->UseRealTime();
+
+// Many messages per round trip, which amortizes the wakeups and leaves
+// the per-message cost of the service path.
+static void BM_SegmentPipelined(benchmark::State &state)
+{
+  using namespace io::socket;
+
+  auto sock = connect_client();
+  const auto depth = static_cast<std::size_t>(state.range(0));
+  auto out = std::vector<char>(depth * 64, 'x');
+  auto in = std::vector<char>(out.size());
+
+  for (auto _ : state)
+  {
+    for (std::size_t i = 0; i < depth; ++i)
+    {
+      auto msg = socket_message{.buffers = std::span(out).subspan(i * 64, 64)};
+      if (io::sendmsg(sock, msg, 0) != 64)
+      {
+        state.SkipWithError("send failed");
+        return;
+      }
+    }
+
+    if (!recv_all(sock, in))
+    {
+      state.SkipWithError("echo failed");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * depth);
+  state.SetBytesProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_SegmentPipelined)->Arg(16)->Arg(256)->UseRealTime();
+// NOLINTEND
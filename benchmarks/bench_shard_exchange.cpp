@@ -0,0 +1,122 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/shard_exchange.hpp"
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+
+using namespace cloudbus::detail;
+
+namespace {
+/** @brief The number of messages handed over per iteration. */
+constexpr std::size_t batch = 64;
+
+/** @brief A mutex-protected queue, the handoff that the rings replace. */
+struct locked_queue {
+  auto push(shard_message &msg) -> void
+  {
+    auto lock = std::lock_guard{mtx};
+    messages.push_back(std::move(msg));
+  }
+
+  template <typename Fn> auto drain(Fn &&fn) -> std::size_t
+  {
+    auto lock = std::lock_guard{mtx};
+    auto count = messages.size();
+    for (auto &msg : messages)
+      fn(std::move(msg));
+    messages.clear();
+    return count;
+  }
+
+  std::mutex mtx;
+  std::deque<shard_message> messages;
+};
+
+/** @brief Makes a message with an owned buffer. */
+auto make_message() -> shard_message
+{
+  static const auto owner = std::make_shared<std::array<std::byte, 64>>();
+  return {.owner = owner, .buf = *owner, .stream = 1, .pieces = 1};
+}
+} // namespace
+
+// One reactor forwards batches of messages to another, which receives them
+// on its own thread.
+static void BM_ShardExchange(benchmark::State &state)
+{
+  auto exchange = shard_exchange(2, batch * 4);
+  auto stop = std::atomic<bool>{false};
+  auto consumer = std::thread([&] {
+    while (!stop.load(std::memory_order_relaxed))
+    {
+      if (!exchange.receive(1, [](shard_message &&msg) {
+            benchmark::DoNotOptimize(msg);
+          }))
+        std::this_thread::yield();
+    }
+  });
+
+  for (auto _ : state)
+  {
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+      auto msg = make_message();
+      while (!exchange.send(0, 1, std::span(&msg, 1)))
+        std::this_thread::yield();
+    }
+  }
+  stop.store(true, std::memory_order_relaxed);
+  consumer.join();
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_ShardExchange)->UseRealTime();
+
+static void BM_LockedQueue(benchmark::State &state)
+{
+  auto queue = locked_queue{};
+  auto stop = std::atomic<bool>{false};
+  auto consumer = std::thread([&] {
+    while (!stop.load(std::memory_order_relaxed))
+    {
+      if (!queue.drain([](shard_message &&msg) {
+            benchmark::DoNotOptimize(msg);
+          }))
+        std::this_thread::yield();
+    }
+  });
+
+  for (auto _ : state)
+  {
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+      auto msg = make_message();
+      queue.push(msg);
+    }
+  }
+  stop.store(true, std::memory_order_relaxed);
+  consumer.join();
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_LockedQueue)->UseRealTime();
+// NOLINTEND
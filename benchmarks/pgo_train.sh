@@ -0,0 +1,41 @@
+#!/bin/sh
+# pgo_train.sh - Train a PGO instrumented segment with segment_bench.
+#
+# Usage: pgo_train.sh PROFILE_DIR SEGMENT SEGMENT_BENCH [SEGMENT_ARGS...]
+#
+# Runs the segment under load from segment_bench once for each framing
+# and message size, and stops it with SIGTERM so that it exits normally
+# and writes its profile. If LLVM_PROFDATA is set, the raw clang profiles
+# are merged into PROFILE_DIR/default.profdata.
+set -eu
+
+dir=$1
+segment=$2
+bench=$3
+shift 3
+port=${CB_SEGMENT_PGO_PORT:-18080}
+duration=${CB_SEGMENT_PGO_DURATION:-5}
+
+# Profiles of earlier runs would skew the counts of this one.
+mkdir -p "$dir"
+find "$dir" \( -name '*.gcda' -o -name '*.profraw' \) -delete
+
+for framing in none length delimited; do
+  for size in 64 4096; do
+    "$segment" -l "127.0.0.1:$port" -o "framing=$framing" "$@" &
+    pid=$!
+    sleep 1
+
+    status=0
+    "$bench" -p "$port" -c 16 -t 2 -d 8 -s "$size" -D "$duration" -w 1 \
+      -f "$framing" || status=$?
+
+    kill -TERM "$pid"
+    wait "$pid"
+    [ "$status" -eq 0 ] || exit "$status"
+  done
+done
+
+if [ -n "${LLVM_PROFDATA:-}" ]; then
+  "$LLVM_PROFDATA" merge -output="$dir/default.profdata" "$dir"/*.profraw
+fi
@@ -0,0 +1,567 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file segment_bench.cpp
+ * @brief This file defines a load generator for the segment.
+ *
+ * @details Every thread drives its share of the connections from one
+ * epoll loop. In closed-loop mode each connection keeps `depth` messages
+ * in flight and sends the next message as soon as a reply completes. In
+ * open-loop mode messages are sent at a fixed aggregate rate whether or
+ * not replies keep up, and their latency is measured from the time they
+ * were scheduled to be sent so that a stalled segment is not hidden by
+ * the load generator backing off.
+ *
+ * The segment echoes its input, so the reply to a message is complete
+ * once as many bytes have been received as were sent up to the end of
+ * the message. The results are written to stdout as one JSON object.
+ */
+#include "segment/detail/metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using clock_type = std::chrono::steady_clock;
+using cloudbus::detail::histogram;
+
+/** @brief How messages are delimited on the wire. */
+enum class framing_mode : std::uint8_t { none, length_prefixed, delimited };
+
+/** @brief The load generator options. */
+struct bench_options {
+  /** @brief The address of the segment. */
+  std::string host{"127.0.0.1"};
+  /** @brief The port of the segment. */
+  std::uint16_t port{8080};
+  /** @brief The number of connections. */
+  std::size_t connections{1};
+  /** @brief The number of load generator threads. */
+  std::size_t threads{1};
+  /** @brief The size of a message, including its framing. */
+  std::size_t size{64};
+  /** @brief The number of messages in flight per connection. */
+  std::size_t depth{1};
+  /** @brief The aggregate send rate in messages per second, 0 = closed loop. */
+  double rate{0};
+  /** @brief The length of the measurement in seconds. */
+  double duration{10};
+  /** @brief The length of the warmup before the measurement in seconds. */
+  double warmup{1};
+  /** @brief The framing of the messages. */
+  framing_mode framing{framing_mode::none};
+};
+
+/** @brief The results of one thread. */
+struct bench_result {
+  /** @brief The number of completed messages. */
+  std::uint64_t messages{0};
+  /** @brief The number of received bytes. */
+  std::uint64_t bytes{0};
+  /** @brief The number of connections that failed. */
+  std::uint64_t errors{0};
+  /** @brief The message latencies in nanoseconds. */
+  std::unique_ptr<histogram> latency{std::make_unique<histogram>()};
+};
+
+/** @brief A message that was sent and is awaiting its reply. */
+struct inflight {
+  /** @brief The stream offset where the reply is complete. */
+  std::uint64_t end;
+  /** @brief When the message was, or was scheduled to be, sent. */
+  clock_type::time_point start;
+};
+
+/** @brief The state of a connection. */
+struct bench_connection {
+  /** @brief The socket. */
+  int fd{-1};
+  /** @brief The number of bytes queued for sending. */
+  std::uint64_t queued{0};
+  /** @brief The number of bytes sent. */
+  std::uint64_t sent{0};
+  /** @brief The number of bytes received. */
+  std::uint64_t received{0};
+  /** @brief The messages awaiting their reply, oldest first. */
+  std::deque<inflight> pending;
+  /** @brief When the next message is scheduled in open-loop mode. */
+  clock_type::time_point next;
+  /** @brief Whether the connection waits for the socket to be writable. */
+  bool writing{false};
+};
+
+/**
+ * @brief Builds the bytes of a message.
+ * @param size The size of the message, including its framing.
+ * @param framing The framing of the message.
+ * @return The message.
+ */
+static auto make_message(std::size_t size,
+                         framing_mode framing) -> std::vector<char>
+{
+  auto message = std::vector<char>(size, 'x');
+  if (framing == framing_mode::length_prefixed)
+  {
+    auto len = static_cast<std::uint32_t>(size - 4);
+    for (std::size_t i = 0; i < 4; ++i)
+      message[i] = static_cast<char>(len >> (24U - (8U * i)));
+  }
+  else if (framing == framing_mode::delimited)
+  {
+    message.back() = '\n';
+  }
+
+  return message;
+}
+
+/**
+ * @brief Connects a socket to the segment.
+ * @param address The address of the segment.
+ * @return The non-blocking socket, or -1 on error.
+ */
+static auto open_connection(const sockaddr_in &address) -> int
+{
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (fd < 0)
+    return -1;
+
+  int enable = 1;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (::connect(fd, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address)) ||
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) ||
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK))
+  {
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * @brief Writes as many queued bytes as the socket takes.
+ * @param conn The connection.
+ * @param message The message that is sent repeatedly.
+ * @return False if the connection failed.
+ */
+static auto send_queued(bench_connection &conn,
+                        const std::vector<char> &message) -> bool
+{
+  const auto size = message.size();
+  while (conn.sent < conn.queued)
+  {
+    // The stream is the message repeated, so the next bytes to send start
+    // at the same offset within the message.
+    auto offset = conn.sent % size;
+    auto len = std::min<std::uint64_t>(size - offset, conn.queued - conn.sent);
+    auto n = ::send(conn.fd, message.data() + offset, len, MSG_NOSIGNAL);
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+
+    conn.sent += static_cast<std::uint64_t>(n);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Queues a message on a connection.
+ * @param conn The connection.
+ * @param size The size of the message.
+ * @param start When the message is due.
+ */
+static auto queue_message(bench_connection &conn, std::size_t size,
+                          clock_type::time_point start) -> void
+{
+  conn.queued += size;
+  conn.pending.push_back({.end = conn.queued, .start = start});
+}
+
+/**
+ * @brief Drives a share of the connections until the deadline.
+ * @param options The load generator options.
+ * @param address The address of the segment.
+ * @param count The number of connections of this thread.
+ * @param rate The send rate of this thread in messages per second.
+ * @param begin When the measurement begins.
+ * @param deadline When the measurement ends.
+ * @return The results of the thread.
+ */
+static auto run_thread(const bench_options &options, const sockaddr_in &address,
+                       std::size_t count, double rate,
+                       clock_type::time_point begin,
+                       clock_type::time_point deadline) -> bench_result
+{
+  auto result = bench_result{};
+  const auto message = make_message(options.size, options.framing);
+
+  auto epfd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0)
+  {
+    result.errors = count;
+    return result;
+  }
+
+  auto interval = std::chrono::nanoseconds(0);
+  if (rate > 0)
+  {
+    interval = std::chrono::nanoseconds(static_cast<std::int64_t>(
+        1e9 * static_cast<double>(count) / rate));
+  }
+
+  auto conns = std::vector<bench_connection>(count);
+  auto now = clock_type::now();
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    auto &conn = conns[i];
+    conn.fd = open_connection(address);
+    if (conn.fd < 0)
+    {
+      ++result.errors;
+      continue;
+    }
+
+    // Stagger the open-loop schedules of the connections.
+    conn.next = now + (interval * i / count);
+
+    auto event = epoll_event{.events = EPOLLIN, .data = {.u64 = i}};
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, conn.fd, &event);
+  }
+
+  auto update = [&](std::size_t idx) {
+    auto &conn = conns[idx];
+    if (!send_queued(conn, message))
+    {
+      ++result.errors;
+      ::close(std::exchange(conn.fd, -1));
+      return;
+    }
+
+    auto writing = conn.sent < conn.queued;
+    if (writing != conn.writing)
+    {
+      conn.writing = writing;
+      auto event = epoll_event{
+          .events = EPOLLIN | (writing ? EPOLLOUT : 0U), .data = {.u64 = idx}};
+      ::epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &event);
+    }
+  };
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    for (std::size_t j = 0; !interval.count() && conns[i].fd >= 0 &&
+                            j < options.depth;
+         ++j)
+    {
+      queue_message(conns[i], message.size(), now);
+    }
+    if (conns[i].fd >= 0)
+      update(i);
+  }
+
+  auto events = std::array<epoll_event, 64>{};
+  auto buf = std::vector<char>(64UL * 1024UL);
+  while ((now = clock_type::now()) < deadline)
+  {
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - now);
+    if (interval.count())
+    {
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        auto &conn = conns[i];
+        if (conn.fd < 0)
+          continue;
+
+        auto queued = false;
+        for (; conn.next <= now; conn.next += interval, queued = true)
+          queue_message(conn, message.size(), conn.next);
+        if (queued)
+          update(i);
+
+        // Rounding down spins through the last millisecond before a send
+        // so that messages are not sent late.
+        timeout = std::min(timeout,
+                           std::chrono::floor<std::chrono::milliseconds>(
+                               conn.next - now));
+      }
+    }
+
+    auto n = ::epoll_wait(epfd, events.data(), events.size(),
+                          static_cast<int>(timeout.count()));
+    now = clock_type::now();
+    for (int e = 0; e < n; ++e)
+    {
+      auto idx = static_cast<std::size_t>(events[e].data.u64);
+      auto &conn = conns[idx];
+      if (conn.fd < 0)
+        continue;
+
+      if (events[e].events & EPOLLOUT)
+        update(idx);
+
+      if (!(events[e].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+        continue;
+
+      auto len = ::recv(conn.fd, buf.data(), buf.size(), 0);
+      if (len <= 0)
+      {
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+          continue;
+
+        ++result.errors;
+        ::close(std::exchange(conn.fd, -1));
+        continue;
+      }
+
+      conn.received += static_cast<std::uint64_t>(len);
+      if (now >= begin)
+        result.bytes += static_cast<std::uint64_t>(len);
+
+      auto completed = std::size_t{0};
+      while (!conn.pending.empty() && conn.pending.front().end <= conn.received)
+      {
+        if (now >= begin)
+        {
+          ++result.messages;
+          result.latency->record(static_cast<std::uint64_t>(
+              std::chrono::nanoseconds(now - conn.pending.front().start)
+                  .count()));
+        }
+        conn.pending.pop_front();
+        ++completed;
+      }
+
+      if (!interval.count() && completed)
+      {
+        for (; completed; --completed)
+          queue_message(conn, message.size(), now);
+        update(idx);
+      }
+    }
+  }
+
+  for (auto &conn : conns)
+  {
+    if (conn.fd >= 0)
+      ::close(conn.fd);
+  }
+  ::close(epfd);
+
+  return result;
+}
+
+static auto usage(const char *name) -> void
+{
+  std::cerr << "Usage: " << name
+            << " [-a addr] [-p port] [-c conns] [-t threads] [-s size]"
+               " [-d depth] [-r rate] [-D secs] [-w secs] [-f framing]\n"
+            << "  -a, --address A     Address of the segment (127.0.0.1).\n"
+            << "  -p, --port N        Port of the segment (8080).\n"
+            << "  -c, --connections N Number of connections (1).\n"
+            << "  -t, --threads N     Number of load generator threads (1).\n"
+            << "  -s, --size N        Message size in bytes (64).\n"
+            << "  -d, --depth N       Messages in flight per connection in "
+               "closed-loop mode (1).\n"
+            << "  -r, --rate N        Aggregate messages per second, "
+               "0 = closed loop (0).\n"
+            << "  -D, --duration S    Measurement length in seconds (10).\n"
+            << "  -w, --warmup S      Warmup length in seconds (1).\n"
+            << "  -f, --framing F     none, length or delimited (none).\n";
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+  auto options = bench_options{};
+
+  static constexpr auto long_options = std::array{
+      option{"address", required_argument, nullptr, 'a'},
+      option{"port", required_argument, nullptr, 'p'},
+      option{"connections", required_argument, nullptr, 'c'},
+      option{"threads", required_argument, nullptr, 't'},
+      option{"size", required_argument, nullptr, 's'},
+      option{"depth", required_argument, nullptr, 'd'},
+      option{"rate", required_argument, nullptr, 'r'},
+      option{"duration", required_argument, nullptr, 'D'},
+      option{"warmup", required_argument, nullptr, 'w'},
+      option{"framing", required_argument, nullptr, 'f'},
+      option{"help", no_argument, nullptr, 'h'},
+      option{nullptr, 0, nullptr, 0},
+  };
+
+  for (int opt = 0;
+       (opt = getopt_long(argc, argv, "a:p:c:t:s:d:r:D:w:f:h",
+                          long_options.data(), nullptr)) != -1;)
+  {
+    switch (opt)
+    {
+      case 'a':
+        options.host = optarg;
+        break;
+
+      case 'p':
+        options.port =
+            static_cast<std::uint16_t>(std::strtoul(optarg, nullptr, 10));
+        break;
+
+      case 'c':
+        options.connections = std::strtoul(optarg, nullptr, 10);
+        break;
+
+      case 't':
+        options.threads = std::strtoul(optarg, nullptr, 10);
+        break;
+
+      case 's':
+        options.size = std::strtoul(optarg, nullptr, 10);
+        break;
+
+      case 'd':
+        options.depth = std::strtoul(optarg, nullptr, 10);
+        break;
+
+      case 'r':
+        options.rate = std::strtod(optarg, nullptr);
+        break;
+
+      case 'D':
+        options.duration = std::strtod(optarg, nullptr);
+        break;
+
+      case 'w':
+        options.warmup = std::strtod(optarg, nullptr);
+        break;
+
+      case 'f':
+        if (std::string_view(optarg) == "none")
+          options.framing = framing_mode::none;
+        else if (std::string_view(optarg) == "length")
+          options.framing = framing_mode::length_prefixed;
+        else if (std::string_view(optarg) == "delimited")
+          options.framing = framing_mode::delimited;
+        else
+        {
+          std::cerr << "Invalid framing: " << optarg << '\n';
+          return EXIT_FAILURE;
+        }
+        break;
+
+      case 'h':
+        usage(argv[0]);
+        return 0;
+
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  auto min_size = options.framing == framing_mode::length_prefixed ? 4UL : 1UL;
+  if (!options.connections || !options.threads || !options.depth ||
+      options.size < min_size || options.duration <= 0)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  options.threads = std::min(options.threads, options.connections);
+
+  auto address = sockaddr_in{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1)
+  {
+    std::cerr << "Invalid address: " << options.host << '\n';
+    return EXIT_FAILURE;
+  }
+
+  using seconds = std::chrono::duration<double>;
+  auto begin = clock_type::now() +
+               std::chrono::duration_cast<clock_type::duration>(
+                   seconds(options.warmup));
+  auto deadline = begin + std::chrono::duration_cast<clock_type::duration>(
+                              seconds(options.duration));
+
+  auto results = std::vector<bench_result>(options.threads);
+  auto threads = std::vector<std::thread>{};
+  for (std::size_t i = 0; i < options.threads; ++i)
+  {
+    // Spread the connections and the rate evenly over the threads.
+    auto count = (options.connections / options.threads) +
+                 (i < options.connections % options.threads ? 1 : 0);
+    auto rate = options.rate * static_cast<double>(count) /
+                static_cast<double>(options.connections);
+    threads.emplace_back([&, i, count, rate] {
+      results[i] = run_thread(options, address, count, rate, begin, deadline);
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  auto total = bench_result{};
+  for (const auto &result : results)
+  {
+    total.messages += result.messages;
+    total.bytes += result.bytes;
+    total.errors += result.errors;
+    total.latency->merge(*result.latency);
+  }
+
+  auto us = [&](double quantile) {
+    return static_cast<double>(total.latency->percentile(quantile)) / 1e3;
+  };
+
+  std::cout << "{\"mode\":\"" << (options.rate > 0 ? "open" : "closed")
+            << "\",\"connections\":" << options.connections
+            << ",\"threads\":" << options.threads
+            << ",\"size\":" << options.size << ",\"depth\":" << options.depth
+            << ",\"rate\":" << options.rate
+            << ",\"duration_s\":" << options.duration
+            << ",\"messages\":" << total.messages
+            << ",\"bytes\":" << total.bytes
+            << ",\"errors\":" << total.errors << ",\"messages_per_s\":"
+            << static_cast<double>(total.messages) / options.duration
+            << ",\"mib_per_s\":"
+            << static_cast<double>(total.bytes) / options.duration /
+                   (1024.0 * 1024.0)
+            << ",\"p50_us\":" << us(0.5) << ",\"p99_us\":" << us(0.99)
+            << ",\"p999_us\":" << us(0.999) << ",\"max_us\":" << us(1.0)
+            << "}\n";
+
+  return total.errors ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,80 @@
+# EnableOptimization.cmake - Configure optimized builds of cloudbus/segment.
+#
+# This module is included before the dependencies are added, so that the
+# flags apply to stdexec, AsyncBerkeley and cloudbus-net as well as to
+# segmentlib. Most of the data path is sender templates that are
+# instantiated in several translation units, which cross-TU inlining and
+# profile feedback can see through.
+#
+#   CB_SEGMENT_ENABLE_LTO  Link time optimization of every target.
+#   CB_SEGMENT_PGO         Profile-guided optimization: generate or use.
+#   CB_SEGMENT_PGO_DIR     Where the profiles are written and read.
+#   CB_SEGMENT_MARCH       A -march target, e.g. native or x86-64-v3.
+#
+# The PGO workflow builds an instrumented segment, trains it with the
+# segment_bench load generator and rebuilds it with the profiles:
+#
+#   cmake --preset pgo-generate
+#   cmake --build --preset pgo-train
+#   cmake --preset pgo-use
+#   cmake --build --preset pgo-use
+option(CB_SEGMENT_ENABLE_LTO "Enable link time optimization." OFF)
+set(CB_SEGMENT_PGO "" CACHE STRING "Profile-guided optimization: generate or use.")
+set_property(CACHE CB_SEGMENT_PGO PROPERTY STRINGS "" generate use)
+set(CB_SEGMENT_PGO_DIR "${CMAKE_BINARY_DIR}/pgo" CACHE PATH "Directory of the PGO profiles.")
+set(CB_SEGMENT_MARCH "" CACHE STRING "Target architecture passed to -march.")
+
+if (CB_SEGMENT_ENABLE_LTO)
+  include(CheckIPOSupported)
+  check_ipo_supported(RESULT LTO_SUPPORTED OUTPUT LTO_ERROR LANGUAGES CXX)
+  if (NOT LTO_SUPPORTED)
+    message(FATAL_ERROR "Link time optimization is not supported: ${LTO_ERROR}")
+  endif()
+  set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+  message(STATUS "Link time optimization enabled")
+endif()
+
+if (CB_SEGMENT_MARCH)
+  add_compile_options(-march=${CB_SEGMENT_MARCH})
+  message(STATUS "Tuning for -march=${CB_SEGMENT_MARCH}")
+endif()
+
+if (CB_SEGMENT_PGO STREQUAL "generate")
+  # The reactors count concurrently, so the counters must be atomic.
+  if (CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+    set(PGO_FLAGS
+      -fprofile-generate=${CB_SEGMENT_PGO_DIR}
+      -fprofile-prefix-path=${CMAKE_BINARY_DIR}
+      -fprofile-update=atomic
+    )
+  elseif (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    set(PGO_FLAGS -fprofile-generate=${CB_SEGMENT_PGO_DIR})
+  else()
+    message(FATAL_ERROR "PGO is not supported by ${CMAKE_CXX_COMPILER_ID}")
+  endif()
+elseif (CB_SEGMENT_PGO STREQUAL "use")
+  # Code that the training did not reach is optimized as without PGO.
+  if (CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+    set(PGO_FLAGS
+      -fprofile-use=${CB_SEGMENT_PGO_DIR}
+      -fprofile-prefix-path=${CMAKE_BINARY_DIR}
+      -fprofile-partial-training
+      -Wno-missing-profile
+    )
+  elseif (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    set(PGO_FLAGS
+      -fprofile-use=${CB_SEGMENT_PGO_DIR}/default.profdata
+      -Wno-profile-instr-unprofiled
+    )
+  else()
+    message(FATAL_ERROR "PGO is not supported by ${CMAKE_CXX_COMPILER_ID}")
+  endif()
+elseif (CB_SEGMENT_PGO)
+  message(FATAL_ERROR "CB_SEGMENT_PGO must be generate, use or empty: ${CB_SEGMENT_PGO}")
+endif()
+
+if (PGO_FLAGS)
+  add_compile_options(${PGO_FLAGS})
+  add_link_options(${PGO_FLAGS})
+  message(STATUS "Profile-guided optimization: ${CB_SEGMENT_PGO} in ${CB_SEGMENT_PGO_DIR}")
+endif()
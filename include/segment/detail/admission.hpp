@@ -0,0 +1,264 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file admission.hpp
+ * @brief This file declares the connection admission control and the
+ * per-connection rate limits.
+ */
+#pragma once
+#ifndef CLOUDBUS_ADMISSION_HPP
+#define CLOUDBUS_ADMISSION_HPP
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <sys/socket.h>
+namespace cloudbus::detail {
+/**
+ * @brief A token bucket that polices a rate.
+ *
+ * @details The bucket holds up to `burst` tokens and is refilled at
+ * `rate` tokens per second, lazily, whenever it is checked. A unit that
+ * costs more than the bucket can hold is let through when the bucket is
+ * full and leaves it in debt, so that large reads are limited to the
+ * rate on average instead of never passing.
+ *
+ * A bucket belongs to a single connection on a single reactor, so it is
+ * plain state: a check is a clock read, a multiply and a compare.
+ */
+class token_bucket {
+public:
+  /** @brief The clock that the bucket is refilled by. */
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief Constructs a bucket that does not limit. */
+  token_bucket() noexcept = default;
+
+  /**
+   * @brief Constructs a full bucket.
+   * @param rate The number of tokens added per second, or 0 for no
+   * limit.
+   * @param burst The number of tokens that the bucket holds.
+   * @param now The time that the bucket is filled at.
+   */
+  token_bucket(std::uint64_t rate, std::uint64_t burst,
+               clock_type::time_point now = clock_type::now()) noexcept;
+
+  /**
+   * @brief Checks whether the bucket has the tokens without taking them.
+   * @details The bucket is refilled up to `now`.
+   * @param tokens The number of tokens.
+   * @param now The current time.
+   * @return True if the bucket has the tokens, or is full.
+   */
+  auto allows(std::uint64_t tokens,
+              clock_type::time_point now) noexcept -> bool;
+
+  /**
+   * @brief Takes tokens from the bucket, whether it has them or not.
+   * @details Units that have already been let through are charged this
+   * way, and may leave the bucket in debt.
+   * @param tokens The number of tokens to take.
+   * @param now The current time.
+   */
+  auto charge(std::uint64_t tokens, clock_type::time_point now) noexcept
+      -> void;
+
+  /**
+   * @brief Checks whether the bucket limits anything.
+   * @return True if the bucket has a rate.
+   */
+  explicit operator bool() const noexcept { return rate_ > 0; }
+
+private:
+  /**
+   * @brief Refills the bucket for the time since it was last refilled.
+   * @param now The current time.
+   */
+  auto refill(clock_type::time_point now) noexcept -> void;
+
+  /** @brief The number of tokens added per nanosecond. */
+  double rate_{0};
+  /** @brief The number of tokens that the bucket holds. */
+  double burst_{0};
+  /** @brief The number of tokens in the bucket, negative if in debt. */
+  double tokens_{0};
+  /** @brief When the bucket was last refilled. */
+  clock_type::time_point refilled_;
+};
+
+/**
+ * @brief The byte and message rate limits of a connection.
+ * @details Messages are charged to both buckets after they have been
+ * read, and the connection reads again once both have room.
+ */
+class rate_limiter {
+public:
+  /** @brief The clock that the buckets are refilled by. */
+  using clock_type = token_bucket::clock_type;
+
+  /** @brief Constructs a limiter that does not limit. */
+  rate_limiter() noexcept = default;
+
+  /**
+   * @brief Constructs the limiter.
+   * @param bytes The number of bytes per second, or 0 for no limit.
+   * @param messages The number of messages per second, or 0 for no limit.
+   * @param burst How much of each rate can be taken at once.
+   * @param now The time that the buckets are filled at.
+   */
+  rate_limiter(std::uint64_t bytes, std::uint64_t messages,
+               std::chrono::milliseconds burst,
+               clock_type::time_point now = clock_type::now()) noexcept;
+
+  /**
+   * @brief Charges a message to the limits.
+   * @details Messages are never dropped. One that exceeds a limit leaves
+   * it in debt, and the connection stops reading while `ready()` is
+   * false.
+   * @param size The size of the message.
+   * @param now The current time.
+   */
+  auto charge(std::size_t size, clock_type::time_point now) noexcept -> void;
+
+  /**
+   * @brief Checks whether the limits have room for another read.
+   * @param now The current time.
+   * @return False while either bucket is empty or in debt.
+   */
+  [[nodiscard]] auto ready(clock_type::time_point now) noexcept -> bool;
+
+  /**
+   * @brief Checks whether the limiter limits anything.
+   * @return True if either rate is limited.
+   */
+  explicit operator bool() const noexcept { return bytes_ || messages_; }
+
+private:
+  /** @brief The bucket of the byte rate. */
+  token_bucket bytes_;
+  /** @brief The bucket of the message rate. */
+  token_bucket messages_;
+};
+
+/**
+ * @brief Caps the connections of a segment, in total and per source IP.
+ *
+ * @details The reactors of a segment share one admission control, so
+ * the caps hold for the segment as a whole rather than for each reactor.
+ * Nothing takes a lock. The total is one atomic count, and the sources
+ * are counted in a fixed table of atomic counters, in the two slots that
+ * a source hashes to. Sources that share a slot count against each
+ * other, so a source is capped by the smaller of its two slots. This can
+ * turn a connection away early, but never lets a source over its cap.
+ * Counts are taken before they are checked, and given back when a cap
+ * is reached.
+ */
+class admission_control {
+public:
+  /**
+   * @brief The source IP of a connection.
+   * @details IPv4 addresses are mapped into IPv6. All Unix-domain peers
+   * have the same source.
+   */
+  using source_type = std::array<std::uint8_t, 16>;
+
+  /** @brief Constructs an admission control that admits everything. */
+  admission_control() noexcept = default;
+
+  /**
+   * @brief Constructs the admission control.
+   * @param max_connections The maximum number of connections, or 0 for
+   * no limit.
+   * @param max_per_source The maximum number of connections from one
+   * source IP, or 0 for no limit.
+   */
+  admission_control(std::size_t max_connections, std::size_t max_per_source);
+
+  /**
+   * @brief Gets the source IP of a peer address.
+   * @param address The address of the peer.
+   * @return The source IP.
+   */
+  [[nodiscard]] static auto
+  source(const sockaddr_storage &address) noexcept -> source_type;
+
+  /**
+   * @brief Gets the source IP of the peer of a connected socket.
+   * @param sock The connected socket.
+   * @return The source IP, or the Unix-domain source if the socket has
+   * no peer address.
+   */
+  [[nodiscard]] static auto source(int sock) noexcept -> source_type;
+
+  /**
+   * @brief Admits a connection.
+   * @param from The source IP of the connection.
+   * @return False if a cap has been reached, in which case the
+   * connection must be closed and not released.
+   */
+  auto admit(const source_type &from) noexcept -> bool;
+
+  /**
+   * @brief Releases an admitted connection.
+   * @param from The source IP of the connection.
+   */
+  auto release(const source_type &from) noexcept -> void;
+
+  /**
+   * @brief Gets the number of admitted connections.
+   * @return The number of connections that have not been released.
+   */
+  [[nodiscard]] auto connections() const noexcept -> std::size_t
+  {
+    return connections_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Checks whether the admission control caps anything.
+   * @return True if either cap is set.
+   */
+  explicit operator bool() const noexcept
+  {
+    return max_connections_ || max_per_source_;
+  }
+
+private:
+  /** @brief The number of counters of the sources. */
+  static constexpr std::size_t slots = 4096;
+
+  /**
+   * @brief Gets the two counters that a source IP is counted in.
+   * @param from The source IP.
+   * @return The indices of the counters.
+   */
+  [[nodiscard]] static auto
+  slots_of(const source_type &from) noexcept -> std::array<std::size_t, 2>;
+
+  /** @brief The connection counts of the sources, once capped. */
+  std::unique_ptr<std::atomic<std::uint32_t>[]> sources_;
+  /** @brief The maximum number of connections. */
+  std::size_t max_connections_{0};
+  /** @brief The maximum number of connections per source IP. */
+  std::size_t max_per_source_{0};
+  /** @brief The number of admitted connections. */
+  std::atomic<std::size_t> connections_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_ADMISSION_HPP
@@ -0,0 +1,173 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file buffer_pool.hpp
+ * @brief This file declares a size-classed, thread-local buffer pool.
+ */
+#pragma once
+#ifndef CLOUDBUS_BUFFER_POOL_HPP
+#define CLOUDBUS_BUFFER_POOL_HPP
+#include <array>
+#include <cstddef>
+#include <new>
+namespace cloudbus::detail {
+/**
+ * @brief A pool of recycled memory blocks in power-of-two size classes.
+ *
+ * @details Each thread has its own pool (see `local()`), so allocating
+ * and deallocating never takes a lock. Since every reactor runs on its
+ * own thread, this makes the pool a per-reactor pool. Freed blocks are
+ * kept on an intrusive free list per size class, up to a fixed number of
+ * cached bytes per class, and the rest are returned to the global heap.
+ * Requests larger than the largest size class bypass the pool.
+ */
+class buffer_pool {
+public:
+  /** @brief The smallest size class. */
+  static constexpr std::size_t min_size = 64;
+  /** @brief The number of size classes. */
+  static constexpr std::size_t classes = 13;
+  /** @brief The largest size class (256KiB). */
+  static constexpr std::size_t max_size = min_size << (classes - 1);
+  /** @brief The maximum number of cached bytes per size class. */
+  static constexpr std::size_t max_cached_bytes = 4UL * 1024UL * 1024UL;
+
+  /** @brief Default constructor. */
+  buffer_pool() noexcept = default;
+  /** @brief Deleted copy constructor. */
+  buffer_pool(const buffer_pool &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const buffer_pool &other) -> buffer_pool & = delete;
+  /** @brief Returns the cached blocks to the global heap. */
+  ~buffer_pool();
+
+  /**
+   * @brief Gets the pool of the calling thread.
+   * @return The thread-local buffer pool.
+   */
+  static auto local() noexcept -> buffer_pool &;
+
+  /**
+   * @brief Gets the size class of an allocation.
+   * @param size The size of the allocation.
+   * @return The index of the size class, or `classes` if the allocation
+   * is larger than the largest size class.
+   */
+  [[nodiscard]] static constexpr auto
+  size_class(std::size_t size) noexcept -> std::size_t
+  {
+    std::size_t index = 0;
+    for (auto block = min_size; block < size && index < classes; block <<= 1)
+      ++index;
+
+    return index;
+  }
+
+  /**
+   * @brief Allocates a block of memory.
+   * @param size The minimum size of the block.
+   * @return A pointer to the block.
+   * @throws std::bad_alloc if the allocation fails.
+   */
+  auto allocate(std::size_t size) -> void *;
+
+  /**
+   * @brief Deallocates a block of memory.
+   * @param ptr The block to deallocate.
+   * @param size The size that the block was allocated with.
+   */
+  auto deallocate(void *ptr, std::size_t size) noexcept -> void;
+
+  /**
+   * @brief Gets the number of bytes cached by the pool.
+   * @return The number of cached bytes.
+   */
+  [[nodiscard]] auto cached_bytes() const noexcept -> std::size_t;
+
+private:
+  /** @brief A cached block. */
+  struct block {
+    /** @brief The next cached block of the same size class. */
+    block *next;
+  };
+
+  /** @brief The free list of a size class. */
+  struct free_list {
+    /** @brief The first cached block. */
+    block *head{nullptr};
+    /** @brief The number of cached blocks. */
+    std::size_t count{0};
+  };
+
+  /** @brief The free lists per size class. */
+  std::array<free_list, classes> lists_{};
+};
+
+/**
+ * @brief An allocator that allocates from the thread-local buffer pool.
+ * @tparam T The type of the allocated objects.
+ */
+template <typename T> struct pool_allocator {
+  static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+  /** @brief The type of the allocated objects. */
+  using value_type = T;
+
+  /** @brief Default constructor. */
+  constexpr pool_allocator() noexcept = default;
+
+  /**
+   * @brief Converting constructor.
+   * @tparam U The type of the other allocator's objects.
+   */
+  template <typename U>
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  constexpr pool_allocator(const pool_allocator<U> & /*other*/) noexcept
+  {}
+
+  /**
+   * @brief Allocates storage for `n` objects.
+   * @param n The number of objects.
+   * @return A pointer to the storage.
+   */
+  [[nodiscard]] auto allocate(std::size_t n) -> T *
+  {
+    return static_cast<T *>(buffer_pool::local().allocate(n * sizeof(T)));
+  }
+
+  /**
+   * @brief Deallocates storage for `n` objects.
+   * @param ptr The storage to deallocate.
+   * @param n The number of objects.
+   */
+  auto deallocate(T *ptr, std::size_t n) noexcept -> void
+  {
+    buffer_pool::local().deallocate(ptr, n * sizeof(T));
+  }
+
+  /**
+   * @brief Compares two pool allocators.
+   * @return Always true since all pool allocators are interchangeable.
+   */
+  template <typename U>
+  constexpr auto
+  operator==(const pool_allocator<U> & /*other*/) const noexcept -> bool
+  {
+    return true;
+  }
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_BUFFER_POOL_HPP
@@ -0,0 +1,48 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file byte_scan.hpp
+ * @brief This file declares vectorized byte scanning.
+ */
+#pragma once
+#ifndef CLOUDBUS_BYTE_SCAN_HPP
+#define CLOUDBUS_BYTE_SCAN_HPP
+#include <cstddef>
+#include <span>
+#include <string_view>
+namespace cloudbus::detail {
+/**
+ * @brief Finds the first occurrence of a byte in a buffer.
+ *
+ * @details The buffer is scanned with the widest vector kernel that the
+ * CPU supports (AVX2 on x86-64, NEON on AArch64), which is selected once
+ * at runtime. Other targets fall back to `std::memchr`.
+ *
+ * @param buf The buffer to scan.
+ * @param value The byte to find.
+ * @return The index of the first occurrence of `value`, or `buf.size()`
+ * if `buf` does not contain it.
+ */
+[[nodiscard]] auto find_byte(std::span<const std::byte> buf,
+                             std::byte value) noexcept -> std::size_t;
+
+/**
+ * @brief Gets the name of the kernel that `find_byte` dispatches to.
+ * @return One of "avx2", "neon" or "memchr".
+ */
+[[nodiscard]] auto find_byte_kernel() noexcept -> std::string_view;
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_BYTE_SCAN_HPP
@@ -0,0 +1,143 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file delimiter_parser.hpp
+ * @brief This file declares a delimiter-terminated frame parser.
+ */
+#pragma once
+#ifndef CLOUDBUS_DELIMITER_PARSER_HPP
+#define CLOUDBUS_DELIMITER_PARSER_HPP
+#include "segment/detail/frame_view.hpp"
+#include "segment/detail/generator.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <vector>
+namespace cloudbus::detail {
+/**
+ * @brief Splits a byte stream into delimiter-terminated frames.
+ *
+ * @details Read buffers are scanned for the delimiter with `find_byte`.
+ * Like frame_parser, the frames that lie entirely within a read buffer
+ * are yielded as spans of that buffer, and a frame that is split across
+ * reads is kept in the read buffers that it arrived in when they have
+ * owners, and is only copied into reassembly storage when they do not.
+ */
+class delimiter_parser {
+public:
+  /** @brief The type of a read buffer. */
+  using buffer_type = std::span<const std::byte>;
+  /** @brief The type that keeps the storage of a buffer alive. */
+  using owner_type = std::shared_ptr<const void>;
+
+  /**
+   * @brief Constructs a delimiter parser.
+   * @param delimiter The byte that terminates each frame.
+   * @param max_frame_size The largest frame, including its delimiter,
+   * that is accepted.
+   */
+  explicit delimiter_parser(std::byte delimiter = std::byte{'\n'},
+                            std::size_t max_frame_size = 16UL * 1024UL *
+                                                         1024UL) noexcept;
+
+  /**
+   * @brief Parses the frames of a read buffer.
+   *
+   * @details The yielded frames include their delimiter. A frame is valid
+   * until the generator is resumed, unless its storage is kept alive:
+   * the head of a split frame is owned by `owner()` and each piece of its
+   * tail by the owner of that piece, and all other frames point into
+   * `buf`. The generator must be run to completion for the bytes of a
+   * split frame to be kept for the next read. Either all the read
+   * buffers of a stream have owners or none of them do.
+   *
+   * Parsing stops once a frame grows beyond the maximum frame size, after
+   * which `error()` is set and no more frames are yielded.
+   *
+   * @param buf The bytes that were read.
+   * @param owner The owner of `buf`, or nullptr to copy split frames.
+   * @return A generator of the complete frames.
+   */
+  auto parse(buffer_type buf,
+             owner_type owner = nullptr) -> generator<frame_view>;
+
+  /**
+   * @brief Gets the owner of the head of the most recently yielded frame.
+   * @return The owner of the head if the frame was split, otherwise
+   * nullptr.
+   */
+  [[nodiscard]] auto owner() const noexcept -> owner_type;
+
+  /**
+   * @brief Gets the number of buffered bytes of a split frame.
+   * @return The number of bytes waiting for their delimiter.
+   */
+  [[nodiscard]] auto pending() const noexcept -> std::size_t;
+
+  /**
+   * @brief Gets the parse error.
+   * @return `std::errc::message_size` if a frame exceeded the maximum
+   * frame size, otherwise an empty error code.
+   */
+  [[nodiscard]] auto error() const noexcept -> std::error_code;
+
+private:
+  /** @brief The storage of a copied frame. */
+  using storage_type = std::vector<std::byte>;
+
+  /**
+   * @brief Starts a split frame.
+   * @details The head is kept in `buf` if it has an owner, otherwise it
+   * is copied. The storage of the last copied frame is reused when
+   * nothing else holds on to it.
+   * @param buf The head of the split frame.
+   * @param owner The owner of `buf`.
+   */
+  auto save(buffer_type buf, owner_type owner) -> void;
+
+  /** @brief Forgets the split frame. */
+  auto reset() noexcept -> void;
+
+  /**
+   * @brief Checks the length of a frame.
+   * @param size The length of the frame, including its delimiter.
+   * @return True if the frame is too large.
+   */
+  auto oversized(std::size_t size) noexcept -> bool;
+
+  /** @brief The byte that terminates each frame. */
+  std::byte delimiter_;
+  /** @brief The largest accepted frame, including its delimiter. */
+  std::size_t max_frame_size_;
+  /** @brief The head of the split frame. */
+  buffer_type head_;
+  /** @brief The owner of the head of the split frame. */
+  owner_type head_owner_;
+  /** @brief The pieces of the split frame that follow its head. */
+  std::vector<frame_view::segment> tail_;
+  /** @brief The number of bytes of the split frame so far. */
+  std::size_t size_{0};
+  /** @brief The storage of the most recently copied frame. */
+  std::shared_ptr<storage_type> storage_;
+  /** @brief Whether the most recently yielded frame was split. */
+  bool split_{false};
+  /** @brief The parse error. */
+  std::error_code error_;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_DELIMITER_PARSER_HPP
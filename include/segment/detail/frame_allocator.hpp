@@ -0,0 +1,129 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file frame_allocator.hpp
+ * @brief This file declares an allocator for coroutine frames.
+ */
+#pragma once
+#ifndef CLOUDBUS_FRAME_ALLOCATOR_HPP
+#define CLOUDBUS_FRAME_ALLOCATOR_HPP
+#include <cstddef>
+#include <memory>
+namespace cloudbus::detail {
+/**
+ * @brief Allocates coroutine frames that remember their allocator.
+ *
+ * @details A promise's `operator delete` is only given the frame pointer
+ * and size, so the allocator that a frame was allocated with is stored
+ * behind the frame, together with a pointer to the function that
+ * deallocates it. Stateless allocators are not stored. Frames that are
+ * allocated without an allocator come from the thread-local buffer pool,
+ * so short-lived coroutines recycle their frames instead of going to the
+ * global heap.
+ */
+struct frame_allocator {
+  /** @brief The type of the function that deallocates a frame. */
+  using deallocate_fn = void (*)(void *frame, std::size_t size) noexcept;
+
+  /**
+   * @brief Allocates a coroutine frame with an allocator.
+   * @tparam Alloc The type of the allocator.
+   * @param alloc The allocator to allocate the frame with.
+   * @param size The size of the coroutine frame.
+   * @return A pointer to the coroutine frame.
+   */
+  template <typename Alloc>
+  static auto allocate(const Alloc &alloc, std::size_t size) -> void *;
+
+  /**
+   * @brief Allocates a coroutine frame from the thread-local buffer pool.
+   * @param size The size of the coroutine frame.
+   * @return A pointer to the coroutine frame.
+   */
+  static auto allocate(std::size_t size) -> void *;
+
+  /**
+   * @brief Deallocates a coroutine frame with the allocator it was
+   * allocated with.
+   * @param frame The coroutine frame.
+   * @param size The size of the coroutine frame.
+   */
+  static auto deallocate(void *frame, std::size_t size) noexcept -> void;
+
+private:
+  /** @brief The unit of frame allocations. */
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) block {
+    /** @brief The storage of the block. */
+    std::byte data[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+  };
+
+  /**
+   * @brief The allocator type that allocates blocks.
+   * @tparam Alloc The type of the user supplied allocator.
+   */
+  template <typename Alloc>
+  using allocator_type =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<block>;
+
+  /**
+   * @brief Checks whether an allocator needs to be stored with the frame.
+   * @tparam Alloc The type of the allocator.
+   */
+  template <typename Alloc>
+  static constexpr bool is_stored =
+      !std::allocator_traits<Alloc>::is_always_equal::value ||
+      !std::is_default_constructible_v<Alloc>;
+
+  /**
+   * @brief Gets the offset of the deallocation function behind a frame.
+   * @param size The size of the coroutine frame.
+   * @return The offset of the deallocation function.
+   */
+  static constexpr auto fn_offset(std::size_t size) noexcept -> std::size_t;
+
+  /**
+   * @brief Gets the offset of the allocator behind a frame.
+   * @tparam Alloc The type of the allocator.
+   * @param size The size of the coroutine frame.
+   * @return The offset of the allocator.
+   */
+  template <typename Alloc>
+  static constexpr auto alloc_offset(std::size_t size) noexcept
+      -> std::size_t;
+
+  /**
+   * @brief Gets the number of blocks of a frame allocation.
+   * @tparam Alloc The type of the allocator.
+   * @param size The size of the coroutine frame.
+   * @return The number of blocks.
+   */
+  template <typename Alloc>
+  static constexpr auto blocks(std::size_t size) noexcept -> std::size_t;
+
+  /**
+   * @brief Deallocates a frame that was allocated with an `Alloc`.
+   * @tparam Alloc The type of the allocator.
+   * @param frame The coroutine frame.
+   * @param size The size of the coroutine frame.
+   */
+  template <typename Alloc>
+  static auto deallocate_with(void *frame, std::size_t size) noexcept -> void;
+};
+} // namespace cloudbus::detail
+
+#include "impl/frame_allocator_impl.hpp" // IWYU pragma: export
+
+#endif // CLOUDBUS_FRAME_ALLOCATOR_HPP
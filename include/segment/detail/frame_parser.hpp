@@ -0,0 +1,178 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file frame_parser.hpp
+ * @brief This file declares a length-prefixed frame parser.
+ */
+#pragma once
+#ifndef CLOUDBUS_FRAME_PARSER_HPP
+#define CLOUDBUS_FRAME_PARSER_HPP
+#include "segment/detail/frame_view.hpp"
+#include "segment/detail/generator.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <vector>
+namespace cloudbus::detail {
+/**
+ * @brief Splits a byte stream into length-prefixed frames.
+ *
+ * @details Each frame starts with a 4 byte big-endian header that holds
+ * the length of the payload that follows it. The frames that lie entirely
+ * within a read buffer are yielded as spans of that buffer without being
+ * copied. A frame that is split across reads is not copied either when
+ * the read buffers have owners: its pieces are kept together with the
+ * owners of their read buffers, and the frame is yielded as a head and a
+ * tail of those pieces once it is complete. Only a head that is shorter
+ * than the head size, e.g. a header that is itself split, is copied.
+ * Without owners, the whole split frame is copied.
+ *
+ * @par Example:
+ * @code{.cpp}
+ * for (const auto &frame : parser.parse(buf, rctx))
+ *   handle(frame_parser::payload(frame));
+ *
+ * if (parser.error())
+ *   close();
+ * @endcode
+ */
+class frame_parser {
+public:
+  /** @brief The type of a read buffer. */
+  using buffer_type = std::span<const std::byte>;
+  /** @brief The type that keeps the storage of a buffer alive. */
+  using owner_type = std::shared_ptr<const void>;
+
+  /** @brief The size of the frame header. */
+  static constexpr std::size_t header_size = 4;
+
+  /**
+   * @brief Constructs a frame parser.
+   * @param max_frame_size The largest frame, including its header, that
+   * is accepted.
+   * @param head_size The number of leading bytes of a frame that are kept
+   * contiguous, at least the header size.
+   */
+  explicit frame_parser(
+      std::size_t max_frame_size = 16UL * 1024UL * 1024UL,
+      std::size_t head_size = header_size) noexcept;
+
+  /**
+   * @brief Parses the frames of a read buffer.
+   *
+   * @details The yielded frames include their header, and their heads
+   * hold at least the first head size bytes or the whole frame. A frame
+   * is valid until the generator is resumed, unless its storage is kept
+   * alive: the head of a split frame is owned by `owner()` and each piece
+   * of its tail by the owner of that piece, and all other frames point
+   * into `buf`. The generator must be run to completion for the bytes of
+   * a split frame to be kept for the next read. Either all the read
+   * buffers of a stream have owners or none of them do.
+   *
+   * Parsing stops at the first frame whose length exceeds the maximum
+   * frame size, after which `error()` is set and no more frames are
+   * yielded.
+   *
+   * @param buf The bytes that were read.
+   * @param owner The owner of `buf`, or nullptr to copy split frames.
+   * @return A generator of the complete frames.
+   */
+  auto parse(buffer_type buf,
+             owner_type owner = nullptr) -> generator<frame_view>;
+
+  /**
+   * @brief Gets the owner of the head of the most recently yielded frame.
+   * @return The owner of the head if the frame was split, otherwise
+   * nullptr.
+   */
+  [[nodiscard]] auto owner() const noexcept -> owner_type;
+
+  /**
+   * @brief Gets the number of buffered bytes of a split frame.
+   * @return The number of bytes waiting for the rest of their frame.
+   */
+  [[nodiscard]] auto pending() const noexcept -> std::size_t;
+
+  /**
+   * @brief Gets the parse error.
+   * @return `std::errc::message_size` if a frame exceeded the maximum
+   * frame size, otherwise an empty error code.
+   */
+  [[nodiscard]] auto error() const noexcept -> std::error_code;
+
+  /**
+   * @brief Gets the payload of a frame.
+   * @param frame A frame yielded by `parse`.
+   * @return The frame without its header.
+   */
+  [[nodiscard]] static auto
+  payload(const frame_view &frame) noexcept -> frame_view;
+
+private:
+  /** @brief The storage of a copied head. */
+  using storage_type = std::vector<std::byte>;
+
+  /**
+   * @brief Copies bytes to the head of the split frame.
+   * @param buf The bytes to take from.
+   * @param size The size that the head should grow to.
+   * @return The bytes of `buf` that were not taken.
+   */
+  auto append(buffer_type buf, std::size_t size) -> buffer_type;
+
+  /**
+   * @brief Starts a split frame.
+   * @details A head that is at least the head size is kept in `buf`,
+   * otherwise it is copied. The storage of the last copied head is
+   * reused when nothing else holds on to it.
+   * @param buf The head of the split frame.
+   * @param owner The owner of `buf`.
+   */
+  auto save(buffer_type buf, owner_type owner) -> void;
+
+  /** @brief Forgets the split frame. */
+  auto reset() noexcept -> void;
+
+  /**
+   * @brief Checks the length of a frame.
+   * @param size The length of the frame, including its header.
+   * @return True if the frame is too large.
+   */
+  auto oversized(std::size_t size) noexcept -> bool;
+
+  /** @brief The largest accepted frame, including its header. */
+  std::size_t max_frame_size_;
+  /** @brief The number of leading bytes of a frame kept contiguous. */
+  std::size_t head_size_;
+  /** @brief The head of the split frame. */
+  buffer_type head_;
+  /** @brief The owner of the head of the split frame. */
+  owner_type head_owner_;
+  /** @brief The pieces of the split frame that follow its head. */
+  std::vector<frame_view::segment> tail_;
+  /** @brief The number of bytes of the split frame so far. */
+  std::size_t size_{0};
+  /** @brief The storage of the most recently copied head. */
+  std::shared_ptr<storage_type> storage_;
+  /** @brief Whether the most recently yielded frame was split. */
+  bool split_{false};
+  /** @brief The parse error. */
+  std::error_code error_;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_FRAME_PARSER_HPP
@@ -0,0 +1,142 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file frame_view.hpp
+ * @brief This file declares a view of a frame that may span read buffers.
+ */
+#pragma once
+#ifndef CLOUDBUS_FRAME_VIEW_HPP
+#define CLOUDBUS_FRAME_VIEW_HPP
+#include <cstddef>
+#include <memory>
+#include <span>
+namespace cloudbus::detail {
+/**
+ * @brief A view of a frame whose bytes may lie in several read buffers.
+ *
+ * @details A frame that lies within one read buffer is only a head. A
+ * frame that was split across reads is a head followed by the pieces of
+ * the later read buffers that it spans, each with the owner of its read
+ * buffer, so that the frame can be queued for writing without being
+ * copied. The frame parsers guarantee that the head holds the frame
+ * header.
+ */
+class frame_view {
+public:
+  /** @brief The type of a contiguous piece of a frame. */
+  using buffer_type = std::span<const std::byte>;
+  /** @brief The type that keeps the storage of a piece alive. */
+  using owner_type = std::shared_ptr<const void>;
+
+  /** @brief A piece of a split frame and the owner of its storage. */
+  struct segment {
+    /** @brief The owner of the read buffer of the piece. */
+    owner_type owner;
+    /** @brief The bytes of the piece. */
+    buffer_type buf;
+  };
+
+  /** @brief Constructs an empty frame. */
+  constexpr frame_view() noexcept = default;
+
+  /**
+   * @brief Constructs a frame that lies within one buffer.
+   * @param head The bytes of the frame.
+   */
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  constexpr frame_view(buffer_type head) noexcept
+      : head_{head}, size_{head.size()}
+  {}
+
+  /**
+   * @brief Constructs a split frame.
+   * @param head The first bytes of the frame.
+   * @param tail The pieces that follow the head.
+   * @param size The total size of the frame.
+   */
+  constexpr frame_view(buffer_type head, std::span<const segment> tail,
+                       std::size_t size) noexcept
+      : head_{head}, tail_{tail}, size_{size}
+  {}
+
+  /**
+   * @brief Gets the first bytes of the frame.
+   * @return The contiguous head of the frame.
+   */
+  [[nodiscard]] constexpr auto head() const noexcept -> buffer_type
+  {
+    return head_;
+  }
+
+  /**
+   * @brief Gets the pieces that follow the head.
+   * @return The pieces of a split frame, or an empty span.
+   */
+  [[nodiscard]] constexpr auto
+  tail() const noexcept -> std::span<const segment>
+  {
+    return tail_;
+  }
+
+  /**
+   * @brief Gets the size of the frame.
+   * @return The total number of bytes of the head and the tail.
+   */
+  [[nodiscard]] constexpr auto size() const noexcept -> std::size_t
+  {
+    return size_;
+  }
+
+  /**
+   * @brief Checks whether the frame is empty.
+   * @return True if the frame has no bytes.
+   */
+  [[nodiscard]] constexpr auto empty() const noexcept -> bool
+  {
+    return size_ == 0;
+  }
+
+  /**
+   * @brief Checks whether the frame spans several read buffers.
+   * @return True if the frame has a tail.
+   */
+  [[nodiscard]] constexpr auto split() const noexcept -> bool
+  {
+    return !tail_.empty();
+  }
+
+  /**
+   * @brief Drops bytes from the front of the frame.
+   * @param offset The number of bytes to drop, at most the size of the
+   * head.
+   * @return The rest of the frame.
+   */
+  [[nodiscard]] constexpr auto
+  subframe(std::size_t offset) const noexcept -> frame_view
+  {
+    return {head_.subspan(offset), tail_, size_ - offset};
+  }
+
+private:
+  /** @brief The first bytes of the frame. */
+  buffer_type head_;
+  /** @brief The pieces that follow the head. */
+  std::span<const segment> tail_;
+  /** @brief The total size of the frame. */
+  std::size_t size_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_FRAME_VIEW_HPP
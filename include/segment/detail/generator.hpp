@@ -20,9 +20,13 @@
 #pragma once
 #ifndef CLOUDBUS_GENERATOR_HPP
 #define CLOUDBUS_GENERATOR_HPP
+#include "segment/detail/frame_allocator.hpp"
+
 #include <coroutine>
 #include <exception>
 #include <iterator>
+#include <memory>
+#include <span>
 #include <type_traits>
 /** @brief This namespace provides internal cloudbus implementation details. */
 namespace cloudbus::detail {
@@ -33,6 +37,16 @@ namespace cloudbus::detail {
  * iterable sequence of values using coroutine mechanics (`co_yield`). It is a
  * move-only type, and it is designed to be used with range-based for loops.
  *
+ * Coroutine frames are allocated from a thread-local frame pool. A
+ * different allocator can be supplied by declaring the coroutine with a
+ * leading `std::allocator_arg_t, const Alloc &` parameter pair.
+ *
+ * @par Example:
+ * @code{.cpp}
+ * auto iota(std::allocator_arg_t, const Alloc &alloc, int count)
+ *     -> generator<int>;
+ * @endcode
+ *
  * @tparam T The type of value that the generator will yield. This can be a
  * value, a reference, or a const reference.
  */
@@ -43,6 +57,8 @@ template <typename T> struct generator {
 public:
   /** @brief The type of the value yielded by the generator. */
   using value_type = std::remove_reference_t<T>;
+  /** @brief The type of the values copied out by `next_batch`. */
+  using batch_type = std::remove_cv_t<value_type>;
   /** @brief The reference type of the value yielded by the generator. */
   using reference_type = std::conditional_t<std::is_reference_v<T>, T, T &>;
   /** @brief The pointer type of the value yielded by the generator. */
@@ -59,6 +75,75 @@ public:
    */
   class promise_type {
   public:
+    /**
+     * @brief The awaiter returned by `yield_value`.
+     * @details Suspends the coroutine unless it is filling a batch that
+     * still has room.
+     */
+    struct yield_awaiter {
+      /** @brief Whether the coroutine keeps running. */
+      bool ready;
+
+      /**
+       * @brief Checks whether the coroutine keeps running.
+       * @return True if the coroutine should not suspend.
+       */
+      [[nodiscard]] constexpr auto await_ready() const noexcept -> bool
+      {
+        return ready;
+      }
+
+      /** @brief Suspends the coroutine. */
+      constexpr auto
+      await_suspend(std::coroutine_handle<> /*coro*/) const noexcept -> void
+      {}
+
+      /** @brief Resumes the coroutine. */
+      constexpr auto await_resume() const noexcept -> void {}
+    };
+
+    /**
+     * @brief Allocates the coroutine frame from the thread-local frame pool.
+     * @param size The size of the coroutine frame.
+     * @return A pointer to the coroutine frame.
+     */
+    static auto operator new(std::size_t size) -> void *;
+
+    /**
+     * @brief Allocates the coroutine frame with a user supplied allocator.
+     * @tparam Alloc The type of the allocator.
+     * @tparam Args The types of the remaining coroutine arguments.
+     * @param size The size of the coroutine frame.
+     * @param alloc The allocator to allocate the frame with.
+     * @return A pointer to the coroutine frame.
+     */
+    template <typename Alloc, typename... Args>
+    static auto operator new(std::size_t size, std::allocator_arg_t /*tag*/,
+                             const Alloc &alloc, const Args &.../*args*/)
+        -> void *;
+
+    /**
+     * @brief Allocates the frame of a member function coroutine with a
+     * user supplied allocator.
+     * @tparam This The type of the object that the coroutine is a member of.
+     * @tparam Alloc The type of the allocator.
+     * @tparam Args The types of the remaining coroutine arguments.
+     * @param size The size of the coroutine frame.
+     * @param alloc The allocator to allocate the frame with.
+     * @return A pointer to the coroutine frame.
+     */
+    template <typename This, typename Alloc, typename... Args>
+    static auto operator new(std::size_t size, const This & /*self*/,
+                             std::allocator_arg_t /*tag*/, const Alloc &alloc,
+                             const Args &.../*args*/) -> void *;
+
+    /**
+     * @brief Deallocates the coroutine frame.
+     * @param ptr The coroutine frame.
+     * @param size The size of the coroutine frame.
+     */
+    static auto operator delete(void *ptr, std::size_t size) noexcept -> void;
+
     /**
      * @brief Creates the generator object from the promise.
      * @return The generator object.
@@ -85,13 +170,18 @@ public:
      * @note Coroutines extend the lifetime of temporary values
      * like `prvalues` until the coroutine is resumed or destroyed.
      *
+     * When a batch is being filled, the value is copied into the batch
+     * and the coroutine only suspends once the batch is full. Batches
+     * are only filled for values that can be copy assigned.
+     *
      * @param value The value being yielded.
-     * @return A suspend_always object to suspend execution and return to the
-     * caller.
+     * @return An awaiter that suspends execution and returns to the caller.
      */
     template <typename U>
       requires std::is_same_v<std::remove_reference_t<U>, value_type>
-    auto yield_value(U &&value) noexcept -> std::suspend_always;
+    auto yield_value(U &&value) noexcept(
+        !std::is_copy_assignable_v<batch_type> ||
+        std::is_nothrow_copy_assignable_v<batch_type>) -> yield_awaiter;
 
     /** @brief Handles any unhandled exceptions within the coroutine. */
     auto unhandled_exception() noexcept -> void;
@@ -114,11 +204,27 @@ public:
     /** @brief Rethrows any exception caught by the coroutine. */
     auto rethrow_if_exception() -> void;
 
+    /**
+     * @brief Starts filling a batch.
+     * @param out The batch to fill.
+     */
+    auto begin_batch(std::span<batch_type> out) noexcept -> void;
+
+    /**
+     * @brief Stops filling a batch.
+     * @return The number of values that were copied into the batch.
+     */
+    auto end_batch() noexcept -> std::size_t;
+
   private:
     /** @brief Pointer to the currently yielded value. */
     pointer_type value_{nullptr};
     /** @brief Holds any exception thrown by the coroutine. */
     std::exception_ptr exception_{nullptr};
+    /** @brief The batch that is being filled. */
+    std::span<batch_type> batch_;
+    /** @brief The number of values copied into the batch. */
+    std::size_t count_{0};
   };
 
   /**
@@ -229,6 +335,28 @@ public:
    */
   [[nodiscard]] constexpr auto end() const noexcept -> sentinel_type;
 
+  /**
+   * @brief Copies up to `out.size()` values into a caller supplied batch.
+   *
+   * @details The coroutine is resumed once and runs without suspending
+   * until it has yielded `out.size()` values or has finished, so the cost
+   * of a resume is paid per batch instead of per value. A generator should
+   * be consumed either by iterating over it or by batches, not both.
+   *
+   * @par Example:
+   * @code{.cpp}
+   * auto batch = std::array<int, 32>{};
+   * while (auto n = gen.next_batch(batch))
+   *   process(std::span(batch).first(n));
+   * @endcode
+   *
+   * @param out The batch to fill.
+   * @return The number of values copied into the batch. Zero once the
+   * sequence is exhausted.
+   */
+  auto next_batch(std::span<batch_type> out) -> std::size_t
+    requires std::is_copy_assignable_v<batch_type>;
+
   /** @brief Destructor. */
   ~generator();
 
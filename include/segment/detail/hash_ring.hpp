@@ -0,0 +1,133 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file hash_ring.hpp
+ * @brief This file declares a consistent-hash ring of upstream peers.
+ */
+#pragma once
+#ifndef CLOUDBUS_HASH_RING_HPP
+#define CLOUDBUS_HASH_RING_HPP
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <sys/socket.h>
+namespace cloudbus::detail {
+/**
+ * @brief An immutable consistent-hash ring of upstream peers.
+ *
+ * @details Each member is placed on the ring at `replicas` points that
+ * are derived from its address, and a key belongs to the member that owns
+ * the first point at or after the key's hash. Adding or removing a member
+ * only moves the keys next to that member's points.
+ *
+ * The points are kept in a sorted flat array together with a bucket
+ * table that is indexed by the top bits of the hash. Each bucket holds the
+ * first point of its hash range, so a lookup is a table load followed by
+ * a short forward scan instead of a binary search over the whole ring.
+ */
+class hash_ring {
+public:
+  /** @brief The type of a member address. */
+  using address_type = sockaddr_storage;
+
+  /** @brief The default number of points per member. */
+  static constexpr std::size_t default_replicas = 128;
+
+  /**
+   * @brief Builds the ring.
+   * @param members The addresses of the members.
+   * @param replicas The number of points per member.
+   */
+  explicit hash_ring(std::vector<address_type> members = {},
+                     std::size_t replicas = default_replicas);
+
+  /**
+   * @brief Finds the member that owns a hash.
+   * @param hash The hash of a key, see `hash()`.
+   * @return The index of the owning member in `members()`. The ring must
+   * not be empty.
+   */
+  [[nodiscard]] auto lookup(std::uint64_t hash) const noexcept -> std::size_t;
+
+  /**
+   * @brief Finds a member by its address.
+   * @param address The address of the member.
+   * @return The index of the member in `members()`, or std::nullopt.
+   */
+  [[nodiscard]] auto find(const address_type &address) const noexcept
+      -> std::optional<std::size_t>;
+
+  /**
+   * @brief Gets the members of the ring.
+   * @return The member addresses.
+   */
+  [[nodiscard]] auto members() const noexcept -> std::span<const address_type>;
+
+  /**
+   * @brief Checks whether the ring has no members.
+   * @return True if the ring is empty.
+   */
+  [[nodiscard]] auto empty() const noexcept -> bool;
+
+  /**
+   * @brief Hashes a key.
+   * @param key The key bytes.
+   * @return The 64-bit hash of the key.
+   */
+  [[nodiscard]] static auto
+  hash(std::span<const std::byte> key) noexcept -> std::uint64_t;
+
+  /**
+   * @brief Hashes a key that is split into pieces.
+   * @details The hash of the pieces is the `hash()` of the whole key.
+   */
+  class key_hasher {
+  public:
+    /**
+     * @brief Hashes the next piece of the key.
+     * @param piece The bytes of the piece.
+     * @return A reference to this hasher.
+     */
+    auto update(std::span<const std::byte> piece) noexcept -> key_hasher &;
+
+    /**
+     * @brief Gets the hash of the pieces so far.
+     * @return The 64-bit hash of the key.
+     */
+    [[nodiscard]] auto value() const noexcept -> std::uint64_t;
+
+  private:
+    /** @brief The FNV-1a state. */
+    std::uint64_t state_{0xcbf29ce484222325ULL};
+  };
+
+private:
+  /** @brief The member addresses. */
+  std::vector<address_type> members_;
+  /** @brief The points on the ring in ascending order. */
+  std::vector<std::uint64_t> points_;
+  /** @brief The member index that owns each point. */
+  std::vector<std::uint32_t> owners_;
+  /** @brief The first point of each bucket of the hash space. */
+  std::vector<std::uint32_t> buckets_;
+  /** @brief The shift that maps a hash to its bucket. */
+  unsigned shift_{63};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_HASH_RING_HPP
@@ -0,0 +1,111 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file frame_allocator_impl.hpp
+ * @brief This file defines an allocator for coroutine frames.
+ */
+#pragma once
+#ifndef CLOUDBUS_FRAME_ALLOCATOR_IMPL_HPP
+#define CLOUDBUS_FRAME_ALLOCATOR_IMPL_HPP
+#include "segment/detail/buffer_pool.hpp"
+#include "segment/detail/frame_allocator.hpp"
+
+#include <cstring>
+namespace cloudbus::detail {
+
+constexpr auto frame_allocator::fn_offset(std::size_t size) noexcept
+    -> std::size_t
+{
+  constexpr auto align = alignof(deallocate_fn);
+  return (size + align - 1) & ~(align - 1);
+}
+
+template <typename Alloc>
+constexpr auto frame_allocator::alloc_offset(std::size_t size) noexcept
+    -> std::size_t
+{
+  constexpr auto align = alignof(allocator_type<Alloc>);
+  return (fn_offset(size) + sizeof(deallocate_fn) + align - 1) & ~(align - 1);
+}
+
+template <typename Alloc>
+constexpr auto frame_allocator::blocks(std::size_t size) noexcept
+    -> std::size_t
+{
+  auto bytes = is_stored<Alloc>
+                   ? alloc_offset<Alloc>(size) + sizeof(allocator_type<Alloc>)
+                   : fn_offset(size) + sizeof(deallocate_fn);
+
+  return (bytes + sizeof(block) - 1) / sizeof(block);
+}
+
+template <typename Alloc>
+auto frame_allocator::allocate(const Alloc &alloc, std::size_t size) -> void *
+{
+  auto rebound = allocator_type<Alloc>(alloc);
+  auto *frame = std::allocator_traits<allocator_type<Alloc>>::allocate(
+      rebound, blocks<Alloc>(size));
+  auto *bytes = reinterpret_cast<std::byte *>(frame);
+
+  deallocate_fn fn = &deallocate_with<Alloc>;
+  std::memcpy(bytes + fn_offset(size), &fn, sizeof(fn));
+
+  if constexpr (is_stored<Alloc>)
+  {
+    ::new (bytes + alloc_offset<Alloc>(size))
+        allocator_type<Alloc>(std::move(rebound));
+  }
+
+  return frame;
+}
+
+inline auto frame_allocator::allocate(std::size_t size) -> void *
+{
+  return allocate(pool_allocator<block>{}, size);
+}
+
+inline auto frame_allocator::deallocate(void *frame,
+                                        std::size_t size) noexcept -> void
+{
+  auto fn = deallocate_fn{};
+  std::memcpy(&fn, static_cast<std::byte *>(frame) + fn_offset(size),
+              sizeof(fn));
+  fn(frame, size);
+}
+
+template <typename Alloc>
+auto frame_allocator::deallocate_with(void *frame, std::size_t size) noexcept
+    -> void
+{
+  using traits = std::allocator_traits<allocator_type<Alloc>>;
+  auto *blocks_ptr = static_cast<block *>(frame);
+
+  if constexpr (is_stored<Alloc>)
+  {
+    auto *stored = std::launder(reinterpret_cast<allocator_type<Alloc> *>(
+        static_cast<std::byte *>(frame) + alloc_offset<Alloc>(size)));
+    auto alloc = std::move(*stored);
+    std::destroy_at(stored);
+    traits::deallocate(alloc, blocks_ptr, blocks<Alloc>(size));
+  }
+  else
+  {
+    auto alloc = allocator_type<Alloc>{};
+    traits::deallocate(alloc, blocks_ptr, blocks<Alloc>(size));
+  }
+}
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_FRAME_ALLOCATOR_IMPL_HPP
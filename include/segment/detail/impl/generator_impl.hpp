@@ -23,6 +23,43 @@
 #include "segment/detail/generator.hpp"
 namespace cloudbus::detail {
 
+template <typename T>
+auto generator<T>::promise_type::operator new(std::size_t size) -> void *
+{
+  return frame_allocator::allocate(size);
+}
+
+template <typename T>
+template <typename Alloc, typename... Args>
+auto generator<T>::promise_type::operator new(std::size_t size,
+                                              std::allocator_arg_t /*tag*/,
+                                              const Alloc &alloc,
+                                              const Args &.../*args*/)
+    -> void *
+{
+  return frame_allocator::allocate(alloc, size);
+}
+
+template <typename T>
+template <typename This, typename Alloc, typename... Args>
+auto generator<T>::promise_type::operator new(std::size_t size,
+                                              const This & /*self*/,
+                                              std::allocator_arg_t /*tag*/,
+                                              const Alloc &alloc,
+                                              const Args &.../*args*/)
+    -> void *
+{
+  return frame_allocator::allocate(alloc, size);
+}
+
+template <typename T>
+auto generator<T>::promise_type::operator delete(void *ptr,
+                                                 std::size_t size) noexcept
+    -> void
+{
+  frame_allocator::deallocate(ptr, size);
+}
+
 template <typename T>
 auto generator<T>::promise_type::get_return_object() noexcept -> generator<T>
 {
@@ -48,11 +85,22 @@ template <typename U>
   requires std::is_same_v<std::remove_reference_t<U>,
                           typename generator<T>::value_type>
 // NOLINTNEXTLINE(cppcoreguidelines-missing-std-forward)
-auto generator<T>::promise_type::yield_value(U &&value) noexcept
-    -> std::suspend_always
+auto generator<T>::promise_type::yield_value(U &&value) noexcept(
+    !std::is_copy_assignable_v<batch_type> ||
+    std::is_nothrow_copy_assignable_v<batch_type>) -> yield_awaiter
 {
+  // Only next_batch() fills a batch, and it requires copyable values.
+  if constexpr (std::is_copy_assignable_v<batch_type>)
+  {
+    if (!batch_.empty())
+    {
+      batch_[count_++] = value;
+      return {.ready = count_ < batch_.size()};
+    }
+  }
+
   value_ = std::addressof(value);
-  return {};
+  return {.ready = false};
 }
 
 template <typename T>
@@ -74,6 +122,21 @@ auto generator<T>::promise_type::rethrow_if_exception() -> void
     std::rethrow_exception(exception_);
 }
 
+template <typename T>
+auto generator<T>::promise_type::begin_batch(std::span<batch_type> out) noexcept
+    -> void
+{
+  batch_ = out;
+  count_ = 0;
+}
+
+template <typename T>
+auto generator<T>::promise_type::end_batch() noexcept -> std::size_t
+{
+  batch_ = {};
+  return count_;
+}
+
 template <typename T>
 generator<T>::iterator::iterator(coroutine_handle coro) noexcept
     : coroutine_{std::move(coro)}
@@ -145,6 +208,24 @@ template <typename T>
   return {};
 }
 
+template <typename T>
+auto generator<T>::next_batch(std::span<batch_type> out) -> std::size_t
+  requires std::is_copy_assignable_v<batch_type>
+{
+  if (!coroutine_ || coroutine_.done() || out.empty())
+    return 0;
+
+  auto &promise = coroutine_.promise();
+  promise.begin_batch(out);
+  coroutine_.resume();
+
+  auto count = promise.end_batch();
+  if (coroutine_.done())
+    promise.rethrow_if_exception();
+
+  return count;
+}
+
 template <typename T> generator<T>::~generator()
 {
   if (coroutine_)
@@ -0,0 +1,133 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file pipeline_impl.hpp
+ * @brief This file defines the compile-time composition of message
+ * handling stages.
+ */
+#pragma once
+#ifndef CLOUDBUS_PIPELINE_IMPL_HPP
+#define CLOUDBUS_PIPELINE_IMPL_HPP
+#include "segment/detail/pipeline.hpp"
+
+#include <utility>
+namespace cloudbus::detail {
+
+template <typename... Stages>
+constexpr pipeline<Stages...>::pipeline(Stages... stages) noexcept(
+    (std::is_nothrow_move_constructible_v<Stages> && ...))
+    : stages_{std::move(stages)...}
+{}
+
+template <typename... Stages>
+template <typename... Args>
+constexpr auto
+pipeline<Stages...>::operator()(Args &&...args) -> decltype(auto)
+{
+  return invoke<0>(std::forward<Args>(args)...);
+}
+
+template <typename... Stages>
+template <std::size_t I, typename... Args>
+constexpr auto pipeline<Stages...>::invoke(Args &&...args) -> decltype(auto)
+{
+  if constexpr (I == size)
+  {
+    ((void)args, ...);
+  }
+  else
+  {
+    auto next = [this](auto &&...rest) -> decltype(auto) {
+      return invoke<I + 1>(std::forward<decltype(rest)>(rest)...);
+    };
+    return std::get<I>(stages_)(next, std::forward<Args>(args)...);
+  }
+}
+
+template <typename Parser>
+template <typename Next, typename Owner>
+auto framing_stage<Parser>::operator()(
+    Next &&next, const Owner &owner,
+    std::span<const std::byte> buf) -> std::error_code
+{
+  auto buffer = write_queue::owner_type(owner);
+  for (const auto &frame : parser_->parse(buf, buffer))
+  {
+    // The head of a split frame is not owned by this read buffer.
+    auto head = write_queue::owner_type(parser_->owner());
+    if (head)
+      next(std::move(head), frame);
+    else
+      next(buffer, frame);
+  }
+
+  return parser_->error();
+}
+
+template <typename Next, typename Owner>
+auto unframed_stage::operator()(
+    Next &&next, const Owner &owner,
+    std::span<const std::byte> buf) -> std::error_code
+{
+  next(write_queue::owner_type(owner), frame_view(buf));
+  return {};
+}
+
+template <typename Next, typename... Args>
+auto counting_stage::operator()(Next &&next,
+                                Args &&...args) -> decltype(auto)
+{
+  metrics::local().add(counter_);
+  return next(std::forward<Args>(args)...);
+}
+
+template <typename Next>
+auto limiting_stage::operator()(Next &&next, write_queue::owner_type owner,
+                                const frame_view &frame) -> void
+{
+  limiter_->charge(frame.size(), now_);
+  next(std::move(owner), frame);
+}
+
+template <typename Next>
+auto enqueue_stage::operator()(Next && /*next*/,
+                               write_queue::owner_type owner,
+                               const frame_view &frame) -> void
+{
+  queue_->push_frame(std::move(owner), frame, queued_);
+}
+
+template <typename... Stages>
+template <typename Framing, typename... Last>
+constexpr auto message_path<Stages...>::compose(const stage_context &ctx,
+                                                Framing framing, Last... last)
+{
+  return pipeline(std::move(framing), make<Stages>(ctx)...,
+                  std::move(last)...);
+}
+
+template <typename... Stages>
+template <typename Stage>
+constexpr auto message_path<Stages...>::make(const stage_context &ctx)
+    -> Stage
+{
+  if constexpr (std::is_constructible_v<Stage, const stage_context &>)
+    return Stage(ctx);
+  else
+    return Stage{};
+}
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_PIPELINE_IMPL_HPP
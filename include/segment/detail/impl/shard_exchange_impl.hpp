@@ -0,0 +1,37 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file shard_exchange_impl.hpp
+ * @brief This file defines the templates of the exchange between
+ * reactors.
+ */
+#pragma once
+#ifndef CLOUDBUS_SHARD_EXCHANGE_IMPL_HPP
+#define CLOUDBUS_SHARD_EXCHANGE_IMPL_HPP
+#include "segment/detail/shard_exchange.hpp"
+namespace cloudbus::detail {
+
+template <typename Fn>
+  requires std::invocable<Fn &, shard_message &&>
+auto shard_exchange::receive(std::size_t shard, Fn &&fn) -> std::size_t
+{
+  auto count = std::size_t{0};
+  for (std::size_t from = 0; from < shards_; ++from)
+    count += ring(from, shard).drain(fn);
+  return count;
+}
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_SHARD_EXCHANGE_IMPL_HPP
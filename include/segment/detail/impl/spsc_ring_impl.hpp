@@ -0,0 +1,118 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file spsc_ring_impl.hpp
+ * @brief This file defines a bounded single-producer single-consumer
+ * ring buffer.
+ */
+#pragma once
+#ifndef CLOUDBUS_SPSC_RING_IMPL_HPP
+#define CLOUDBUS_SPSC_RING_IMPL_HPP
+#include "segment/detail/spsc_ring.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+namespace cloudbus::detail {
+
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+spsc_ring<T>::spsc_ring(std::size_t capacity)
+    : mask_{std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1},
+      slots_{std::make_unique<T[]>(mask_ + 1)}
+{}
+
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+auto spsc_ring<T>::try_push(T &value) noexcept(
+    std::is_nothrow_move_assignable_v<T>) -> bool
+{
+  auto tail = producer_.tail.load(std::memory_order_relaxed);
+  if (tail - producer_.head > mask_)
+  {
+    producer_.head = consumer_.head.load(std::memory_order_acquire);
+    if (tail - producer_.head > mask_)
+      return false;
+  }
+
+  slots_[tail & mask_] = std::move(value);
+  producer_.tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+auto spsc_ring<T>::try_push(std::span<T> values) noexcept(
+    std::is_nothrow_move_assignable_v<T>) -> bool
+{
+  auto tail = producer_.tail.load(std::memory_order_relaxed);
+  if (tail + values.size() - producer_.head > mask_ + 1)
+  {
+    producer_.head = consumer_.head.load(std::memory_order_acquire);
+    if (tail + values.size() - producer_.head > mask_ + 1)
+      return false;
+  }
+
+  for (auto &value : values)
+    slots_[tail++ & mask_] = std::move(value);
+  producer_.tail.store(tail, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+auto spsc_ring<T>::try_pop(T &value) noexcept(
+    std::is_nothrow_move_assignable_v<T>) -> bool
+{
+  auto head = consumer_.head.load(std::memory_order_relaxed);
+  if (head == consumer_.tail)
+  {
+    consumer_.tail = producer_.tail.load(std::memory_order_acquire);
+    if (head == consumer_.tail)
+      return false;
+  }
+
+  value = std::exchange(slots_[head & mask_], T{});
+  consumer_.head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+template <typename Fn>
+  requires std::invocable<Fn &, T &&>
+auto spsc_ring<T>::drain(Fn &&fn) -> std::size_t
+{
+  auto head = consumer_.head.load(std::memory_order_relaxed);
+  consumer_.tail = producer_.tail.load(std::memory_order_acquire);
+
+  auto count = consumer_.tail - head;
+  for (; head != consumer_.tail; ++head)
+    fn(std::exchange(slots_[head & mask_], T{}));
+
+  consumer_.head.store(head, std::memory_order_release);
+  return count;
+}
+
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+auto spsc_ring<T>::empty() const noexcept -> bool
+{
+  return consumer_.head.load(std::memory_order_relaxed) ==
+         producer_.tail.load(std::memory_order_acquire);
+}
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_SPSC_RING_IMPL_HPP
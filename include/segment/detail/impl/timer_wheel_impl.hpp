@@ -0,0 +1,78 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file timer_wheel_impl.hpp
+ * @brief This file defines a hierarchical timing wheel.
+ */
+#pragma once
+#ifndef CLOUDBUS_TIMER_WHEEL_IMPL_HPP
+#define CLOUDBUS_TIMER_WHEEL_IMPL_HPP
+#include "segment/detail/timer_wheel.hpp"
+
+#include <bit>
+namespace cloudbus::detail {
+
+template <typename Fn>
+auto timer_wheel::advance(clock_type::time_point now,
+                          Fn &&fn) -> std::size_t
+{
+  constexpr auto mask = slots - 1;
+  const auto target = tick(now);
+  auto expired = std::size_t{0};
+
+  while (now_ < target)
+  {
+    // Nothing can expire before the target, so skip straight to it.
+    if (!size_)
+    {
+      now_ = target;
+      break;
+    }
+
+    // Skip to the next tick that has timers or starts a rotation.
+    auto index = now_ & mask;
+    auto later = occupied_[0] & ~((2ULL << index) - 1);
+    auto next = later ? (now_ - index) + std::countr_zero(later)
+                      : (now_ | mask) + 1;
+    if (next > target)
+    {
+      now_ = target;
+      break;
+    }
+    now_ = next;
+
+    // At the start of a slot of a higher level, its timers move down,
+    // starting from the highest level that wrapped.
+    auto wrapped = std::size_t{0};
+    while (wrapped + 1 < levels &&
+           !(now_ & ((1ULL << (slot_bits * (wrapped + 1))) - 1)))
+    {
+      ++wrapped;
+    }
+    for (auto level = wrapped; level > 0; --level)
+      cascade(level, (now_ >> (slot_bits * level)) & mask);
+
+    while (auto *t = pop(0, now_ & mask))
+    {
+      ++expired;
+      fn(*t);
+    }
+  }
+
+  return expired;
+}
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_TIMER_WHEEL_IMPL_HPP
@@ -0,0 +1,66 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file listener_handoff.hpp
+ * @brief This file declares the handoff of listening sockets between
+ * processes.
+ */
+#pragma once
+#ifndef CLOUDBUS_LISTENER_HANDOFF_HPP
+#define CLOUDBUS_LISTENER_HANDOFF_HPP
+#include <cstddef>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include <sys/socket.h>
+namespace cloudbus::detail {
+/** @brief The largest number of sockets that can be handed off at once. */
+inline constexpr std::size_t max_handoff_sockets = 253;
+
+/**
+ * @brief Sends listening sockets to another process.
+ * @details The sockets are passed as SCM_RIGHTS ancillary data on a
+ * Unix-domain stream socket, so the receiving process shares their open
+ * file descriptions, including the connections that are waiting in their
+ * accept queues. The sockets stay open in the sending process.
+ * @param sock The connected Unix-domain socket to send on.
+ * @param fds The listening sockets, at most `max_handoff_sockets`.
+ * @return An error code if the sockets could not be sent.
+ */
+auto send_listeners(int sock, std::span<const int> fds) noexcept
+    -> std::error_code;
+
+/**
+ * @brief Receives listening sockets that were sent by `send_listeners`.
+ * @details The received sockets are close-on-exec.
+ * @param sock The connected Unix-domain socket to receive on.
+ * @param fds Set to the received sockets, in the order they were sent.
+ * @return An error code if no sockets could be received.
+ */
+auto receive_listeners(int sock, std::vector<int> &fds) -> std::error_code;
+
+/**
+ * @brief Checks whether a socket is bound to an address.
+ * @param fd The socket.
+ * @param address The address.
+ * @return True if `fd` is bound to the same family, address and port as
+ * `address`, or the same path for Unix-domain sockets.
+ */
+[[nodiscard]] auto is_bound_to(int fd, const sockaddr_storage &address) noexcept
+    -> bool;
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_LISTENER_HANDOFF_HPP
@@ -0,0 +1,148 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file memory_budget.hpp
+ * @brief This file declares the accounting of buffer memory.
+ */
+#pragma once
+#ifndef CLOUDBUS_MEMORY_BUDGET_HPP
+#define CLOUDBUS_MEMORY_BUDGET_HPP
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+namespace cloudbus::detail {
+/**
+ * @brief A cap on the buffer memory of all reactors.
+ *
+ * @details Reactors charge the budget for the buffers that they hold and
+ * stop reading from connections while it is exhausted. The budget is
+ * not a hard limit: it is charged after the memory has been allocated,
+ * so the reactors can overshoot it by the buffers that they are reading
+ * into when it runs out.
+ */
+class memory_budget {
+public:
+  /**
+   * @brief Constructs the budget.
+   * @param limit The number of bytes at which the budget is exhausted.
+   */
+  explicit memory_budget(std::size_t limit) noexcept : limit_{limit} {}
+
+  /**
+   * @brief Charges bytes to the budget.
+   * @param bytes The number of bytes.
+   */
+  auto charge(std::size_t bytes) noexcept -> void
+  {
+    used_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns bytes to the budget.
+   * @param bytes The number of bytes that were charged.
+   */
+  auto release(std::size_t bytes) noexcept -> void
+  {
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Gets the number of charged bytes.
+   * @return The charged bytes.
+   */
+  [[nodiscard]] auto used() const noexcept -> std::size_t
+  {
+    return used_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Gets the limit of the budget.
+   * @return The number of bytes at which the budget is exhausted.
+   */
+  [[nodiscard]] auto limit() const noexcept -> std::size_t { return limit_; }
+
+  /**
+   * @brief Checks whether the budget is exhausted.
+   * @return True if at least `limit()` bytes are charged.
+   */
+  [[nodiscard]] auto exhausted() const noexcept -> bool
+  {
+    return used() >= limit_;
+  }
+
+private:
+  /** @brief The number of bytes at which the budget is exhausted. */
+  std::size_t limit_;
+  /** @brief The number of charged bytes. */
+  std::atomic<std::size_t> used_{0};
+};
+
+/**
+ * @brief The buffer memory held by one connection.
+ * @details An account charges the optional shared budget along with
+ * itself. Buffers may be released by another reactor than the one that
+ * read them, so the account is atomic.
+ */
+class memory_account {
+public:
+  /**
+   * @brief Constructs the account.
+   * @param budget The budget to charge, or nullptr.
+   */
+  explicit memory_account(std::shared_ptr<memory_budget> budget = {}) noexcept
+      : budget_{std::move(budget)}
+  {}
+
+  /**
+   * @brief Charges bytes to the account.
+   * @param bytes The number of bytes.
+   */
+  auto charge(std::size_t bytes) noexcept -> void
+  {
+    used_.fetch_add(bytes, std::memory_order_relaxed);
+    if (budget_)
+      budget_->charge(bytes);
+  }
+
+  /**
+   * @brief Returns bytes to the account.
+   * @param bytes The number of bytes that were charged.
+   */
+  auto release(std::size_t bytes) noexcept -> void
+  {
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+    if (budget_)
+      budget_->release(bytes);
+  }
+
+  /**
+   * @brief Gets the number of bytes held by the connection.
+   * @return The charged bytes.
+   */
+  [[nodiscard]] auto used() const noexcept -> std::size_t
+  {
+    return used_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /** @brief The budget shared by all reactors. */
+  std::shared_ptr<memory_budget> budget_;
+  /** @brief The number of charged bytes. */
+  std::atomic<std::size_t> used_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_MEMORY_BUDGET_HPP
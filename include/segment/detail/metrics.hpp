@@ -0,0 +1,238 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file metrics.hpp
+ * @brief This file declares per-thread counters and latency histograms.
+ */
+#pragma once
+#ifndef CLOUDBUS_METRICS_HPP
+#define CLOUDBUS_METRICS_HPP
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+namespace cloudbus::detail {
+/**
+ * @brief A histogram of values in log-linear buckets.
+ *
+ * @details Like an HDR histogram, the values below `2 * sub_buckets` are
+ * counted exactly, and every following power of two is split into
+ * `sub_buckets` buckets of equal width, so a value is never off by more
+ * than `1 / sub_buckets` of itself. Recording a value is a couple of
+ * shifts and one store.
+ *
+ * A histogram has a single writer. The counts are read and written
+ * atomically, so other threads can merge a histogram while it is being
+ * written to.
+ */
+class histogram {
+public:
+  /** @brief The log2 of the number of buckets per power of two. */
+  static constexpr unsigned sub_bits = 5;
+  /** @brief The number of buckets per power of two. */
+  static constexpr std::size_t sub_buckets = 1UL << sub_bits;
+  /** @brief The number of buckets that cover all 64-bit values. */
+  static constexpr std::size_t buckets = (64 - sub_bits + 1) * sub_buckets;
+
+  /**
+   * @brief Gets the bucket of a value.
+   * @param value The value.
+   * @return The index of the bucket that counts `value`.
+   */
+  [[nodiscard]] static constexpr auto
+  index(std::uint64_t value) noexcept -> std::size_t
+  {
+    auto width = static_cast<unsigned>(std::bit_width(value));
+    auto shift = width > sub_bits + 1 ? width - sub_bits - 1 : 0U;
+    return (shift * sub_buckets) + (value >> shift);
+  }
+
+  /**
+   * @brief Gets the largest value that is counted by a bucket.
+   * @param index The index of the bucket.
+   * @return The largest value of the bucket.
+   */
+  [[nodiscard]] static constexpr auto
+  highest(std::size_t index) noexcept -> std::uint64_t
+  {
+    if (index < 2 * sub_buckets)
+      return index;
+
+    auto shift = (index / sub_buckets) - 1;
+    auto mantissa = index - (shift * sub_buckets);
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+  /**
+   * @brief Counts a value.
+   * @param value The value to count.
+   */
+  auto record(std::uint64_t value) noexcept -> void
+  {
+    auto count = std::atomic_ref(counts_[index(value)]);
+    count.store(count.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Adds the counts of another histogram to this one.
+   * @param other The histogram to add.
+   */
+  auto merge(const histogram &other) noexcept -> void;
+
+  /**
+   * @brief Gets the number of counted values.
+   * @return The total count.
+   */
+  [[nodiscard]] auto count() const noexcept -> std::uint64_t;
+
+  /**
+   * @brief Gets a percentile of the counted values.
+   * @param quantile The quantile, between 0 and 1.
+   * @return The largest value of the bucket that holds the quantile, or
+   * 0 if the histogram is empty.
+   */
+  [[nodiscard]] auto
+  percentile(double quantile) const noexcept -> std::uint64_t;
+
+private:
+  /** @brief The counts per bucket. */
+  std::array<std::uint64_t, buckets> counts_{};
+};
+
+/**
+ * @brief The hot path counters and latencies of every thread.
+ *
+ * @details Each thread writes to its own cache-line aligned slot (see
+ * `local()`), so counting an event is a plain store to memory that no
+ * other thread writes to. The slots are only summed up when a snapshot
+ * is taken by `collect()`. Slots outlive their threads so that their
+ * counts are not lost.
+ */
+class metrics {
+public:
+  /** @brief The counted events. */
+  enum class counter : std::uint8_t {
+    /** @brief The number of bytes read. */
+    bytes_read,
+    /** @brief The number of bytes written. */
+    bytes_written,
+    /** @brief The number of messages read. */
+    messages,
+    /** @brief The number of sendmsg calls. */
+    sendmsg_calls,
+    /** @brief The number of writes that did not write all their bytes. */
+    short_writes,
+    /** @brief The number of failed I/O operations. */
+    errors,
+    /** @brief The number of connections that admission control closed. */
+    rejected,
+    /** @brief The number of reads paused by a rate limit. */
+    throttled,
+    /** @brief The number of connections closed by a timeout. */
+    timeouts,
+    /** @brief The number of messages or reads dropped past their deadline. */
+    expired,
+    /** @brief The number of messages handed to another reactor. */
+    handoffs,
+    /** @brief The number of counters. */
+    count
+  };
+
+  /** @brief The number of counters. */
+  static constexpr std::size_t counters =
+      static_cast<std::size_t>(counter::count);
+
+  /** @brief The counters and latencies of one thread. */
+  struct alignas(64) slot {
+    /**
+     * @brief Counts events.
+     * @param event The counted event.
+     * @param n The number of events.
+     */
+    auto add(counter event, std::uint64_t n = 1) noexcept -> void
+    {
+      auto value = std::atomic_ref(values[static_cast<std::size_t>(event)]);
+      value.store(value.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records the latency between reading a message and sending
+     * its reply.
+     * @param elapsed The latency.
+     */
+    auto record(std::chrono::nanoseconds elapsed) noexcept -> void
+    {
+      latency.record(static_cast<std::uint64_t>(elapsed.count()));
+    }
+
+    /** @brief The counter values. */
+    std::array<std::uint64_t, counters> values{};
+    /** @brief The read to send latencies in nanoseconds. */
+    histogram latency;
+  };
+
+  /** @brief The sum of all slots. */
+  struct snapshot {
+    /**
+     * @brief Gets a counter value.
+     * @param event The counted event.
+     * @return The sum of the counter over all threads.
+     */
+    [[nodiscard]] auto operator[](counter event) const noexcept -> std::uint64_t
+    {
+      return values[static_cast<std::size_t>(event)];
+    }
+
+    /**
+     * @brief Writes the snapshot as one `name value` pair per line.
+     * @param os The stream to write to.
+     */
+    auto print(std::ostream &os) const -> void;
+
+    /** @brief The counter values. */
+    std::array<std::uint64_t, counters> values{};
+    /** @brief The read to send latencies in nanoseconds. */
+    histogram latency;
+  };
+
+  /**
+   * @brief Gets the slot of the calling thread.
+   * @details The slot is registered on first use.
+   * @return The thread-local slot.
+   */
+  static auto local() -> slot &;
+
+  /**
+   * @brief Sums up the slots of all threads.
+   * @return The snapshot.
+   */
+  static auto collect() -> snapshot;
+
+  /**
+   * @brief Gets the name of a counter.
+   * @param event The counted event.
+   * @return The name of the counter.
+   */
+  [[nodiscard]] static auto name(counter event) noexcept -> std::string_view;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_METRICS_HPP
@@ -0,0 +1,77 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file mux_frame.hpp
+ * @brief This file declares the frames that are multiplexed upstream.
+ */
+#pragma once
+#ifndef CLOUDBUS_MUX_FRAME_HPP
+#define CLOUDBUS_MUX_FRAME_HPP
+#include "segment/detail/frame_parser.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+namespace cloudbus::detail {
+/**
+ * @brief A message of one stream on a multiplexed upstream connection.
+ *
+ * @details Messages from many downstream connections share one upstream
+ * connection. Each message is wrapped in a length-prefixed frame whose
+ * payload starts with the 4 byte big-endian id of its stream, followed by
+ * the message as it was received. The header is written with its own
+ * buffer in front of the message, so the message itself is not copied.
+ * Replies are expected in the same format and are routed back to the
+ * downstream connection of their stream.
+ */
+struct mux_frame {
+  /** @brief The type of a contiguous buffer. */
+  using buffer_type = std::span<const std::byte>;
+
+  /** @brief The size of the multiplexing header. */
+  static constexpr std::size_t header_size = frame_parser::header_size + 4;
+  /** @brief The type of an encoded header. */
+  using header_type = std::array<std::byte, header_size>;
+
+  /** @brief The id of the stream that the message belongs to. */
+  std::uint32_t stream;
+  /** @brief The message. */
+  frame_view payload;
+
+  /**
+   * @brief Encodes the header of a multiplexed message.
+   * @param stream The id of the stream of the message.
+   * @param size The size of the message.
+   * @return The header to write in front of the message.
+   */
+  [[nodiscard]] static auto header(std::uint32_t stream,
+                                   std::size_t size) noexcept -> header_type;
+
+  /**
+   * @brief Decodes a multiplexed message.
+   * @details The header must lie in the head of the frame, which a
+   * frame_parser with a head size of at least `header_size` guarantees.
+   * @param frame A complete frame yielded by frame_parser.
+   * @return The message, or std::nullopt if the frame is too short to
+   * hold a stream id.
+   */
+  [[nodiscard]] static auto
+  parse(const frame_view &frame) noexcept -> std::optional<mux_frame>;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_MUX_FRAME_HPP
@@ -0,0 +1,326 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file pipeline.hpp
+ * @brief This file declares the compile-time composition of message
+ * handling stages.
+ */
+#pragma once
+#ifndef CLOUDBUS_PIPELINE_HPP
+#define CLOUDBUS_PIPELINE_HPP
+#include "segment/detail/admission.hpp"
+#include "segment/detail/metrics.hpp"
+#include "segment/detail/write_queue.hpp"
+
+#include <cstddef>
+#include <span>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+namespace cloudbus::detail {
+/**
+ * @brief A chain of message handling stages that is fixed at compile time.
+ *
+ * @details A stage is any callable that is called as
+ * `stage(next, args...)`, where `next` calls the rest of the chain. A
+ * stage can call `next` any number of times and with different arguments
+ * than it was called with, e.g. a framing stage takes a read buffer and
+ * calls `next` once per frame, a filter stage calls it only for some
+ * messages, and the last stage ignores it. Because `next` is a distinct
+ * type for every position in the chain, all the calls are direct and
+ * a message goes through the whole chain in one inlined loop, without
+ * virtual dispatch or type-erased callbacks.
+ *
+ * ```cpp
+ * auto queue = write_queue{};
+ * auto handle = pipeline(framing_stage(parser),
+ *                        counting_stage(metrics::counter::messages),
+ *                        enqueue_stage(queue));
+ * if (auto error = handle(rctx, buf))
+ *   return drop();
+ * ```
+ * @tparam Stages The types of the stages, in the order that they run.
+ */
+template <typename... Stages> class pipeline {
+public:
+  /** @brief The number of stages. */
+  static constexpr std::size_t size = sizeof...(Stages);
+
+  /**
+   * @brief Composes the stages.
+   * @param stages The stages, in the order that they run.
+   */
+  constexpr explicit pipeline(Stages... stages) noexcept(
+      (std::is_nothrow_move_constructible_v<Stages> && ...));
+
+  /**
+   * @brief Runs a message through the stages.
+   * @tparam Args The types of the arguments of the first stage.
+   * @param args The arguments of the first stage.
+   * @return What the first stage returns.
+   */
+  template <typename... Args>
+  constexpr auto operator()(Args &&...args) -> decltype(auto);
+
+  /**
+   * @brief Gets a stage.
+   * @tparam I The position of the stage.
+   * @return The stage.
+   */
+  template <std::size_t I>
+  [[nodiscard]] constexpr auto get() noexcept -> auto &
+  {
+    return std::get<I>(stages_);
+  }
+
+private:
+  /**
+   * @brief Runs a message through the stages from a position onwards.
+   * @details Past the last stage, the message is dropped.
+   * @tparam I The position of the stage to run.
+   * @tparam Args The types of the arguments of the stage.
+   * @param args The arguments of the stage.
+   * @return What the stage returns.
+   */
+  template <std::size_t I, typename... Args>
+  constexpr auto invoke(Args &&...args) -> decltype(auto);
+
+  /** @brief The stages. */
+  std::tuple<Stages...> stages_;
+};
+
+/** @brief What the stages of a message path are built from. */
+struct stage_context {
+  /** @brief The rate limits of the connection. */
+  rate_limiter &limiter;
+  /** @brief The time that the messages were read at. */
+  rate_limiter::clock_type::time_point now;
+};
+
+/**
+ * @brief The stage that splits a read buffer into frames.
+ * @details The stage is called with the owner of the read buffer and the
+ * bytes that were read, and calls the next stage with the owner of the
+ * head of each complete frame and the frame. The read buffer is handed
+ * to the parser with its owner, so split frames are not copied. It
+ * returns the error of the parser.
+ * @tparam Parser The frame parser type, e.g. frame_parser.
+ */
+template <typename Parser> class framing_stage {
+public:
+  /**
+   * @brief Constructs the stage.
+   * @param parser The frame parser of the connection.
+   */
+  constexpr explicit framing_stage(Parser &parser) noexcept
+      : parser_{&parser}
+  {}
+
+  /**
+   * @brief Splits a read buffer into frames.
+   * @tparam Next The type of the rest of the pipeline.
+   * @tparam Owner The type of the owner of the read buffer.
+   * @param next The rest of the pipeline.
+   * @param owner The owner of the read buffer.
+   * @param buf The bytes that were read.
+   * @return The parse error, if any.
+   */
+  template <typename Next, typename Owner>
+  auto operator()(Next &&next, const Owner &owner,
+                  std::span<const std::byte> buf) -> std::error_code;
+
+private:
+  /** @brief The frame parser of the connection. */
+  Parser *parser_;
+};
+
+/**
+ * @brief The stage that passes a read buffer on as a single frame.
+ * @details This is the framing stage of unframed streams. It has the same
+ * signature as framing_stage and never fails.
+ */
+struct unframed_stage {
+  /**
+   * @brief Passes the read buffer on.
+   * @tparam Next The type of the rest of the pipeline.
+   * @tparam Owner The type of the owner of the read buffer.
+   * @param next The rest of the pipeline.
+   * @param owner The owner of the read buffer.
+   * @param buf The bytes that were read.
+   * @return An empty error code.
+   */
+  template <typename Next, typename Owner>
+  auto operator()(Next &&next, const Owner &owner,
+                  std::span<const std::byte> buf) -> std::error_code;
+};
+
+/** @brief The stage that counts the messages that pass through it. */
+class counting_stage {
+public:
+  /**
+   * @brief Constructs the stage.
+   * @param counter The counter of the thread's metrics to add to.
+   */
+  constexpr explicit counting_stage(
+      metrics::counter counter = metrics::counter::messages) noexcept
+      : counter_{counter}
+  {}
+
+  /**
+   * @brief Counts a message and passes it on.
+   * @tparam Next The type of the rest of the pipeline.
+   * @tparam Args The types of the message.
+   * @param next The rest of the pipeline.
+   * @param args The message.
+   * @return What the rest of the pipeline returns.
+   */
+  template <typename Next, typename... Args>
+  auto operator()(Next &&next, Args &&...args) -> decltype(auto);
+
+private:
+  /** @brief The counter to add to. */
+  metrics::counter counter_;
+};
+
+/**
+ * @brief The stage that charges messages to the rate limits.
+ * @details Messages that have been framed are never dropped. Those over
+ * the limits leave the limiter in debt, and the connection stops reading
+ * until `rate_limiter::ready()` is true again.
+ */
+class limiting_stage {
+public:
+  /** @brief The clock of the rate limits. */
+  using clock_type = rate_limiter::clock_type;
+
+  /**
+   * @brief Constructs the stage.
+   * @param limiter The rate limits of the connection.
+   * @param now The time that the messages were read at.
+   */
+  constexpr limiting_stage(rate_limiter &limiter,
+                           clock_type::time_point now) noexcept
+      : limiter_{&limiter}, now_{now}
+  {}
+
+  /**
+   * @brief Constructs the stage of a message path.
+   * @param ctx The connection and read time of the messages.
+   */
+  constexpr explicit limiting_stage(const stage_context &ctx) noexcept
+      : limiting_stage(ctx.limiter, ctx.now)
+  {}
+
+  /**
+   * @brief Charges a message to the rate limits and passes it on.
+   * @tparam Next The type of the rest of the pipeline.
+   * @param next The rest of the pipeline.
+   * @param owner The owner of the head of the message.
+   * @param frame The message.
+   */
+  template <typename Next>
+  auto operator()(Next &&next, write_queue::owner_type owner,
+                  const frame_view &frame) -> void;
+
+private:
+  /** @brief The rate limits of the connection. */
+  rate_limiter *limiter_;
+  /** @brief The time that the messages were read at. */
+  clock_type::time_point now_;
+};
+
+/**
+ * @brief The stage that queues messages on a write queue.
+ * @details This is a last stage, so it does not call the next stage.
+ */
+class enqueue_stage {
+public:
+  /**
+   * @brief Constructs the stage.
+   * @param queue The queue to push messages to.
+   * @param queued When the messages were read, or the epoch if they are
+   * not timed.
+   */
+  constexpr explicit enqueue_stage(
+      write_queue &queue,
+      write_queue::clock_type::time_point queued = {}) noexcept
+      : queue_{&queue}, queued_{queued}
+  {}
+
+  /**
+   * @brief Queues a message.
+   * @tparam Next The type of the rest of the pipeline.
+   * @param next The rest of the pipeline, which is not called.
+   * @param owner The owner of the head of the message.
+   * @param frame The message.
+   */
+  template <typename Next>
+  auto operator()(Next &&next, write_queue::owner_type owner,
+                  const frame_view &frame) -> void;
+
+private:
+  /** @brief The queue to push messages to. */
+  write_queue *queue_;
+  /** @brief When the messages were read. */
+  write_queue::clock_type::time_point queued_;
+};
+
+/**
+ * @brief The stages that a message goes through between its framing and
+ * its delivery.
+ *
+ * @details A message path is a type, so a service that is given one
+ * builds the same inlined pipeline for every read, and only runs the
+ * stages that its deployment needs. Each stage is built for the read from
+ * the stage context if it takes one, and default constructed otherwise.
+ *
+ * ```cpp
+ * using limited_path = message_path<counting_stage, limiting_stage>;
+ * auto handle = limited_path::compose({.limiter = limiter, .now = now},
+ *                                     framing_stage(parser),
+ *                                     enqueue_stage(queue));
+ * ```
+ * @tparam Stages The types of the stages, in the order that they run.
+ */
+template <typename... Stages> struct message_path {
+  /**
+   * @brief Composes the pipeline of a read.
+   * @tparam Framing The type of the framing stage.
+   * @tparam Last The types of the stages that deliver the messages.
+   * @param ctx What the stages are built from.
+   * @param framing The stage that splits the read into messages.
+   * @param last The stages that deliver the messages.
+   * @return The pipeline.
+   */
+  template <typename Framing, typename... Last>
+  static constexpr auto compose(const stage_context &ctx, Framing framing,
+                                Last... last);
+
+private:
+  /**
+   * @brief Builds a stage for a read.
+   * @tparam Stage The type of the stage.
+   * @param ctx What the stage is built from.
+   * @return The stage.
+   */
+  template <typename Stage>
+  static constexpr auto make(const stage_context &ctx) -> Stage;
+};
+} // namespace cloudbus::detail
+
+#include "impl/pipeline_impl.hpp" // IWYU pragma: export
+
+#endif // CLOUDBUS_PIPELINE_HPP
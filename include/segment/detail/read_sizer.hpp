@@ -0,0 +1,106 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file read_sizer.hpp
+ * @brief This file declares the adaptive sizing of read buffers.
+ */
+#pragma once
+#ifndef CLOUDBUS_READ_SIZER_HPP
+#define CLOUDBUS_READ_SIZER_HPP
+#include <algorithm>
+#include <cstddef>
+namespace cloudbus::detail {
+/**
+ * @brief Sizes the read buffer of a connection by its recent reads.
+ *
+ * @details A read that fills its buffer means that more bytes were
+ * waiting, so the size grows by `growth` at once, up to `max_size`. The
+ * size halves only after `shrink_after` reads in a row that would have
+ * fit in a quarter of it, down to `min_size`. Bulk streams quickly get
+ * large buffers that save syscalls, while request-response connections
+ * settle on small buffers that save memory, and the occasional large
+ * message does not make them shrink and grow back and forth.
+ */
+class read_sizer {
+public:
+  /** @brief The default smallest size. */
+  static constexpr std::size_t default_min_size = 4UL * 1024UL;
+  /** @brief The default largest size. */
+  static constexpr std::size_t default_max_size = 256UL * 1024UL;
+  /** @brief The factor that the size grows by. */
+  static constexpr std::size_t growth = 4;
+  /** @brief The number of small reads in a row before shrinking. */
+  static constexpr unsigned shrink_after = 8;
+
+  /**
+   * @brief Constructs the sizer at its smallest size.
+   * @param min_size The smallest size.
+   * @param max_size The largest size, at least `min_size`.
+   */
+  constexpr explicit read_sizer(
+      std::size_t min_size = default_min_size,
+      std::size_t max_size = default_max_size) noexcept
+      : min_{min_size}, max_{std::max(min_size, max_size)}, size_{min_size}
+  {}
+
+  /**
+   * @brief Records a read.
+   * @param len The number of bytes that were read.
+   * @param capacity The size of the buffer that was read into.
+   */
+  constexpr auto record(std::size_t len, std::size_t capacity) noexcept
+      -> void
+  {
+    if (len >= capacity)
+    {
+      size_ = std::min(std::max(size_, capacity) * growth, max_);
+      small_ = 0;
+    }
+    else if (len <= size_ / 4)
+    {
+      if (++small_ >= shrink_after)
+      {
+        size_ = std::max(size_ / 2, min_);
+        small_ = 0;
+      }
+    }
+    else
+    {
+      small_ = 0;
+    }
+  }
+
+  /**
+   * @brief Gets the size of the next read buffer.
+   * @return The size, between the smallest and the largest size.
+   */
+  [[nodiscard]] constexpr auto size() const noexcept -> std::size_t
+  {
+    return size_;
+  }
+
+private:
+  /** @brief The smallest size. */
+  std::size_t min_;
+  /** @brief The largest size. */
+  std::size_t max_;
+  /** @brief The current size. */
+  std::size_t size_;
+  /** @brief The number of small reads in a row. */
+  unsigned small_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_READ_SIZER_HPP
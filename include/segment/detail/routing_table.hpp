@@ -0,0 +1,79 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file routing_table.hpp
+ * @brief This file declares the routing table of a forwarding segment.
+ */
+#pragma once
+#ifndef CLOUDBUS_ROUTING_TABLE_HPP
+#define CLOUDBUS_ROUTING_TABLE_HPP
+#include "segment/detail/hash_ring.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+namespace cloudbus::detail {
+/**
+ * @brief The current membership of the upstream peers.
+ *
+ * @details Membership changes are published RCU-style: a new hash_ring is
+ * built off to the side and swapped in with a single atomic store.
+ * Readers take a snapshot with `load()` and keep using it for as long as
+ * they hold on to it, so the data path never waits for a writer, and the
+ * old ring is freed once its last reader lets go. A routing table can be
+ * shared by the segment services of every reactor.
+ */
+class routing_table {
+public:
+  /** @brief The type of a member address. */
+  using address_type = hash_ring::address_type;
+
+  /**
+   * @brief Constructs the routing table.
+   * @param members The addresses of the initial members.
+   */
+  explicit routing_table(std::vector<address_type> members = {});
+
+  /**
+   * @brief Replaces the members of the routing table.
+   * @param members The addresses of the new members.
+   */
+  auto update(std::vector<address_type> members) -> void;
+
+  /**
+   * @brief Takes a snapshot of the current members.
+   * @return The current hash ring.
+   */
+  [[nodiscard]] auto load() const noexcept -> std::shared_ptr<const hash_ring>;
+
+  /**
+   * @brief Gets the version of the members.
+   * @details The version changes with every update. Readers cache their
+   * snapshot and only call `load()` again when the version has changed,
+   * so the data path is a single atomic integer load.
+   * @return The version of the members.
+   */
+  [[nodiscard]] auto version() const noexcept -> std::uint64_t;
+
+private:
+  /** @brief The current hash ring. */
+  std::atomic<std::shared_ptr<const hash_ring>> ring_;
+  /** @brief The number of updates. */
+  std::atomic<std::uint64_t> version_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_ROUTING_TABLE_HPP
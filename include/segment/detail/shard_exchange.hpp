@@ -0,0 +1,222 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file shard_exchange.hpp
+ * @brief This file declares the handoff of messages between reactors.
+ */
+#pragma once
+#ifndef CLOUDBUS_SHARD_EXCHANGE_HPP
+#define CLOUDBUS_SHARD_EXCHANGE_HPP
+#include "segment/detail/spsc_ring.hpp"
+#include "segment/detail/write_queue.hpp"
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+namespace cloudbus::detail {
+/**
+ * @brief A piece of a message that is handed from one reactor to another.
+ * @details The piece holds a reference to the owner of its bytes, so the
+ * bytes are not copied and stay alive until the receiving reactor has
+ * written them. Owners must be safe to release on another thread, which
+ * is the case for the read contexts of the epoll service, but not for
+ * the provided buffers of the io_uring service.
+ */
+struct shard_message {
+  /** @brief The object that owns the bytes. */
+  write_queue::owner_type owner;
+  /** @brief The bytes of the piece. */
+  write_queue::buffer_type buf;
+  /** @brief When the message was read, set on its first piece. */
+  write_queue::clock_type::time_point queued{};
+  /** @brief The stream id of the multiplexed connection. */
+  std::uint32_t stream{0};
+  /** @brief The number of pieces of the message, set on its first piece. */
+  std::uint32_t pieces{0};
+  /** @brief Whether the message is a reply to the stream. */
+  bool reply{false};
+};
+
+/**
+ * @brief Moves messages between a fixed set of reactors without locks.
+ *
+ * @details Every ordered pair of reactors has its own `spsc_ring`, so a
+ * reactor is the only producer of its outgoing rings and the only
+ * consumer of its incoming rings, and no two reactors ever write to the
+ * same index. The pieces of a message are sent together, so the
+ * receiving reactor always receives whole messages.
+ *
+ * Wakeups are batched. A reactor `park()`s once it has received
+ * everything, and only the first message sent to a parked reactor rings
+ * its doorbell, so a burst of messages costs a single write. The
+ * doorbell is a Unix-domain datagram socket of the reactor, so that it
+ * can be watched by the same poller as its connections.
+ */
+class shard_exchange {
+public:
+  /** @brief The type of the messages. */
+  using message_type = shard_message;
+  /** @brief The default number of pieces in flight per pair of reactors. */
+  static constexpr std::size_t default_capacity = 4096;
+
+  /**
+   * @brief Constructs the exchange.
+   * @param shards The number of reactors.
+   * @param capacity The minimum number of pieces that each pair of
+   * reactors can have in flight.
+   */
+  explicit shard_exchange(std::size_t shards,
+                          std::size_t capacity = default_capacity);
+  /** @brief Deleted copy constructor. */
+  shard_exchange(const shard_exchange &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const shard_exchange &other) -> shard_exchange & = delete;
+  /** @brief Closes the socket that the doorbells are rung from. */
+  ~shard_exchange();
+
+  /**
+   * @brief Checks whether the socket that rings the doorbells was opened.
+   * @return True if the exchange can be used.
+   */
+  explicit operator bool() const noexcept { return sock_ >= 0; }
+
+  /**
+   * @brief Gets the number of reactors.
+   * @return The number of reactors.
+   */
+  [[nodiscard]] auto shards() const noexcept -> std::size_t
+  {
+    return shards_;
+  }
+
+  /**
+   * @brief Gets the number of pieces that fit in a ring.
+   * @return The capacity of each ring.
+   */
+  [[nodiscard]] auto capacity() const noexcept -> std::size_t
+  {
+    return rings_.empty() ? 0 : rings_.front()->capacity();
+  }
+
+  /**
+   * @brief Attaches the doorbell of a reactor.
+   * @details Binds the socket to an autobound abstract address if it is
+   * not bound yet. Messages may only be sent to a reactor once it is
+   * attached.
+   * @param shard The reactor.
+   * @param fd A Unix-domain datagram socket of the reactor.
+   * @return An error code if the doorbell could not be attached.
+   */
+  auto attach(std::size_t shard, int fd) -> std::error_code;
+
+  /**
+   * @brief Checks whether a reactor can be sent messages.
+   * @param shard The reactor.
+   * @return True once the doorbell of the reactor is attached.
+   */
+  [[nodiscard]] auto attached(std::size_t shard) const noexcept -> bool;
+
+  /**
+   * @brief Sends the pieces of messages to another reactor.
+   * @details Must only be called by the sending reactor. The pieces are
+   * sent together, and the doorbell of the receiving reactor is rung if
+   * it is parked.
+   * @param from The sending reactor.
+   * @param to The receiving reactor.
+   * @param pieces The pieces, which are left untouched if they don't all
+   * fit in the ring.
+   * @return False if the ring from `from` to `to` is too full.
+   */
+  auto send(std::size_t from, std::size_t to,
+            std::span<message_type> pieces) noexcept -> bool;
+
+  /**
+   * @brief Receives the pieces sent to a reactor.
+   * @details Must only be called by the receiving reactor.
+   * @tparam Fn The type of the function.
+   * @param shard The receiving reactor.
+   * @param fn The function that is called with each piece.
+   * @return The number of received pieces.
+   */
+  template <typename Fn>
+    requires std::invocable<Fn &, message_type &&>
+  auto receive(std::size_t shard, Fn &&fn) -> std::size_t;
+
+  /**
+   * @brief Marks a reactor as waiting for its doorbell.
+   * @details Must only be called by the reactor itself.
+   * @param shard The reactor.
+   * @return False if messages arrived in the meantime, in which case the
+   * reactor is not parked and must receive them first.
+   */
+  auto park(std::size_t shard) noexcept -> bool;
+
+  /**
+   * @brief Checks whether a reactor has messages waiting.
+   * @param shard The receiving reactor.
+   * @return True if any incoming ring is not empty.
+   */
+  [[nodiscard]] auto pending(std::size_t shard) const noexcept -> bool;
+
+private:
+  /** @brief The size of a cache line. */
+  static constexpr std::size_t cache_line = 64;
+
+  /** @brief The wakeup state of a reactor. */
+  struct alignas(cache_line) mailbox {
+    /** @brief Whether the reactor waits for its doorbell. */
+    std::atomic<bool> parked{false};
+    /** @brief Whether the doorbell is attached. */
+    std::atomic<bool> attached{false};
+    /** @brief The address of the doorbell. */
+    sockaddr_un address{};
+    /** @brief The length of the address. */
+    socklen_t length{};
+  };
+
+  /**
+   * @brief Gets the ring between two reactors.
+   * @param from The sending reactor.
+   * @param to The receiving reactor.
+   * @return The ring.
+   */
+  auto ring(std::size_t from, std::size_t to) noexcept
+      -> spsc_ring<message_type> &;
+
+  /** @brief The number of reactors. */
+  std::size_t shards_;
+  /** @brief The socket that the doorbells are rung from. */
+  int sock_{-1};
+  /** @brief The error that opening the socket failed with, or 0. */
+  int error_{0};
+  /** @brief The rings, grouped by the receiving reactor. */
+  std::vector<std::unique_ptr<spsc_ring<message_type>>> rings_;
+  /** @brief The wakeup state of each reactor. */
+  std::unique_ptr<mailbox[]> mailboxes_;
+};
+} // namespace cloudbus::detail
+
+#include "impl/shard_exchange_impl.hpp" // IWYU pragma: export
+
+#endif // CLOUDBUS_SHARD_EXCHANGE_HPP
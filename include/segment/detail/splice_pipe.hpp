@@ -0,0 +1,93 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file splice_pipe.hpp
+ * @brief This file declares a pipe for splicing between sockets.
+ */
+#pragma once
+#ifndef CLOUDBUS_SPLICE_PIPE_HPP
+#define CLOUDBUS_SPLICE_PIPE_HPP
+#include <array>
+#include <cstddef>
+#include <span>
+#include <system_error>
+namespace cloudbus::detail {
+/**
+ * @brief A pipe that moves bytes between two sockets inside the kernel.
+ *
+ * @details `splice()` can only move bytes to or from a pipe, so bytes are
+ * relayed from one socket to another by splicing them into the pipe and
+ * then out of it. The payload never reaches userspace. Both ends of the
+ * pipe are non-blocking, so a transfer stops as soon as the source has no
+ * more bytes or the destination cannot take any more. Bytes that the
+ * destination could not take stay in the pipe.
+ */
+class splice_pipe {
+public:
+  /** @brief Creates the pipe. */
+  splice_pipe() noexcept;
+  /** @brief Deleted copy constructor. */
+  splice_pipe(const splice_pipe &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const splice_pipe &other) -> splice_pipe & = delete;
+  /** @brief Closes the pipe. */
+  ~splice_pipe();
+
+  /**
+   * @brief Checks whether the pipe was created.
+   * @return True if the pipe can be used.
+   */
+  explicit operator bool() const noexcept;
+
+  /**
+   * @brief Relays bytes from one file descriptor to another.
+   * @details Bytes are moved until `in` has no more bytes to read, `in`
+   * reaches end of file, or `out` would block.
+   * @param in The file descriptor to read from.
+   * @param out The file descriptor to write to.
+   * @return An error code if either splice failed.
+   */
+  auto transfer(int in, int out) noexcept -> std::error_code;
+
+  /**
+   * @brief Reads the bytes left in the pipe.
+   * @param buf The buffer to read into.
+   * @return The number of bytes that were read.
+   */
+  auto read(std::span<std::byte> buf) noexcept -> std::size_t;
+
+  /**
+   * @brief Gets the number of bytes left in the pipe.
+   * @return The number of bytes that `out` could not take.
+   */
+  [[nodiscard]] auto size() const noexcept -> std::size_t;
+
+  /**
+   * @brief Checks whether the source reached end of file.
+   * @return True if a transfer read end of file from `in`.
+   */
+  [[nodiscard]] auto eof() const noexcept -> bool;
+
+private:
+  /** @brief The read and write ends of the pipe. */
+  std::array<int, 2> fds_{-1, -1};
+  /** @brief The number of bytes in the pipe. */
+  std::size_t size_{0};
+  /** @brief Whether the source reached end of file. */
+  bool eof_{false};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_SPLICE_PIPE_HPP
@@ -0,0 +1,155 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file spsc_ring.hpp
+ * @brief This file declares a bounded single-producer single-consumer
+ * ring buffer.
+ */
+#pragma once
+#ifndef CLOUDBUS_SPSC_RING_HPP
+#define CLOUDBUS_SPSC_RING_HPP
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <span>
+namespace cloudbus::detail {
+/**
+ * @brief A bounded lock-free ring buffer for one producer and one consumer
+ * thread.
+ *
+ * @details The producer only writes the tail and the consumer only writes
+ * the head, and each keeps the index of the other side in a cached copy
+ * on its own cache line, so the shared indices are only read when the
+ * cached copy says that the ring looks full or empty. `drain()` pops
+ * everything that has been pushed with a single release of the head, so
+ * a consumer that falls behind catches up in one batch.
+ *
+ * Popped slots are reset to a default-constructed `T`, so that values
+ * that own resources release them on the consumer thread as soon as they
+ * are popped.
+ * @tparam T The type of the values, which must be default constructible
+ * and movable.
+ */
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+class spsc_ring {
+public:
+  /**
+   * @brief Constructs the ring.
+   * @param capacity The minimum number of values that fit in the ring,
+   * rounded up to a power of two.
+   */
+  explicit spsc_ring(std::size_t capacity);
+
+  /** @brief Deleted copy constructor. */
+  spsc_ring(const spsc_ring &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const spsc_ring &other) -> spsc_ring & = delete;
+
+  /**
+   * @brief Pushes a value.
+   * @details Must only be called by the producer.
+   * @param value The value to push, which is left untouched if the ring is
+   * full.
+   * @return False if the ring is full.
+   */
+  auto try_push(T &value) noexcept(std::is_nothrow_move_assignable_v<T>)
+      -> bool;
+
+  /**
+   * @brief Pushes several values at once.
+   * @details Must only be called by the producer. The values become
+   * visible to the consumer together, so a `drain()` pops either all of
+   * them or none.
+   * @param values The values to push, which are left untouched if they
+   * don't all fit in the ring.
+   * @return False if there is not enough room for all values.
+   */
+  auto try_push(std::span<T> values) noexcept(
+      std::is_nothrow_move_assignable_v<T>) -> bool;
+
+  /**
+   * @brief Pops a value.
+   * @details Must only be called by the consumer.
+   * @param value Set to the popped value.
+   * @return False if the ring is empty.
+   */
+  auto try_pop(T &value) noexcept(std::is_nothrow_move_assignable_v<T>)
+      -> bool;
+
+  /**
+   * @brief Pops all values that have been pushed.
+   * @details Must only be called by the consumer.
+   * @tparam Fn The type of the function.
+   * @param fn The function that is called with each popped value.
+   * @return The number of popped values.
+   */
+  template <typename Fn>
+    requires std::invocable<Fn &, T &&>
+  auto drain(Fn &&fn) -> std::size_t;
+
+  /**
+   * @brief Checks whether the ring is empty.
+   * @details The result is exact on the consumer thread, and may be stale
+   * on any other thread.
+   * @return True if there are no values to pop.
+   */
+  [[nodiscard]] auto empty() const noexcept -> bool;
+
+  /**
+   * @brief Gets the capacity of the ring.
+   * @return The number of values that fit in the ring.
+   */
+  [[nodiscard]] auto capacity() const noexcept -> std::size_t
+  {
+    return mask_ + 1;
+  }
+
+private:
+  /** @brief The size of a cache line. */
+  static constexpr std::size_t cache_line = 64;
+
+  /** @brief The state that is written by the producer. */
+  struct alignas(cache_line) producer_state {
+    /** @brief The index of the next slot to push to. */
+    std::atomic<std::size_t> tail{0};
+    /** @brief The last head that the producer has read. */
+    std::size_t head{0};
+  };
+
+  /** @brief The state that is written by the consumer. */
+  struct alignas(cache_line) consumer_state {
+    /** @brief The index of the next slot to pop from. */
+    std::atomic<std::size_t> head{0};
+    /** @brief The last tail that the consumer has read. */
+    std::size_t tail{0};
+  };
+
+  /** @brief The producer state. */
+  producer_state producer_;
+  /** @brief The consumer state. */
+  consumer_state consumer_;
+  /** @brief The mask that maps an index to its slot. */
+  std::size_t mask_;
+  /** @brief The slots of the ring. */
+  std::unique_ptr<T[]> slots_;
+};
+} // namespace cloudbus::detail
+
+#include "impl/spsc_ring_impl.hpp" // IWYU pragma: export
+
+#endif // CLOUDBUS_SPSC_RING_HPP
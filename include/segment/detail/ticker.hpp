@@ -0,0 +1,165 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file ticker.hpp
+ * @brief This file declares the periodic wakeup of event loops.
+ */
+#pragma once
+#ifndef CLOUDBUS_TICKER_HPP
+#define CLOUDBUS_TICKER_HPP
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+namespace cloudbus::detail {
+/**
+ * @brief Wakes event loops at a fixed interval.
+ *
+ * @details An event loop that has nothing but sockets to wait on
+ * subscribes a Unix-domain datagram socket of its own, and the ticker
+ * sends a one-byte datagram to each subscribed socket every `interval()`
+ * from a background thread. The event loop reads the socket like any
+ * other, and runs its timers and housekeeping on each tick. Ticks that
+ * do not fit in a socket's receive buffer are dropped, and a socket that
+ * has been closed is unsubscribed by the next tick.
+ *
+ * The ticker also coordinates draining: `drain()` tells the event loops
+ * to stop taking new work, each event loop reports with `drained()` once
+ * its connections have nothing left to write, and `wait_drained()`
+ * blocks until all of them have.
+ */
+class ticker {
+public:
+  /** @brief The default interval between ticks. */
+  static constexpr auto default_interval = std::chrono::milliseconds(100);
+
+  /**
+   * @brief Constructs the ticker.
+   * @details The background thread starts with the first subscription.
+   * If the socket that the ticks are sent from cannot be opened, every
+   * subscription fails.
+   * @param interval The interval between ticks.
+   */
+  explicit ticker(std::chrono::milliseconds interval = default_interval);
+
+  ticker(const ticker &) = delete;
+  auto operator=(const ticker &) -> ticker & = delete;
+
+  /** @brief Destructor, which stops the background thread. */
+  ~ticker();
+
+  /**
+   * @brief Subscribes a socket to the ticks.
+   * @details Binds the socket to an autobound abstract address if it is
+   * not bound yet.
+   * @param fd A Unix-domain datagram socket.
+   * @param id Set to the id that the subscriber reports draining with.
+   * @return An error code if the socket could not be subscribed.
+   */
+  auto subscribe(int fd, std::uint64_t &id) -> std::error_code;
+
+  /** @brief Tells the event loops to drain, and wakes them. */
+  auto drain() -> void;
+
+  /**
+   * @brief Checks whether the event loops have been told to drain.
+   * @return True once `drain()` has been called.
+   */
+  [[nodiscard]] auto draining() const noexcept -> bool
+  {
+    return draining_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Reports that a subscriber has drained.
+   * @param id The id of the subscriber.
+   */
+  auto drained(std::uint64_t id) -> void;
+
+  /**
+   * @brief Waits until every subscriber has drained.
+   * @param token Stops the wait early.
+   * @param timeout The longest time to wait.
+   * @return True if every subscriber has drained.
+   */
+  auto wait_drained(std::stop_token token,
+                    std::chrono::milliseconds timeout) -> bool;
+
+  /**
+   * @brief Gets the interval between ticks.
+   * @return The interval.
+   */
+  [[nodiscard]] auto interval() const noexcept -> std::chrono::milliseconds
+  {
+    return interval_;
+  }
+
+private:
+  /** @brief A subscribed socket. */
+  struct subscriber {
+    /** @brief The id of the subscriber. */
+    std::uint64_t id{};
+    /** @brief The address of the socket. */
+    sockaddr_un address{};
+    /** @brief The length of the address. */
+    socklen_t length{};
+    /** @brief Whether the subscriber has drained. */
+    bool drained{false};
+  };
+
+  /**
+   * @brief Sends the ticks until the thread is stopped.
+   * @param token The stop token of the thread.
+   */
+  auto run(const std::stop_token &token) -> void;
+
+  /**
+   * @brief Checks whether every subscriber has drained.
+   * @return True if no subscriber has yet to drain.
+   */
+  [[nodiscard]] auto all_drained() const noexcept -> bool;
+
+  /** @brief The interval between ticks. */
+  std::chrono::milliseconds interval_;
+  /** @brief The socket that the ticks are sent from. */
+  int sock_{-1};
+  /** @brief The error that opening the socket failed with, or 0. */
+  int error_{0};
+  /** @brief Whether the event loops have been told to drain. */
+  std::atomic<bool> draining_{false};
+  /** @brief Guards the subscribers. */
+  mutable std::mutex mtx_;
+  /** @brief Signals new subscribers, drain reports, and early ticks. */
+  std::condition_variable_any cvar_;
+  /** @brief The subscribed sockets. */
+  std::vector<subscriber> subscribers_;
+  /** @brief The id of the next subscriber. */
+  std::uint64_t next_id_{1};
+  /** @brief Whether the next tick is sent without waiting. */
+  bool wake_{false};
+  /** @brief The thread that sends the ticks. */
+  std::jthread thread_;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_TICKER_HPP
@@ -0,0 +1,183 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file timer_wheel.hpp
+ * @brief This file declares a hierarchical timing wheel.
+ */
+#pragma once
+#ifndef CLOUDBUS_TIMER_WHEEL_HPP
+#define CLOUDBUS_TIMER_WHEEL_HPP
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+namespace cloudbus::detail {
+/**
+ * @brief A hierarchical timing wheel of millisecond timers.
+ *
+ * @details The wheel has `levels` levels of `slots` slots each. Level 0
+ * has a slot per millisecond, and each slot of level `n` spans a whole
+ * rotation of level `n - 1`. A timer is linked into the slot of the
+ * lowest level that its deadline falls into, and is moved down a level
+ * when the wheel reaches the start of its slot, so scheduling and
+ * cancelling a timer are O(1), and every timer is moved at most `levels`
+ * times. Empty slots are skipped with one bit scan per rotation of
+ * level 0. Timers are intrusive: the wheel never allocates, and a timer
+ * that is rescheduled on every read costs an unlink and a link.
+ *
+ * A wheel belongs to one event loop and must only be used from its
+ * thread. Deadlines further out than the wheel spans (about 4.6 hours)
+ * are parked at the top level and moved again when it comes round.
+ */
+class timer_wheel {
+public:
+  /** @brief The clock of the deadlines. */
+  using clock_type = std::chrono::steady_clock;
+  /** @brief The resolution of the wheel. */
+  using duration = std::chrono::milliseconds;
+
+  /** @brief The log2 of the number of slots per level. */
+  static constexpr unsigned slot_bits = 6;
+  /** @brief The number of slots per level. */
+  static constexpr std::size_t slots = 1UL << slot_bits;
+  /** @brief The number of levels. */
+  static constexpr std::size_t levels = 4;
+
+  /** @brief A timer that can be linked into a wheel. */
+  struct timer {
+    /** @brief The object that the timer belongs to. */
+    void *owner{nullptr};
+    /** @brief The previous timer of the slot. */
+    timer *prev{nullptr};
+    /** @brief The next timer of the slot. */
+    timer *next{nullptr};
+    /** @brief The tick that the timer expires at. */
+    std::uint64_t expiry{0};
+    /** @brief The slot that the timer is linked into. */
+    std::uint16_t slot{0};
+
+    /**
+     * @brief Checks whether the timer is scheduled.
+     * @return True if the timer is linked into a wheel.
+     */
+    [[nodiscard]] auto armed() const noexcept -> bool
+    {
+      return prev != nullptr;
+    }
+  };
+
+  /** @brief Constructs an empty wheel that starts now. */
+  timer_wheel() noexcept : timer_wheel(clock_type::now()) {}
+
+  /**
+   * @brief Constructs an empty wheel.
+   * @param now The time that the wheel starts at.
+   */
+  explicit timer_wheel(clock_type::time_point now) noexcept;
+
+  /** @brief Deleted copy constructor. */
+  timer_wheel(const timer_wheel &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const timer_wheel &other) -> timer_wheel & = delete;
+  /** @brief Destructor, which leaves the timers that are still linked. */
+  ~timer_wheel() = default;
+
+  /**
+   * @brief Schedules a timer, or reschedules it if it is armed.
+   * @details Deadlines that have already passed expire at the next
+   * `advance()`.
+   * @param t The timer, which must stay alive until it expires or is
+   * cancelled.
+   * @param deadline When the timer expires.
+   */
+  auto schedule(timer &t, clock_type::time_point deadline) noexcept -> void;
+
+  /**
+   * @brief Cancels a timer.
+   * @details Timers that are not armed are left alone.
+   * @param t The timer.
+   */
+  auto cancel(timer &t) noexcept -> void;
+
+  /**
+   * @brief Expires the timers whose deadline has passed.
+   * @details Expired timers are unlinked before `fn` is called with them,
+   * so `fn` may reschedule or destroy them, and schedule or cancel other
+   * timers.
+   * @tparam Fn The type of the function.
+   * @param now The current time.
+   * @param fn The function that is called with each expired timer.
+   * @return The number of expired timers.
+   */
+  template <typename Fn>
+  auto advance(clock_type::time_point now, Fn &&fn) -> std::size_t;
+
+  /**
+   * @brief Gets the number of armed timers.
+   * @return The number of timers linked into the wheel.
+   */
+  [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }
+
+  /**
+   * @brief Checks whether no timers are armed.
+   * @return True if the wheel is empty.
+   */
+  [[nodiscard]] auto empty() const noexcept -> bool { return size_ == 0; }
+
+private:
+  /**
+   * @brief Converts a time to a tick of the wheel.
+   * @param time The time.
+   * @return The tick.
+   */
+  [[nodiscard]] static auto tick(clock_type::time_point time) noexcept
+      -> std::uint64_t;
+
+  /**
+   * @brief Links a timer into the slot of its expiry.
+   * @param t The unlinked timer.
+   */
+  auto link(timer &t) noexcept -> void;
+
+  /**
+   * @brief Moves the timers of a slot down to the lower levels.
+   * @param level The level of the slot.
+   * @param index The index of the slot.
+   */
+  auto cascade(std::size_t level, std::size_t index) noexcept -> void;
+
+  /**
+   * @brief Unlinks the first timer of a slot.
+   * @param level The level of the slot.
+   * @param index The index of the slot.
+   * @return The timer, or nullptr if the slot is empty.
+   */
+  auto pop(std::size_t level, std::size_t index) noexcept -> timer *;
+
+  /** @brief The sentinels of the circular timer lists of each slot. */
+  std::array<std::array<timer, slots>, levels> wheel_;
+  /** @brief The bitmaps of the slots of each level that hold timers. */
+  std::array<std::uint64_t, levels> occupied_{};
+  /** @brief The current tick. */
+  std::uint64_t now_;
+  /** @brief The number of armed timers. */
+  std::size_t size_{0};
+};
+} // namespace cloudbus::detail
+
+#include "impl/timer_wheel_impl.hpp" // IWYU pragma: export
+
+#endif // CLOUDBUS_TIMER_WHEEL_HPP
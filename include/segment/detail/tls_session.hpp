@@ -0,0 +1,186 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file tls_session.hpp
+ * @brief This file declares the TLS handshakes that hand the record
+ * layer to kernel TLS.
+ */
+#pragma once
+#ifndef CLOUDBUS_TLS_SESSION_HPP
+#define CLOUDBUS_TLS_SESSION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <system_error>
+
+/** @brief The OpenSSL context type. */
+struct ssl_ctx_st;
+/** @brief The OpenSSL connection type. */
+struct ssl_st;
+
+namespace cloudbus::detail {
+/** @brief The credentials and verification settings of a TLS endpoint. */
+struct tls_settings {
+  /** @brief The PEM file of the certificate chain. */
+  std::string certificate;
+  /** @brief The PEM file of the private key. */
+  std::string private_key;
+  /**
+   * @brief The PEM file of the CAs that peers are verified against.
+   * @details When this is empty, peers are not verified, and servers do
+   * not ask clients for a certificate.
+   */
+  std::string ca_file;
+  /**
+   * @brief The name that the server certificate must match.
+   * @details Clients also send it as SNI. When this is empty, the server
+   * certificate is only verified against `ca_file`.
+   */
+  std::string server_name;
+};
+
+/**
+ * @brief The shared TLS configuration of one side of the segment links.
+ *
+ * @details Sessions are restricted to what kernel TLS can take over:
+ * TLS 1.2 and 1.3 with AES-GCM or ChaCha20-Poly1305. Session tickets are
+ * disabled, since a post-handshake message would be a control record
+ * that a plain `recv()` on a kTLS socket cannot read.
+ */
+class tls_context {
+public:
+  /** @brief Which side of the handshake the context is for. */
+  enum class side : std::uint8_t {
+    /** @brief Accepts handshakes. */
+    server,
+    /** @brief Initiates handshakes. */
+    client,
+  };
+
+  /**
+   * @brief Creates the context.
+   * @param role Which side of the handshake the context is for.
+   */
+  explicit tls_context(side role) noexcept;
+  /** @brief Deleted copy constructor. */
+  tls_context(const tls_context &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const tls_context &other) -> tls_context & = delete;
+  /** @brief Frees the context. */
+  ~tls_context();
+
+  /**
+   * @brief Loads the credentials and verification settings.
+   * @param settings The settings to load.
+   * @return `std::errc::invalid_argument` if a file could not be loaded
+   * or the key does not match the certificate.
+   */
+  auto configure(const tls_settings &settings) -> std::error_code;
+
+  /**
+   * @brief Checks whether the context was created.
+   * @return True if the context can be used.
+   */
+  explicit operator bool() const noexcept { return ctx_ != nullptr; }
+
+  /**
+   * @brief Gets which side of the handshake the context is for.
+   * @return The side.
+   */
+  [[nodiscard]] auto role() const noexcept -> side { return role_; }
+
+private:
+  friend class tls_session;
+
+  /** @brief The OpenSSL context. */
+  ssl_ctx_st *ctx_;
+  /** @brief The name that the server certificate must match. */
+  std::string server_name_;
+  /** @brief Which side of the handshake the context is for. */
+  side role_;
+};
+
+/**
+ * @brief A TLS handshake on a non-blocking socket.
+ *
+ * @details The handshake runs in userspace. Once it completes, the keys
+ * and sequence numbers of both directions are installed in the kernel
+ * (TCP_ULP "tls"), so the socket carries plaintext for `sendmsg()`,
+ * `recv()` and `splice()` while the kernel does the record crypto. The
+ * session is not needed after that and can be dropped without closing
+ * the socket. `MSG_ZEROCOPY` is not supported on kTLS sockets.
+ */
+class tls_session {
+public:
+  /** @brief The progress of the handshake. */
+  enum class status : std::uint8_t {
+    /** @brief The handshake completed and kTLS carries the records. */
+    done,
+    /** @brief The handshake waits for the socket to be readable. */
+    want_read,
+    /** @brief The handshake waits for the socket to be writable. */
+    want_write,
+    /** @brief The handshake failed, see `error()`. */
+    failed,
+  };
+
+  /**
+   * @brief Starts a session on a socket.
+   * @details A server whose socket has already been read from is given
+   * the bytes that were read, which the handshake reads before it reads
+   * from the socket. They must be handshake records only, since kernel
+   * TLS cannot take over records that were read ahead.
+   * @param ctx The context of the session, which must outlive it.
+   * @param sock The connected socket, which the session does not own.
+   * @param received The bytes that were already read from the socket.
+   */
+  tls_session(const tls_context &ctx, int sock,
+              std::span<const std::byte> received = {}) noexcept;
+  /** @brief Deleted copy constructor. */
+  tls_session(const tls_session &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const tls_session &other) -> tls_session & = delete;
+  /** @brief Frees the session and leaves the socket open. */
+  ~tls_session();
+
+  /**
+   * @brief Continues the handshake.
+   * @details Call this again when the socket is ready for the status
+   * that it returned.
+   * @return The progress of the handshake.
+   */
+  auto handshake() noexcept -> status;
+
+  /**
+   * @brief Gets the reason that the handshake failed.
+   * @return `std::errc::operation_not_supported` if kernel TLS could not
+   * take over both directions, `std::errc::protocol_error` if the
+   * handshake was rejected, or the error of the socket.
+   */
+  [[nodiscard]] auto error() const noexcept -> std::error_code
+  {
+    return error_;
+  }
+
+private:
+  /** @brief The OpenSSL connection. */
+  ssl_st *ssl_;
+  /** @brief The reason that the handshake failed. */
+  std::error_code error_;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_TLS_SESSION_HPP
@@ -0,0 +1,238 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file trace.hpp
+ * @brief This file declares per-thread trace rings of hot path events.
+ */
+#pragma once
+#ifndef CLOUDBUS_TRACE_HPP
+#define CLOUDBUS_TRACE_HPP
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+namespace cloudbus::detail {
+/**
+ * @brief Timestamped hot path events of every thread.
+ *
+ * @details Tracing is compiled in with `CB_SEGMENT_ENABLE_TRACE`. In
+ * other builds `emit()` is empty and the data path carries no trace
+ * code at all.
+ *
+ * Each thread records into its own ring (see `local()`), which keeps the
+ * last `ring::capacity` events and overwrites the oldest ones, so
+ * recording an event never blocks and never allocates. `dump()` copies
+ * the rings of all threads into a compact binary file that `decode()`
+ * turns into text offline.
+ *
+ * The file starts with the 8 byte magic `CBTRACE1` and the number of
+ * rings as a 32-bit integer. Each ring follows as its 32-bit index, its
+ * 32-bit record count and its records in the order they were recorded.
+ * All integers are in host byte order.
+ */
+class trace {
+public:
+  /** @brief Whether tracing is compiled in. */
+#ifdef CB_SEGMENT_HAS_TRACE
+  static constexpr bool enabled = true;
+#else
+  static constexpr bool enabled = false;
+#endif
+
+  /** @brief The traced events. */
+  enum class event : std::uint8_t {
+    /** @brief A read completed. The size is the number of bytes read. */
+    read,
+    /** @brief A read is serviced. The size is the number of bytes. */
+    service,
+    /** @brief A sendmsg is submitted. The size is the number of bytes. */
+    send_submit,
+    /** @brief A sendmsg completed. The size is the number of bytes. */
+    send_complete,
+    /** @brief A sendmsg wrote less than it was given. The size is the
+     * number of unwritten bytes. */
+    short_write,
+    /** @brief The number of events. */
+    count
+  };
+
+  /** @brief One event as it is stored in the trace file. */
+  struct record {
+    /** @brief The steady clock time of the event in nanoseconds. */
+    std::uint64_t time;
+    /** @brief The socket of the event. */
+    std::uint32_t fd;
+    /** @brief The size of the event shifted left by 8, or'ed with the
+     * event. */
+    std::uint32_t info;
+
+    /**
+     * @brief Gets the event.
+     * @return The traced event.
+     */
+    [[nodiscard]] auto what() const noexcept -> event
+    {
+      return static_cast<event>(info & 0xFFU);
+    }
+
+    /**
+     * @brief Gets the size of the event.
+     * @return The size, saturated at 2^24 - 1.
+     */
+    [[nodiscard]] auto size() const noexcept -> std::uint32_t
+    {
+      return info >> 8U;
+    }
+  };
+  static_assert(sizeof(record) == 16);
+
+  /**
+   * @brief The events of one thread.
+   *
+   * @details A ring has a single writer. The records are written
+   * atomically and the head is published with release semantics, so
+   * other threads can copy a ring while it is being written to. A copy
+   * checks the head again when it is done and drops the records that
+   * were overwritten in the meantime.
+   */
+  class alignas(64) ring {
+  public:
+    /** @brief The number of records that a ring keeps. */
+    static constexpr std::size_t capacity = 1UL << 14;
+
+    /**
+     * @brief Records an event.
+     * @param what The event.
+     * @param fd The socket of the event.
+     * @param size The size of the event.
+     * @param time The time of the event.
+     */
+    auto push(event what, int fd, std::size_t size,
+              std::chrono::steady_clock::time_point time) noexcept -> void
+    {
+      constexpr auto max_size = std::size_t{0xFFFFFF};
+      auto head = head_.load(std::memory_order_relaxed);
+      auto &slot = slots_[head & (capacity - 1)];
+
+      // Readers that see a part of this record must also see the head
+      // that tells them it is being overwritten.
+      std::atomic_thread_fence(std::memory_order_release);
+      std::atomic_ref(slot[0]).store(
+          static_cast<std::uint64_t>(time.time_since_epoch().count()),
+          std::memory_order_relaxed);
+      std::atomic_ref(slot[1]).store(
+          pack(static_cast<std::uint32_t>(fd),
+               static_cast<std::uint32_t>(
+                   (std::min(size, max_size) << 8U) |
+                   static_cast<std::uint8_t>(what))),
+          std::memory_order_relaxed);
+      head_.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copies the records that are still in the ring.
+     * @return The records, from the oldest to the newest.
+     */
+    [[nodiscard]] auto snapshot() const -> std::vector<record>;
+
+  private:
+    /**
+     * @brief Packs the socket and info of a record into one word.
+     * @param fd The socket.
+     * @param info The size and event.
+     * @return The packed word.
+     */
+    static constexpr auto pack(std::uint32_t fd,
+                               std::uint32_t info) noexcept -> std::uint64_t
+    {
+      return (std::uint64_t{fd} << 32U) | info;
+    }
+
+    /** @brief The number of records ever pushed. */
+    std::atomic<std::uint64_t> head_{0};
+    /** @brief The records as a time word and a packed word each. */
+    std::array<std::array<std::uint64_t, 2>, capacity> slots_{};
+  };
+
+  /**
+   * @brief Records an event on the calling thread.
+   * @details This compiles to nothing unless tracing is enabled.
+   * @param what The event.
+   * @param fd The socket of the event.
+   * @param size The size of the event.
+   */
+  static auto emit([[maybe_unused]] event what, [[maybe_unused]] int fd,
+                   [[maybe_unused]] std::size_t size = 0) noexcept -> void
+  {
+    if constexpr (enabled)
+      local().push(what, fd, size, std::chrono::steady_clock::now());
+  }
+
+  /**
+   * @brief Gets the ring of the calling thread.
+   * @details The ring is registered on first use, and outlives its
+   * thread so that its events are not lost.
+   * @return The thread-local ring.
+   */
+  static auto local() -> ring &;
+
+  /**
+   * @brief Writes the rings of all threads as a trace file.
+   * @param os The binary stream to write to.
+   * @return An error if the stream failed.
+   */
+  static auto dump(std::ostream &os) -> std::error_code;
+
+  /**
+   * @brief Sets the file that `flush()` writes to.
+   * @param path The path of the trace file, or empty to disable
+   * `flush()`.
+   */
+  static auto output(std::string path) -> void;
+
+  /**
+   * @brief Replaces the trace file with the current rings.
+   * @return An error if the file could not be written.
+   */
+  static auto flush() -> std::error_code;
+
+  /**
+   * @brief Writes a trace file as one `time ring fd event size` line
+   * per record.
+   * @param is The binary stream to read the trace file from.
+   * @param os The stream to write the text to.
+   * @return `std::errc::invalid_argument` if the trace file is
+   * malformed.
+   */
+  static auto decode(std::istream &is, std::ostream &os) -> std::error_code;
+
+  /**
+   * @brief Gets the name of an event.
+   * @param what The event.
+   * @return The name of the event.
+   */
+  [[nodiscard]] static auto name(event what) noexcept -> std::string_view;
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_TRACE_HPP
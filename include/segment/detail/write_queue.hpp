@@ -0,0 +1,166 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file write_queue.hpp
+ * @brief This file declares a per-connection output queue.
+ */
+#pragma once
+#ifndef CLOUDBUS_WRITE_QUEUE_HPP
+#define CLOUDBUS_WRITE_QUEUE_HPP
+#include "segment/detail/frame_view.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <span>
+#include <vector>
+namespace cloudbus::detail {
+/**
+ * @brief An ordered queue of buffers waiting to be written to a socket.
+ *
+ * @details Buffers are not copied into the queue. Each buffer is stored
+ * together with a reference to the object that owns its storage (e.g. the
+ * read context that the bytes were read into), so the storage stays alive
+ * until the buffer has been written. Pending buffers can be gathered
+ * into a single scatter-gather write.
+ *
+ * A buffer that is pushed with the time that it was read starts a
+ * message, which runs up to the next buffer that starts one. Messages
+ * that have waited too long can be dropped as a whole, as long as none
+ * of their bytes have been written yet.
+ */
+class write_queue {
+public:
+  /** @brief The type of a queued buffer. */
+  using buffer_type = std::span<const std::byte>;
+  /** @brief The type that keeps the storage of a buffer alive. */
+  using owner_type = std::shared_ptr<const void>;
+
+  /** @brief The clock that messages are timed with. */
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief The maximum number of buffers gathered into one write. */
+  static constexpr std::size_t max_buffers = 64;
+
+  /**
+   * @brief Appends a buffer to the back of the queue.
+   * @details Empty buffers are ignored.
+   * @param owner The object that owns the buffer storage.
+   * @param buf The buffer to write.
+   * @param queued When the buffer was read if it starts a message, or
+   * the epoch if it continues the message before it.
+   */
+  auto push(owner_type owner, buffer_type buf,
+            clock_type::time_point queued = {}) -> void;
+
+  /**
+   * @brief Appends a frame to the back of the queue.
+   * @details The head and each piece of the tail of a split frame are
+   * queued as separate buffers with their own owners. A timed frame
+   * starts its message at its first buffer that is not empty.
+   * @param owner The object that owns the storage of the head.
+   * @param frame The frame to write.
+   * @param queued When the frame was read if it starts a message, or the
+   * epoch if it continues the message before it.
+   */
+  auto push_frame(owner_type owner, const frame_view &frame,
+                  clock_type::time_point queued = {}) -> void;
+
+  /**
+   * @brief Gathers buffers from the front of the queue.
+   * @param out The buffers to fill, at most `out.size()` buffers are
+   * gathered.
+   * @return The number of buffers written to `out`.
+   */
+  auto gather(std::span<buffer_type> out) const noexcept -> std::size_t;
+
+  /**
+   * @brief Removes written bytes from the front of the queue.
+   * @details Buffers that were written completely are removed. If the
+   * write ended part way through a buffer, that buffer is narrowed to its
+   * unwritten tail so that it can be written again without copying.
+   * @param len The number of bytes that were written.
+   */
+  auto consume(std::size_t len) noexcept -> void;
+
+  /**
+   * @brief Removes written bytes from the front of the queue.
+   * @details Like `consume(len)`, but the owners of every buffer that the
+   * written bytes came from are appended to `released`. This keeps the
+   * storage alive for writes that the kernel may still be reading from,
+   * e.g. `MSG_ZEROCOPY` sends.
+   * @param len The number of bytes that were written.
+   * @param released The owners of the written buffers.
+   */
+  auto consume(std::size_t len, std::vector<owner_type> &released) -> void;
+
+  /**
+   * @brief Drops the messages at the front of the queue that were read
+   * at or before a cutoff.
+   * @details Dropping stops at the first message that is newer, that
+   * has been partly written, or whose start was not timed.
+   * @param cutoff The latest read time of a dropped message.
+   * @return The number of messages that were dropped.
+   */
+  auto expire(clock_type::time_point cutoff) noexcept -> std::size_t;
+
+  /**
+   * @brief Gets when the oldest queued message was read.
+   * @return The read time of the oldest message, or the epoch if no
+   * queued buffer starts a message.
+   */
+  [[nodiscard]] auto oldest() const noexcept -> clock_type::time_point;
+
+  /**
+   * @brief Gets the number of queued buffers.
+   * @return The number of queued buffers.
+   */
+  [[nodiscard]] auto size() const noexcept -> std::size_t;
+
+  /**
+   * @brief Gets the number of queued bytes.
+   * @return The number of queued bytes.
+   */
+  [[nodiscard]] auto bytes() const noexcept -> std::size_t;
+
+  /**
+   * @brief Checks whether the queue is empty.
+   * @return True if there are no queued buffers, false otherwise.
+   */
+  [[nodiscard]] auto empty() const noexcept -> bool;
+
+  /** @brief Removes all buffers from the queue. */
+  auto clear() noexcept -> void;
+
+private:
+  /** @brief A queued buffer and the owner of its storage. */
+  struct entry {
+    /** @brief The owner of the buffer storage. */
+    owner_type owner;
+    /** @brief The buffer to write. */
+    buffer_type buf;
+    /** @brief When the message that the buffer starts was read. */
+    clock_type::time_point queued;
+  };
+
+  /** @brief The queued buffers. */
+  std::deque<entry> entries_;
+  /** @brief The total number of queued bytes. */
+  std::size_t bytes_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_WRITE_QUEUE_HPP
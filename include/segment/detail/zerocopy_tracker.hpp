@@ -0,0 +1,84 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file zerocopy_tracker.hpp
+ * @brief This file declares a tracker for in-flight MSG_ZEROCOPY sends.
+ */
+#pragma once
+#ifndef CLOUDBUS_ZEROCOPY_TRACKER_HPP
+#define CLOUDBUS_ZEROCOPY_TRACKER_HPP
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+namespace cloudbus::detail {
+/**
+ * @brief Keeps the buffers of `MSG_ZEROCOPY` sends alive until the kernel
+ * releases them.
+ *
+ * @details The kernel numbers the successful zerocopy sends on a socket
+ * from zero and reports ranges of completed sends on the socket error
+ * queue. The tracker numbers the sends in the same order and holds on to
+ * the owners of their buffers until their completions are read.
+ */
+class zerocopy_tracker {
+public:
+  /** @brief The type that keeps the storage of a buffer alive. */
+  using owner_type = std::shared_ptr<const void>;
+
+  /**
+   * @brief Records a successful zerocopy send.
+   * @param owners The owners of the buffers that the send read from.
+   */
+  auto push(std::vector<owner_type> owners) -> void;
+
+  /**
+   * @brief Releases the buffers of completed sends.
+   * @param lo The first completed send.
+   * @param hi The last completed send (inclusive).
+   */
+  auto release(std::uint32_t lo, std::uint32_t hi) noexcept -> void;
+
+  /**
+   * @brief Reads the zerocopy completions on a socket's error queue.
+   * @details The error queue is read without blocking until it is empty.
+   * @param fd The native socket handle.
+   * @return The number of completion notifications that were read.
+   */
+  auto reap(int fd) -> std::size_t;
+
+  /**
+   * @brief Gets the number of sends awaiting completion.
+   * @return The number of sends awaiting completion.
+   */
+  [[nodiscard]] auto pending() const noexcept -> std::size_t;
+
+private:
+  /** @brief The buffer owners of a zerocopy send. */
+  struct send {
+    /** @brief The number of the send. */
+    std::uint32_t id;
+    /** @brief The owners of the buffers that the send read from. */
+    std::vector<owner_type> owners;
+  };
+
+  /** @brief The sends awaiting completion, in order. */
+  std::deque<send> sends_;
+  /** @brief The number of the next send. */
+  std::uint32_t next_{0};
+};
+} // namespace cloudbus::detail
+#endif // CLOUDBUS_ZEROCOPY_TRACKER_HPP
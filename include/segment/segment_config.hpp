@@ -0,0 +1,155 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file segment_config.hpp
+ * @brief This file declares the runtime configuration of a segment.
+ */
+#pragma once
+#ifndef CLOUDBUS_SEGMENT_CONFIG_HPP
+#define CLOUDBUS_SEGMENT_CONFIG_HPP
+#include "segment/segment_options.hpp"
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <sys/socket.h>
+namespace cloudbus::segment {
+/**
+ * @brief The runtime configuration of a segment process.
+ *
+ * @details The configuration is read from a file of `key = value` lines,
+ * where `#` starts a comment, and each setting can be overridden on the
+ * command line with the same key. Keys that take addresses (`listen`,
+ * `upstream` and `route`) may be repeated. Addresses are written as
+ * `A.B.C.D:PORT`, `[IPV6]:PORT`, `*:PORT` for all IPv4 interfaces, or
+ * `unix:PATH`, where a PATH that starts with `@` is in the abstract
+ * namespace. Sizes take an optional `K`, `M` or `G` suffix.
+ *
+ * @par Example:
+ * @code{.unparsed}
+ * listen = [::]:8080
+ * listen = unix:/run/segment.sock
+ * workers = 8
+ * cpus = 0-7
+ * tuning = latency
+ * framing = length
+ * max_frame_size = 1M
+ * @endcode
+ */
+struct segment_config {
+  /** @brief The default port that the segment listens on. */
+  static constexpr std::uint16_t default_port = 8080;
+
+  /**
+   * @brief The addresses to listen on.
+   * @details Each address is served by `workers` reactors. When this is
+   * empty, the segment listens on port `default_port` of all IPv4
+   * interfaces.
+   */
+  std::vector<sockaddr_storage> listen;
+  /** @brief The number of reactors per address, or 0 for one per CPU. */
+  std::size_t workers = 1;
+  /** @brief The CPUs to pin the reactors to, or all allowed CPUs. */
+  std::vector<int> cpus;
+  /** @brief Runs the data path on io_uring. */
+  bool io_uring = false;
+  /**
+   * @brief Serves datagrams instead of streams.
+   * @details The segment binds UDP sockets, or Unix-domain datagram
+   * sockets, to the listen addresses (see udp_segment_service).
+   */
+  bool udp = false;
+  /** @brief Sets SO_INCOMING_CPU on each reactor to its pinned CPU. */
+  bool incoming_cpu = false;
+  /**
+   * @brief The path of the Unix-domain socket for hot restarts.
+   * @details A segment that starts while another segment serves on this
+   * path takes over its listening sockets, and the other segment drains.
+   * Stream sockets are only handed off on the io_uring data path. When
+   * this is empty, hot restarts are disabled.
+   */
+  std::string handoff;
+  /**
+   * @brief Terminates TLS on accepted connections.
+   * @details Both data paths terminate TLS on stream sockets, which
+   * needs a segment built with kernel TLS support.
+   */
+  bool accept_tls = false;
+  /** @brief Encrypts the connections to the upstream peers. */
+  bool upstream_tls = false;
+  /**
+   * @brief The TLS credentials of the segment.
+   * @details The same credentials are used for accepted and upstream
+   * connections, so that segments that share a CA authenticate each
+   * other on both ends of a link.
+   */
+  detail::tls_settings tls;
+  /**
+   * @brief The file that the hot path trace is written to.
+   * @details The trace is written on SIGUSR1 and at exit, and needs a
+   * build with `CB_SEGMENT_ENABLE_TRACE`. When this is empty, no trace
+   * is written.
+   */
+  std::string trace_file;
+  /**
+   * @brief The options of the segment services.
+   * @details The connection caps, `max_connections` and
+   * `max_connections_per_source`, are shared by all reactors, so they
+   * cap the connections of the whole segment. The rate limits apply to
+   * each connection, which stops reading while it is over them.
+   */
+  segment_options options;
+
+  /**
+   * @brief Sets a configuration value.
+   * @param key The name of the setting.
+   * @param value The value of the setting.
+   * @return `std::errc::invalid_argument` if the key is unknown or the
+   * value is malformed.
+   */
+  auto set(std::string_view key, std::string_view value) -> std::error_code;
+
+  /**
+   * @brief Reads configuration values from a stream.
+   * @param is The stream of `key = value` lines.
+   * @param line Set to the number of the line that failed.
+   * @return The error of the first line that failed.
+   */
+  auto load(std::istream &is, std::size_t &line) -> std::error_code;
+
+  /**
+   * @brief Parses a socket address.
+   * @param arg The address to parse.
+   * @param address The parsed address.
+   * @return The length of the parsed address, or 0 if it is malformed.
+   */
+  static auto parse_address(std::string_view arg,
+                            sockaddr_storage &address) -> socklen_t;
+
+  /**
+   * @brief Gets the length of a socket address.
+   * @param address A socket address that was set by `parse_address`.
+   * @return The length of the address.
+   */
+  [[nodiscard]] static auto
+  address_size(const sockaddr_storage &address) noexcept -> socklen_t;
+};
+} // namespace cloudbus::segment
+#endif // CLOUDBUS_SEGMENT_CONFIG_HPP
@@ -0,0 +1,308 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file segment_options.hpp
+ * @brief This file declares the runtime options of the segment service.
+ */
+#pragma once
+#ifndef CLOUDBUS_SEGMENT_OPTIONS_HPP
+#define CLOUDBUS_SEGMENT_OPTIONS_HPP
+#include "segment/detail/admission.hpp"
+#include "segment/detail/memory_budget.hpp"
+#include "segment/detail/routing_table.hpp"
+#include "segment/detail/shard_exchange.hpp"
+#include "segment/detail/ticker.hpp"
+#include "segment/detail/tls_session.hpp"
+#include "segment/socket_tuning.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <sys/socket.h>
+namespace cloudbus::segment {
+/** @brief How a segment splits its input stream into messages. */
+enum class framing_mode : std::uint8_t {
+  /** @brief The stream is treated as raw bytes. */
+  none,
+  /** @brief Messages are prefixed with a 4 byte big-endian length. */
+  length_prefixed,
+  /** @brief Messages are terminated by a delimiter byte. */
+  delimited,
+};
+
+/** @brief Runtime options for a segment_service instance. */
+struct segment_options {
+  /**
+   * @brief Sets SO_REUSEPORT on the listening socket.
+   * @details This allows several segment services (one per reactor) to
+   * bind to the same address so that the kernel load-balances accepted
+   * connections between them.
+   */
+  bool reuse_port = false;
+  /**
+   * @brief The maximum number of buffers coalesced into one `sendmsg`.
+   * @details Buffers that are queued while a send is in flight are written
+   * together in a single scatter-gather `sendmsg`. When more buffers are
+   * queued than fit in one call, the call is made with `MSG_MORE` so that
+   * the kernel holds back the partial segment until the rest follows.
+   * A value of 1 disables coalescing.
+   */
+  std::size_t max_send_buffers = 64;
+  /**
+   * @brief Keeps reading from a connection while its sends are in flight.
+   * @details When pipelining is disabled, the next read on a connection
+   * is only posted after all of the bytes that were read have been
+   * written back. When it is enabled, the next read is posted immediately
+   * into a fresh read buffer and the writes are ordered through the
+   * connection's output queue.
+   */
+  bool pipeline = false;
+  /**
+   * @brief The maximum number of unwritten bytes per pipelined connection.
+   * @details Reads are paused while this many bytes are waiting to be
+   * written, and resumed once the output queue drains below it.
+   */
+  std::size_t max_outstanding_bytes = 1024UL * 1024UL;
+  /**
+   * @brief The smallest send that is made with `MSG_ZEROCOPY`.
+   * @details Sends of at least this many bytes are made with
+   * `MSG_ZEROCOPY`, and their read buffers are kept alive until the
+   * kernel reports on the socket error queue that it has released the
+   * pages. Zerocopy only pays off for large sends, since each one costs a
+   * page pinning and a completion notification. A value of 0 disables
+   * zerocopy sends.
+   */
+  std::size_t zerocopy_threshold = 0;
+  /** @brief The socket options that are set on every socket. */
+  socket_tuning tuning;
+  /**
+   * @brief The busy-polling window in microseconds.
+   * @details When this is non-zero, SO_BUSY_POLL is set on every socket,
+   * so that blocking on a socket first spins on the device queue for up
+   * to this long, and the io_uring event loop spins on its completion
+   * queue for up to this long before it sleeps. This trades a busy core
+   * for not paying a wakeup per message. Windows longer than the
+   * `net.core.busy_read` sysctl need CAP_NET_ADMIN. A value of 0
+   * disables busy polling.
+   */
+  std::uint32_t busy_poll_usecs = 0;
+  /**
+   * @brief How long a draining service waits for its writes to complete.
+   * @details The connections that are still open when this has passed
+   * are closed.
+   */
+  std::chrono::milliseconds drain_timeout{5000};
+  /**
+   * @brief How long a connection may go without receiving anything.
+   * @details Idle connections are closed, which also bounds how long a
+   * TLS handshake may take. Timeouts are checked on a timing wheel each
+   * time the event loop wakes up, so they fire up to 100ms late. A
+   * forwarded connection and its upstream peer are only idle while
+   * neither receives anything. A value of 0 disables the timeout.
+   */
+  std::chrono::milliseconds idle_timeout{0};
+  /**
+   * @brief How long a send may stay in flight.
+   * @details A connection whose peer stops reading is closed once a send
+   * has made no progress for this long. A value of 0 disables the
+   * timeout.
+   */
+  std::chrono::milliseconds write_timeout{0};
+  /**
+   * @brief How long a message may wait behind the send in flight.
+   * @details When a send completes, the framed messages behind it that
+   * were read longer ago are dropped instead of sent late, so that an
+   * overloaded connection cannot hold its backlog for ever. The reads of
+   * an unframed stream cannot be dropped on their own without corrupting
+   * it, so a stream whose oldest unsent read is past the deadline is
+   * closed instead. A value of 0 disables the deadline.
+   */
+  std::chrono::milliseconds message_deadline{0};
+  /**
+   * @brief The number of buffers in the io_uring provided buffer ring.
+   * @details Must be a power of two. Only used by uring_segment_service.
+   */
+  std::size_t uring_buffer_count = 4096;
+  /** @brief The size of each io_uring provided buffer. */
+  std::size_t uring_buffer_size = 16UL * 1024UL;
+  /**
+   * @brief The number of buffers in the io_uring large buffer ring.
+   * @details Each connection receives into the buffer ring that fits its
+   * recent reads (see detail::read_sizer), so bulk streams get large
+   * buffers while request-response connections keep small ones. Must be
+   * a power of two. A value of 0 disables the large buffers.
+   */
+  std::size_t uring_large_buffer_count = 64;
+  /** @brief The size of each io_uring large buffer. */
+  std::size_t uring_large_buffer_size = 256UL * 1024UL;
+  /**
+   * @brief The number of datagrams received and sent per syscall.
+   * @details Only used by udp_segment_service.
+   */
+  std::size_t udp_batch_size = 32;
+  /**
+   * @brief The size of each datagram receive slot.
+   * @details Datagrams that do not fit in a slot are dropped. With UDP
+   * GRO, a slot holds a train of datagrams, so slots smaller than 64K
+   * truncate the longer trains.
+   */
+  std::size_t udp_buffer_size = 64UL * 1024UL;
+  /**
+   * @brief Enables UDP GRO and GSO where the kernel supports them.
+   * @details GRO coalesces the datagrams of a sender into one receive
+   * slot, and GSO sends a train of equally sized datagrams to the same
+   * peer as one message that the kernel or the device segments.
+   */
+  bool udp_offload = true;
+  /**
+   * @brief How the input stream is split into messages.
+   * @details When framing is enabled, only complete messages are written
+   * back, and a connection is closed when it sends a malformed message.
+   */
+  framing_mode framing = framing_mode::none;
+  /** @brief The byte that terminates each message in delimited framing. */
+  char delimiter = '\n';
+  /** @brief The largest accepted message, including its framing. */
+  std::size_t max_frame_size = 16UL * 1024UL * 1024UL;
+  /**
+   * @brief The peers that connections are forwarded to.
+   * @details When this is empty, the segment echoes its input back to the
+   * same connection. Otherwise each inbound connection is connected to
+   * the next upstream peer in round-robin order, and bytes are relayed in
+   * both directions. Without framing, the bytes are spliced between the
+   * sockets through a pipe and never reach userspace. With framing, only
+   * complete messages are relayed through the output queues.
+   */
+  std::vector<sockaddr_storage> upstreams;
+  /**
+   * @brief The number of persistent upstream connections per reactor.
+   * @details When this is non-zero and framing is enabled, the messages of
+   * all downstream connections are multiplexed onto this many upstream
+   * connections (see detail::mux_frame) instead of opening an upstream
+   * connection per downstream connection. Replies are routed back by their
+   * stream id. With a routing table, this is the number of connections to
+   * each member of the table. With a shard exchange, the reactors share
+   * one pool instead of each keeping their own.
+   */
+  std::size_t upstream_pool_size = 0;
+  /**
+   * @brief Routes multiplexed messages by key across the upstream peers.
+   * @details When this is set, the members of the routing table replace
+   * `upstreams` for multiplexed connections, and each message is sent to
+   * the member that owns the hash of its key on a consistent-hash ring,
+   * on one of `upstream_pool_size` connections to that member. The table
+   * may be shared by all reactors and updated while they run.
+   */
+  std::shared_ptr<detail::routing_table> routes;
+  /**
+   * @brief Caps the read buffer memory of all reactors.
+   * @details Each connection's read buffers, whose sizes follow its
+   * recent reads, are charged to the budget while any of their bytes are
+   * held, whether they are queued for writing, held by a zerocopy send,
+   * or queued on the pooled connections by a multiplexed connection.
+   * While the budget is exhausted, a connection that still holds any of
+   * its read buffers stops reading until they are released. The budget
+   * may be shared by all reactors. When this is null, the memory is not
+   * capped.
+   */
+  std::shared_ptr<detail::memory_budget> memory_budget;
+  /**
+   * @brief Wakes the reactors up for their timers and housekeeping.
+   * @details The ticker may be shared by all reactors. When this is null,
+   * each reactor of segment_service starts its own. Not used by
+   * uring_segment_service, whose event loop wakes itself up.
+   */
+  std::shared_ptr<detail::ticker> ticker;
+  /**
+   * @brief Shares the upstream connection pool between the reactors.
+   * @details When this is set, each connection of the pool is owned by
+   * the reactor whose `shard` is its index modulo the number of shards,
+   * and multiplexed messages are handed to that reactor through the
+   * exchange, as are the replies to the reactor of their stream. Each
+   * reactor sharing the exchange needs its own `shard`. Not used by
+   * uring_segment_service, which does not multiplex.
+   */
+  std::shared_ptr<detail::shard_exchange> exchange;
+  /** @brief The index of the reactor in the shard exchange. */
+  std::size_t shard = 0;
+  /**
+   * @brief The maximum number of connections.
+   * @details The cap holds for all reactors that share `admission`, or
+   * for the reactor alone without it. Connections beyond this are closed
+   * as soon as they are accepted, whether or not they have sent
+   * anything. Outbound upstream connections are not counted. A value of
+   * 0 disables the limit.
+   */
+  std::size_t max_connections = 0;
+  /**
+   * @brief The maximum number of connections from one source IP.
+   * @details The cap holds for all reactors that share `admission`, like
+   * `max_connections`. All Unix-domain peers count as one source. A
+   * value of 0 disables the limit.
+   */
+  std::size_t max_connections_per_source = 0;
+  /**
+   * @brief The admission control that the reactors share.
+   * @details It enforces `max_connections` and
+   * `max_connections_per_source` across the reactors that share it. When
+   * this is null, each reactor enforces the caps on its own connections.
+   */
+  std::shared_ptr<detail::admission_control> admission;
+  /**
+   * @brief The byte rate limit of each inbound connection, per second.
+   * @details A connection over the rate stops reading until its limits
+   * have refilled, so that the messages that it has already sent are
+   * delayed rather than dropped. A value of 0 disables the limit.
+   */
+  std::uint64_t rate_limit_bytes = 0;
+  /**
+   * @brief The message rate limit of each inbound connection, per second.
+   * @details A value of 0 disables the limit.
+   */
+  std::uint64_t rate_limit_messages = 0;
+  /**
+   * @brief How much of the rate limits a connection can take at once.
+   * @details A connection that has been idle can send this long's worth
+   * of its rates in a burst.
+   */
+  std::chrono::milliseconds rate_limit_burst{1000};
+  /**
+   * @brief Terminates TLS on accepted connections.
+   * @details The handshake runs in userspace and the records are then
+   * encrypted and decrypted by kernel TLS, so sends, receives and splices
+   * work on the plaintext. Connections that kernel TLS cannot take over
+   * are closed. When this is null, connections are not encrypted.
+   */
+  std::shared_ptr<detail::tls_context> tls;
+  /**
+   * @brief Encrypts the connections to the upstream peers.
+   * @details Bytes that are queued for an upstream peer are held back
+   * until its handshake has completed. Zerocopy sends are not made on
+   * encrypted connections, since kernel TLS does not support them. When
+   * this is null, upstream connections are not encrypted.
+   */
+  std::shared_ptr<detail::tls_context> upstream_tls;
+  /**
+   * @brief The number of leading payload bytes that form a message key.
+   * @details A value of 0 makes the whole payload the key.
+   */
+  std::size_t routing_key_size = 0;
+};
+} // namespace cloudbus::segment
+#endif // CLOUDBUS_SEGMENT_OPTIONS_HPP
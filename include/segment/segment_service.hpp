@@ -20,35 +20,140 @@
 #pragma once
 #ifndef CLOUDBUS_SEGMENT_SERVICE_HPP
 #define CLOUDBUS_SEGMENT_SERVICE_HPP
+#include "segment/detail/admission.hpp"
+#include "segment/detail/buffer_pool.hpp"
+#include "segment/detail/delimiter_parser.hpp"
+#include "segment/detail/frame_parser.hpp"
+#include "segment/detail/hash_ring.hpp"
+#include "segment/detail/memory_budget.hpp"
+#include "segment/detail/metrics.hpp"
+#include "segment/detail/mux_frame.hpp"
+#include "segment/detail/pipeline.hpp"
+#include "segment/detail/read_sizer.hpp"
+#include "segment/detail/shard_exchange.hpp"
+#include "segment/detail/splice_pipe.hpp"
+#include "segment/detail/ticker.hpp"
+#include "segment/detail/timer_wheel.hpp"
+#include "segment/detail/tls_session.hpp"
+#include "segment/detail/write_queue.hpp"
+#include "segment/detail/zerocopy_tracker.hpp"
+#include "segment/segment_options.hpp"
+
 #include <net/service/async_tcp_service.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 /** @namespace For cloudbus segment definitions. */
 namespace cloudbus::segment {
 /** @brief The service type to use. */
 template <typename TCPStreamHandler>
 using service_base = service::async_tcp_service<TCPStreamHandler>;
 
+/** @brief The message path of a segment without rate limits. */
+using default_path = detail::message_path<detail::counting_stage>;
+/** @brief The message path of a segment that enforces rate limits. */
+using limited_path =
+    detail::message_path<detail::counting_stage, detail::limiting_stage>;
+
 /** @brief The Cloudbus segment service. */
 struct segment_service : public service_base<segment_service> {
   /** @brief The base class. */
   using Base = service_base<segment_service>;
   /** @brief The socket message type. */
   using socket_message = io::socket::socket_message<>;
+
+  /**
+   * @brief A read buffer taken from the reactor's buffer pool.
+   * @details The buffer is sized for its connection, and charged to the
+   * connection's memory account until the last owner of the read context
+   * lets go of it.
+   */
+  struct read_context {
+    /**
+     * @brief Takes a buffer from the buffer pool.
+     * @param size The size of the buffer.
+     * @param account The memory account to charge.
+     */
+    read_context(std::size_t size,
+                 std::shared_ptr<detail::memory_account> account);
+    /** @brief Deleted copy constructor. */
+    read_context(const read_context &other) = delete;
+    /** @brief Deleted copy assignment. */
+    auto operator=(const read_context &other) -> read_context & = delete;
+    /** @brief Returns the buffer to the buffer pool. */
+    ~read_context();
+
+    /** @brief The buffer. */
+    std::span<std::byte> buffer;
+
+  private:
+    /** @brief The memory account that the buffer is charged to. */
+    std::shared_ptr<detail::memory_account> account_;
+  };
   /**
    * @brief Constructs segment_service on the socket address.
    * @tparam T The type of the socket_address.
    * @param address The local IP address to bind to.
+   * @param options The runtime options of the service.
    */
   template <typename T>
-  explicit segment_service(socket_address<T> address) noexcept : Base(address)
-  {}
+  explicit segment_service(socket_address<T> address,
+                           const segment_options &options = {}) noexcept
+      : Base(address), options_{options},
+        admission_{options.admission
+                       ? options.admission
+                       : std::make_shared<detail::admission_control>(
+                             options.max_connections,
+                             options.max_connections_per_source)},
+        address_len_{sizeof(T)}
+  {
+    std::memcpy(&address_, address.operator->(), sizeof(T));
+    if (options.rate_limit_bytes || options.rate_limit_messages)
+      path_ = limited_path{};
+  }
   /**
    * @brief Initializes socket options.
    * @param sock The socket to initialize.
+   * @return An error code if a socket option could not be set.
    */
-  [[nodiscard]] static auto
-  initialize(const socket_handle &sock) noexcept -> std::error_code;
+  [[nodiscard]] auto
+  initialize(const socket_handle &sock) const noexcept -> std::error_code;
   /**
-   * @brief Services the incoming socket_message.
+   * @brief Starts listening and accepting connections.
+   * @details The service accepts its connections itself rather than
+   * through service_base, so that every connection is admitted and gets
+   * its idle timeout as soon as it is accepted, whether or not it ever
+   * sends anything. The ticks and the shard exchange are started too.
+   * @param ctx The asynchronous context of the reactor.
+   * @return An error code if the listening socket could not be set up.
+   */
+  [[nodiscard]] auto start(async_context &ctx) noexcept -> std::error_code;
+  /**
+   * @brief Handles a signal sent to the reactor.
+   * @details On terminate, the listening socket is shut down so that no
+   * more connections are accepted.
+   * @param signum The signal number.
+   */
+  auto signal_handler(int signum) noexcept -> void;
+  /**
+   * @brief Services the incoming bytes.
+   * @details The bytes are queued on the output queue of the connection
+   * that they are forwarded to, or of the same connection when there are
+   * no upstream peers, and written to its socket. Bytes that are queued
+   * while a send is in flight are coalesced into the next send. Short
+   * writes are resumed from the unwritten tail of the read buffer. If
+   * pipelining is enabled, the next read is posted before the send
+   * completes. The messages go through the message path of the service,
+   * which only has a limiting stage when rate limits are set.
    * @param ctx The asynchronous context of the message.
    * @param socket The socket that the message was read from.
    * @param rctx The read context that manages the read buffer lifetime.
@@ -58,7 +163,9 @@ struct segment_service : public service_base<segment_service> {
                const std::shared_ptr<read_context> &rctx,
                const socket_message &msg) -> void;
   /**
-   * @brief Receives the bytes emitted by the service_base reader.
+   * @brief Receives the bytes that were read from a connection.
+   * @details Reads that complete after their connection was dropped are
+   * ignored.
    * @param ctx The asynchronous context of the message.
    * @param socket The socket that the message was read from.
    * @param rctx The read context that manages the read buffer lifetime.
@@ -67,6 +174,512 @@ struct segment_service : public service_base<segment_service> {
   auto operator()(async_context &ctx, const socket_dialog &socket,
                   const std::shared_ptr<read_context> &rctx,
                   std::span<const std::byte> buf) -> void;
+
+private:
+  /** @brief The per-connection state of the service. */
+  struct connection {
+    /** @brief The buffers waiting to be written to the socket. */
+    detail::write_queue queue;
+    /** @brief The buffers of zerocopy sends awaiting their completion. */
+    detail::zerocopy_tracker zerocopy;
+    /** @brief Splits a length-prefixed input stream into messages. */
+    detail::frame_parser prefixed;
+    /** @brief Splits a delimited input stream into messages. */
+    detail::delimiter_parser delimited;
+    /** @brief The read context of the read in flight. */
+    std::shared_ptr<read_context> rctx;
+    /** @brief Sizes the read buffers by the recent reads. */
+    detail::read_sizer sizer;
+    /** @brief What other queues hold a shared read buffer through. */
+    std::shared_ptr<std::shared_ptr<read_context>> lease;
+    /** @brief The read buffer memory held by the connection. */
+    std::shared_ptr<detail::memory_account> memory;
+    /** @brief The connection that the input is forwarded to. */
+    std::weak_ptr<connection> peer;
+    /** @brief The socket of the connection. */
+    std::optional<socket_dialog> socket;
+    /** @brief The pipe that the input is spliced to the peer through. */
+    std::unique_ptr<detail::splice_pipe> pipe;
+#ifdef CB_SEGMENT_HAS_KTLS
+    /** @brief The TLS handshake in progress on the connection. */
+    std::unique_ptr<detail::tls_session> tls;
+#endif
+    /** @brief The buffer that is peeked into to wait for input. */
+    std::array<std::byte, 1> peek{};
+    /** @brief The connections waiting for the output queue to drain. */
+    std::vector<std::weak_ptr<connection>> waiters;
+    /** @brief When the oldest bytes in the output queue were read. */
+    std::chrono::steady_clock::time_point queued_at;
+    /** @brief The rate limits of an inbound connection. */
+    detail::rate_limiter limiter;
+    /** @brief The idle or write timeout of the connection. */
+    detail::timer_wheel::timer timeout;
+    /** @brief The source IP that the connection was admitted for. */
+    detail::admission_control::source_type source{};
+    /** @brief The stream id of a multiplexed connection, or 0. */
+    std::uint32_t stream{0};
+    /** @brief Whether the connection counts against admission control. */
+    bool admitted{false};
+    /** @brief Whether the connection is forwarded to a peer. */
+    bool forwarded{false};
+    /** @brief Whether kernel TLS encrypts the connection. */
+    bool encrypted{false};
+    /** @brief Whether SO_ZEROCOPY is enabled on the socket. */
+    bool zerocopy_capable{false};
+    /** @brief Whether the connection was made to an upstream peer. */
+    bool outbound{false};
+    /** @brief Whether this is a pooled upstream connection. */
+    bool pooled{false};
+    /** @brief Whether the upstream peer was removed from the routes. */
+    bool retired{false};
+    /** @brief Whether a send is in flight on the connection. */
+    bool sending{false};
+    /** @brief Whether a read is posted on the connection. */
+    bool reading{false};
+    /** @brief Whether the last read filled its read buffer. */
+    bool busy{false};
+    /** @brief Whether the input of a spliced connection has ended. */
+    bool eof{false};
+    /** @brief Whether the reads wait for the rate limits to refill. */
+    bool throttled{false};
+    /** @brief Whether the reactor reaps the zerocopy sends on its ticks. */
+    bool reaping{false};
+    /** @brief Whether the connection has been dropped. */
+    bool closed{false};
+  };
+  /** @brief The native socket handle type. */
+  using native_handle_type = io::socket::native_socket_type;
+
+  /**
+   * @brief Gets the state of the connection on a socket.
+   * @details The connection state is created if it doesn't exist yet.
+   * @param socket The socket of the connection.
+   * @return The connection state.
+   */
+  auto get_connection(const socket_dialog &socket)
+      -> const std::shared_ptr<connection> &;
+
+  /**
+   * @brief Accepts the connections on the listening socket.
+   * @details Accepting stops when the listening socket is shut down. If
+   * an accept fails for any other reason, such as running out of file
+   * descriptors, it is retried on the next tick.
+   * @param ctx The asynchronous context of the reactor.
+   * @param listener The listening socket.
+   */
+  auto accept(async_context &ctx, const socket_dialog &listener) -> void;
+
+  /**
+   * @brief Starts the data path of a connection that has been accepted.
+   * @details The connection is admitted and its idle timeout armed before
+   * its first read is posted, or its TLS handshake started.
+   * @param ctx The asynchronous context of the reactor.
+   * @param socket The socket of the connection.
+   */
+  auto accepted(async_context &ctx, const socket_dialog &socket) -> void;
+
+  /**
+   * @brief Admits a new inbound connection.
+   * @details This is called when a connection is accepted. A connection
+   * that admission control rejects is shut down and gets no state. An
+   * admitted connection gets its rate limits.
+   * @param socket The socket of the connection.
+   * @return False if the connection was rejected.
+   */
+  auto admit(const socket_dialog &socket) -> bool;
+
+  /**
+   * @brief Gets the connection that the input of a connection goes to.
+   * @details The first time that this is called for an inbound connection
+   * while there are upstream peers, a connection to the next upstream
+   * peer is made.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket of the connection.
+   * @param conn The connection state.
+   * @return The peer of a forwarded connection, `conn` itself if the
+   * input is echoed, or nullptr if the peer has been dropped.
+   */
+  auto forward(async_context &ctx, const socket_dialog &socket,
+               const std::shared_ptr<connection> &conn)
+      -> std::shared_ptr<connection>;
+
+  /**
+   * @brief Forwards the messages of a multiplexed connection.
+   * @details Each message is queued on the pooled upstream connection in
+   * the slot that `select_slot` picks for it, behind a header with its
+   * stream id, or handed to the reactor that owns that slot.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket of the downstream connection.
+   * @param conn The downstream connection state.
+   * @param rctx The read context that manages the read buffer lifetime.
+   * @param buf The bytes that were read from the socket.
+   */
+  auto multiplex(async_context &ctx, const socket_dialog &socket,
+                 const std::shared_ptr<connection> &conn,
+                 const std::shared_ptr<read_context> &rctx,
+                 std::span<const std::byte> buf) -> void;
+
+  /**
+   * @brief Picks the slot of the connection pool for a message.
+   * @details With a routing table, the upstream peer is picked by the
+   * hash of the message key, otherwise by the stream id.
+   * @param stream The stream id of the message.
+   * @param frame The message.
+   * @return The slot, or nothing if there are no upstream peers.
+   */
+  auto select_slot(std::uint32_t stream, const detail::frame_view &frame)
+      -> std::optional<std::size_t>;
+
+  /**
+   * @brief Gets the pooled upstream connection in a slot of the pool.
+   * @details The pooled connection is connected if it doesn't exist yet
+   * or has been dropped.
+   * @param ctx The asynchronous context of the connection.
+   * @param slot A slot that `select_slot` picked.
+   * @return The pooled upstream connection.
+   */
+  auto select_upstream(async_context &ctx, std::size_t slot)
+      -> std::shared_ptr<connection>;
+
+  /**
+   * @brief Rebuilds the connection pool for a new routing table snapshot.
+   * @param ring The new snapshot.
+   */
+  auto repool(std::shared_ptr<const detail::hash_ring> ring) -> void;
+
+  /**
+   * @brief Retires a pooled upstream connection of a removed member, or
+   * the output of a half-closed spliced connection.
+   * @details The write side of the connection is shut down once its
+   * output queue has drained.
+   * @param conn The connection to retire.
+   */
+  auto retire(const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Opens a connection to an upstream peer.
+   * @details Bytes that are queued for the upstream peer are held back
+   * until the connection is established.
+   * @param ctx The asynchronous context to connect on.
+   * @param upstream The address of the upstream peer.
+   * @return The upstream connection state.
+   */
+  auto connect(async_context &ctx, const sockaddr_storage &upstream)
+      -> std::shared_ptr<connection>;
+
+  /**
+   * @brief Starts the data path of a connection once it is connected and
+   * its TLS handshake, if any, has completed.
+   * @details Writes the bytes that were held back while connecting and
+   * posts the first read.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket of the connection.
+   * @param conn The connection state.
+   */
+  auto established(async_context &ctx, const socket_dialog &socket,
+                   const std::shared_ptr<connection> &conn) -> void;
+
+#ifdef CB_SEGMENT_HAS_KTLS
+  /**
+   * @brief Continues the TLS handshake of a connection.
+   * @details Upstream connections run the client side of the handshake,
+   * inbound connections the server side. The handshake waits for the
+   * socket by peeking at one byte, and the data path starts once kernel
+   * TLS has taken over the records.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket of the connection.
+   * @param conn The connection state.
+   */
+  auto handshake(async_context &ctx, const socket_dialog &socket,
+                 const std::shared_ptr<connection> &conn) -> void;
+#endif
+
+  /**
+   * @brief Routes the replies on a pooled upstream connection.
+   * @details Each reply is queued on the downstream connection of its
+   * stream without being copied, or handed to the reactor of its stream.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket of the pooled upstream connection.
+   * @param conn The pooled upstream connection state.
+   * @param rctx The read context that manages the read buffer lifetime.
+   * @param buf The bytes that were read from the socket.
+   */
+  auto demux(async_context &ctx, const socket_dialog &socket,
+             const std::shared_ptr<connection> &conn,
+             const std::shared_ptr<read_context> &rctx,
+             std::span<const std::byte> buf) -> void;
+
+  /**
+   * @brief Hands a multiplexed message to another reactor.
+   * @details The message is sent through the shard exchange, or kept in
+   * order behind the messages to the same reactor that are still waiting
+   * for room in its ring.
+   * @param to The reactor to hand the message to.
+   * @param stream The stream id of the message.
+   * @param owner The owner of the head of the message, which is moved
+   * from if the message is handed off.
+   * @param frame The message.
+   * @param reply Whether the message is a reply to the stream.
+   * @return False if the message must be handled by this reactor, which
+   * is the case when `to` is this reactor or has no doorbell.
+   */
+  auto handoff(std::size_t to, std::uint32_t stream,
+               detail::write_queue::owner_type &owner,
+               const detail::frame_view &frame, bool reply) -> bool;
+
+  /**
+   * @brief Queues a message that another reactor has handed over.
+   * @details A forwarded message is queued on the pooled upstream
+   * connection that this reactor picks for it, and a reply on the
+   * downstream connection of its stream.
+   * @param ctx The asynchronous context of the reactor.
+   * @param pieces The pieces of the message.
+   */
+  auto deliver(async_context &ctx, std::span<detail::shard_message> pieces)
+      -> void;
+
+  /**
+   * @brief Sends the messages that are waiting for room in the rings of
+   * the shard exchange.
+   * @details The multiplexed connections that paused their reads on them
+   * read again once no message is left waiting.
+   * @param ctx The asynchronous context of the reactor.
+   */
+  auto send_backlog(async_context &ctx) -> void;
+
+  /**
+   * @brief Gets the owner that queues hold a shared read buffer through.
+   * @details The messages in the read buffer of a multiplexed or pooled
+   * connection are queued on many connections. They all hold the buffer
+   * through the same lease, so that the use count of the lease shows
+   * whether any of them still refers to the buffer.
+   * @param conn The multiplexed or pooled connection state.
+   * @param rctx The read context of the read buffer.
+   * @return The lease of the read buffer.
+   */
+  auto lease(const std::shared_ptr<connection> &conn,
+             const std::shared_ptr<read_context> &rctx)
+      -> detail::write_queue::owner_type;
+
+  /**
+   * @brief Drops the state of the connection on a socket.
+   * @details The peer of a forwarded connection is dropped with it.
+   * @param socket The socket of the connection.
+   * @param conn The connection state to drop, or nullptr to drop whatever
+   * state is currently associated with the socket.
+   */
+  auto drop_connection(const socket_dialog &socket,
+                       const std::shared_ptr<connection> &conn = {}) -> void;
+
+  /**
+   * @brief Resumes the reads that were paused on an output queue.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket of the connection.
+   * @param conn The connection whose output queue has drained.
+   */
+  auto resume(async_context &ctx, const socket_dialog &socket,
+              const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Writes the buffers at the front of the output queue.
+   * @details When a send completes, the messages behind it that are past
+   * the message deadline are dropped, or an unframed connection is closed.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket to write to.
+   * @param conn The connection state.
+   */
+  auto flush(async_context &ctx, const socket_dialog &socket,
+             const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Posts the next read on a connection if it is allowed to read.
+   * @details A connection may read if it has no read posted and either
+   * the output queue that its input goes to is empty or, when pipelining,
+   * that queue is below the outstanding bytes limit and the memory budget
+   * is not exhausted. Over the memory budget, a connection whose read
+   * buffers are still held by queues or zerocopy sends that do not wake
+   * it up, such as the messages of a multiplexed connection, reads again
+   * on a later tick. Forwarded connections without framing splice
+   * instead. Zerocopy completions that have already arrived are reaped
+   * before the checks. A connection over its rate limits reads again
+   * on a later tick, and a multiplexed connection once the messages
+   * that wait for room in the shard exchange have been handed over. While
+   * the reactor drains, only connections to upstream peers read, so that
+   * the replies to the bytes that were already read are still passed on.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket to read from.
+   * @param conn The connection state.
+   */
+  auto read(async_context &ctx, const socket_dialog &socket,
+            const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Waits for a connection to become readable, then reads it.
+   * @details The connection lets go of its previous read buffer and peeks
+   * at one byte, so that an idle connection holds no read buffer. Once the
+   * socket is readable, a read buffer of the size that the connection's
+   * recent reads call for is taken from the reactor's buffer pool and
+   * read into. After a read that filled its buffer, the connection is
+   * still busy and reads straight into a new buffer without the peek.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket to read from.
+   * @param conn The connection state.
+   */
+  auto await_input(async_context &ctx, const socket_dialog &socket,
+                   const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Reads into the read buffer of a connection.
+   * @details The size of the read is recorded for the next read buffer,
+   * and the bytes are passed to `operator()`. The end of the input drops
+   * the connection.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket to read from.
+   * @param conn The connection state.
+   */
+  auto receive(async_context &ctx, const socket_dialog &socket,
+               const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Splices the input of a forwarded connection to its peer.
+   * @details Waits for the socket to become readable by peeking at one
+   * byte, then splices as many bytes as the peer will take through the
+   * connection's pipe. Bytes that the peer could not take are read out of
+   * the pipe and queued on the peer's output queue, and splicing resumes
+   * once that queue has drained. At the end of the input, the write side
+   * of the peer is shut down once it has written everything, and the
+   * connection is dropped once the input of the peer has ended too.
+   * @param ctx The asynchronous context of the connection.
+   * @param socket The socket to read from.
+   * @param conn The connection state.
+   */
+  auto splice(async_context &ctx, const socket_dialog &socket,
+              const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Starts reading the ticks of the reactor.
+   * @details The reactor subscribes a socket of its own to the ticker of
+   * the options, or to a ticker of its own if the options have none.
+   * Without ticks, no timeouts fire.
+   * @param ctx The asynchronous context of the reactor.
+   */
+  auto start_ticks(async_context &ctx) -> void;
+
+  /**
+   * @brief Waits for the next tick and runs the reactor's timers on it.
+   * @param ctx The asynchronous context of the reactor.
+   */
+  auto await_tick(async_context &ctx) -> void;
+
+  /**
+   * @brief Expires the timeouts that are due, reaps the zerocopy sends
+   * that have been waiting for their completions, and resumes the reads
+   * of throttled connections.
+   * @details Messages that are waiting for room in the shard exchange are
+   * sent again, and a failed accept is retried. While the ticker drains,
+   * the reactor shuts down its listening socket, and reports that it has
+   * drained once no connection has anything left to write and no handed
+   * off message is waiting.
+   * @param ctx The asynchronous context of the reactor.
+   */
+  auto tick(async_context &ctx) -> void;
+
+  /**
+   * @brief Attaches the doorbell of the reactor to the shard exchange.
+   * @details Without a doorbell, the reactor neither hands messages to
+   * other reactors nor is handed any.
+   * @param ctx The asynchronous context of the reactor.
+   */
+  auto start_exchange(async_context &ctx) -> void;
+
+  /**
+   * @brief Receives the messages that other reactors have handed over,
+   * and waits for the doorbell to ring again once none are left.
+   * @param ctx The asynchronous context of the reactor.
+   */
+  auto await_handoff(async_context &ctx) -> void;
+
+  /**
+   * @brief Restarts the idle timeout of a connection that has received
+   * bytes.
+   * @details A forwarded connection and its peer share the idle time, so
+   * that one-way traffic keeps both open. Reads do not hold off the write
+   * timeout of a stalled send.
+   * @param conn The connection state.
+   */
+  auto arm_idle(const std::shared_ptr<connection> &conn) -> void;
+
+  /**
+   * @brief Schedules the timeout of a connection.
+   * @details The write timeout is used while a send is in flight, and the
+   * idle timeout otherwise. A timeout of 0 disarms the timer.
+   * @param conn The connection state.
+   */
+  auto arm_timeout(connection &conn) -> void;
+
+  /**
+   * @brief Closes a connection whose timeout has expired.
+   * @param conn The connection state.
+   */
+  auto expire(connection &conn) -> void;
+
+  /** @brief The runtime options of the service. */
+  segment_options options_;
+  /** @brief The connection caps, possibly shared with other reactors. */
+  std::shared_ptr<detail::admission_control> admission_;
+  /** @brief The message path, which only limits rates if they are set. */
+  std::variant<default_path, limited_path> path_;
+  /** @brief The address to listen on. */
+  sockaddr_storage address_{};
+  /** @brief The length of the address to listen on. */
+  socklen_t address_len_{0};
+  /** @brief The listening socket until the reactor drains, or -1. */
+  std::atomic<int> listener_{-1};
+  /** @brief The listening socket while it is open. */
+  std::optional<socket_dialog> listening_;
+  /** @brief Whether an accept is posted on the listening socket. */
+  bool accepting_{false};
+  /** @brief Whether accepted sockets inherit SO_ZEROCOPY. */
+  bool zerocopy_{false};
+  /** @brief The index of the next upstream peer to connect to. */
+  std::size_t next_upstream_{0};
+  /** @brief The pooled upstream connections of the reactor. */
+  std::vector<std::shared_ptr<connection>> pool_;
+  /** @brief The routing table snapshot that the pool was built for. */
+  std::shared_ptr<const detail::hash_ring> ring_;
+  /** @brief The routing table version of the snapshot. */
+  std::uint64_t ring_version_{~std::uint64_t{0}};
+  /** @brief The downstream connections indexed by their stream id. */
+  std::unordered_map<std::uint32_t, std::weak_ptr<connection>> streams_;
+  /** @brief The last stream id that was assigned. */
+  std::uint32_t next_stream_{0};
+  /** @brief When the most recent read completed. */
+  std::chrono::steady_clock::time_point read_time_;
+  /** @brief The timeouts of the connections, once ticks have started. */
+  std::unique_ptr<detail::timer_wheel> timers_;
+  /** @brief The socket that the ticks are read from. */
+  std::optional<socket_dialog> ticks_;
+  /** @brief The buffer that the ticks are read into. */
+  std::array<std::byte, 1> tick_{};
+  /** @brief The id that the reactor reports to the ticker with. */
+  std::uint64_t subscription_{0};
+  /** @brief The connections with zerocopy sends awaiting completion. */
+  std::vector<std::weak_ptr<connection>> reaping_;
+  /** @brief The connections whose reads wait for their rate limits. */
+  std::vector<std::weak_ptr<connection>> throttled_;
+  /** @brief The socket that the doorbell of the shard exchange rings. */
+  std::optional<socket_dialog> doorbell_;
+  /** @brief The buffer that the doorbell is read into. */
+  std::array<std::byte, 1> bell_{};
+  /** @brief The messages waiting for room, indexed by their reactor. */
+  std::vector<std::vector<detail::shard_message>> backlog_;
+  /** @brief The pieces of the message that is being received. */
+  std::vector<detail::shard_message> received_;
+  /** @brief The connections whose reads wait for the backlog. */
+  std::vector<std::weak_ptr<connection>> handing_;
+  /** @brief The connection states indexed by their native socket handle. */
+  std::unordered_map<native_handle_type, std::shared_ptr<connection>>
+      connections_;
 };
 } // namespace cloudbus::segment
 #endif // CLOUDBUS_SEGMENT_SERVICE_HPP
@@ -0,0 +1,107 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file socket_tuning.hpp
+ * @brief This file declares the socket tuning profile of a segment.
+ */
+#pragma once
+#ifndef CLOUDBUS_SOCKET_TUNING_HPP
+#define CLOUDBUS_SOCKET_TUNING_HPP
+#include <system_error>
+namespace cloudbus::segment {
+/**
+ * @brief The socket options that a segment sets on its sockets.
+ *
+ * @details The options are set on the listening socket, whose accepted
+ * sockets inherit all of them except TCP_QUICKACK, and on the sockets
+ * that the segment connects to its upstream peers. Every option is read
+ * back after it is set, so that a setting that the kernel ignored or
+ * clamped fails the startup instead of going unnoticed. A zero or
+ * negative value leaves the kernel default in place. The TCP options
+ * are skipped on sockets of other protocols, such as Unix-domain
+ * sockets.
+ */
+struct socket_tuning {
+  /** @brief Sets TCP_NODELAY, which disables Nagle's algorithm. */
+  bool nodelay = false;
+  /**
+   * @brief Sets TCP_QUICKACK on connected sockets.
+   * @details The kernel clears quickack mode again once it decides that
+   * a connection is interactive, so this only removes the delayed ACKs
+   * at the start of a connection.
+   */
+  bool quickack = false;
+  /**
+   * @brief The SO_SNDBUF size in bytes.
+   * @details Setting a buffer size disables the kernel's buffer
+   * auto-tuning, and sizes above `net.core.wmem_max` are rejected.
+   */
+  int send_buffer = 0;
+  /**
+   * @brief The SO_RCVBUF size in bytes.
+   * @details Sizes above `net.core.rmem_max` are rejected.
+   */
+  int receive_buffer = 0;
+  /**
+   * @brief The TCP_NOTSENT_LOWAT limit in bytes.
+   * @details Limits the unsent bytes in the send buffer, which keeps
+   * queued replies in userspace where they can still be coalesced.
+   */
+  int notsent_lowat = 0;
+  /**
+   * @brief The TCP_DEFER_ACCEPT timeout in seconds.
+   * @details Connections are only accepted once they have sent data, or
+   * after the timeout.
+   */
+  int defer_accept = 0;
+  /**
+   * @brief The SO_INCOMING_CPU of the listening socket, or -1.
+   * @details With SO_REUSEPORT, connections whose packets are received on
+   * this CPU are accepted by this listening socket, which keeps each
+   * connection on the reactor that is pinned to the CPU that handles its
+   * interrupts.
+   */
+  int incoming_cpu = -1;
+
+  /**
+   * @brief Gets the profile for request/response traffic.
+   * @details Disables Nagle's algorithm and delayed ACKs, which together
+   * stall small replies by up to the delayed ACK timeout, and keeps at
+   * most 16KiB of unsent bytes in the kernel.
+   * @return The low-latency profile.
+   */
+  static auto low_latency() noexcept -> socket_tuning;
+
+  /**
+   * @brief Applies the options to a listening socket.
+   * @param sock The native socket handle.
+   * @return The error of the first option that could not be set or that
+   * reads back a different value.
+   */
+  [[nodiscard]] auto
+  apply_listener(int sock) const noexcept -> std::error_code;
+
+  /**
+   * @brief Applies the options to a connected socket.
+   * @param sock The native socket handle.
+   * @return The error of the first option that could not be set or that
+   * reads back a different value.
+   */
+  [[nodiscard]] auto
+  apply_connection(int sock) const noexcept -> std::error_code;
+};
+} // namespace cloudbus::segment
+#endif // CLOUDBUS_SOCKET_TUNING_HPP
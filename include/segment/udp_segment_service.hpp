@@ -0,0 +1,218 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file udp_segment_service.hpp
+ * @brief This file declares the datagram cloudbus segment service.
+ */
+#pragma once
+#ifndef CLOUDBUS_UDP_SEGMENT_SERVICE_HPP
+#define CLOUDBUS_UDP_SEGMENT_SERVICE_HPP
+#include "segment/detail/memory_budget.hpp"
+#include "segment/segment_options.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <stop_token>
+#include <system_error>
+#include <vector>
+
+#include <sys/socket.h>
+namespace cloudbus::segment {
+/**
+ * @brief The Cloudbus segment service on a datagram socket.
+ *
+ * @details This service runs its own event loop on a single UDP (or
+ * Unix-domain datagram) socket. Datagrams are received in batches of up
+ * to `segment_options::udp_batch_size` with one `recvmmsg`, and the
+ * datagrams that are queued while servicing a batch are sent with one
+ * `sendmmsg`. Where the kernel supports it, UDP GRO lets a single receive
+ * slot hold a train of datagrams from the same sender, and UDP GSO sends
+ * a train of equally sized datagrams to the same peer as one message.
+ *
+ * Each datagram is a message. The service exposes the same `service()`
+ * and `operator()` hooks as segment_service, where the socket is the
+ * peer that the datagram came from. A datagram is echoed back to its
+ * sender, or forwarded to one of `segment_options::upstreams` picked by
+ * the sender's address, so that the datagrams of a sender stay in order.
+ * Datagrams are not copied: a batch's receive buffer is reused once none
+ * of its datagrams are waiting to be sent.
+ */
+class udp_segment_service {
+public:
+  /** @brief The event loop state. */
+  struct async_context;
+
+  /** @brief The address of a datagram peer. */
+  struct endpoint {
+    /** @brief The address of the peer. */
+    sockaddr_storage address{};
+    /** @brief The length of the address. */
+    socklen_t len{0};
+  };
+  /** @brief The type of the peer that a datagram came from. */
+  using socket_dialog = const endpoint *;
+
+  /** @brief The buffer that a batch of datagrams was received into. */
+  class read_context {
+  public:
+    /**
+     * @brief Allocates the buffer.
+     * @details The buffer is charged to the memory budget until it is
+     * released.
+     * @param size The size of the buffer.
+     * @param budget The memory budget, or nullptr.
+     */
+    read_context(std::size_t size, detail::memory_budget *budget);
+    /** @brief Deleted copy constructor. */
+    read_context(const read_context &other) = delete;
+    /** @brief Deleted copy assignment. */
+    auto operator=(const read_context &other) -> read_context & = delete;
+    /** @brief Releases the buffer. */
+    ~read_context();
+
+    /**
+     * @brief Gets the buffer.
+     * @return The bytes of the buffer.
+     */
+    [[nodiscard]] auto buffer() const noexcept -> std::span<std::byte>
+    {
+      return {data_.get(), size_};
+    }
+
+  private:
+    /** @brief The memory of the buffer. */
+    std::unique_ptr<std::byte[]> data_;
+    /** @brief The size of the buffer. */
+    std::size_t size_;
+    /** @brief The memory budget that the buffer is charged to. */
+    detail::memory_budget *budget_;
+  };
+
+  /**
+   * @brief Constructs udp_segment_service on the socket address.
+   * @tparam T The sockaddr type of the address, e.g. `sockaddr_in`.
+   * @param address The local address to bind to.
+   * @param options The runtime options of the service.
+   */
+  template <typename T>
+  explicit udp_segment_service(const T &address,
+                               const segment_options &options = {})
+      : udp_segment_service(reinterpret_cast<const sockaddr *>(&address),
+                            sizeof(T), options)
+  {
+    static_assert(sizeof(T) <= sizeof(sockaddr_storage));
+  }
+
+  /** @brief Deleted copy constructor. */
+  udp_segment_service(const udp_segment_service &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const udp_segment_service &other)
+      -> udp_segment_service & = delete;
+  /** @brief Destructor. */
+  ~udp_segment_service();
+
+  /**
+   * @brief Runs the event loop until a stop is requested.
+   * @param token The stop token that ends the event loop.
+   * @return An error code if the socket could not be set up.
+   */
+  auto run(std::stop_token token) -> std::error_code;
+
+  /**
+   * @brief Gets the socket of the running event loop.
+   * @return The bound socket, or -1 if the event loop is not running.
+   */
+  [[nodiscard]] auto listener() const noexcept -> int;
+
+  /**
+   * @brief Initializes socket options.
+   * @param sock The native handle of the socket to initialize.
+   * @return An error code if a socket option could not be set.
+   */
+  [[nodiscard]] auto initialize(int sock) const noexcept -> std::error_code;
+
+  /**
+   * @brief Services an incoming datagram.
+   * @details The datagram is queued to be sent with the rest of the batch.
+   * @param ctx The event loop of the datagram.
+   * @param socket The peer that the datagram came from.
+   * @param rctx The read context that manages the read buffer lifetime.
+   * @param buf The bytes of the datagram.
+   */
+  auto service(async_context &ctx, socket_dialog socket,
+               const std::shared_ptr<read_context> &rctx,
+               std::span<const std::byte> buf) -> void;
+
+  /**
+   * @brief Receives the datagrams emitted by the batched receive.
+   * @param ctx The event loop of the datagram.
+   * @param socket The peer that the datagram came from.
+   * @param rctx The read context that manages the read buffer lifetime.
+   * @param buf The bytes of the datagram.
+   */
+  auto operator()(async_context &ctx, socket_dialog socket,
+                  const std::shared_ptr<read_context> &rctx,
+                  std::span<const std::byte> buf) -> void;
+
+private:
+  /**
+   * @brief Constructs udp_segment_service on the socket address.
+   * @param address The local address to bind to.
+   * @param len The length of the address.
+   * @param options The runtime options of the service.
+   */
+  udp_segment_service(const sockaddr *address, socklen_t len,
+                      const segment_options &options);
+
+  /**
+   * @brief Receives a batch of datagrams and services them.
+   * @details Datagrams that were truncated are dropped. A receive slot
+   * that holds a GRO train is split into its datagrams.
+   * @param ctx The event loop to receive on.
+   * @return An error code if the receive failed.
+   */
+  auto receive(async_context &ctx) -> std::error_code;
+
+  /**
+   * @brief Sends the queued datagrams.
+   * @details Datagrams that the socket cannot take yet stay queued.
+   * Datagrams that the kernel rejects, e.g. because their peer is
+   * unreachable, are dropped.
+   * @param ctx The event loop to send on.
+   */
+  auto flush(async_context &ctx) -> void;
+
+  /**
+   * @brief Gets the peer that the datagrams of a sender are sent to.
+   * @param sender The peer that the datagrams came from.
+   * @return The sender itself, or the upstream peer of the sender.
+   */
+  [[nodiscard]] auto destination(const endpoint &sender) const noexcept
+      -> const endpoint &;
+
+  /** @brief The runtime options of the service. */
+  segment_options options_;
+  /** @brief The address to bind to. */
+  endpoint address_;
+  /** @brief The peers that datagrams are forwarded to. */
+  std::vector<endpoint> upstreams_;
+  /** @brief The current socket. */
+  std::atomic<int> socket_{-1};
+};
+} // namespace cloudbus::segment
+#endif // CLOUDBUS_UDP_SEGMENT_SERVICE_HPP
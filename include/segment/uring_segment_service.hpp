@@ -0,0 +1,297 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file uring_segment_service.hpp
+ * @brief This file declares the io_uring backed cloudbus segment service.
+ */
+#pragma once
+#ifndef CLOUDBUS_URING_SEGMENT_SERVICE_HPP
+#define CLOUDBUS_URING_SEGMENT_SERVICE_HPP
+#include "segment/detail/admission.hpp"
+#include "segment/detail/write_queue.hpp"
+#include "segment/segment_options.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stop_token>
+#include <system_error>
+#include <unordered_map>
+
+#include <sys/socket.h>
+namespace cloudbus::segment {
+/**
+ * @brief The Cloudbus segment service on an io_uring data path.
+ *
+ * @details This service runs its own io_uring event loop instead of the
+ * readiness-based reactor of `service_base`. Connections are accepted with
+ * a multishot accept, and each connection has a single multishot recv that
+ * selects its buffers from a provided buffer ring that is registered with
+ * the kernel. There is a ring of small and a ring of large buffers, and
+ * each connection receives into the one that fits its recent reads.
+ * Sends are gathered from the same per-connection write queue that
+ * segment_service uses, and all submissions of an event loop iteration
+ * are submitted together with the wait for the next completion.
+ *
+ * Sends are not linked behind the recvs that they echo with
+ * IOSQE_IO_LINK. A link only orders the requests, it does not hand the
+ * result of the recv to the send, so the send would have to name its
+ * buffer and length when it is submitted. The multishot recv only picks
+ * its provided buffer, and learns the length, when bytes arrive, and it
+ * has no single completion for a link to follow. Instead, the send is
+ * prepared as the recv completion is reaped and goes to the kernel with
+ * the next wait, so the echo costs no syscall of its own. The link is
+ * used the other way around: a recv that is paused over the memory
+ * budget until the write queue is written is linked behind the send that
+ * takes the whole queue, so that it is armed as soon as the send
+ * completes rather than on the next iteration of the event loop.
+ *
+ * With `segment_options::tls`, accepted connections first complete a TLS
+ * handshake, after which kernel TLS does the record crypto, so the recv
+ * and send paths are the same on encrypted connections.
+ *
+ * The service exposes the same `service()` and `operator()` hooks as
+ * segment_service. A received buffer is returned to the buffer ring when
+ * the last reference to its read context is released.
+ */
+class uring_segment_service {
+public:
+  /** @brief The io_uring event loop state. */
+  struct async_context;
+  /** @brief The per-connection state of the service. */
+  struct connection;
+  /** @brief The type of a connected socket. */
+  using socket_dialog = connection *;
+
+  /** @brief A provided buffer that bytes were received into. */
+  class read_context {
+  public:
+    /**
+     * @brief Constructs the read context of a provided buffer.
+     * @details The buffer is charged to the memory budget until it is
+     * returned.
+     * @param ctx The event loop that owns the buffer ring.
+     * @param group The id of the buffer group of the buffer.
+     * @param bid The id of the buffer in the buffer ring.
+     */
+    read_context(async_context &ctx, std::uint16_t group,
+                 std::uint16_t bid) noexcept;
+    /** @brief Deleted copy constructor. */
+    read_context(const read_context &other) = delete;
+    /** @brief Deleted copy assignment. */
+    auto operator=(const read_context &other) -> read_context & = delete;
+    /** @brief Returns the buffer to the buffer ring. */
+    ~read_context();
+
+  private:
+    /** @brief The event loop that owns the buffer ring. */
+    async_context *ctx_;
+    /** @brief The id of the buffer group of the buffer. */
+    std::uint16_t group_;
+    /** @brief The id of the buffer in the buffer ring. */
+    std::uint16_t bid_;
+  };
+
+  /**
+   * @brief Constructs uring_segment_service on the socket address.
+   * @tparam T The sockaddr type of the address, e.g. `sockaddr_in`.
+   * @param address The local IP address to bind to.
+   * @param options The runtime options of the service.
+   */
+  template <typename T>
+  explicit uring_segment_service(const T &address,
+                                 const segment_options &options = {}) noexcept
+      : uring_segment_service(reinterpret_cast<const sockaddr *>(&address),
+                              sizeof(T), options)
+  {
+    static_assert(sizeof(T) <= sizeof(sockaddr_storage));
+  }
+
+  /** @brief Deleted copy constructor. */
+  uring_segment_service(const uring_segment_service &other) = delete;
+  /** @brief Deleted copy assignment. */
+  auto operator=(const uring_segment_service &other)
+      -> uring_segment_service & = delete;
+  /** @brief Destructor. */
+  ~uring_segment_service();
+
+  /**
+   * @brief Runs the event loop until a stop is requested.
+   * @details The event loop also ends once a drain has finished.
+   * @param token The stop token that ends the event loop.
+   * @return An error code if the event loop could not be set up.
+   */
+  auto run(std::stop_token token) -> std::error_code;
+
+  /**
+   * @brief Serves on an inherited listening socket.
+   * @details Must be called before `run`, which then takes ownership of
+   * the socket instead of binding a new one. This is used to take over
+   * the listening sockets of a previous process without dropping the
+   * connections in their accept queues.
+   * @param listener The listening socket.
+   */
+  auto adopt(int listener) noexcept -> void;
+
+  /**
+   * @brief Gets the listening socket of the running event loop.
+   * @return The listening socket, or -1 if the event loop is not running.
+   */
+  [[nodiscard]] auto listener() const noexcept -> int;
+
+  /**
+   * @brief Drains the service.
+   * @details The event loop stops accepting connections, closes the
+   * connections that have nothing left to write, and closes the others
+   * once their writes have completed. A connection that has not sent
+   * anything yet is closed once its first read has been answered, so
+   * that a connection accepted just before the drain is not reset. The
+   * event loop ends when all connections are closed and the accept has
+   * completed, or `segment_options::drain_timeout` has passed. This may
+   * be called from any thread.
+   */
+  auto drain() noexcept -> void;
+
+  /**
+   * @brief Initializes socket options.
+   * @param sock The native handle of the socket to initialize.
+   * @return An error code if a socket option could not be set.
+   */
+  [[nodiscard]] auto initialize(int sock) const noexcept -> std::error_code;
+
+  /**
+   * @brief Services the incoming bytes.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection the bytes were received on.
+   * @param rctx The read context that manages the read buffer lifetime.
+   * @param buf The bytes that were received.
+   */
+  auto service(async_context &ctx, socket_dialog socket,
+               const std::shared_ptr<read_context> &rctx,
+               std::span<const std::byte> buf) -> void;
+
+  /**
+   * @brief Receives the bytes emitted by the multishot recv.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection the bytes were received on.
+   * @param rctx The read context that manages the read buffer lifetime, or
+   * nullptr if the connection was closed.
+   * @param buf The bytes that were received.
+   */
+  auto operator()(async_context &ctx, socket_dialog socket,
+                  const std::shared_ptr<read_context> &rctx,
+                  std::span<const std::byte> buf) -> void;
+
+private:
+  /**
+   * @brief Constructs uring_segment_service on the socket address.
+   * @param address The local IP address to bind to.
+   * @param len The length of the address.
+   * @param options The runtime options of the service.
+   */
+  uring_segment_service(const sockaddr *address, socklen_t len,
+                        const segment_options &options) noexcept;
+
+  /**
+   * @brief Submits a send of the buffers at the front of the write queue.
+   * @details A recv that is paused until the queue is written is linked
+   * behind a send of the whole queue.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection to write to.
+   */
+  auto flush(async_context &ctx, socket_dialog socket) -> void;
+
+  /**
+   * @brief Dispatches a completion queue entry.
+   * @param ctx The event loop that the completion belongs to.
+   * @param user_data The user data of the completion.
+   * @param res The result of the completion.
+   * @param flags The completion flags.
+   */
+  auto complete(async_context &ctx, std::uint64_t user_data, int res,
+                std::uint32_t flags) -> void;
+
+  /**
+   * @brief Arms the multishot recv of a connection.
+   * @details The recv selects from the buffer group that fits the recent
+   * reads of the connection. A recv that is armed on the wrong group,
+   * while the memory budget is exhausted and the connection has bytes
+   * waiting to be written, or while the connection is over its rate
+   * limits, is cancelled, and this is called again when it ends. A
+   * throttled connection is tried again each time the event loop wakes
+   * up.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection to receive on.
+   */
+  auto receive(async_context &ctx, socket_dialog socket) -> void;
+
+  /**
+   * @brief Schedules the timeout of a connection.
+   * @details While a send is in flight, this is the write timeout,
+   * otherwise the idle timeout.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection.
+   */
+  auto arm_timeout(async_context &ctx, socket_dialog socket) -> void;
+
+  /**
+   * @brief Closes a connection whose timeout has expired.
+   * @details A stalled send is ended by shutting down the socket.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection.
+   */
+  auto expire(async_context &ctx, socket_dialog socket) -> void;
+
+  /**
+   * @brief Continues the TLS handshake of an accepted connection.
+   * @details The handshake waits for the socket with a poll, and the
+   * multishot recv is armed once kernel TLS has taken over the records.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection to continue the handshake of.
+   */
+  auto handshake(async_context &ctx, socket_dialog socket) -> void;
+
+  /**
+   * @brief Stops accepting and closes the idle connections.
+   * @param ctx The event loop to drain.
+   */
+  auto drain(async_context &ctx) -> void;
+
+  /**
+   * @brief Closes a connection once no operations refer to it.
+   * @param ctx The event loop of the connection.
+   * @param socket The connection to close.
+   */
+  auto close(async_context &ctx, socket_dialog socket) -> void;
+
+  /** @brief The runtime options of the service. */
+  segment_options options_;
+  /** @brief The connection caps, possibly shared with other reactors. */
+  std::shared_ptr<detail::admission_control> admission_;
+  /** @brief The address to listen on. */
+  sockaddr_storage address_{};
+  /** @brief The length of the address to listen on. */
+  socklen_t address_len_{};
+  /** @brief The connection states indexed by their native socket handle. */
+  std::unordered_map<int, std::unique_ptr<connection>> connections_;
+  /** @brief The adopted or the current listening socket. */
+  std::atomic<int> listener_{-1};
+  /** @brief Whether a drain was requested. */
+  std::atomic<bool> draining_{false};
+};
+} // namespace cloudbus::segment
+#endif // CLOUDBUS_URING_SEGMENT_SERVICE_HPP
@@ -0,0 +1,190 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file admission.cpp
+ * @brief This file defines the connection admission control and the
+ * per-connection rate limits.
+ */
+#include "segment/detail/admission.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <netinet/in.h>
+namespace cloudbus::detail {
+
+token_bucket::token_bucket(std::uint64_t rate, std::uint64_t burst,
+                           clock_type::time_point now) noexcept
+    : rate_{static_cast<double>(rate) / 1e9},
+      burst_{static_cast<double>(std::max<std::uint64_t>(burst, 1))},
+      tokens_{burst_},
+      refilled_{now}
+{}
+
+auto token_bucket::allows(std::uint64_t tokens,
+                          clock_type::time_point now) noexcept -> bool
+{
+  if (!rate_)
+    return true;
+
+  refill(now);
+  // A unit that is larger than the bucket only passes a full bucket.
+  auto cost = static_cast<double>(tokens);
+  return tokens_ >= std::min(cost, burst_);
+}
+
+auto token_bucket::charge(std::uint64_t tokens,
+                          clock_type::time_point now) noexcept -> void
+{
+  if (!rate_)
+    return;
+
+  refill(now);
+  tokens_ -= static_cast<double>(tokens);
+}
+
+auto token_bucket::refill(clock_type::time_point now) noexcept -> void
+{
+  if (now > refilled_)
+  {
+    auto elapsed = std::chrono::duration<double, std::nano>(now - refilled_);
+    tokens_ = std::min(burst_, tokens_ + (elapsed.count() * rate_));
+    refilled_ = now;
+  }
+}
+
+rate_limiter::rate_limiter(std::uint64_t bytes, std::uint64_t messages,
+                           std::chrono::milliseconds burst,
+                           clock_type::time_point now) noexcept
+{
+  auto window = std::max<std::chrono::milliseconds::rep>(burst.count(), 1);
+  if (bytes)
+    bytes_ = token_bucket(bytes, bytes * window / 1000, now);
+  if (messages)
+    messages_ = token_bucket(messages, messages * window / 1000, now);
+}
+
+auto rate_limiter::charge(std::size_t size,
+                          clock_type::time_point now) noexcept -> void
+{
+  bytes_.charge(size, now);
+  messages_.charge(1, now);
+}
+
+auto rate_limiter::ready(clock_type::time_point now) noexcept -> bool
+{
+  return bytes_.allows(1, now) && messages_.allows(1, now);
+}
+
+admission_control::admission_control(std::size_t max_connections,
+                                     std::size_t max_per_source)
+    : max_connections_{max_connections}, max_per_source_{max_per_source}
+{
+  if (max_per_source_)
+    sources_ = std::make_unique<std::atomic<std::uint32_t>[]>(slots);
+}
+
+auto admission_control::source(const sockaddr_storage &address) noexcept
+    -> source_type
+{
+  auto from = source_type{};
+  if (address.ss_family == AF_INET6)
+  {
+    const auto *in6 = reinterpret_cast<const sockaddr_in6 *>(&address);
+    std::memcpy(from.data(), &in6->sin6_addr, from.size());
+  }
+  else if (address.ss_family == AF_INET)
+  {
+    // The IPv4-mapped IPv6 address, so that both forms are one source.
+    const auto *in = reinterpret_cast<const sockaddr_in *>(&address);
+    from[10] = 0xff;
+    from[11] = 0xff;
+    std::memcpy(from.data() + 12, &in->sin_addr, 4);
+  }
+  return from;
+}
+
+auto admission_control::source(int sock) noexcept -> source_type
+{
+  auto address = sockaddr_storage{};
+  auto len = socklen_t{sizeof(address)};
+  if (::getpeername(sock, reinterpret_cast<sockaddr *>(&address), &len))
+    return {};
+  return source(address);
+}
+
+auto admission_control::admit(const source_type &from) noexcept -> bool
+{
+  // Counts are taken first, and given back if a cap has been reached.
+  auto count = connections_.fetch_add(1, std::memory_order_relaxed);
+  if (max_connections_ && count >= max_connections_)
+  {
+    connections_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  if (max_per_source_)
+  {
+    // The slot with fewer connections is the closer bound on the source.
+    auto [first, second] = slots_of(from);
+    auto sourced =
+        std::min(sources_[first].fetch_add(1, std::memory_order_relaxed),
+                 sources_[second].fetch_add(1, std::memory_order_relaxed));
+    if (sourced >= max_per_source_)
+    {
+      sources_[first].fetch_sub(1, std::memory_order_relaxed);
+      sources_[second].fetch_sub(1, std::memory_order_relaxed);
+      connections_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+auto admission_control::release(const source_type &from) noexcept -> void
+{
+  connections_.fetch_sub(1, std::memory_order_relaxed);
+  if (max_per_source_)
+  {
+    auto [first, second] = slots_of(from);
+    sources_[first].fetch_sub(1, std::memory_order_relaxed);
+    sources_[second].fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+auto admission_control::slots_of(const source_type &from) noexcept
+    -> std::array<std::size_t, 2>
+{
+  auto high = std::uint64_t{};
+  auto low = std::uint64_t{};
+  std::memcpy(&high, from.data(), sizeof(high));
+  std::memcpy(&low, from.data() + sizeof(high), sizeof(low));
+
+  // The splitmix64 finalizer of the folded halves.
+  auto value = high ^ (low * 0x9e3779b97f4a7c15ULL);
+  value ^= value >> 30U;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27U;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31U;
+
+  // The two halves of the hash pick a slot in each half of the table.
+  constexpr auto half = slots / 2;
+  return {static_cast<std::size_t>(value % half),
+          half + static_cast<std::size_t>((value >> 32U) % half)};
+}
+} // namespace cloudbus::detail
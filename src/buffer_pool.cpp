@@ -0,0 +1,84 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file buffer_pool.cpp
+ * @brief This file defines the size-classed, thread-local buffer pool.
+ */
+#include "segment/detail/buffer_pool.hpp"
+namespace cloudbus::detail {
+
+buffer_pool::~buffer_pool()
+{
+  for (auto &list : lists_)
+  {
+    while (auto *head = list.head)
+    {
+      list.head = head->next;
+      ::operator delete(head);
+    }
+    list.count = 0;
+  }
+}
+
+auto buffer_pool::local() noexcept -> buffer_pool &
+{
+  static thread_local auto pool = buffer_pool{};
+  return pool;
+}
+
+auto buffer_pool::allocate(std::size_t size) -> void *
+{
+  auto index = size_class(size);
+  if (index == classes)
+    return ::operator new(size);
+
+  auto &list = lists_[index];
+  if (auto *head = list.head)
+  {
+    list.head = head->next;
+    --list.count;
+    return head;
+  }
+
+  return ::operator new(min_size << index);
+}
+
+auto buffer_pool::deallocate(void *ptr, std::size_t size) noexcept -> void
+{
+  if (!ptr)
+    return;
+
+  auto index = size_class(size);
+  if (index == classes)
+    return ::operator delete(ptr);
+
+  auto &list = lists_[index];
+  if ((list.count + 1) * (min_size << index) > max_cached_bytes)
+    return ::operator delete(ptr);
+
+  list.head = ::new (ptr) block{.next = list.head};
+  ++list.count;
+}
+
+auto buffer_pool::cached_bytes() const noexcept -> std::size_t
+{
+  std::size_t bytes = 0;
+  for (std::size_t index = 0; index < classes; ++index)
+    bytes += lists_[index].count * (min_size << index);
+
+  return bytes;
+}
+} // namespace cloudbus::detail
@@ -0,0 +1,182 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file byte_scan.cpp
+ * @brief This file defines vectorized byte scanning.
+ */
+#include "segment/detail/byte_scan.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+namespace cloudbus::detail {
+namespace {
+/** @brief The signature of a scan kernel. */
+using kernel_type = auto (*)(const std::byte *, std::size_t,
+                             std::byte) noexcept -> std::size_t;
+
+/** @brief A scan kernel and its name. */
+struct kernel {
+  /** @brief The kernel function. */
+  kernel_type fn;
+  /** @brief The name of the kernel. */
+  std::string_view name;
+};
+
+/**
+ * @brief Finds a byte with `std::memchr`.
+ * @param data The buffer to scan.
+ * @param size The size of the buffer.
+ * @param value The byte to find.
+ * @return The index of the first occurrence of `value`, or `size`.
+ */
+auto find_memchr(const std::byte *data, std::size_t size,
+                 std::byte value) noexcept -> std::size_t
+{
+  // An empty span may have a null data pointer, which memchr cannot take.
+  if (size == 0)
+    return size;
+
+  const auto *found =
+      std::memchr(data, std::to_integer<unsigned char>(value), size);
+  return found ? static_cast<const std::byte *>(found) - data : size;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief Finds a byte 64 bytes at a time with AVX2.
+ * @param data The buffer to scan.
+ * @param size The size of the buffer.
+ * @param value The byte to find.
+ * @return The index of the first occurrence of `value`, or `size`.
+ */
+__attribute__((target("avx2"))) auto
+find_avx2(const std::byte *data, std::size_t size,
+          std::byte value) noexcept -> std::size_t
+{
+  const auto needle =
+      _mm256_set1_epi8(static_cast<char>(std::to_integer<int>(value)));
+
+  auto i = std::size_t{0};
+  for (; i + 64 <= size; i += 64)
+  {
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    auto hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 32));
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto eq_lo = _mm256_cmpeq_epi8(lo, needle);
+    auto eq_hi = _mm256_cmpeq_epi8(hi, needle);
+
+    if (!_mm256_testz_si256(_mm256_or_si256(eq_lo, eq_hi),
+                            _mm256_or_si256(eq_lo, eq_hi)))
+    {
+      auto mask =
+          static_cast<std::uint64_t>(
+              static_cast<std::uint32_t>(_mm256_movemask_epi8(eq_lo))) |
+          static_cast<std::uint64_t>(
+              static_cast<std::uint32_t>(_mm256_movemask_epi8(eq_hi)))
+              << 32U;
+      return i + __builtin_ctzll(mask);
+    }
+  }
+
+  for (; i + 32 <= size; i += 32)
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    auto mask = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+
+  return i + find_memchr(data + i, size - i, value);
+}
+#elif defined(__aarch64__)
+/**
+ * @brief Finds a byte 16 bytes at a time with NEON.
+ * @param data The buffer to scan.
+ * @param size The size of the buffer.
+ * @param value The byte to find.
+ * @return The index of the first occurrence of `value`, or `size`.
+ */
+auto find_neon(const std::byte *data, std::size_t size,
+               std::byte value) noexcept -> std::size_t
+{
+  const auto needle = vdupq_n_u8(std::to_integer<std::uint8_t>(value));
+
+  auto i = std::size_t{0};
+  for (; i + 16 <= size; i += 16)
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto chunk = vld1q_u8(reinterpret_cast<const std::uint8_t *>(data + i));
+    auto eq = vceqq_u8(chunk, needle);
+
+    // Narrow each byte of the comparison to a nibble of a 64-bit mask.
+    auto mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    if (mask)
+      return i + (__builtin_ctzll(mask) >> 2U);
+  }
+
+  return i + find_memchr(data + i, size - i, value);
+}
+#endif
+
+/**
+ * @brief Selects the scan kernel for the running CPU.
+ * @return The fastest supported kernel.
+ */
+auto select_kernel() noexcept -> kernel
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {.fn = find_avx2, .name = "avx2"};
+#elif defined(__aarch64__)
+  return {.fn = find_neon, .name = "neon"};
+#endif
+  return {.fn = find_memchr, .name = "memchr"};
+}
+
+/**
+ * @brief Gets the scan kernel for the running CPU.
+ * @return The kernel selected on first use.
+ */
+auto get_kernel() noexcept -> const kernel &
+{
+  static const auto selected = select_kernel();
+  return selected;
+}
+} // namespace
+
+auto find_byte(std::span<const std::byte> buf, std::byte value) noexcept
+    -> std::size_t
+{
+  return get_kernel().fn(buf.data(), buf.size(), value);
+}
+
+auto find_byte_kernel() noexcept -> std::string_view
+{
+  return get_kernel().name;
+}
+} // namespace cloudbus::detail
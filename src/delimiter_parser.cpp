@@ -0,0 +1,133 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file delimiter_parser.cpp
+ * @brief This file defines the delimiter-terminated frame parser.
+ */
+#include "segment/detail/delimiter_parser.hpp"
+#include "segment/detail/byte_scan.hpp"
+
+#include <utility>
+namespace cloudbus::detail {
+
+delimiter_parser::delimiter_parser(std::byte delimiter,
+                                   std::size_t max_frame_size) noexcept
+    : delimiter_{delimiter}, max_frame_size_{max_frame_size}
+{}
+
+auto delimiter_parser::parse(buffer_type buf,
+                             owner_type owner) -> generator<frame_view>
+{
+  if (!size_)
+    reset();
+  if (error_)
+    co_return;
+
+  if (size_)
+  {
+    auto pos = find_byte(buf, delimiter_);
+    auto found = pos < buf.size();
+    auto len = found ? pos + 1 : buf.size();
+    if (oversized(size_ + len))
+      co_return;
+
+    // Without an owner, the frame is copied as a whole.
+    if (owner && len)
+      tail_.push_back({.owner = owner, .buf = buf.first(len)});
+    else if (len)
+      storage_->insert(storage_->end(), buf.begin(), buf.begin() + len);
+
+    if (!owner)
+      head_ = buffer_type(*storage_);
+    size_ += len;
+    buf = buf.subspan(len);
+    if (!found)
+      co_return;
+
+    auto frame = frame_view(head_, tail_, std::exchange(size_, 0));
+    split_ = true;
+    co_yield frame;
+    reset();
+  }
+
+  for (auto pos = find_byte(buf, delimiter_); pos < buf.size();
+       pos = find_byte(buf, delimiter_))
+  {
+    if (oversized(pos + 1))
+      co_return;
+
+    co_yield frame_view(buf.first(pos + 1));
+    buf = buf.subspan(pos + 1);
+  }
+
+  if (!buf.empty() && !oversized(buf.size()))
+    save(buf, std::move(owner));
+}
+
+auto delimiter_parser::owner() const noexcept -> owner_type
+{
+  return split_ ? head_owner_ : nullptr;
+}
+
+auto delimiter_parser::pending() const noexcept -> std::size_t
+{
+  return size_;
+}
+
+auto delimiter_parser::error() const noexcept -> std::error_code
+{
+  return error_;
+}
+
+auto delimiter_parser::save(buffer_type buf, owner_type owner) -> void
+{
+  size_ = buf.size();
+  if (owner)
+  {
+    head_ = buf;
+    head_owner_ = std::move(owner);
+    return;
+  }
+
+  if (storage_ && storage_.use_count() == 1)
+    storage_->clear();
+  else
+    storage_ = std::make_shared<storage_type>();
+
+  storage_->assign(buf.begin(), buf.end());
+  head_ = buffer_type(*storage_);
+  head_owner_ = storage_;
+}
+
+auto delimiter_parser::reset() noexcept -> void
+{
+  split_ = false;
+  head_ = {};
+  head_owner_.reset();
+  tail_.clear();
+}
+
+auto delimiter_parser::oversized(std::size_t size) noexcept -> bool
+{
+  if (size <= max_frame_size_)
+    return false;
+
+  error_ = std::make_error_code(std::errc::message_size);
+  size_ = 0;
+  reset();
+  return true;
+}
+} // namespace cloudbus::detail
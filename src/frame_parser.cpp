@@ -0,0 +1,174 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file frame_parser.cpp
+ * @brief This file defines the length-prefixed frame parser.
+ */
+#include "segment/detail/frame_parser.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+namespace cloudbus::detail {
+namespace {
+/**
+ * @brief Decodes the length of a frame from its header.
+ * @param header The first `header_size` bytes of the frame.
+ * @return The length of the frame, including its header.
+ */
+auto frame_size(frame_parser::buffer_type header) noexcept -> std::size_t
+{
+  auto len = std::uint32_t{0};
+  for (auto byte : header.first(frame_parser::header_size))
+    len = (len << 8U) | std::to_integer<std::uint32_t>(byte);
+
+  return frame_parser::header_size + len;
+}
+} // namespace
+
+frame_parser::frame_parser(std::size_t max_frame_size,
+                           std::size_t head_size) noexcept
+    : max_frame_size_{max_frame_size},
+      head_size_{std::max(head_size, header_size)}
+{}
+
+auto frame_parser::parse(buffer_type buf,
+                         owner_type owner) -> generator<frame_view>
+{
+  if (!size_)
+    reset();
+  if (error_)
+    co_return;
+
+  if (size_)
+  {
+    buf = append(buf, header_size);
+    if (head_.size() < header_size)
+      co_return;
+
+    auto size = frame_size(head_);
+    if (oversized(size))
+      co_return;
+
+    // Without an owner, the rest of the frame is copied as well.
+    buf = append(buf, std::min(owner ? head_size_ : size, size));
+    if (auto len = std::min(size - size_, buf.size()))
+    {
+      tail_.push_back({.owner = owner, .buf = buf.first(len)});
+      size_ += len;
+      buf = buf.subspan(len);
+    }
+
+    if (size_ < size)
+      co_return;
+
+    auto frame = frame_view(head_, tail_, std::exchange(size_, 0));
+    split_ = true;
+    co_yield frame;
+    reset();
+  }
+
+  while (buf.size() >= header_size)
+  {
+    auto size = frame_size(buf);
+    if (oversized(size))
+      co_return;
+
+    if (buf.size() < size)
+      break;
+
+    co_yield frame_view(buf.first(size));
+    buf = buf.subspan(size);
+  }
+
+  if (!buf.empty())
+    save(buf, std::move(owner));
+}
+
+auto frame_parser::owner() const noexcept -> owner_type
+{
+  return split_ ? head_owner_ : nullptr;
+}
+
+auto frame_parser::pending() const noexcept -> std::size_t { return size_; }
+
+auto frame_parser::error() const noexcept -> std::error_code
+{
+  return error_;
+}
+
+auto frame_parser::payload(const frame_view &frame) noexcept -> frame_view
+{
+  return frame.subframe(std::min(header_size, frame.head().size()));
+}
+
+auto frame_parser::append(buffer_type buf, std::size_t size) -> buffer_type
+{
+  // A head that is shorter than it should be is always a copy.
+  if (head_.size() >= size)
+    return buf;
+
+  auto len = std::min(size - head_.size(), buf.size());
+  if (size > storage_->capacity())
+    storage_->reserve(size);
+
+  storage_->insert(storage_->end(), buf.begin(), buf.begin() + len);
+  head_ = buffer_type(*storage_);
+  size_ += len;
+  return buf.subspan(len);
+}
+
+auto frame_parser::save(buffer_type buf, owner_type owner) -> void
+{
+  size_ = buf.size();
+  if (owner && buf.size() >= head_size_)
+  {
+    head_ = buf;
+    head_owner_ = std::move(owner);
+    return;
+  }
+
+  if (storage_ && storage_.use_count() == 1)
+    storage_->clear();
+  else
+    storage_ = std::make_shared<storage_type>();
+
+  // Only the short head is copied here, the rest of the frame is kept in
+  // the read buffers that it arrives in, or copied if they have no owner.
+  storage_->assign(buf.begin(), buf.end());
+  head_ = buffer_type(*storage_);
+  head_owner_ = storage_;
+}
+
+auto frame_parser::reset() noexcept -> void
+{
+  split_ = false;
+  head_ = {};
+  head_owner_.reset();
+  tail_.clear();
+}
+
+auto frame_parser::oversized(std::size_t size) noexcept -> bool
+{
+  if (size <= max_frame_size_)
+    return false;
+
+  error_ = std::make_error_code(std::errc::message_size);
+  size_ = 0;
+  reset();
+  return true;
+}
+} // namespace cloudbus::detail
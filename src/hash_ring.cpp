@@ -0,0 +1,157 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file hash_ring.cpp
+ * @brief This file defines the consistent-hash ring of upstream peers.
+ */
+#include "segment/detail/hash_ring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <numeric>
+
+#include <netinet/in.h>
+namespace cloudbus::detail {
+namespace {
+/**
+ * @brief Gets the bytes of an address that identify it.
+ * @param address The address.
+ * @return The bytes of the address for its family.
+ */
+auto address_bytes(const hash_ring::address_type &address) noexcept
+    -> std::span<const std::byte>
+{
+  auto size = sizeof(address);
+  if (address.ss_family == AF_INET)
+    size = sizeof(sockaddr_in);
+  else if (address.ss_family == AF_INET6)
+    size = sizeof(sockaddr_in6);
+
+  return std::as_bytes(std::span(&address, 1)).first(size);
+}
+
+/**
+ * @brief Mixes the bits of a hash.
+ * @details This is the splitmix64 finalizer.
+ * @param value The value to mix.
+ * @return The mixed value.
+ */
+constexpr auto mix(std::uint64_t value) noexcept -> std::uint64_t
+{
+  value ^= value >> 30U;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27U;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31U;
+  return value;
+}
+} // namespace
+
+hash_ring::hash_ring(std::vector<address_type> members, std::size_t replicas)
+    : members_{std::move(members)}
+{
+  if (members_.empty())
+    return;
+
+  replicas = std::max<std::size_t>(replicas, 1);
+  auto order = std::vector<std::pair<std::uint64_t, std::uint32_t>>{};
+  order.reserve(members_.size() * replicas);
+
+  for (std::uint32_t i = 0; i < members_.size(); ++i)
+  {
+    auto base = hash(address_bytes(members_[i]));
+    for (std::uint64_t replica = 0; replica < replicas; ++replica)
+      order.emplace_back(mix(base + replica), i);
+  }
+  std::ranges::sort(order);
+
+  points_.reserve(order.size());
+  owners_.reserve(order.size());
+  for (const auto &[point, owner] : order)
+  {
+    points_.push_back(point);
+    owners_.push_back(owner);
+  }
+
+  // Use at least as many buckets as points, so a lookup scans about one
+  // point per bucket.
+  auto buckets = std::bit_ceil(points_.size());
+  auto bits =
+      std::max<unsigned>(1, static_cast<unsigned>(std::countr_zero(buckets)));
+  shift_ = 64U - bits;
+  buckets_.resize(std::size_t{1} << bits);
+  for (std::size_t bucket = 0; bucket < buckets_.size(); ++bucket)
+  {
+    auto start = static_cast<std::uint64_t>(bucket) << shift_;
+    buckets_[bucket] = static_cast<std::uint32_t>(
+        std::ranges::lower_bound(points_, start) - points_.begin());
+  }
+}
+
+auto hash_ring::lookup(std::uint64_t hash) const noexcept -> std::size_t
+{
+  auto i = std::size_t{buckets_[hash >> shift_]};
+  while (i < points_.size() && points_[i] < hash)
+    ++i;
+
+  // Hashes past the last point wrap around to the first one.
+  return owners_[i < points_.size() ? i : 0];
+}
+
+auto hash_ring::find(const address_type &address) const noexcept
+    -> std::optional<std::size_t>
+{
+  auto bytes = address_bytes(address);
+  for (std::size_t i = 0; i < members_.size(); ++i)
+  {
+    auto other = address_bytes(members_[i]);
+    if (std::ranges::equal(bytes, other))
+      return i;
+  }
+  return std::nullopt;
+}
+
+auto hash_ring::members() const noexcept -> std::span<const address_type>
+{
+  return members_;
+}
+
+auto hash_ring::empty() const noexcept -> bool { return members_.empty(); }
+
+auto hash_ring::hash(std::span<const std::byte> key) noexcept -> std::uint64_t
+{
+  return key_hasher{}.update(key).value();
+}
+
+auto hash_ring::key_hasher::update(std::span<const std::byte> piece) noexcept
+    -> key_hasher &
+{
+  for (auto byte : piece)
+  {
+    state_ ^= std::to_integer<std::uint64_t>(byte);
+    state_ *= 0x100000001b3ULL;
+  }
+  return *this;
+}
+
+auto hash_ring::key_hasher::value() const noexcept -> std::uint64_t
+{
+  // FNV-1a, with the result mixed so that similar keys spread out.
+  return mix(state_);
+}
+} // namespace cloudbus::detail
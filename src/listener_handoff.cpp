@@ -0,0 +1,158 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file listener_handoff.cpp
+ * @brief This file defines the handoff of listening sockets between
+ * processes.
+ */
+#include "segment/detail/listener_handoff.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <netinet/in.h>
+#include <sys/un.h>
+namespace cloudbus::detail {
+namespace {
+/** @brief The control buffer for the largest handoff. */
+using control_buffer =
+    std::array<std::byte, CMSG_SPACE(sizeof(int) * max_handoff_sockets)>;
+} // namespace
+
+auto send_listeners(int sock, std::span<const int> fds) noexcept
+    -> std::error_code
+{
+  if (fds.size() > max_handoff_sockets)
+    return std::make_error_code(std::errc::argument_list_too_long);
+
+  // The count goes in the payload since a message with no payload and
+  // no descriptors cannot be told apart from the end of the stream.
+  auto count = static_cast<std::uint32_t>(fds.size());
+  auto iov = iovec{.iov_base = &count, .iov_len = sizeof(count)};
+
+  alignas(cmsghdr) auto control = control_buffer{};
+  auto msg = msghdr{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  if (!fds.empty())
+  {
+    msg.msg_control = control.data();
+    msg.msg_controllen = CMSG_SPACE(fds.size_bytes());
+
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.size_bytes());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size_bytes());
+  }
+
+  auto len = ssize_t{};
+  while ((len = ::sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+    ;
+  if (len < 0)
+    return {errno, std::system_category()};
+  return {};
+}
+
+auto receive_listeners(int sock, std::vector<int> &fds) -> std::error_code
+{
+  auto count = std::uint32_t{};
+  auto iov = iovec{.iov_base = &count, .iov_len = sizeof(count)};
+
+  alignas(cmsghdr) auto control = control_buffer{};
+  auto msg = msghdr{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  auto len = ssize_t{};
+  while ((len = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL)) < 0 &&
+         errno == EINTR)
+    ;
+  if (len < 0)
+    return {errno, std::system_category()};
+
+  fds.clear();
+  for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    auto size = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    auto offset = fds.size();
+    fds.resize(offset + size);
+    std::memcpy(fds.data() + offset, CMSG_DATA(cmsg), size * sizeof(int));
+  }
+
+  if (len != sizeof(count) || fds.size() != count ||
+      (msg.msg_flags & MSG_CTRUNC))
+  {
+    return std::make_error_code(std::errc::protocol_error);
+  }
+  return {};
+}
+
+auto is_bound_to(int fd, const sockaddr_storage &address) noexcept -> bool
+{
+  auto bound = sockaddr_storage{};
+  auto len = socklen_t{sizeof(bound)};
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (::getsockname(fd, reinterpret_cast<sockaddr *>(&bound), &len) ||
+      bound.ss_family != address.ss_family)
+  {
+    return false;
+  }
+
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  switch (address.ss_family)
+  {
+    case AF_INET:
+    {
+      const auto &lhs = reinterpret_cast<const sockaddr_in &>(bound);
+      const auto &rhs = reinterpret_cast<const sockaddr_in &>(address);
+      return lhs.sin_port == rhs.sin_port &&
+             lhs.sin_addr.s_addr == rhs.sin_addr.s_addr;
+    }
+
+    case AF_INET6:
+    {
+      const auto &lhs = reinterpret_cast<const sockaddr_in6 &>(bound);
+      const auto &rhs = reinterpret_cast<const sockaddr_in6 &>(address);
+      return lhs.sin6_port == rhs.sin6_port &&
+             !std::memcmp(&lhs.sin6_addr, &rhs.sin6_addr,
+                          sizeof(lhs.sin6_addr));
+    }
+
+    case AF_UNIX:
+    {
+      // Abstract names are not NUL-terminated, so compare the bound length.
+      const auto &lhs = reinterpret_cast<const sockaddr_un &>(bound);
+      const auto &rhs = reinterpret_cast<const sockaddr_un &>(address);
+      auto size = len - offsetof(sockaddr_un, sun_path);
+      return size > 0 && !std::memcmp(lhs.sun_path, rhs.sun_path, size);
+    }
+
+    default:
+      return false;
+  }
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+} // namespace cloudbus::detail
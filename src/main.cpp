@@ -1,16 +1,47 @@
+#include "segment/detail/admission.hpp"
+#include "segment/detail/listener_handoff.hpp"
+#include "segment/detail/metrics.hpp"
+#include "segment/detail/shard_exchange.hpp"
+#include "segment/detail/ticker.hpp"
+#include "segment/detail/trace.hpp"
+#include "segment/segment_config.hpp"
 #include "segment/segment_service.hpp"
+#include "segment/udp_segment_service.hpp"
+#ifdef CB_SEGMENT_HAS_IO_URING
+#include "segment/uring_segment_service.hpp"
+#endif
 
+#include <algorithm>
+#include <array>
 #include <condition_variable>
+#include <cerrno>
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace cloudbus::service;
 using namespace cloudbus::segment;
 
 using service_type = async_service<segment_service>;
 
-static constexpr std::uint16_t PORT = 8080;
-
 static auto signal_mask() -> sigset_t *
 {
   static auto set = sigset_t{};
@@ -21,50 +52,897 @@ static auto signal_mask() -> sigset_t *
   {
     sigemptyset(&set);
     sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
     setp = &set;
   }
   return setp;
 }
 
-static auto handle_signals(service_type &service) -> std::thread
+static auto handle_signals(std::function<void()> terminate,
+                           std::function<void()> drain) -> std::thread
 {
   static const auto *sigmask = signal_mask();
   pthread_sigmask(SIG_BLOCK, sigmask, nullptr);
 
-  return std::thread([&]() noexcept {
+  return std::thread([terminate = std::move(terminate),
+                      drain = std::move(drain)]() noexcept {
     auto stop_condition = [](int signal) { return signal == SIGTERM; };
 
     for (int signal = 0; !stop_condition(signal);)
     {
-      using enum service_type::signals;
-
       sigwait(sigmask, &signal);
 
       if (signal == SIGTERM)
-        service.signal(terminate);
+        terminate();
+
+      // SIGUSR2 stops accepting and exits once the connections are idle.
+      if (signal == SIGUSR2)
+        drain();
+
+      // SIGUSR1 dumps the hot path metrics and trace of all reactors.
+      if (signal == SIGUSR1)
+      {
+        cloudbus::detail::metrics::collect().print(std::cerr);
+        if (auto error = cloudbus::detail::trace::flush())
+          std::cerr << "trace: " << error.message() << '\n';
+      }
+    }
+  });
+}
+
+/**
+ * @brief Lists the CPUs that this process is allowed to run on.
+ * @return The allowed CPUs in ascending order.
+ */
+static auto allowed_cpus() -> std::vector<int>
+{
+  auto cpus = std::vector<int>{};
+  auto set = cpu_set_t{};
+
+  if (!pthread_getaffinity_np(pthread_self(), sizeof(set), &set))
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+/**
+ * @brief Spawns threads that are pinned to a single CPU.
+ * @details Threads inherit the CPU affinity of the thread that creates
+ * them, so the calling thread is pinned while `spawn` runs and then
+ * restored.
+ * @param cpu The CPU to pin the spawned threads to.
+ * @param spawn The function that spawns the threads.
+ */
+template <typename Fn> static auto pinned(int cpu, Fn &&spawn) -> void
+{
+  auto saved = cpu_set_t{};
+  auto cpus = cpu_set_t{};
+  auto self = pthread_self();
+
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+
+  auto restore = !pthread_getaffinity_np(self, sizeof(saved), &saved) &&
+                 !pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+
+  std::forward<Fn>(spawn)();
+
+  if (restore)
+    pthread_setaffinity_np(self, sizeof(saved), &saved);
+}
+
+/**
+ * @brief Gets the options of the reactor that is pinned to a CPU.
+ * @param options The segment options.
+ * @param incoming_cpu Whether the reactor only accepts connections whose
+ * packets are received on its CPU.
+ * @param cpu The CPU that the reactor is pinned to.
+ * @return The options of the reactor.
+ */
+static auto reactor_options(const segment_options &options, bool incoming_cpu,
+                            int cpu) -> segment_options
+{
+  auto reactor = options;
+  if (incoming_cpu)
+    reactor.tuning.incoming_cpu = cpu;
+  return reactor;
+}
+
+/**
+ * @brief Calls a function with a socket address cast to its concrete type.
+ * @param address A socket address that was parsed by `segment_config`.
+ * @param fn The function to call with a `sockaddr_in`, `sockaddr_in6` or
+ * `sockaddr_un`.
+ */
+template <typename Fn>
+static auto visit_address(const sockaddr_storage &address, Fn &&fn) -> void
+{
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  switch (address.ss_family)
+  {
+    case AF_INET6:
+      std::forward<Fn>(fn)(reinterpret_cast<const sockaddr_in6 &>(address));
+      break;
+
+    case AF_UNIX:
+      std::forward<Fn>(fn)(reinterpret_cast<const sockaddr_un &>(address));
+      break;
+
+    default:
+      std::forward<Fn>(fn)(reinterpret_cast<const sockaddr_in &>(address));
+      break;
+  }
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+/**
+ * @brief Stops the signal handler once the reactors have exited.
+ * @param sighandler The signal handling thread.
+ */
+static auto stop_signals(std::thread &sighandler) -> void
+{
+  pthread_kill(sighandler.native_handle(), SIGTERM);
+  sighandler.join();
+}
+
+/**
+ * @brief Removes stale Unix-domain socket files before binding.
+ * @details The paths of inherited listeners are kept, since they are
+ * still bound to them.
+ * @param config The segment configuration.
+ * @param inherited The inherited listening sockets.
+ */
+static auto unlink_sockets(const segment_config &config,
+                           const std::vector<int> &inherited) -> void
+{
+  for (const auto &address : config.listen)
+  {
+    auto bound = std::ranges::any_of(inherited, [&](int fd) {
+      return cloudbus::detail::is_bound_to(fd, address);
+    });
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto &local = reinterpret_cast<const sockaddr_un &>(address);
+    if (address.ss_family == AF_UNIX && local.sun_path[0] && !bound)
+      ::unlink(local.sun_path);
+  }
+}
+
+/**
+ * @brief Makes a Unix-domain socket address from a path.
+ * @param path The path of the socket.
+ * @return The socket address.
+ */
+static auto handoff_address(const std::string &path) -> sockaddr_un
+{
+  auto address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  return address;
+}
+
+/**
+ * @brief Takes over the listening sockets of a running segment.
+ * @param path The path of the handoff socket.
+ * @param inherited Set to the listening sockets of the running segment.
+ * @return The connection to the running segment, or -1 if no segment is
+ * running on the handoff socket.
+ */
+static auto take_over(const std::string &path,
+                      std::vector<int> &inherited) -> int
+{
+  auto address = handoff_address(path);
+  int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (sock < 0 || ::connect(sock, reinterpret_cast<sockaddr *>(&address),
+                            sizeof(address)))
+  {
+    if (sock >= 0)
+      ::close(sock);
+    return -1;
+  }
+
+  if (auto error = cloudbus::detail::receive_listeners(sock, inherited))
+  {
+    std::cerr << path << ": " << error.message() << '\n';
+    ::close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+/**
+ * @brief Removes the inherited listener that is bound to an address.
+ * @param inherited The inherited listening sockets.
+ * @param address The address to listen on.
+ * @return The listening socket, or -1 if none is bound to `address`.
+ */
+static auto take_listener(std::vector<int> &inherited,
+                          const sockaddr_storage &address) -> int
+{
+  auto it = std::ranges::find_if(inherited, [&](int fd) {
+    return cloudbus::detail::is_bound_to(fd, address);
+  });
+  if (it == inherited.end())
+    return -1;
+
+  int fd = *it;
+  inherited.erase(it);
+  return fd;
+}
+
+/**
+ * @brief Completes a hot restart and listens for the next one.
+ * @details The previous segment is told that this segment is serving,
+ * so that it drains, and the handoff socket is rebound so that the next
+ * segment takes over from this one.
+ * @param config The segment configuration.
+ * @param predecessor The connection to the previous segment, or -1.
+ * @return The listening handoff socket, or -1 if hot restarts are
+ * disabled.
+ */
+static auto publish_handoff(const segment_config &config,
+                            int predecessor) -> int
+{
+  if (predecessor >= 0)
+  {
+    auto ready = char{};
+    if (::send(predecessor, &ready, sizeof(ready), MSG_NOSIGNAL) < 0)
+      std::cerr << config.handoff << ": " << std::strerror(errno) << '\n';
+    ::close(predecessor);
+  }
+
+  if (config.handoff.empty())
+    return -1;
+
+  auto address = handoff_address(config.handoff);
+  ::unlink(address.sun_path);
+
+  int server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (server < 0 || ::bind(server, reinterpret_cast<sockaddr *>(&address),
+                           sizeof(address)) ||
+      ::listen(server, 1))
+  {
+    std::cerr << config.handoff << ": " << std::strerror(errno) << '\n';
+    if (server >= 0)
+      ::close(server);
+    return -1;
+  }
+  return server;
+}
+
+/**
+ * @brief Hands off the listening sockets to the next segment.
+ * @details Once the next segment reports that it is serving, this
+ * segment drains. If the next segment fails before that, the handoff
+ * socket keeps waiting for another one.
+ * @param server The listening handoff socket, or -1.
+ * @param listeners Gets the listening sockets to hand off.
+ * @param drain Drains the reactors.
+ * @return The thread that serves the handoff socket.
+ */
+static auto serve_handoff(int server,
+                          std::function<std::vector<int>()> listeners,
+                          std::function<void()> drain) -> std::jthread
+{
+  if (server < 0)
+    return {};
+
+  return std::jthread([=, listeners = std::move(listeners),
+                       drain = std::move(drain)] {
+    for (int peer = -1; (peer = ::accept4(server, nullptr, nullptr,
+                                          SOCK_CLOEXEC)) >= 0;)
+    {
+      auto ready = char{};
+      auto handed_off =
+          !cloudbus::detail::send_listeners(peer, listeners()) &&
+          ::recv(peer, &ready, sizeof(ready), MSG_WAITALL) == sizeof(ready);
+      ::close(peer);
+
+      if (handed_off)
+      {
+        drain();
+        break;
+      }
+    }
+  });
+}
+
+/**
+ * @brief Stops serving the handoff socket.
+ * @details The handoff socket is not unlinked, since its path may
+ * already belong to the next segment.
+ * @param server The listening handoff socket, or -1.
+ * @param handoff The thread that serves the handoff socket.
+ */
+static auto stop_handoff(int server, std::jthread &handoff) -> void
+{
+  if (server < 0)
+    return;
+
+  // Wakes up the blocked accept.
+  ::shutdown(server, SHUT_RDWR);
+  if (handoff.joinable())
+    handoff.join();
+  ::close(server);
+}
+
+#ifdef CB_SEGMENT_HAS_IO_URING
+/**
+ * @brief Runs the segment on the io_uring data path until SIGTERM.
+ * @details The event loops serve on the inherited listening sockets that
+ * are bound to their addresses, and hand off their listening sockets to
+ * the next segment on a hot restart.
+ * @param config The segment configuration.
+ * @param cpus The CPUs to pin the event loops to.
+ * @param inherited The listening sockets of the previous segment.
+ * @param predecessor The connection to the previous segment, or -1.
+ * @return The exit status.
+ */
+static auto run_uring(const segment_config &config,
+                      const std::vector<int> &cpus, std::vector<int> inherited,
+                      int predecessor) -> int
+{
+  auto services = std::list<uring_segment_service>{};
+  auto threads = std::list<std::jthread>{};
+  auto drain = [&] {
+    for (auto &service : services)
+      service.drain();
+  };
+
+  auto sighandler = handle_signals(
+      [&] {
+        for (auto &thread : threads)
+          thread.request_stop();
+      },
+      drain);
+
+  auto cpu = cpus.begin();
+  for (const auto &address : config.listen)
+  {
+    for (auto i = 0UL; i < config.workers; ++i)
+    {
+      visit_address(address, [&](const auto &addr) {
+        services.emplace_back(
+            addr, reactor_options(config.options, config.incoming_cpu, *cpu));
+      });
+      if (int fd = take_listener(inherited, address); fd >= 0)
+        services.back().adopt(fd);
+
+      pinned(*cpu, [&, &service = services.back()] {
+        threads.emplace_back([&service](std::stop_token token) {
+          if (auto error = service.run(std::move(token)))
+            std::cerr << "io_uring service: " << error.message() << '\n';
+        });
+      });
+      if (++cpu == cpus.end())
+        cpu = cpus.begin();
+    }
+  }
+
+  // Listeners of the previous segment that were not taken over.
+  for (int fd : inherited)
+    ::close(fd);
+
+  auto server = publish_handoff(config, predecessor);
+  auto handoff = serve_handoff(
+      server,
+      [&] {
+        auto fds = std::vector<int>{};
+        for (const auto &service : services)
+        {
+          if (int fd = service.listener(); fd >= 0)
+            fds.push_back(fd);
+        }
+        return fds;
+      },
+      drain);
+
+  for (auto &thread : threads)
+    thread.join();
+
+  stop_handoff(server, handoff);
+  stop_signals(sighandler);
+  return 0;
+}
+#endif
+
+/**
+ * @brief Runs the segment on datagram sockets until SIGTERM.
+ * @details Datagram sockets have no accept queue to hand off, so the
+ * next segment binds next to them with SO_REUSEPORT, and draining stops
+ * the event loops.
+ * @param config The segment configuration.
+ * @param cpus The CPUs to pin the event loops to.
+ * @param predecessor The connection to the previous segment, or -1.
+ * @return The exit status.
+ */
+static auto run_udp(const segment_config &config,
+                    const std::vector<int> &cpus, int predecessor) -> int
+{
+  auto services = std::list<udp_segment_service>{};
+  auto threads = std::list<std::jthread>{};
+  auto stop = [&] {
+    for (auto &thread : threads)
+      thread.request_stop();
+  };
+  auto sighandler = handle_signals(stop, stop);
+
+  auto cpu = cpus.begin();
+  for (const auto &address : config.listen)
+  {
+    for (auto i = 0UL; i < config.workers; ++i)
+    {
+      visit_address(address, [&](const auto &addr) {
+        services.emplace_back(
+            addr, reactor_options(config.options, config.incoming_cpu, *cpu));
+      });
+
+      pinned(*cpu, [&, &service = services.back()] {
+        threads.emplace_back([&service](std::stop_token token) {
+          if (auto error = service.run(std::move(token)))
+            std::cerr << "udp service: " << error.message() << '\n';
+        });
+      });
+      if (++cpu == cpus.end())
+        cpu = cpus.begin();
+    }
+  }
+
+  auto server = publish_handoff(config, predecessor);
+  auto handoff =
+      serve_handoff(server, [] { return std::vector<int>{}; }, stop);
+
+  for (auto &thread : threads)
+    thread.join();
+
+  stop_handoff(server, handoff);
+  stop_signals(sighandler);
+  return 0;
+}
+
+/**
+ * @brief Creates the TLS contexts of the segment links.
+ * @param config The segment configuration to add the contexts to.
+ * @return True if TLS is disabled or the contexts were created.
+ */
+static auto setup_tls(segment_config &config) -> bool
+{
+  if (!config.accept_tls && !config.upstream_tls)
+    return true;
+
+  if (config.udp)
+  {
+    std::cerr << "TLS is not supported on datagram sockets\n";
+    return false;
+  }
+
+#ifdef CB_SEGMENT_HAS_KTLS
+  using cloudbus::detail::tls_context;
+
+  auto make = [&](tls_context::side side) -> std::shared_ptr<tls_context> {
+    auto ctx = std::make_shared<tls_context>(side);
+    if (auto error = ctx->configure(config.tls))
+    {
+      std::cerr << "TLS credentials: " << error.message() << '\n';
+      return nullptr;
     }
+    return ctx;
+  };
+
+  if (config.accept_tls &&
+      !(config.options.tls = make(tls_context::side::server)))
+  {
+    return false;
+  }
+
+  if (config.upstream_tls &&
+      !(config.options.upstream_tls = make(tls_context::side::client)))
+  {
+    return false;
+  }
+  return true;
+#else
+  std::cerr << "This segment was built without kernel TLS support\n";
+  return false;
+#endif
+}
+
+/**
+ * @brief Checks that the data path can hand off its listening sockets.
+ * @details The epoll data path cannot stop accepting on a listening
+ * socket without shutting it down, which would reset the connections
+ * that are queued on it for the next segment, so hot restarts of stream
+ * sockets need the io_uring data path. Datagram sockets have no accept
+ * queue and are not handed off.
+ * @param config The segment configuration.
+ * @return True if hot restarts are disabled or supported.
+ */
+static auto check_handoff(const segment_config &config) -> bool
+{
+  if (config.handoff.empty() || config.udp)
+    return true;
+
+#ifdef CB_SEGMENT_HAS_IO_URING
+  if (config.io_uring)
+    return true;
+#endif
+  std::cerr << "handoff needs the io_uring data path\n";
+  return false;
+}
+
+/**
+ * @brief Sets up the trace file of the hot path events.
+ * @details The trace is written on SIGUSR1 and once more at exit.
+ * @param config The segment configuration.
+ * @return True if tracing is disabled or the trace file is set.
+ */
+static auto setup_trace(const segment_config &config) -> bool
+{
+  using cloudbus::detail::trace;
+
+  if (config.trace_file.empty())
+    return true;
+
+  if constexpr (!trace::enabled)
+  {
+    std::cerr << "This segment was built without trace support\n";
+    return false;
+  }
+
+  trace::output(config.trace_file);
+  std::atexit([] {
+    if (auto error = trace::flush())
+      std::cerr << "trace: " << error.message() << '\n';
   });
+  return true;
+}
+
+/**
+ * @brief Writes a trace file as text to the standard output.
+ * @param path The path of the trace file.
+ * @return The exit status.
+ */
+static auto decode_trace(const char *path) -> int
+{
+  auto file = std::ifstream(path, std::ios::binary);
+  if (!file)
+  {
+    std::cerr << path << ": cannot open trace file\n";
+    return EXIT_FAILURE;
+  }
+
+  if (auto error = cloudbus::detail::trace::decode(file, std::cout))
+  {
+    std::cerr << path << ": " << error.message() << '\n';
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
+
+static auto usage(const char *name) -> void
+{
+  std::cerr << "Usage: " << name
+            << " [-c file] [-l addr]... [-o key=value]... [-j workers]"
+               " [-U addr]... [-B usecs] [-T profile] [-C] [-d]"
+               " [-R file]"
+#ifdef CB_SEGMENT_HAS_IO_URING
+            << " [-u]"
+#endif
+            << "\n"
+            << "  -c, --config FILE   Read settings from a file of "
+               "key = value lines.\n"
+            << "  -l, --listen ADDR   Listen on an address, may be "
+               "repeated (default *:"
+            << segment_config::default_port << ").\n"
+            << "  -o, --set K=V       Override a setting of the "
+               "configuration file.\n"
+            << "  -j, --workers N     Number of reactors sharing each "
+               "listening address (0 = one per CPU).\n"
+            << "  -U, --upstream ADDR Forward connections to an upstream "
+               "peer, may be repeated.\n"
+            << "  -B, --busy-poll US  Busy-poll sockets for up to US "
+               "microseconds before sleeping.\n"
+            << "  -T, --tuning P      Socket tuning profile: default or "
+               "latency.\n"
+            << "  -C, --incoming-cpu  Accept connections on the reactor "
+               "pinned to their receive CPU.\n"
+            << "  -d, --udp           Serve datagrams on UDP or "
+               "Unix-domain datagram sockets.\n"
+            << "  -R, --read-trace F  Write a trace file as text and "
+               "exit.\n"
+#ifdef CB_SEGMENT_HAS_IO_URING
+            << "  -u, --io-uring      Run the data path on io_uring.\n"
+#endif
+            << "Addresses are A.B.C.D:PORT, [IPV6]:PORT, *:PORT or "
+               "unix:PATH.\n"
+            << "SIGUSR2 drains the segment. With handoff = PATH, a new "
+               "segment takes over\nthe listening sockets of the running "
+               "one, which then drains. Stream sockets\nneed --io-uring "
+               "to be handed off.\n";
+}
+
+/**
+ * @brief Reads a configuration file.
+ * @param path The path of the file.
+ * @param config The configuration to update.
+ * @return True if the file was read.
+ */
+static auto load_config(const char *path, segment_config &config) -> bool
+{
+  auto file = std::ifstream(path);
+  if (!file)
+  {
+    std::cerr << path << ": cannot open configuration file\n";
+    return false;
+  }
+
+  auto line = std::size_t{};
+  if (auto error = config.load(file, line))
+  {
+    std::cerr << path << ':' << line << ": " << error.message() << '\n';
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Applies a `key=value` command line override.
+ * @param arg The override.
+ * @param config The configuration to update.
+ * @return True if the override was applied.
+ */
+static auto set_config(std::string_view arg, segment_config &config) -> bool
+{
+  auto eq = arg.find('=');
+  if (eq == std::string_view::npos ||
+      config.set(arg.substr(0, eq), arg.substr(eq + 1)))
+  {
+    std::cerr << "Invalid setting: " << arg << '\n';
+    return false;
+  }
+  return true;
 }
 
 auto main(int argc, char *argv[]) -> int
 {
   using namespace io::socket;
 
+  auto config = segment_config{};
+
+  static constexpr auto long_options = std::array{
+      option{"config", required_argument, nullptr, 'c'},
+      option{"listen", required_argument, nullptr, 'l'},
+      option{"set", required_argument, nullptr, 'o'},
+      option{"workers", required_argument, nullptr, 'j'},
+      option{"upstream", required_argument, nullptr, 'U'},
+      option{"busy-poll", required_argument, nullptr, 'B'},
+      option{"tuning", required_argument, nullptr, 'T'},
+      option{"incoming-cpu", no_argument, nullptr, 'C'},
+      option{"udp", no_argument, nullptr, 'd'},
+      option{"io-uring", no_argument, nullptr, 'u'},
+      option{"read-trace", required_argument, nullptr, 'R'},
+      option{"help", no_argument, nullptr, 'h'},
+      option{nullptr, 0, nullptr, 0},
+  };
+  static constexpr auto optstring = "c:l:o:j:U:B:T:R:Cduh";
+
+  // The configuration file is read first so that every other option
+  // overrides it regardless of its position on the command line.
+  // Errors are reported by the second pass.
+  opterr = 0;
+  for (int opt = 0; (opt = getopt_long(argc, argv, optstring,
+                                       long_options.data(), nullptr)) != -1;)
+  {
+    if (opt == 'c' && !load_config(optarg, config))
+      return EXIT_FAILURE;
+  }
+
+  auto listen = std::vector<sockaddr_storage>{};
+  opterr = 1;
+  optind = 1;
+  for (int opt = 0; (opt = getopt_long(argc, argv, optstring,
+                                       long_options.data(), nullptr)) != -1;)
+  {
+    auto ok = true;
+    switch (opt)
+    {
+      case 'c':
+        break;
+
+      case 'l':
+        ok = config.parse_address(optarg, listen.emplace_back()) != 0;
+        break;
+
+      case 'o':
+        if (!set_config(optarg, config))
+          return EXIT_FAILURE;
+        break;
+
+      case 'j':
+        ok = !config.set("workers", optarg);
+        break;
+
+      case 'U':
+        ok = !config.set("upstream", optarg);
+        break;
+
+      case 'B':
+        ok = !config.set("busy_poll_usecs", optarg);
+        break;
+
+      case 'T':
+        ok = !config.set("tuning", optarg);
+        break;
+
+      case 'C':
+        config.incoming_cpu = true;
+        break;
+
+      case 'd':
+        config.udp = true;
+        break;
+
+      case 'R':
+        return decode_trace(optarg);
+
+#ifdef CB_SEGMENT_HAS_IO_URING
+      case 'u':
+        config.io_uring = true;
+        break;
+#endif
+
+      case 'h':
+        usage(argv[0]);
+        return 0;
+
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!ok)
+    {
+      std::cerr << "Invalid argument: " << optarg << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Listen addresses on the command line replace those of the file.
+  if (!listen.empty())
+    config.listen = std::move(listen);
+
+  if (config.listen.empty())
+  {
+    auto &address = config.listen.emplace_back();
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto &inet = reinterpret_cast<sockaddr_in &>(address);
+    inet.sin_family = AF_INET;
+    inet.sin_port = htons(segment_config::default_port);
+  }
+
+  auto cpus = config.cpus.empty() ? allowed_cpus() : config.cpus;
+  if (cpus.empty())
+    cpus.push_back(0);
+
+  if (!config.workers)
+    config.workers = cpus.size();
+
+  if (!setup_tls(config) || !setup_trace(config) || !check_handoff(config))
+    return EXIT_FAILURE;
+
+  // A hot restart binds the listening addresses of the previous segment
+  // while it is still serving on them.
+  auto inherited = std::vector<int>{};
+  auto predecessor =
+      config.handoff.empty() ? -1 : take_over(config.handoff, inherited);
+
+  config.options.reuse_port = config.workers > 1 || !config.handoff.empty();
+  unlink_sockets(config, inherited);
+
+  // The connection caps hold for the segment, not for each reactor.
+  if (config.options.max_connections ||
+      config.options.max_connections_per_source)
+  {
+    config.options.admission =
+        std::make_shared<cloudbus::detail::admission_control>(
+            config.options.max_connections,
+            config.options.max_connections_per_source);
+  }
+
+  if (config.udp)
+  {
+    for (int fd : inherited)
+      ::close(fd);
+    return run_udp(config, cpus, predecessor);
+  }
+
+#ifdef CB_SEGMENT_HAS_IO_URING
+  if (config.io_uring)
+    return run_uring(config, cpus, std::move(inherited), predecessor);
+#endif
+
   auto mtx = std::mutex{};
   auto cvar = std::condition_variable{};
 
-  auto address = socket_address<sockaddr_in>{};
-  address->sin_family = AF_INET;
-  address->sin_port = htons(PORT);
+  auto services = std::list<service_type>{};
+  auto reactors = std::list<segment_options>{};
+  for (auto i = 0UL; i < config.listen.size() * config.workers; ++i)
+    services.emplace_back();
 
-  auto service = service_type{};
-  auto sighandler = handle_signals(service);
+  auto stop = [&] {
+    using enum service_type::signals;
+    for (auto &service : services)
+      service.signal(terminate);
+  };
 
-  service.start(mtx, cvar, address);
+  // The reactors of a draining epoll data path shut down their listening
+  // sockets and stop reading from the connections that they have
+  // accepted, and are stopped once every connection has written
+  // everything, or after the drain timeout.
+  auto ticker = std::make_shared<cloudbus::detail::ticker>();
+  config.options.ticker = ticker;
+  auto drain_once = std::once_flag{};
+  auto drainer = std::jthread{};
+  auto drain = [&] {
+    std::call_once(drain_once, [&] {
+      ticker->drain();
+      drainer = std::jthread([&](std::stop_token token) {
+        ticker->wait_drained(token, config.options.drain_timeout);
+        if (!token.stop_requested())
+          stop();
+      });
+    });
+  };
+  auto sighandler = handle_signals(stop, drain);
+
+  // The reactors share one upstream connection pool, and hand each
+  // multiplexed message to the reactor that owns its pooled connection.
+  if (config.options.upstream_pool_size &&
+      config.options.framing != framing_mode::none && services.size() > 1)
+  {
+    config.options.exchange =
+        std::make_shared<cloudbus::detail::shard_exchange>(services.size());
+  }
+
+  auto cpu = cpus.begin();
+  auto service = services.begin();
+  auto shard = 0UL;
+  for (const auto &address : config.listen)
+  {
+    for (auto i = 0UL; i < config.workers; ++i, ++service)
+    {
+      auto &reactor = reactors.emplace_back(
+          reactor_options(config.options, config.incoming_cpu, *cpu));
+      reactor.shard = shard++;
+
+      visit_address(address, [&](const auto &addr) {
+        auto listen_address =
+            socket_address<std::remove_cvref_t<decltype(addr)>>{};
+        *listen_address.operator->() = addr;
+        pinned(*cpu, [&] {
+          service->start(mtx, cvar, listen_address, reactor);
+        });
+      });
+      if (++cpu == cpus.end())
+        cpu = cpus.begin();
+    }
+  }
 
   auto lock = std::unique_lock{mtx};
-  cvar.wait(lock, [&] { return service.stopped.load(); });
+  cvar.wait(lock, [&] {
+    return std::ranges::all_of(
+        services, [](const auto &service) { return service.stopped.load(); });
+  });
+  lock.unlock();
 
-  sighandler.join();
+  stop_signals(sighandler);
   return 0;
 }
@@ -0,0 +1,178 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file metrics.cpp
+ * @brief This file defines per-thread counters and latency histograms.
+ */
+#include "segment/detail/metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+namespace cloudbus::detail {
+namespace {
+/** @brief The slots of all threads that have counted anything. */
+struct registry {
+  /** @brief Protects the slots. */
+  std::mutex mtx;
+  /** @brief The registered slots. */
+  std::vector<std::unique_ptr<metrics::slot>> slots;
+};
+
+/**
+ * @brief Gets the slot registry.
+ * @details The registry is never destroyed, so threads that exit after
+ * `main` returns can still count.
+ * @return The registry.
+ */
+auto get_registry() -> registry &
+{
+  static auto *instance = new registry{};
+  return *instance;
+}
+
+/**
+ * @brief Reads a value that may be written by another thread.
+ * @param value The value.
+ * @return The current value.
+ */
+auto load(const std::uint64_t &value) noexcept -> std::uint64_t
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+  return std::atomic_ref(const_cast<std::uint64_t &>(value))
+      .load(std::memory_order_relaxed);
+}
+} // namespace
+
+auto histogram::merge(const histogram &other) noexcept -> void
+{
+  for (std::size_t i = 0; i < buckets; ++i)
+  {
+    auto count = std::atomic_ref(counts_[i]);
+    count.store(count.load(std::memory_order_relaxed) + load(other.counts_[i]),
+                std::memory_order_relaxed);
+  }
+}
+
+auto histogram::count() const noexcept -> std::uint64_t
+{
+  auto total = std::uint64_t{0};
+  for (const auto &count : counts_)
+    total += load(count);
+
+  return total;
+}
+
+auto histogram::percentile(double quantile) const noexcept -> std::uint64_t
+{
+  auto total = count();
+  if (!total)
+    return 0;
+
+  auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(
+             std::ceil(std::clamp(quantile, 0.0, 1.0) *
+                       static_cast<double>(total))));
+
+  auto seen = std::uint64_t{0};
+  for (std::size_t i = 0; i < buckets; ++i)
+  {
+    seen += load(counts_[i]);
+    if (seen >= rank)
+      return highest(i);
+  }
+
+  return highest(buckets - 1);
+}
+
+auto metrics::local() -> slot &
+{
+  static thread_local auto *local = [] {
+    auto &reg = get_registry();
+    auto lock = std::lock_guard{reg.mtx};
+    return reg.slots.emplace_back(std::make_unique<slot>()).get();
+  }();
+
+  return *local;
+}
+
+auto metrics::collect() -> snapshot
+{
+  auto snap = snapshot{};
+  auto &reg = get_registry();
+  auto lock = std::lock_guard{reg.mtx};
+
+  for (const auto &slot : reg.slots)
+  {
+    for (std::size_t i = 0; i < counters; ++i)
+      snap.values[i] += load(slot->values[i]);
+
+    snap.latency.merge(slot->latency);
+  }
+
+  return snap;
+}
+
+auto metrics::name(counter event) noexcept -> std::string_view
+{
+  using enum counter;
+  switch (event)
+  {
+    case bytes_read:
+      return "bytes_read";
+    case bytes_written:
+      return "bytes_written";
+    case messages:
+      return "messages";
+    case sendmsg_calls:
+      return "sendmsg_calls";
+    case short_writes:
+      return "short_writes";
+    case errors:
+      return "errors";
+    case rejected:
+      return "rejected";
+    case throttled:
+      return "throttled";
+    case timeouts:
+      return "timeouts";
+    case expired:
+      return "expired";
+    case handoffs:
+      return "handoffs";
+    default:
+      return "unknown";
+  }
+}
+
+auto metrics::snapshot::print(std::ostream &os) const -> void
+{
+  for (std::size_t i = 0; i < counters; ++i)
+    os << name(static_cast<counter>(i)) << ' ' << values[i] << '\n';
+
+  os << "latency_count " << latency.count() << '\n';
+  for (auto [label, quantile] :
+       {std::pair{"p50", 0.5}, std::pair{"p90", 0.9}, std::pair{"p99", 0.99},
+        std::pair{"p999", 0.999}, std::pair{"max", 1.0}})
+  {
+    os << "latency_" << label << "_ns " << latency.percentile(quantile)
+       << '\n';
+  }
+}
+} // namespace cloudbus::detail
@@ -0,0 +1,63 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file mux_frame.cpp
+ * @brief This file defines the frames that are multiplexed upstream.
+ */
+#include "segment/detail/mux_frame.hpp"
+
+#include <ranges>
+namespace cloudbus::detail {
+namespace {
+/**
+ * @brief Writes a 32-bit big-endian integer.
+ * @param out The 4 bytes to write to.
+ * @param value The value to write.
+ */
+auto store(std::span<std::byte, 4> out, std::uint32_t value) noexcept -> void
+{
+  for (auto &byte : out | std::views::reverse)
+  {
+    byte = static_cast<std::byte>(value & 0xffU);
+    value >>= 8U;
+  }
+}
+} // namespace
+
+auto mux_frame::header(std::uint32_t stream, std::size_t size) noexcept
+    -> header_type
+{
+  auto header = header_type{};
+  auto len = static_cast<std::uint32_t>(size + header_size -
+                                        frame_parser::header_size);
+  store(std::span(header).first<4>(), len);
+  store(std::span(header).last<4>(), stream);
+  return header;
+}
+
+auto mux_frame::parse(const frame_view &frame) noexcept
+    -> std::optional<mux_frame>
+{
+  if (frame.head().size() < header_size)
+    return std::nullopt;
+
+  auto stream = std::uint32_t{0};
+  for (auto byte : frame.head().subspan(frame_parser::header_size, 4))
+    stream = (stream << 8U) | std::to_integer<std::uint32_t>(byte);
+
+  return mux_frame{.stream = stream, .payload = frame.subframe(header_size)};
+}
+} // namespace cloudbus::detail
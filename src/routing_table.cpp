@@ -0,0 +1,43 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file routing_table.cpp
+ * @brief This file defines the routing table of a forwarding segment.
+ */
+#include "segment/detail/routing_table.hpp"
+namespace cloudbus::detail {
+
+routing_table::routing_table(std::vector<address_type> members)
+    : ring_{std::make_shared<const hash_ring>(std::move(members))}
+{}
+
+auto routing_table::update(std::vector<address_type> members) -> void
+{
+  ring_.store(std::make_shared<const hash_ring>(std::move(members)),
+              std::memory_order_release);
+  version_.fetch_add(1, std::memory_order_release);
+}
+
+auto routing_table::load() const noexcept -> std::shared_ptr<const hash_ring>
+{
+  return ring_.load(std::memory_order_acquire);
+}
+
+auto routing_table::version() const noexcept -> std::uint64_t
+{
+  return version_.load(std::memory_order_acquire);
+}
+} // namespace cloudbus::detail
@@ -0,0 +1,600 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file segment_config.cpp
+ * @brief This file defines the runtime configuration of a segment.
+ */
+#include "segment/segment_config.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+namespace cloudbus::segment {
+namespace {
+/**
+ * @brief Removes leading and trailing whitespace.
+ * @param str The string to trim.
+ * @return The trimmed string.
+ */
+auto trim(std::string_view str) noexcept -> std::string_view
+{
+  constexpr auto whitespace = std::string_view(" \t\r\n");
+  auto first = str.find_first_not_of(whitespace);
+  if (first == std::string_view::npos)
+    return {};
+
+  return str.substr(first, str.find_last_not_of(whitespace) - first + 1);
+}
+
+/**
+ * @brief Parses an integer.
+ * @tparam T The integer type.
+ * @param str The string to parse.
+ * @param value The parsed value.
+ * @return True if the whole string is a valid integer.
+ */
+template <typename T> auto parse_int(std::string_view str, T &value) -> bool
+{
+  const auto *last = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), last, value);
+  return !str.empty() && ec == std::errc{} && ptr == last;
+}
+
+/**
+ * @brief Parses a duration in milliseconds.
+ * @param str The string to parse.
+ * @param value The parsed duration.
+ * @return True if the whole string is a valid number of milliseconds.
+ */
+auto parse_msecs(std::string_view str,
+                 std::chrono::milliseconds &value) -> bool
+{
+  auto msecs = std::chrono::milliseconds::rep{};
+  if (!parse_int(str, msecs))
+    return false;
+  value = std::chrono::milliseconds(msecs);
+  return true;
+}
+
+/**
+ * @brief Parses a size with an optional binary `K`, `M` or `G` suffix.
+ * @tparam T The integer type.
+ * @param str The string to parse.
+ * @param value The parsed value.
+ * @return True if the string is a valid size.
+ */
+template <typename T> auto parse_size(std::string_view str, T &value) -> bool
+{
+  auto shift = 0U;
+  if (!str.empty())
+  {
+    switch (str.back())
+    {
+      case 'K':
+      case 'k':
+        shift = 10;
+        break;
+      case 'M':
+      case 'm':
+        shift = 20;
+        break;
+      case 'G':
+      case 'g':
+        shift = 30;
+        break;
+      default:
+        break;
+    }
+  }
+  if (shift)
+    str.remove_suffix(1);
+
+  auto base = T{};
+  if (!parse_int(str, base) ||
+      base > (std::numeric_limits<T>::max() >> shift))
+  {
+    return false;
+  }
+
+  value = static_cast<T>(base << shift);
+  return true;
+}
+
+/**
+ * @brief Parses a boolean.
+ * @param str One of true, false, on, off, yes, no, 1 or 0.
+ * @param value The parsed value.
+ * @return True if the string is a valid boolean.
+ */
+auto parse_bool(std::string_view str, bool &value) -> bool
+{
+  if (str == "true" || str == "on" || str == "yes" || str == "1")
+    value = true;
+  else if (str == "false" || str == "off" || str == "no" || str == "0")
+    value = false;
+  else
+    return false;
+
+  return true;
+}
+
+/**
+ * @brief Parses a list of CPUs such as `0-3,8`.
+ * @param str The string to parse.
+ * @param cpus The parsed CPUs, in the order that they are listed.
+ * @return True if the string is a valid CPU list.
+ */
+auto parse_cpus(std::string_view str, std::vector<int> &cpus) -> bool
+{
+  auto parsed = std::vector<int>{};
+  while (!str.empty())
+  {
+    auto comma = str.find(',');
+    auto item = trim(str.substr(0, comma));
+    str = comma == std::string_view::npos ? std::string_view{}
+                                          : str.substr(comma + 1);
+
+    auto dash = item.find('-');
+    auto first = 0;
+    auto last = 0;
+    if (!parse_int(item.substr(0, dash), first) ||
+        (dash != std::string_view::npos &&
+         !parse_int(item.substr(dash + 1), last)))
+    {
+      return false;
+    }
+    if (dash == std::string_view::npos)
+      last = first;
+    if (first < 0 || last < first)
+      return false;
+
+    for (auto cpu = first; cpu <= last; ++cpu)
+      parsed.push_back(cpu);
+  }
+
+  if (parsed.empty())
+    return false;
+
+  cpus = std::move(parsed);
+  return true;
+}
+
+/**
+ * @brief Parses a framing mode.
+ * @param str One of none, length or delimited.
+ * @param framing The parsed framing mode.
+ * @return True if the string is a valid framing mode.
+ */
+auto parse_framing(std::string_view str, framing_mode &framing) -> bool
+{
+  if (str == "none")
+    framing = framing_mode::none;
+  else if (str == "length")
+    framing = framing_mode::length_prefixed;
+  else if (str == "delimited")
+    framing = framing_mode::delimited;
+  else
+    return false;
+
+  return true;
+}
+
+/**
+ * @brief Adds a member to the routing table, creating it if needed.
+ * @param options The segment options.
+ * @param member The address of the member.
+ */
+auto add_route(segment_options &options,
+               const sockaddr_storage &member) -> void
+{
+  if (!options.routes)
+  {
+    options.routes = std::make_shared<detail::routing_table>(
+        std::vector<sockaddr_storage>{member});
+    return;
+  }
+
+  auto members = options.routes->load()->members();
+  auto updated = std::vector<sockaddr_storage>(members.begin(), members.end());
+  updated.push_back(member);
+  options.routes->update(std::move(updated));
+}
+
+/** @brief A configuration setting. */
+struct setting {
+  /** @brief The key of the setting. */
+  std::string_view key;
+  /** @brief Parses the value of the setting into the configuration. */
+  bool (*set)(segment_config &config, std::string_view value);
+};
+
+/** @brief All configuration settings. */
+constexpr auto settings = std::array{
+    setting{"listen",
+            [](segment_config &config, std::string_view value) {
+              auto address = sockaddr_storage{};
+              if (!segment_config::parse_address(value, address))
+                return false;
+              config.listen.push_back(address);
+              return true;
+            }},
+    setting{"workers",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.workers);
+            }},
+    setting{"cpus",
+            [](segment_config &config, std::string_view value) {
+              return parse_cpus(value, config.cpus);
+            }},
+    setting{"io_uring",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.io_uring);
+            }},
+    setting{"udp",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.udp);
+            }},
+    setting{"incoming_cpu",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.incoming_cpu);
+            }},
+    setting{"handoff",
+            [](segment_config &config, std::string_view value) {
+              constexpr auto size = sizeof(sockaddr_un::sun_path);
+              if (value.empty() || value.size() >= size)
+                return false;
+              config.handoff = value;
+              return true;
+            }},
+    setting{"upstream",
+            [](segment_config &config, std::string_view value) {
+              auto address = sockaddr_storage{};
+              if (!segment_config::parse_address(value, address))
+                return false;
+              config.options.upstreams.push_back(address);
+              return true;
+            }},
+    setting{"route",
+            [](segment_config &config, std::string_view value) {
+              auto address = sockaddr_storage{};
+              if (!segment_config::parse_address(value, address))
+                return false;
+              add_route(config.options, address);
+              return true;
+            }},
+    setting{"upstream_pool_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.upstream_pool_size);
+            }},
+    setting{"routing_key_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.routing_key_size);
+            }},
+    setting{"framing",
+            [](segment_config &config, std::string_view value) {
+              return parse_framing(value, config.options.framing);
+            }},
+    setting{"delimiter",
+            [](segment_config &config, std::string_view value) {
+              if (value == "\\n")
+                value = "\n";
+              if (value.size() != 1)
+                return false;
+              config.options.delimiter = value.front();
+              return true;
+            }},
+    setting{"max_frame_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.max_frame_size);
+            }},
+    setting{"pipeline",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.options.pipeline);
+            }},
+    setting{"max_outstanding_bytes",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.max_outstanding_bytes);
+            }},
+    setting{"max_send_buffers",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.max_send_buffers);
+            }},
+    setting{"zerocopy_threshold",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.zerocopy_threshold);
+            }},
+    setting{"uring_buffer_count",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.uring_buffer_count);
+            }},
+    setting{"uring_buffer_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.uring_buffer_size);
+            }},
+    setting{"uring_large_buffer_count",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.uring_large_buffer_count);
+            }},
+    setting{"uring_large_buffer_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.uring_large_buffer_size);
+            }},
+    setting{"udp_batch_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.udp_batch_size);
+            }},
+    setting{"udp_buffer_size",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.udp_buffer_size);
+            }},
+    setting{"udp_offload",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.options.udp_offload);
+            }},
+    setting{"memory_limit",
+            [](segment_config &config, std::string_view value) {
+              auto limit = std::size_t{};
+              if (!parse_size(value, limit))
+                return false;
+              config.options.memory_budget =
+                  limit ? std::make_shared<detail::memory_budget>(limit)
+                        : nullptr;
+              return true;
+            }},
+    setting{"busy_poll_usecs",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.busy_poll_usecs);
+            }},
+    setting{"drain_timeout",
+            [](segment_config &config, std::string_view value) {
+              return parse_msecs(value, config.options.drain_timeout);
+            }},
+    setting{"idle_timeout",
+            [](segment_config &config, std::string_view value) {
+              return parse_msecs(value, config.options.idle_timeout);
+            }},
+    setting{"write_timeout",
+            [](segment_config &config, std::string_view value) {
+              return parse_msecs(value, config.options.write_timeout);
+            }},
+    setting{"message_deadline",
+            [](segment_config &config, std::string_view value) {
+              return parse_msecs(value, config.options.message_deadline);
+            }},
+    setting{"max_connections",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.max_connections);
+            }},
+    setting{"max_connections_per_source",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value,
+                               config.options.max_connections_per_source);
+            }},
+    setting{"rate_limit_bytes",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.rate_limit_bytes);
+            }},
+    setting{"rate_limit_messages",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.rate_limit_messages);
+            }},
+    setting{"rate_limit_burst",
+            [](segment_config &config, std::string_view value) {
+              auto burst = std::chrono::milliseconds{};
+              if (!parse_msecs(value, burst) || !burst.count())
+                return false;
+              config.options.rate_limit_burst = burst;
+              return true;
+            }},
+    setting{"tls",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.accept_tls);
+            }},
+    setting{"upstream_tls",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.upstream_tls);
+            }},
+    setting{"tls_certificate",
+            [](segment_config &config, std::string_view value) {
+              config.tls.certificate = value;
+              return !value.empty();
+            }},
+    setting{"tls_private_key",
+            [](segment_config &config, std::string_view value) {
+              config.tls.private_key = value;
+              return !value.empty();
+            }},
+    setting{"tls_ca_file",
+            [](segment_config &config, std::string_view value) {
+              config.tls.ca_file = value;
+              return !value.empty();
+            }},
+    setting{"tls_server_name",
+            [](segment_config &config, std::string_view value) {
+              config.tls.server_name = value;
+              return !value.empty();
+            }},
+    setting{"trace_file",
+            [](segment_config &config, std::string_view value) {
+              config.trace_file = value;
+              return !value.empty();
+            }},
+    setting{"tuning",
+            [](segment_config &config, std::string_view value) {
+              if (value == "latency")
+                config.options.tuning = socket_tuning::low_latency();
+              else if (value == "default")
+                config.options.tuning = socket_tuning{};
+              else
+                return false;
+              return true;
+            }},
+    setting{"nodelay",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.options.tuning.nodelay);
+            }},
+    setting{"quickack",
+            [](segment_config &config, std::string_view value) {
+              return parse_bool(value, config.options.tuning.quickack);
+            }},
+    setting{"send_buffer",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.tuning.send_buffer);
+            }},
+    setting{"receive_buffer",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.tuning.receive_buffer);
+            }},
+    setting{"notsent_lowat",
+            [](segment_config &config, std::string_view value) {
+              return parse_size(value, config.options.tuning.notsent_lowat);
+            }},
+    setting{"defer_accept",
+            [](segment_config &config, std::string_view value) {
+              return parse_int(value, config.options.tuning.defer_accept);
+            }},
+};
+} // namespace
+
+auto segment_config::set(std::string_view key,
+                         std::string_view value) -> std::error_code
+{
+  const auto *it = std::ranges::find(settings, trim(key), &setting::key);
+  if (it == settings.end() || !it->set(*this, trim(value)))
+    return std::make_error_code(std::errc::invalid_argument);
+
+  return {};
+}
+
+auto segment_config::load(std::istream &is,
+                          std::size_t &line) -> std::error_code
+{
+  line = 0;
+  for (auto buf = std::string{}; std::getline(is, buf);)
+  {
+    ++line;
+    auto str = trim(std::string_view(buf).substr(0, buf.find('#')));
+    if (str.empty())
+      continue;
+
+    auto eq = str.find('=');
+    if (eq == std::string_view::npos)
+      return std::make_error_code(std::errc::invalid_argument);
+
+    if (auto error = set(str.substr(0, eq), str.substr(eq + 1)))
+      return error;
+  }
+
+  return {};
+}
+
+auto segment_config::parse_address(std::string_view arg,
+                                   sockaddr_storage &address) -> socklen_t
+{
+  address = {};
+
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (arg.starts_with("unix:"))
+  {
+    auto path = arg.substr(5);
+    auto *addr = reinterpret_cast<sockaddr_un *>(&address);
+    if (path.empty() || path.size() >= sizeof(addr->sun_path))
+      return 0;
+
+    addr->sun_family = AF_UNIX;
+    std::memcpy(addr->sun_path, path.data(), path.size());
+
+    // Abstract socket names start with a NUL byte instead of an '@'.
+    if (path.front() == '@')
+      addr->sun_path[0] = '\0';
+
+    return address_size(address);
+  }
+
+  auto colon = arg.rfind(':');
+  auto port = 0U;
+  if (colon == std::string_view::npos ||
+      !parse_int(arg.substr(colon + 1), port) || !port || port > UINT16_MAX)
+  {
+    return 0;
+  }
+
+  auto host = arg.substr(0, colon);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+  {
+    auto *addr = reinterpret_cast<sockaddr_in6 *>(&address);
+    auto str = std::string(host.substr(1, host.size() - 2));
+    addr->sin6_family = AF_INET6;
+    addr->sin6_port = htons(static_cast<std::uint16_t>(port));
+    if (inet_pton(AF_INET6, str.c_str(), &addr->sin6_addr) != 1)
+      return 0;
+
+    return sizeof(sockaddr_in6);
+  }
+
+  auto *addr = reinterpret_cast<sockaddr_in *>(&address);
+  auto str = std::string(host);
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(static_cast<std::uint16_t>(port));
+  if (host == "*")
+    addr->sin_addr.s_addr = htonl(INADDR_ANY);
+  else if (inet_pton(AF_INET, str.c_str(), &addr->sin_addr) != 1)
+    return 0;
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+  return sizeof(sockaddr_in);
+}
+
+auto segment_config::address_size(const sockaddr_storage &address) noexcept
+    -> socklen_t
+{
+  switch (address.ss_family)
+  {
+    case AF_INET:
+      return sizeof(sockaddr_in);
+
+    case AF_INET6:
+      return sizeof(sockaddr_in6);
+
+    case AF_UNIX:
+    {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      const auto *addr = reinterpret_cast<const sockaddr_un *>(&address);
+      const auto *path = static_cast<const char *>(addr->sun_path);
+      auto size = sizeof(addr->sun_path);
+
+      // Abstract names end at the first NUL after the leading one.
+      auto len = path[0] ? strnlen(path, size) + 1
+                         : strnlen(path + 1, size - 1) + 1;
+      return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len);
+    }
+
+    default:
+      return sizeof(address);
+  }
+}
+} // namespace cloudbus::segment
@@ -18,26 +18,224 @@
  * @brief This file defines the segment service.
  */
 #include "segment/segment_service.hpp"
+#include "segment/detail/pipeline.hpp"
+#include "segment/detail/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 namespace cloudbus::segment {
+namespace {
+/**
+ * @brief Gets the native handle of the socket underlying a socket dialog.
+ * @param socket The socket dialog.
+ * @return The native socket handle.
+ */
+auto native_handle(const segment_service::socket_dialog &socket) noexcept
+    -> io::socket::native_socket_type
+{
+  return static_cast<io::socket::native_socket_type>(*socket.socket);
+}
+
+/**
+ * @brief Gets the bytes of a message that was read from a socket.
+ * @details Reads fill a single buffer, so only the first buffer of the
+ * message is looked at.
+ * @tparam Message The socket message type.
+ * @param msg The message.
+ * @return The bytes of the message.
+ */
+template <typename Message>
+auto bytes_of(const Message &msg) noexcept -> std::span<const std::byte>
+{
+  if (msg.buffers.empty())
+    return {};
+
+  const auto &buf = *msg.buffers.begin();
+  if constexpr (requires { buf.iov_base; })
+    return {static_cast<const std::byte *>(buf.iov_base), buf.iov_len};
+  else
+    return std::as_bytes(std::span(buf));
+}
+
+/**
+ * @brief Gets the number of reactors that share the upstream pool.
+ * @param options The options of the reactor.
+ * @return The number of shards of the exchange, or 1 without one.
+ */
+auto shards(const segment_options &options) noexcept -> std::size_t
+{
+  return options.exchange ? options.exchange->shards() : 1;
+}
+} // namespace
+
+segment_service::read_context::read_context(
+    std::size_t size, std::shared_ptr<detail::memory_account> account)
+    : buffer{static_cast<std::byte *>(
+                 detail::buffer_pool::local().allocate(size)),
+             size},
+      account_{std::move(account)}
+{
+  account_->charge(size);
+}
 
-auto segment_service::initialize(const socket_handle &sock) noexcept
+segment_service::read_context::~read_context()
+{
+  account_->release(buffer.size());
+  detail::buffer_pool::local().deallocate(buffer.data(), buffer.size());
+}
+
+auto segment_service::initialize(const socket_handle &sock) const noexcept
     -> std::error_code
 {
+  if (auto error = options_.tuning.apply_listener(
+          static_cast<io::socket::native_socket_type>(sock)))
+  {
+    return error;
+  }
+
+  int enable = 1;
+  if (io::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)))
+    return {errno, std::system_category()};
+
+  if (options_.reuse_port && io::setsockopt(sock, SOL_SOCKET, SO_REUSEPORT,
+                                            &enable, sizeof(enable)))
+  {
+    return {errno, std::system_category()};
+  }
+
+  // Accepted sockets inherit SO_ZEROCOPY from the listening socket.
+  // Unix-domain sockets do not support zerocopy sends.
+  int domain = AF_UNSPEC;
+  auto len = socklen_t{sizeof(domain)};
+  io::getsockopt(sock, SOL_SOCKET, SO_DOMAIN, &domain, &len);
+  if (options_.zerocopy_threshold && domain != AF_UNIX &&
+      io::setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)))
+  {
+    return {errno, std::system_category()};
+  }
+
+  // And the busy-polling window.
+  if (int usecs = static_cast<int>(options_.busy_poll_usecs);
+      usecs &&
+      io::setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)))
+  {
+    return {errno, std::system_category()};
+  }
+
   return {};
 }
 
+auto segment_service::start(async_context &ctx) noexcept -> std::error_code
+{
+  auto sock = socket_handle(address_.ss_family, SOCK_STREAM,
+                            address_.ss_family == AF_UNIX ? 0 : IPPROTO_TCP);
+  if (auto error = initialize(sock))
+    return error;
+  // initialize() fails if SO_ZEROCOPY could not be set where it applies.
+  zerocopy_ = options_.zerocopy_threshold && address_.ss_family != AF_UNIX;
+
+  const auto handle = static_cast<native_handle_type>(sock);
+  if (::bind(handle, reinterpret_cast<const sockaddr *>(&address_),
+             address_len_) ||
+      ::listen(handle, SOMAXCONN))
+  {
+    return {errno, std::system_category()};
+  }
+
+  start_ticks(ctx);
+  if (options_.exchange)
+    start_exchange(ctx);
+
+  // Kept so that a draining reactor can leave the SO_REUSEPORT group.
+  listening_ = ctx.poller.emplace(std::move(sock));
+  listener_.store(handle, std::memory_order_release);
+  accept(ctx, *listening_);
+  return {};
+}
+
+auto segment_service::signal_handler(int signum) noexcept -> void
+{
+  if (signum == async_context::terminate)
+  {
+    if (int fd = listener_.exchange(-1, std::memory_order_acq_rel); fd >= 0)
+      ::shutdown(fd, SHUT_RD);
+  }
+
+  Base::signal_handler(signum);
+}
+
 auto segment_service::service(async_context &ctx, const socket_dialog &socket,
                               const std::shared_ptr<read_context> &rctx,
                               const socket_message &msg) -> void
 {
-  using namespace stdexec;
+  const auto buf = bytes_of(msg);
+  detail::trace::emit(detail::trace::event::service, native_handle(socket),
+                      buf.size());
+  auto conn = get_connection(socket);
+  if (conn->pooled)
+    return demux(ctx, socket, conn, rctx, buf);
 
-  sender auto sendmsg =
-      io::sendmsg(socket, msg, 0) |
-      then([&, socket, rctx](auto &&len) { reader(ctx, socket, rctx); }) |
-      upon_error([](auto &&error) {});
+  auto target = forward(ctx, socket, conn);
+  if (conn->stream)
+    return multiplex(ctx, socket, conn, rctx, buf);
 
-  ctx.scope.spawn(std::move(sendmsg));
+  if (!target)
+    return drop_connection(socket, conn);
+
+  const auto &out = conn->forwarded ? *target->socket : socket;
+  const auto stages =
+      detail::stage_context{.limiter = conn->limiter, .now = read_time_};
+  auto send = detail::enqueue_stage(target->queue, read_time_);
+
+  auto error = std::visit(
+      [&](auto path) -> std::error_code {
+        switch (options_.framing)
+        {
+          case framing_mode::length_prefixed:
+            return path.compose(stages, detail::framing_stage(conn->prefixed),
+                                send)(rctx, buf);
+
+          case framing_mode::delimited:
+            return path.compose(stages,
+                                detail::framing_stage(conn->delimited),
+                                send)(rctx, buf);
+
+          default:
+            // Each read of an unframed stream counts as a message.
+            return path.compose(stages, detail::unframed_stage{},
+                                send)(rctx, buf);
+        }
+      },
+      path_);
+
+  // A malformed message closes the connection once its replies are sent.
+  if (error)
+  {
+    if (!target->sending && !target->queue.empty())
+      flush(ctx, out, target);
+    return drop_connection(socket, conn);
+  }
+
+  conn->reading = false;
+
+  if (!target->sending)
+    flush(ctx, out, target);
+
+  read(ctx, socket, conn);
 }
 
 auto segment_service::operator()(async_context &ctx,
@@ -45,7 +243,1274 @@ auto segment_service::operator()(async_context &ctx,
                                  const std::shared_ptr<read_context> &rctx,
                                  std::span<const std::byte> buf) -> void
 {
-  if (rctx)
-    service(ctx, socket, rctx, {.buffers = buf});
+  if (!rctx)
+    return drop_connection(socket);
+
+  auto it = connections_.find(native_handle(socket));
+  if (it == connections_.end())
+    return;
+
+  read_time_ = std::chrono::steady_clock::now();
+  arm_idle(it->second);
+
+  detail::metrics::local().add(detail::metrics::counter::bytes_read,
+                               buf.size());
+  detail::trace::emit(detail::trace::event::read, native_handle(socket),
+                      buf.size());
+  service(ctx, socket, rctx, {.buffers = buf});
+}
+
+auto segment_service::accept(async_context &ctx, const socket_dialog &listener)
+    -> void
+{
+  using namespace stdexec;
+
+  accepting_ = true;
+  sender auto accept =
+      io::accept(listener) | then([&, listener](auto &&result) {
+        auto &&[socket, address] = result;
+        accepting_ = false;
+        accepted(ctx, socket);
+        this->accept(ctx, listener);
+      }) |
+      upon_error([&](auto && /*error*/) {
+        accepting_ = false;
+        // The listening socket has been shut down.
+        if (listener_.load(std::memory_order_acquire) < 0)
+          return listening_.reset();
+
+        detail::metrics::local().add(detail::metrics::counter::errors);
+      });
+
+  ctx.scope.spawn(std::move(accept));
+}
+
+auto segment_service::accepted(async_context &ctx, const socket_dialog &socket)
+    -> void
+{
+  read_time_ = std::chrono::steady_clock::now();
+  if (!admit(socket))
+    return;
+
+  const auto &conn = get_connection(socket);
+  conn->zerocopy_capable = zerocopy_;
+  arm_idle(conn);
+#ifdef CB_SEGMENT_HAS_KTLS
+  if (options_.tls)
+  {
+    conn->encrypted = true;
+    conn->tls = std::make_unique<detail::tls_session>(*options_.tls,
+                                                      native_handle(socket));
+    return handshake(ctx, socket, conn);
+  }
+#endif
+  read(ctx, socket, conn);
+}
+
+auto segment_service::get_connection(const socket_dialog &socket)
+    -> const std::shared_ptr<connection> &
+{
+  auto &conn = connections_[native_handle(socket)];
+  if (!conn)
+  {
+    // Quickack mode is the only tuning option that is not inherited.
+    if (int enable = 1; options_.tuning.quickack)
+    {
+      io::setsockopt(*socket.socket, IPPROTO_TCP, TCP_QUICKACK, &enable,
+                     sizeof(enable));
+    }
+
+    conn = std::make_shared<connection>();
+    conn->socket = socket;
+    conn->timeout.owner = conn.get();
+    conn->memory =
+        std::make_shared<detail::memory_account>(options_.memory_budget);
+    conn->prefixed = detail::frame_parser(options_.max_frame_size);
+    conn->delimited = detail::delimiter_parser(
+        static_cast<std::byte>(options_.delimiter), options_.max_frame_size);
+  }
+
+  return conn;
+}
+
+auto segment_service::admit(const socket_dialog &socket) -> bool
+{
+  using detail::admission_control;
+
+  const auto handle = native_handle(socket);
+  // Only the per-source cap needs the peer address.
+  auto source = options_.max_connections_per_source
+                    ? admission_control::source(handle)
+                    : admission_control::source_type{};
+  if (*admission_ && !admission_->admit(source))
+  {
+    detail::metrics::local().add(detail::metrics::counter::rejected);
+    ::shutdown(handle, SHUT_RDWR);
+    return false;
+  }
+
+  const auto &conn = get_connection(socket);
+  conn->source = source;
+  conn->admitted = static_cast<bool>(*admission_);
+  conn->limiter = detail::rate_limiter(
+      options_.rate_limit_bytes, options_.rate_limit_messages,
+      options_.rate_limit_burst, read_time_);
+  return true;
+}
+
+auto segment_service::forward(async_context &ctx,
+                             const socket_dialog &socket,
+                             const std::shared_ptr<connection> &conn)
+    -> std::shared_ptr<connection>
+{
+  if (conn->forwarded)
+    return conn->peer.lock();
+
+  if (options_.upstreams.empty() && !options_.routes)
+    return conn;
+
+  // Multiplexed connections pick an upstream connection per message.
+  if (options_.upstream_pool_size && options_.framing != framing_mode::none)
+  {
+    // The stream ids of a reactor are its shard modulo the number of
+    // shards, so that the replies find their way back to it.
+    const auto count = shards(options_);
+    const auto limit =
+        (std::numeric_limits<std::uint32_t>::max() - options_.shard) / count;
+    auto stream = std::uint32_t{0};
+    while (!stream || streams_.contains(stream))
+    {
+      next_stream_ = static_cast<std::uint32_t>(next_stream_ % limit + 1);
+      stream = static_cast<std::uint32_t>(next_stream_ * count +
+                                          options_.shard);
+    }
+
+    streams_[stream] = conn;
+    conn->stream = stream;
+    conn->forwarded = true;
+    return nullptr;
+  }
+
+  auto ring = options_.routes ? options_.routes->load() : nullptr;
+  auto upstreams = options_.upstreams.empty()
+                       ? ring->members()
+                       : std::span<const sockaddr_storage>(options_.upstreams);
+  if (upstreams.empty())
+    return nullptr;
+
+  auto peer = connect(ctx, upstreams[next_upstream_++ % upstreams.size()]);
+  peer->peer = conn;
+  peer->forwarded = true;
+  conn->peer = peer;
+  conn->forwarded = true;
+
+  return peer;
+}
+
+auto segment_service::multiplex(async_context &ctx,
+                               const socket_dialog &socket,
+                               const std::shared_ptr<connection> &conn,
+                               const std::shared_ptr<read_context> &rctx,
+                               std::span<const std::byte> buf) -> void
+{
+  using header_type = detail::mux_frame::header_type;
+
+  const auto stages =
+      detail::stage_context{.limiter = conn->limiter, .now = read_time_};
+  // A message for a pooled connection of another reactor is handed over.
+  auto route = [&](auto &&next, detail::write_queue::owner_type owner,
+                   const detail::frame_view &frame) {
+    auto slot = select_slot(conn->stream, frame);
+    if (!slot ||
+        handoff(*slot % shards(options_), conn->stream, owner, frame, false))
+    {
+      return;
+    }
+    next(select_upstream(ctx, *slot), std::move(owner), frame);
+  };
+
+  // Multiplexed messages are sent behind a header with their stream id.
+  auto send = [&](auto && /*next*/,
+                  const std::shared_ptr<connection> &upstream,
+                  detail::write_queue::owner_type owner,
+                  const detail::frame_view &frame) {
+    auto header = std::allocate_shared<header_type>(
+        detail::pool_allocator<header_type>{},
+        detail::mux_frame::header(conn->stream, frame.size()));
+    upstream->queue.push(header, *header, read_time_);
+    upstream->queue.push_frame(std::move(owner), frame);
+    conn->peer = upstream;
+
+    if (!upstream->sending)
+      flush(ctx, *upstream->socket, upstream);
+  };
+
+  auto owner = lease(conn, rctx);
+  auto error = std::visit(
+      [&](auto path) -> std::error_code {
+        if (options_.framing == framing_mode::length_prefixed)
+        {
+          return path.compose(stages, detail::framing_stage(conn->prefixed),
+                              route, send)(owner, buf);
+        }
+        return path.compose(stages, detail::framing_stage(conn->delimited),
+                            route, send)(owner, buf);
+      },
+      path_);
+  if (error)
+    return drop_connection(socket, conn);
+
+  conn->reading = false;
+  read(ctx, socket, conn);
+}
+
+auto segment_service::select_slot(std::uint32_t stream,
+                                 const detail::frame_view &frame)
+    -> std::optional<std::size_t>
+{
+  const auto size = options_.upstream_pool_size;
+  // The stream ids of a reactor only differ in their quotient.
+  const auto index = stream / shards(options_) % size;
+
+  if (options_.routes)
+  {
+    // Only a membership change takes a new snapshot of the routing table.
+    if (auto version = options_.routes->version(); version != ring_version_)
+    {
+      repool(options_.routes->load());
+      ring_version_ = version;
+    }
+
+    if (!ring_ || ring_->empty())
+      return std::nullopt;
+
+    auto key = options_.framing == framing_mode::length_prefixed
+                   ? detail::frame_parser::payload(frame)
+                   : frame;
+    auto left = options_.routing_key_size
+                    ? std::min(key.size(), options_.routing_key_size)
+                    : key.size();
+
+    // The key of a split message is hashed piece by piece.
+    auto hasher = detail::hash_ring::key_hasher{};
+    auto take = [&](std::span<const std::byte> piece) {
+      auto len = std::min(left, piece.size());
+      hasher.update(piece.first(len));
+      left -= len;
+    };
+    take(key.head());
+    for (const auto &piece : key.tail())
+      take(piece.buf);
+
+    return ring_->lookup(hasher.value()) * size + index;
+  }
+
+  if (pool_.empty())
+    pool_.resize(size);
+
+  return index;
+}
+
+auto segment_service::select_upstream(async_context &ctx, std::size_t slot)
+    -> std::shared_ptr<connection>
+{
+  const auto &address =
+      options_.routes
+          ? ring_->members()[slot / options_.upstream_pool_size]
+          : options_.upstreams[slot % options_.upstreams.size()];
+
+  auto &upstream = pool_[slot];
+  if (!upstream || upstream->closed)
+  {
+    upstream = connect(ctx, address);
+    upstream->pooled = true;
+    upstream->prefixed = detail::frame_parser(
+        options_.max_frame_size + detail::mux_frame::header_size,
+        detail::mux_frame::header_size);
+  }
+
+  return upstream;
+}
+
+auto segment_service::repool(std::shared_ptr<const detail::hash_ring> ring)
+    -> void
+{
+  const auto size = options_.upstream_pool_size;
+  auto pool = std::vector<std::shared_ptr<connection>>(
+      ring ? ring->members().size() * size : 0);
+
+  // Connections to members that are still in the ring are kept, the
+  // others are retired.
+  for (std::size_t i = 0; ring_ && i < ring_->members().size(); ++i)
+  {
+    auto member = ring ? ring->find(ring_->members()[i]) : std::nullopt;
+    for (std::size_t j = 0; j < size; ++j)
+    {
+      auto &upstream = pool_[i * size + j];
+      if (!upstream)
+        continue;
+
+      if (member)
+        pool[*member * size + j] = std::move(upstream);
+      else
+        retire(upstream);
+    }
+  }
+
+  pool_ = std::move(pool);
+  ring_ = std::move(ring);
+}
+
+auto segment_service::retire(const std::shared_ptr<connection> &conn) -> void
+{
+  // Shutting down the write side tells the upstream peer to close the
+  // connection once it has replied to everything it has read.
+  conn->retired = true;
+  if (!conn->closed && !conn->sending && conn->queue.empty())
+    ::shutdown(native_handle(*conn->socket), SHUT_WR);
+}
+
+auto segment_service::connect(async_context &ctx,
+                              const sockaddr_storage &upstream)
+    -> std::shared_ptr<connection>
+{
+  using namespace stdexec;
+
+  auto address = socket_address<sockaddr_storage>{};
+  *address.operator->() = upstream;
+
+  auto dialog = ctx.poller.emplace(
+      socket_handle(upstream.ss_family, SOCK_STREAM,
+                    upstream.ss_family == AF_UNIX ? 0 : IPPROTO_TCP));
+  // Upstream sockets have no listening socket to inherit options from.
+  std::ignore = options_.tuning.apply_connection(native_handle(dialog));
+  // Kernel TLS does not support zerocopy sends. Without SO_ZEROCOPY the
+  // kernel copies MSG_ZEROCOPY sends and never completes them.
+  auto zerocopy = false;
+  if (options_.zerocopy_threshold && upstream.ss_family != AF_UNIX &&
+      !options_.upstream_tls)
+  {
+    int enable = 1;
+    zerocopy = !io::setsockopt(*dialog.socket, SOL_SOCKET, SO_ZEROCOPY,
+                               &enable, sizeof(enable));
+  }
+  if (int usecs = static_cast<int>(options_.busy_poll_usecs))
+  {
+    io::setsockopt(*dialog.socket, SOL_SOCKET, SO_BUSY_POLL, &usecs,
+                   sizeof(usecs));
+  }
+
+  auto peer = get_connection(dialog);
+  peer->outbound = true;
+  peer->zerocopy_capable = zerocopy;
+
+  // Hold back writes to the upstream peer until it is connected.
+  peer->sending = true;
+
+  sender auto connecting =
+      io::connect(dialog, address) |
+      then([&, dialog, peer](auto &&...) {
+        if (peer->closed || (!peer->pooled && peer->peer.expired()))
+        {
+          peer->sending = false;
+          return drop_connection(dialog, peer);
+        }
+
+#ifdef CB_SEGMENT_HAS_KTLS
+        if (options_.upstream_tls)
+        {
+          peer->encrypted = true;
+          peer->tls = std::make_unique<detail::tls_session>(
+              *options_.upstream_tls, native_handle(dialog));
+          return handshake(ctx, dialog, peer);
+        }
+#endif
+        established(ctx, dialog, peer);
+      }) |
+      upon_error([&, dialog, peer](auto &&error) {
+        detail::metrics::local().add(detail::metrics::counter::errors);
+        peer->sending = false;
+        peer->queue.clear();
+        drop_connection(dialog, peer);
+      });
+
+  ctx.scope.spawn(std::move(connecting));
+  return peer;
+}
+
+auto segment_service::established(async_context &ctx,
+                                  const socket_dialog &socket,
+                                  const std::shared_ptr<connection> &conn)
+    -> void
+{
+  conn->sending = false;
+  if (!conn->queue.empty())
+    flush(ctx, socket, conn);
+  else
+    resume(ctx, socket, conn);
+
+  read(ctx, socket, conn);
+}
+
+#ifdef CB_SEGMENT_HAS_KTLS
+auto segment_service::handshake(async_context &ctx,
+                                const socket_dialog &socket,
+                                const std::shared_ptr<connection> &conn)
+    -> void
+{
+  using namespace stdexec;
+  using enum detail::tls_session::status;
+
+  auto status = conn->tls->handshake();
+  if (status == done)
+  {
+    // The kTLS socket is read and written like any other from here on.
+    conn->tls.reset();
+    return established(ctx, socket, conn);
+  }
+
+  // A fresh socket has room for the handshake messages, so a handshake
+  // that cannot write has failed.
+  if (status != want_read)
+  {
+    detail::metrics::local().add(detail::metrics::counter::errors);
+    conn->sending = false;
+    conn->queue.clear();
+    return drop_connection(socket, conn);
+  }
+
+  auto msg = socket_message{};
+  msg.buffers.push_back(std::span(conn->peek));
+  conn->reading = true;
+
+  sender auto peek =
+      io::recvmsg(socket, msg, MSG_PEEK) |
+      then([&, socket, conn](auto &&len) {
+        conn->reading = false;
+        if (!len || conn->closed ||
+            (conn->outbound && !conn->pooled && conn->peer.expired()))
+        {
+          conn->sending = false;
+          conn->queue.clear();
+          return drop_connection(socket, conn);
+        }
+        handshake(ctx, socket, conn);
+      }) |
+      upon_error([&, socket, conn](auto &&error) {
+        detail::metrics::local().add(detail::metrics::counter::errors);
+        conn->reading = false;
+        conn->sending = false;
+        conn->queue.clear();
+        drop_connection(socket, conn);
+      });
+
+  ctx.scope.spawn(std::move(peek));
+}
+#endif
+
+auto segment_service::demux(async_context &ctx, const socket_dialog &socket,
+                            const std::shared_ptr<connection> &conn,
+                            const std::shared_ptr<read_context> &rctx,
+                            std::span<const std::byte> buf) -> void
+{
+  const auto shared = lease(conn, rctx);
+  for (const auto &frame : conn->prefixed.parse(buf, shared))
+  {
+    auto mux = detail::mux_frame::parse(frame);
+    if (!mux)
+      continue;
+
+    // The replies to the streams of other reactors are handed back.
+    auto owner = detail::write_queue::owner_type(conn->prefixed.owner());
+    if (!owner)
+      owner = shared;
+    if (handoff(mux->stream % shards(options_), mux->stream, owner,
+                mux->payload, true))
+    {
+      detail::metrics::local().add(detail::metrics::counter::messages);
+      continue;
+    }
+
+    // Replies to streams that have already been dropped are discarded.
+    auto it = streams_.find(mux->stream);
+    if (it == streams_.end())
+      continue;
+
+    auto downstream = it->second.lock();
+    if (!downstream || downstream->closed)
+      continue;
+
+    downstream->queue.push_frame(std::move(owner), mux->payload, read_time_);
+    detail::metrics::local().add(detail::metrics::counter::messages);
+    if (!downstream->sending)
+      flush(ctx, *downstream->socket, downstream);
+  }
+
+  if (conn->prefixed.error())
+    return drop_connection(socket, conn);
+
+  conn->reading = false;
+  read(ctx, socket, conn);
+}
+
+auto segment_service::handoff(std::size_t to, std::uint32_t stream,
+                              detail::write_queue::owner_type &owner,
+                              const detail::frame_view &frame, bool reply)
+    -> bool
+{
+  const auto &exchange = options_.exchange;
+  const auto pieces = frame.tail().size() + 1;
+  // A message that would never fit in a ring is handled here.
+  if (!exchange || to == options_.shard || pieces > exchange->capacity() ||
+      !doorbell_ || !exchange->attached(to))
+  {
+    return false;
+  }
+
+  auto &backlog = backlog_[to];
+  const auto waiting = !backlog.empty();
+  backlog.push_back({.owner = std::move(owner),
+                     .buf = frame.head(),
+                     .queued = read_time_,
+                     .stream = stream,
+                     .pieces = static_cast<std::uint32_t>(pieces),
+                     .reply = reply});
+  for (const auto &piece : frame.tail())
+    backlog.push_back({.owner = piece.owner, .buf = piece.buf});
+
+  // Messages must not overtake the ones that are still waiting for room.
+  if (!waiting && exchange->send(options_.shard, to, backlog))
+    backlog.clear();
+
+  detail::metrics::local().add(detail::metrics::counter::handoffs);
+  return true;
+}
+
+auto segment_service::deliver(async_context &ctx,
+                              std::span<detail::shard_message> pieces)
+    -> void
+{
+  using header_type = detail::mux_frame::header_type;
+
+  auto &head = pieces.front();
+  auto size = head.buf.size();
+  auto tail = std::vector<detail::frame_view::segment>{};
+  for (auto &piece : pieces.subspan(1))
+  {
+    size += piece.buf.size();
+    tail.push_back({.owner = std::move(piece.owner), .buf = piece.buf});
+  }
+  auto frame = detail::frame_view(head.buf, tail, size);
+
+  // Replies to streams that have already been dropped are discarded.
+  if (head.reply)
+  {
+    auto it = streams_.find(head.stream);
+    if (it == streams_.end())
+      return;
+
+    auto downstream = it->second.lock();
+    if (!downstream || downstream->closed)
+      return;
+
+    downstream->queue.push_frame(std::move(head.owner), frame, head.queued);
+    if (!downstream->sending)
+      flush(ctx, *downstream->socket, downstream);
+    return;
+  }
+
+  // The routing table may have changed since the other reactor picked
+  // this one, in which case the message still goes out from here.
+  auto slot = select_slot(head.stream, frame);
+  if (!slot)
+    return;
+
+  auto upstream = select_upstream(ctx, *slot);
+  auto header = std::allocate_shared<header_type>(
+      detail::pool_allocator<header_type>{},
+      detail::mux_frame::header(head.stream, frame.size()));
+  upstream->queue.push(header, *header, head.queued);
+  upstream->queue.push_frame(std::move(head.owner), frame);
+  if (!upstream->sending)
+    flush(ctx, *upstream->socket, upstream);
+}
+
+auto segment_service::send_backlog(async_context &ctx) -> void
+{
+  auto waiting = false;
+  for (std::size_t to = 0; to < backlog_.size(); ++to)
+  {
+    auto &backlog = backlog_[to];
+    auto sent = std::size_t{0};
+    while (sent < backlog.size())
+    {
+      auto pieces = std::span(backlog).subspan(sent, backlog[sent].pieces);
+      if (!options_.exchange->send(options_.shard, to, pieces))
+        break;
+      sent += pieces.size();
+    }
+
+    backlog.erase(backlog.begin(),
+                  backlog.begin() + static_cast<std::ptrdiff_t>(sent));
+    waiting = waiting || !backlog.empty();
+  }
+
+  if (waiting)
+    return;
+
+  for (const auto &weak : std::exchange(handing_, {}))
+  {
+    if (auto conn = weak.lock(); conn && !conn->closed)
+      read(ctx, *conn->socket, conn);
+  }
+}
+
+auto segment_service::lease(const std::shared_ptr<connection> &conn,
+                            const std::shared_ptr<read_context> &rctx)
+    -> detail::write_queue::owner_type
+{
+  using lease_type = std::shared_ptr<read_context>;
+
+  if (!conn->lease || *conn->lease != rctx)
+  {
+    conn->lease = std::allocate_shared<lease_type>(
+        detail::pool_allocator<lease_type>{}, rctx);
+  }
+
+  return conn->lease;
+}
+
+auto segment_service::drop_connection(const socket_dialog &socket,
+                                      const std::shared_ptr<connection> &conn)
+    -> void
+{
+  auto it = connections_.find(native_handle(socket));
+  if (it == connections_.end() || (conn && it->second != conn))
+    return;
+
+  auto dropped = std::move(it->second);
+  connections_.erase(it);
+  dropped->closed = true;
+  if (timers_)
+    timers_->cancel(dropped->timeout);
+
+  if (dropped->admitted)
+    admission_->release(dropped->source);
+
+  if (dropped->stream)
+    streams_.erase(dropped->stream);
+
+  // The streams of a pooled upstream connection are dropped with it,
+  // unless it was retired and its streams have moved on. The streams of
+  // other reactors that were handed to it time out instead.
+  if (dropped->pooled && !dropped->retired)
+  {
+    auto streams = std::vector<std::shared_ptr<connection>>{};
+    for (const auto &[id, stream] : streams_)
+    {
+      if (auto downstream = stream.lock();
+          downstream && downstream->peer.lock() == dropped)
+      {
+        streams.push_back(std::move(downstream));
+      }
+    }
+
+    for (const auto &downstream : streams)
+      drop_connection(*downstream->socket, downstream);
+  }
+
+  if (dropped->forwarded)
+  {
+    // Wake up any read that is still posted on the socket, queued writes
+    // are still sent.
+    ::shutdown(native_handle(socket), SHUT_RD);
+
+    auto peer = dropped->peer.lock();
+    if (!dropped->stream && peer && !peer->closed)
+      drop_connection(*peer->socket, peer);
+  }
+}
+
+auto segment_service::resume(async_context &ctx, const socket_dialog &socket,
+                             const std::shared_ptr<connection> &conn) -> void
+{
+  if (conn->pooled)
+  {
+    for (const auto &waiter : std::exchange(conn->waiters, {}))
+    {
+      if (auto source = waiter.lock())
+        read(ctx, *source->socket, source);
+    }
+  }
+  else if (!conn->forwarded)
+  {
+    read(ctx, socket, conn);
+  }
+  else if (auto source = conn->peer.lock())
+  {
+    read(ctx, *source->socket, source);
+  }
+}
+
+auto segment_service::flush(async_context &ctx, const socket_dialog &socket,
+                            const std::shared_ptr<connection> &conn) -> void
+{
+  using namespace stdexec;
+  using buffer_type = detail::write_queue::buffer_type;
+
+  auto buffers = std::array<buffer_type, detail::write_queue::max_buffers>{};
+  auto limit = std::clamp<std::size_t>(options_.max_send_buffers, 1,
+                                       buffers.size());
+
+  auto msg = socket_message{};
+  auto bytes = std::size_t{0};
+  auto count = conn->queue.gather(std::span(buffers).first(limit));
+  for (const auto &buf : std::span(buffers).first(count))
+  {
+    msg.buffers.push_back(buf);
+    bytes += buf.size();
+  }
+
+  // Cork the write if the rest of the queue follows immediately.
+  auto flags = conn->queue.size() > count ? MSG_MORE : 0;
+  auto zerocopy = conn->zerocopy_capable && !conn->encrypted &&
+                  bytes >= options_.zerocopy_threshold;
+  if (zerocopy)
+    flags |= MSG_ZEROCOPY;
+  conn->sending = true;
+  arm_timeout(*conn);
+
+  // The latency of a burst is measured from the receipt of its first
+  // bytes, which may have been read by another reactor or spliced.
+  if (conn->queued_at == std::chrono::steady_clock::time_point{})
+  {
+    conn->queued_at = conn->queue.oldest();
+    if (conn->queued_at == std::chrono::steady_clock::time_point{})
+      conn->queued_at = read_time_;
+  }
+  detail::metrics::local().add(detail::metrics::counter::sendmsg_calls);
+  detail::trace::emit(detail::trace::event::send_submit, native_handle(socket),
+                      bytes);
+
+  sender auto sendmsg =
+      io::sendmsg(socket, msg, flags) |
+      then([&, socket, conn, zerocopy, bytes](auto &&len) {
+        auto written = static_cast<std::size_t>(len);
+
+        auto &stats = detail::metrics::local();
+        stats.add(detail::metrics::counter::bytes_written, written);
+        detail::trace::emit(detail::trace::event::send_complete,
+                            native_handle(socket), written);
+        if (written < bytes)
+        {
+          stats.add(detail::metrics::counter::short_writes);
+          detail::trace::emit(detail::trace::event::short_write,
+                              native_handle(socket), bytes - written);
+        }
+
+        // A short write leaves the unwritten tail at the front of the queue.
+        if (zerocopy && written)
+        {
+          auto owners = std::vector<detail::write_queue::owner_type>{};
+          conn->queue.consume(written, owners);
+          conn->zerocopy.push(std::move(owners));
+        }
+        else
+        {
+          conn->queue.consume(written);
+        }
+        conn->sending = false;
+        arm_timeout(*conn);
+
+        if (conn->zerocopy.pending())
+          conn->zerocopy.reap(native_handle(socket));
+
+        // The kernel may release the buffers long after the send, so the
+        // reactor reaps them on its ticks until it has.
+        if (conn->zerocopy.pending() && !std::exchange(conn->reaping, true))
+          reaping_.push_back(conn);
+
+        // Messages that waited behind the send past their deadline are
+        // dropped. The reads of an unframed stream cannot be dropped
+        // without corrupting it, so the connection is closed instead.
+        if (auto deadline = options_.message_deadline;
+            deadline.count() && !conn->queue.empty())
+        {
+          auto cutoff = std::chrono::steady_clock::now() - deadline;
+          if (options_.framing != framing_mode::none)
+          {
+            stats.add(detail::metrics::counter::expired,
+                      conn->queue.expire(cutoff));
+          }
+          else if (auto oldest = conn->queue.oldest();
+                   oldest != std::chrono::steady_clock::time_point{} &&
+                   oldest <= cutoff)
+          {
+            stats.add(detail::metrics::counter::expired, conn->queue.size());
+            conn->queue.clear();
+            ::shutdown(native_handle(socket), SHUT_RDWR);
+            return drop_connection(socket, conn);
+          }
+        }
+
+        if (!conn->queue.empty())
+        {
+          flush(ctx, socket, conn);
+        }
+        else
+        {
+          stats.record(std::chrono::steady_clock::now() -
+                       std::exchange(conn->queued_at, {}));
+          if (conn->retired)
+            retire(conn);
+        }
+
+        resume(ctx, socket, conn);
+      }) |
+      upon_error([&, socket, conn](auto &&error) {
+        detail::metrics::local().add(detail::metrics::counter::errors);
+        conn->queue.clear();
+        drop_connection(socket, conn);
+      });
+
+  ctx.scope.spawn(std::move(sendmsg));
+}
+
+auto segment_service::read(async_context &ctx, const socket_dialog &socket,
+                           const std::shared_ptr<connection> &conn) -> void
+{
+  if (conn->closed || conn->reading || conn->eof)
+    return;
+
+  // A draining reactor only reads the replies of its upstream peers.
+  if (!conn->outbound && options_.ticker && options_.ticker->draining())
+    return;
+
+  // A pooled upstream connection always reads, its replies go to many
+  // downstream connections.
+  if (conn->pooled)
+    return await_input(ctx, socket, conn);
+
+  // A multiplexed connection waits for the messages that it has handed to
+  // other reactors to fit in their rings.
+  if (conn->stream && std::ranges::any_of(backlog_, [](const auto &backlog) {
+        return !backlog.empty();
+      }))
+  {
+    handing_.push_back(conn);
+    return;
+  }
+
+  // A multiplexed connection may not have sent anything upstream yet.
+  auto target = conn->forwarded ? conn->peer.lock() : conn;
+  if (!target && !conn->stream)
+    return;
+
+  // Over the memory budget, connections only read once the bytes that
+  // they hold have been written, which is what releases the memory.
+  auto exhausted =
+      options_.memory_budget && options_.memory_budget->exhausted();
+  if (target && !target->queue.empty() &&
+      (!options_.pipeline || exhausted ||
+       target->queue.bytes() >= options_.max_outstanding_bytes))
+  {
+    if (target->pooled)
+      target->waiters.push_back(conn);
+    return;
+  }
+
+  // Completions that arrived since the last send release their buffers.
+  if (target && target->zerocopy.pending())
+    target->zerocopy.reap(native_handle(*target->socket));
+
+  // The read buffers of a multiplexed connection are queued on the pooled
+  // connections, and those of a zerocopy send are held by the kernel.
+  // Neither wakes the connection up when it lets go of them, so over the
+  // memory budget it tries again on a later tick.
+  if (exhausted && ((conn->stream && conn->lease.use_count() > 1) ||
+                    (target && target->zerocopy.pending())))
+  {
+    if (!std::exchange(conn->throttled, true))
+      throttled_.push_back(conn);
+    return;
+  }
+
+  // A connection over its rate limits reads again on a later tick, once
+  // the limits have refilled. The messages that it has already sent are
+  // delayed rather than dropped.
+  if (conn->limiter && !conn->limiter.ready(std::chrono::steady_clock::now()))
+  {
+    if (!std::exchange(conn->throttled, true))
+    {
+      detail::metrics::local().add(detail::metrics::counter::throttled);
+      throttled_.push_back(conn);
+    }
+    return;
+  }
+
+  if (conn->forwarded && options_.framing == framing_mode::none)
+  {
+    if (!conn->pipe)
+      conn->pipe = std::make_unique<detail::splice_pipe>();
+
+    // Spliced bytes must not overtake the bytes that are still queued.
+    if (*conn->pipe)
+    {
+      if (target->queue.empty() && !target->sending)
+        splice(ctx, socket, conn);
+      return;
+    }
+  }
+
+  await_input(ctx, socket, conn);
+}
+
+auto segment_service::await_input(async_context &ctx,
+                                  const socket_dialog &socket,
+                                  const std::shared_ptr<connection> &conn)
+    -> void
+{
+  using namespace stdexec;
+
+  // Whatever still holds bytes of the previous read buffer keeps it
+  // alive, the connection itself lets go of it.
+  conn->rctx.reset();
+  if (conn->lease.use_count() == 1)
+    conn->lease.reset();
+
+  conn->reading = true;
+
+  // The last read filled its buffer, so more input is most likely
+  // waiting already and the peek would only cost another syscall.
+  if (conn->busy)
+  {
+    conn->rctx = std::allocate_shared<read_context>(
+        detail::pool_allocator<read_context>{}, conn->sizer.size(),
+        conn->memory);
+    return receive(ctx, socket, conn);
+  }
+
+  auto msg = socket_message{};
+  msg.buffers.push_back(std::span(conn->peek));
+
+  sender auto peek =
+      io::recvmsg(socket, msg, MSG_PEEK) |
+      then([&, socket, conn](auto && /*len*/) {
+        if (conn->closed)
+        {
+          conn->reading = false;
+          return;
+        }
+
+        // The end of the input is read, and reported, by the recv too.
+        conn->rctx = std::allocate_shared<read_context>(
+            detail::pool_allocator<read_context>{}, conn->sizer.size(),
+            conn->memory);
+        receive(ctx, socket, conn);
+      }) |
+      upon_error([&, socket, conn](auto &&error) {
+        detail::metrics::local().add(detail::metrics::counter::errors);
+        conn->reading = false;
+        drop_connection(socket, conn);
+      });
+
+  ctx.scope.spawn(std::move(peek));
+}
+
+auto segment_service::receive(async_context &ctx,
+                              const socket_dialog &socket,
+                              const std::shared_ptr<connection> &conn) -> void
+{
+  using namespace stdexec;
+
+  auto msg = socket_message{};
+  msg.buffers.push_back(conn->rctx->buffer);
+
+  sender auto recv =
+      io::recvmsg(socket, msg, 0) |
+      then([&, socket, conn](auto &&len) {
+        auto size = static_cast<std::size_t>(len);
+        auto rctx = std::move(conn->rctx);
+        conn->busy = size == rctx->buffer.size();
+        if (!size)
+        {
+          conn->reading = false;
+          return (*this)(ctx, socket, nullptr, {});
+        }
+
+        conn->sizer.record(size, rctx->buffer.size());
+        (*this)(ctx, socket, rctx, rctx->buffer.first(size));
+      }) |
+      upon_error([&, socket, conn](auto &&error) {
+        detail::metrics::local().add(detail::metrics::counter::errors);
+        conn->reading = false;
+        conn->rctx.reset();
+        drop_connection(socket, conn);
+      });
+
+  ctx.scope.spawn(std::move(recv));
+}
+
+auto segment_service::splice(async_context &ctx, const socket_dialog &socket,
+                             const std::shared_ptr<connection> &conn) -> void
+{
+  using namespace stdexec;
+
+  auto msg = socket_message{};
+  msg.buffers.push_back(std::span(conn->peek));
+  conn->reading = true;
+
+  sender auto peek =
+      io::recvmsg(socket, msg, MSG_PEEK) |
+      then([&, socket, conn](auto &&len) {
+        auto received = std::chrono::steady_clock::now();
+        conn->reading = false;
+
+        auto peer = conn->peer.lock();
+        if (conn->closed || !peer)
+          return;
+
+        if (len)
+          arm_idle(conn);
+
+        if (len && conn->pipe->transfer(native_handle(socket),
+                                        native_handle(*peer->socket)))
+        {
+          return drop_connection(socket, conn);
+        }
+
+        // The peer can't take any more bytes right now, so the rest is
+        // written through its output queue.
+        if (auto size = conn->pipe->size())
+        {
+          // Charged like a read buffer, since it holds read bytes too.
+          auto rctx = std::allocate_shared<read_context>(
+              detail::pool_allocator<read_context>{}, size, conn->memory);
+          auto buf = rctx->buffer.first(conn->pipe->read(rctx->buffer));
+          peer->queue.push(rctx, buf, received);
+
+          if (!peer->sending)
+            flush(ctx, *peer->socket, peer);
+        }
+
+        // A half-close is passed on to the peer once it has written
+        // everything, the peer may still reply until its input ends too.
+        if (!len || conn->pipe->eof())
+        {
+          conn->eof = true;
+          if (peer->eof)
+            return drop_connection(socket, conn);
+
+          return retire(peer);
+        }
+
+        read(ctx, socket, conn);
+      }) |
+      upon_error([&, socket, conn](auto &&error) {
+        detail::metrics::local().add(detail::metrics::counter::errors);
+        conn->reading = false;
+        drop_connection(socket, conn);
+      });
+
+  ctx.scope.spawn(std::move(peek));
+}
+
+auto segment_service::start_ticks(async_context &ctx) -> void
+{
+  timers_ = std::make_unique<detail::timer_wheel>();
+  if (!options_.ticker)
+    options_.ticker = std::make_shared<detail::ticker>();
+
+  auto dialog = ctx.poller.emplace(socket_handle(AF_UNIX, SOCK_DGRAM, 0));
+  if (options_.ticker->subscribe(native_handle(dialog), subscription_))
+  {
+    detail::metrics::local().add(detail::metrics::counter::errors);
+    return;
+  }
+
+  ticks_ = dialog;
+  await_tick(ctx);
+}
+
+auto segment_service::await_tick(async_context &ctx) -> void
+{
+  using namespace stdexec;
+
+  auto msg = socket_message{};
+  msg.buffers.push_back(std::span(tick_));
+
+  sender auto recv = io::recvmsg(*ticks_, msg, 0) |
+                     then([&](auto && /*len*/) {
+                       tick(ctx);
+                       await_tick(ctx);
+                     }) |
+                     upon_error([&](auto && /*error*/) {
+                       detail::metrics::local().add(
+                           detail::metrics::counter::errors);
+                     });
+
+  ctx.scope.spawn(std::move(recv));
+}
+
+auto segment_service::tick(async_context &ctx) -> void
+{
+  timers_->advance(std::chrono::steady_clock::now(),
+                   [&](detail::timer_wheel::timer &timer) {
+                     expire(*static_cast<connection *>(timer.owner));
+                   });
+
+  // Idle connections would otherwise hold on to the buffers of their
+  // last zerocopy sends until they send again.
+  std::erase_if(reaping_, [&](const std::weak_ptr<connection> &weak) {
+    auto conn = weak.lock();
+    if (!conn || conn->closed)
+      return true;
+
+    conn->zerocopy.reap(native_handle(*conn->socket));
+    conn->reaping = conn->zerocopy.pending() != 0;
+    return !conn->reaping;
+  });
+
+  // Throttled streams try again, and wait for another tick if their
+  // limits have not refilled yet.
+  for (const auto &weak : std::exchange(throttled_, {}))
+  {
+    if (auto conn = weak.lock(); conn && !conn->closed)
+    {
+      conn->throttled = false;
+      read(ctx, *conn->socket, conn);
+    }
+  }
+
+  send_backlog(ctx);
+
+  if (!accepting_ && listening_ &&
+      listener_.load(std::memory_order_acquire) >= 0)
+  {
+    accept(ctx, *listening_);
+  }
+
+  // A draining reactor stops listening, so that the kernel hashes new
+  // connections to the other sockets of the SO_REUSEPORT group. The
+  // listening socket is never shared with another segment, since the
+  // epoll data path does not hand it off. The connections that it has
+  // already accepted are still served, and it has drained once nothing
+  // is left to write.
+  if (!options_.ticker->draining())
+    return;
+
+  if (int fd = listener_.exchange(-1, std::memory_order_acq_rel); fd >= 0)
+    ::shutdown(fd, SHUT_RD);
+
+  auto handing = std::ranges::any_of(
+      backlog_, [](const auto &backlog) { return !backlog.empty(); });
+  if (doorbell_ && options_.exchange->pending(options_.shard))
+    handing = true;
+
+  if (!handing && std::ranges::all_of(connections_, [](const auto &entry) {
+        const auto &[handle, conn] = entry;
+        return conn->queue.empty() && !conn->sending;
+      }))
+  {
+    options_.ticker->drained(subscription_);
+  }
+}
+
+auto segment_service::start_exchange(async_context &ctx) -> void
+{
+  const auto &exchange = options_.exchange;
+  if (options_.shard >= exchange->shards())
+  {
+    detail::metrics::local().add(detail::metrics::counter::errors);
+    return;
+  }
+
+  backlog_.resize(exchange->shards());
+  auto dialog = ctx.poller.emplace(socket_handle(AF_UNIX, SOCK_DGRAM, 0));
+  if (exchange->attach(options_.shard, native_handle(dialog)))
+  {
+    detail::metrics::local().add(detail::metrics::counter::errors);
+    return;
+  }
+
+  doorbell_ = dialog;
+  await_handoff(ctx);
+}
+
+auto segment_service::await_handoff(async_context &ctx) -> void
+{
+  using namespace stdexec;
+
+  // The pieces of a message are sent together, so they are received one
+  // after the other. The reactor parks once there is nothing left, so
+  // that the next message rings the doorbell.
+  auto &exchange = *options_.exchange;
+  do
+  {
+    exchange.receive(options_.shard, [&](detail::shard_message &&piece) {
+      received_.push_back(std::move(piece));
+      if (received_.size() < received_.front().pieces)
+        return;
+
+      deliver(ctx, received_);
+      received_.clear();
+    });
+  } while (!exchange.park(options_.shard));
+
+  send_backlog(ctx);
+
+  auto msg = socket_message{};
+  msg.buffers.push_back(std::span(bell_));
+
+  sender auto recv = io::recvmsg(*doorbell_, msg, 0) |
+                     then([&](auto && /*len*/) { await_handoff(ctx); }) |
+                     upon_error([&](auto && /*error*/) {
+                       detail::metrics::local().add(
+                           detail::metrics::counter::errors);
+                     });
+
+  ctx.scope.spawn(std::move(recv));
+}
+
+auto segment_service::arm_idle(const std::shared_ptr<connection> &conn)
+    -> void
+{
+  if (!conn->sending)
+    arm_timeout(*conn);
+
+  if (auto peer = conn->forwarded ? conn->peer.lock() : nullptr;
+      peer && !peer->sending)
+  {
+    arm_timeout(*peer);
+  }
+}
+
+auto segment_service::arm_timeout(connection &conn) -> void
+{
+  if (!timers_)
+    return;
+
+  auto timeout =
+      conn.sending ? options_.write_timeout : options_.idle_timeout;
+  if (timeout.count() && !conn.closed)
+  {
+    timers_->schedule(conn.timeout,
+                      std::chrono::steady_clock::now() + timeout);
+  }
+  else
+  {
+    timers_->cancel(conn.timeout);
+  }
+}
+
+auto segment_service::expire(connection &conn) -> void
+{
+  detail::metrics::local().add(detail::metrics::counter::timeouts);
+  // Shutting down both directions fails a send that the peer does not
+  // read and ends the read that is posted on the socket. The dialog is
+  // copied since dropping the connection may destroy it.
+  auto socket = *conn.socket;
+  ::shutdown(native_handle(socket), SHUT_RDWR);
+  drop_connection(socket);
 }
 } // namespace cloudbus::segment
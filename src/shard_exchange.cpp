@@ -0,0 +1,135 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file shard_exchange.cpp
+ * @brief This file defines the handoff of messages between reactors.
+ */
+#include "segment/detail/shard_exchange.hpp"
+
+#include <cerrno>
+
+#include <unistd.h>
+namespace cloudbus::detail {
+
+shard_exchange::shard_exchange(std::size_t shards, std::size_t capacity)
+    : shards_{shards},
+      sock_{::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)},
+      error_{sock_ < 0 ? errno : 0},
+      mailboxes_{std::make_unique<mailbox[]>(shards)}
+{
+  rings_.reserve(shards * shards);
+  for (std::size_t i = 0; i < shards * shards; ++i)
+    rings_.push_back(std::make_unique<spsc_ring<message_type>>(capacity));
+}
+
+shard_exchange::~shard_exchange()
+{
+  if (sock_ >= 0)
+    ::close(sock_);
+}
+
+auto shard_exchange::attach(std::size_t shard, int fd) -> std::error_code
+{
+  auto &box = mailboxes_[shard];
+  box.length = sizeof(box.address);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto *addr = reinterpret_cast<sockaddr *>(&box.address);
+  if (sock_ < 0)
+    return {error_, std::system_category()};
+  if (::getsockname(fd, addr, &box.length))
+    return {errno, std::system_category()};
+  if (box.address.sun_family != AF_UNIX)
+    return std::make_error_code(std::errc::address_family_not_supported);
+
+  // An address of just the family autobinds a unique abstract name.
+  if (box.length <= sizeof(sa_family_t))
+  {
+    box.address = {.sun_family = AF_UNIX, .sun_path = {}};
+    if (::bind(fd, addr, sizeof(sa_family_t)))
+      return {errno, std::system_category()};
+
+    box.length = sizeof(box.address);
+    if (::getsockname(fd, addr, &box.length))
+      return {errno, std::system_category()};
+  }
+
+  box.attached.store(true, std::memory_order_release);
+  return {};
+}
+
+auto shard_exchange::attached(std::size_t shard) const noexcept -> bool
+{
+  return mailboxes_[shard].attached.load(std::memory_order_acquire);
+}
+
+auto shard_exchange::send(std::size_t from, std::size_t to,
+                          std::span<message_type> pieces) noexcept -> bool
+{
+  if (!ring(from, to).try_push(pieces))
+    return false;
+
+  // Pairs with the fence in park(): either the receiver sees the message
+  // when it checks its rings, or the sender sees that it is parked.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  auto &box = mailboxes_[to];
+  if (box.parked.load(std::memory_order_relaxed) &&
+      box.parked.exchange(false, std::memory_order_relaxed))
+  {
+    static constexpr auto ring = std::byte{1};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto *addr = reinterpret_cast<const sockaddr *>(&box.address);
+    // A full receive buffer already holds a wakeup, so EAGAIN is not an
+    // error.
+    while (::sendto(sock_, &ring, sizeof(ring), MSG_DONTWAIT, addr,
+                    box.length) < 0 &&
+           errno == EINTR)
+      ;
+  }
+  return true;
+}
+
+auto shard_exchange::park(std::size_t shard) noexcept -> bool
+{
+  auto &box = mailboxes_[shard];
+  box.parked.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (!pending(shard))
+    return true;
+
+  // A sender may have cleared the flag and rung the doorbell already, in
+  // which case the reactor is woken once more for nothing.
+  box.parked.store(false, std::memory_order_relaxed);
+  return false;
+}
+
+auto shard_exchange::pending(std::size_t shard) const noexcept -> bool
+{
+  for (std::size_t from = 0; from < shards_; ++from)
+  {
+    if (!rings_[(shard * shards_) + from]->empty())
+      return true;
+  }
+  return false;
+}
+
+auto shard_exchange::ring(std::size_t from, std::size_t to) noexcept
+    -> spsc_ring<message_type> &
+{
+  return *rings_[(to * shards_) + from];
+}
+} // namespace cloudbus::detail
@@ -0,0 +1,156 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file socket_tuning.cpp
+ * @brief This file defines the socket tuning profile of a segment.
+ */
+#include "segment/socket_tuning.hpp"
+
+#include <cerrno>
+#include <cstdint>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+namespace cloudbus::segment {
+namespace {
+/** @brief How a value that is read back is checked. */
+enum class readback : std::uint8_t {
+  /** @brief The value must be unchanged. */
+  exact,
+  /** @brief The value may be rounded up by the kernel. */
+  at_least,
+  /** @brief The kernel doubles the value for its bookkeeping. */
+  doubled,
+};
+
+/**
+ * @brief Sets an integer socket option and reads it back.
+ * @param sock The native socket handle.
+ * @param level The protocol level of the option.
+ * @param name The option name.
+ * @param value The value to set.
+ * @param check How the value that is read back is checked.
+ * @return An error code if the option could not be set, or
+ * `std::errc::result_out_of_range` if it reads back a different value.
+ */
+auto set_checked(int sock, int level, int name, int value,
+                 readback check) noexcept -> std::error_code
+{
+  if (::setsockopt(sock, level, name, &value, sizeof(value)))
+    return {errno, std::system_category()};
+
+  int actual = 0;
+  auto len = socklen_t{sizeof(actual)};
+  if (::getsockopt(sock, level, name, &actual, &len))
+    return {errno, std::system_category()};
+
+  auto expected = check == readback::doubled ? 2L * value : value;
+  auto applied = check == readback::exact ? actual == expected
+                                          : actual >= expected;
+  if (!applied)
+    return std::make_error_code(std::errc::result_out_of_range);
+
+  return {};
+}
+
+/**
+ * @brief Checks whether a socket is a TCP socket.
+ * @param sock The native socket handle.
+ * @return True if the TCP level options apply to the socket.
+ */
+auto is_tcp(int sock) noexcept -> bool
+{
+  int protocol = 0;
+  auto len = socklen_t{sizeof(protocol)};
+  return !::getsockopt(sock, SOL_SOCKET, SO_PROTOCOL, &protocol, &len) &&
+         protocol == IPPROTO_TCP;
+}
+
+/**
+ * @brief Applies the options that connected sockets share with the
+ * listening socket.
+ * @param tuning The tuning profile.
+ * @param sock The native socket handle.
+ * @param tcp Whether the socket is a TCP socket.
+ * @return The error of the first option that failed.
+ */
+auto apply_common(const socket_tuning &tuning, int sock,
+                  bool tcp) noexcept -> std::error_code
+{
+  using enum readback;
+  auto error = std::error_code{};
+
+  if (!error && tcp && tuning.nodelay)
+    error = set_checked(sock, IPPROTO_TCP, TCP_NODELAY, 1, at_least);
+
+  // Buffer sizes above the sysctl maximum are clamped before doubling.
+  if (!error && tuning.send_buffer > 0)
+    error = set_checked(sock, SOL_SOCKET, SO_SNDBUF, tuning.send_buffer,
+                        doubled);
+
+  if (!error && tuning.receive_buffer > 0)
+    error = set_checked(sock, SOL_SOCKET, SO_RCVBUF, tuning.receive_buffer,
+                        doubled);
+
+  if (!error && tcp && tuning.notsent_lowat > 0)
+    error = set_checked(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                        tuning.notsent_lowat, exact);
+
+  return error;
+}
+} // namespace
+
+auto socket_tuning::low_latency() noexcept -> socket_tuning
+{
+  return {.nodelay = true, .quickack = true, .notsent_lowat = 16 * 1024};
+}
+
+auto socket_tuning::apply_listener(int sock) const noexcept -> std::error_code
+{
+  using enum readback;
+  auto tcp = is_tcp(sock);
+  auto error = apply_common(*this, sock, tcp);
+
+  // The timeout is kept as a number of SYN-ACK retransmits, which rounds
+  // it up.
+  if (!error && tcp && defer_accept > 0)
+    error = set_checked(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, defer_accept,
+                        at_least);
+
+  if (!error && incoming_cpu >= 0)
+    error = set_checked(sock, SOL_SOCKET, SO_INCOMING_CPU, incoming_cpu, exact);
+
+  return error;
+}
+
+auto socket_tuning::apply_connection(int sock) const noexcept
+    -> std::error_code
+{
+  auto tcp = is_tcp(sock);
+  auto error = apply_common(*this, sock, tcp);
+
+  // Quickack mode does not stick, so it is not read back.
+  if (int enable = 1; !error && tcp && quickack &&
+                      ::setsockopt(sock, IPPROTO_TCP, TCP_QUICKACK, &enable,
+                                   sizeof(enable)))
+  {
+    error = {errno, std::system_category()};
+  }
+
+  return error;
+}
+} // namespace cloudbus::segment
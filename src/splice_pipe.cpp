@@ -0,0 +1,111 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file splice_pipe.cpp
+ * @brief This file defines the pipe for splicing between sockets.
+ */
+#include "segment/detail/splice_pipe.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+namespace cloudbus::detail {
+namespace {
+/** @brief The splice flags used for both ends of the pipe. */
+constexpr unsigned int splice_flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+/** @brief The most bytes requested from the source per splice. */
+constexpr std::size_t splice_size = 64UL * 1024UL;
+
+/**
+ * @brief Checks whether an error means that the call would block.
+ * @param error The errno value.
+ * @return True if the call would block.
+ */
+auto would_block(int error) noexcept -> bool
+{
+  return error == EAGAIN || error == EWOULDBLOCK;
+}
+} // namespace
+
+splice_pipe::splice_pipe() noexcept
+{
+  if (pipe2(fds_.data(), O_NONBLOCK | O_CLOEXEC))
+    fds_ = {-1, -1};
+}
+
+splice_pipe::~splice_pipe()
+{
+  for (auto fd : fds_)
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+}
+
+splice_pipe::operator bool() const noexcept { return fds_[0] >= 0; }
+
+auto splice_pipe::transfer(int in, int out) noexcept -> std::error_code
+{
+  for (;;)
+  {
+    // Drain the pipe before reading more so that the bytes stay in order.
+    while (size_)
+    {
+      auto len =
+          splice(fds_[0], nullptr, out, nullptr, size_, splice_flags);
+      if (len < 0)
+      {
+        if (would_block(errno))
+          return {};
+        return {errno, std::system_category()};
+      }
+      size_ -= static_cast<std::size_t>(len);
+    }
+
+    if (eof_)
+      return {};
+
+    auto len = splice(in, nullptr, fds_[1], nullptr, splice_size,
+                      splice_flags);
+    if (len < 0)
+    {
+      if (would_block(errno))
+        return {};
+      return {errno, std::system_category()};
+    }
+
+    if (!len)
+      eof_ = true;
+    size_ += static_cast<std::size_t>(len);
+  }
+}
+
+auto splice_pipe::read(std::span<std::byte> buf) noexcept -> std::size_t
+{
+  auto len = ::read(fds_[0], buf.data(), std::min(buf.size(), size_));
+  if (len <= 0)
+    return 0;
+
+  size_ -= static_cast<std::size_t>(len);
+  return static_cast<std::size_t>(len);
+}
+
+auto splice_pipe::size() const noexcept -> std::size_t { return size_; }
+
+auto splice_pipe::eof() const noexcept -> bool { return eof_; }
+} // namespace cloudbus::detail
@@ -0,0 +1,137 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file ticker.cpp
+ * @brief This file defines the periodic wakeup of event loops.
+ */
+#include "segment/detail/ticker.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+
+#include <unistd.h>
+namespace cloudbus::detail {
+
+ticker::ticker(std::chrono::milliseconds interval)
+    : interval_{interval},
+      sock_{::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)},
+      error_{sock_ < 0 ? errno : 0}
+{}
+
+ticker::~ticker()
+{
+  // The thread sends on the socket, so it is stopped before the socket
+  // is closed.
+  thread_.request_stop();
+  if (thread_.joinable())
+    thread_.join();
+  if (sock_ >= 0)
+    ::close(sock_);
+}
+
+auto ticker::subscribe(int fd, std::uint64_t &id) -> std::error_code
+{
+  auto sub = subscriber{};
+  sub.length = sizeof(sub.address);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto *addr = reinterpret_cast<sockaddr *>(&sub.address);
+  if (sock_ < 0)
+    return {error_, std::system_category()};
+  if (::getsockname(fd, addr, &sub.length))
+    return {errno, std::system_category()};
+  if (sub.address.sun_family != AF_UNIX)
+    return std::make_error_code(std::errc::address_family_not_supported);
+
+  // An address of just the family autobinds a unique abstract name.
+  if (sub.length <= sizeof(sa_family_t))
+  {
+    sub.address = {.sun_family = AF_UNIX, .sun_path = {}};
+    if (::bind(fd, addr, sizeof(sa_family_t)))
+      return {errno, std::system_category()};
+
+    sub.length = sizeof(sub.address);
+    if (::getsockname(fd, addr, &sub.length))
+      return {errno, std::system_category()};
+  }
+
+  auto lock = std::lock_guard{mtx_};
+  id = sub.id = next_id_++;
+  subscribers_.push_back(sub);
+  if (!thread_.joinable())
+    thread_ = std::jthread([this](std::stop_token token) { run(token); });
+  return {};
+}
+
+auto ticker::drain() -> void
+{
+  draining_.store(true, std::memory_order_release);
+  {
+    auto lock = std::lock_guard{mtx_};
+    wake_ = true;
+  }
+  cvar_.notify_all();
+}
+
+auto ticker::drained(std::uint64_t id) -> void
+{
+  {
+    auto lock = std::lock_guard{mtx_};
+    auto it = std::ranges::find(subscribers_, id, &subscriber::id);
+    if (it == subscribers_.end() || it->drained)
+      return;
+    it->drained = true;
+  }
+  cvar_.notify_all();
+}
+
+auto ticker::wait_drained(std::stop_token token,
+                          std::chrono::milliseconds timeout) -> bool
+{
+  auto lock = std::unique_lock{mtx_};
+  return cvar_.wait_for(lock, token, timeout,
+                        [&]() noexcept { return all_drained(); });
+}
+
+auto ticker::all_drained() const noexcept -> bool
+{
+  return std::ranges::all_of(subscribers_, &subscriber::drained);
+}
+
+auto ticker::run(const std::stop_token &token) -> void
+{
+  static constexpr auto tick = std::byte{1};
+
+  auto lock = std::unique_lock{mtx_};
+  while (!token.stop_requested())
+  {
+    cvar_.wait_for(lock, token, interval_, [&]() noexcept { return wake_; });
+    wake_ = false;
+
+    // A full receive buffer already holds a tick. The socket of a
+    // subscriber that has gone away refuses the tick.
+    std::erase_if(subscribers_, [&](const subscriber &sub) noexcept {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      const auto *addr = reinterpret_cast<const sockaddr *>(&sub.address);
+      return ::sendto(sock_, &tick, sizeof(tick), MSG_DONTWAIT, addr,
+                      sub.length) < 0 &&
+             (errno == ECONNREFUSED || errno == ENOENT);
+    });
+    // Unsubscribing may have left only drained subscribers.
+    cvar_.notify_all();
+  }
+}
+} // namespace cloudbus::detail
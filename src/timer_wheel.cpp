@@ -0,0 +1,129 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file timer_wheel.cpp
+ * @brief This file defines a hierarchical timing wheel.
+ */
+#include "segment/detail/timer_wheel.hpp"
+
+#include <algorithm>
+#include <bit>
+namespace cloudbus::detail {
+
+timer_wheel::timer_wheel(clock_type::time_point now) noexcept
+    : now_{tick(now)}
+{
+  for (auto &level : wheel_)
+  {
+    for (auto &head : level)
+      head.prev = head.next = &head;
+  }
+}
+
+auto timer_wheel::schedule(timer &t,
+                           clock_type::time_point deadline) noexcept -> void
+{
+  cancel(t);
+  // A deadline that has passed expires at the next tick.
+  t.expiry = std::max(tick(deadline), now_ + 1);
+  link(t);
+  ++size_;
+}
+
+auto timer_wheel::cancel(timer &t) noexcept -> void
+{
+  if (!t.armed())
+    return;
+
+  t.prev->next = t.next;
+  t.next->prev = t.prev;
+  t.prev = t.next = nullptr;
+  --size_;
+
+  auto level = t.slot / slots;
+  auto index = t.slot % slots;
+  if (auto &head = wheel_[level][index]; head.next == &head)
+    occupied_[level] &= ~(1ULL << index);
+}
+
+auto timer_wheel::tick(clock_type::time_point time) noexcept -> std::uint64_t
+{
+  auto ticks = std::chrono::duration_cast<duration>(time.time_since_epoch());
+  return static_cast<std::uint64_t>(std::max<duration::rep>(ticks.count(), 0));
+}
+
+auto timer_wheel::link(timer &t) noexcept -> void
+{
+  constexpr auto mask = slots - 1;
+
+  // The level is the lowest one whose rotation spans the delay. Within
+  // that span, the slot that the expiry maps to is only reached once.
+  auto delay = t.expiry > now_ ? t.expiry - now_ : 0;
+  auto level = delay ? static_cast<std::size_t>(std::bit_width(delay) - 1) /
+                           slot_bits
+                     : 0;
+
+  // Timers beyond the top level wait in the last slot that it reaches,
+  // and are linked again from there.
+  auto expiry = t.expiry;
+  if (level >= levels)
+  {
+    level = levels - 1;
+    expiry = now_ + (1ULL << (slot_bits * levels)) - 1;
+  }
+
+  auto index = (expiry >> (slot_bits * level)) & mask;
+  auto &head = wheel_[level][index];
+  t.slot = static_cast<std::uint16_t>((level * slots) + index);
+  occupied_[level] |= 1ULL << index;
+  t.prev = head.prev;
+  t.next = &head;
+  head.prev->next = &t;
+  head.prev = &t;
+}
+
+auto timer_wheel::cascade(std::size_t level, std::size_t index) noexcept
+    -> void
+{
+  auto &head = wheel_[level][index];
+  if (head.next == &head)
+    return;
+
+  // Detach the list first, since a parked timer may link back into it.
+  auto *t = head.next;
+  head.prev->next = nullptr;
+  head.prev = head.next = &head;
+  occupied_[level] &= ~(1ULL << index);
+  while (t)
+  {
+    auto *next = t->next;
+    link(*t);
+    t = next;
+  }
+}
+
+auto timer_wheel::pop(std::size_t level, std::size_t index) noexcept
+    -> timer *
+{
+  auto &head = wheel_[level][index];
+  if (head.next == &head)
+    return nullptr;
+
+  auto *t = head.next;
+  cancel(*t);
+  return t;
+}
+} // namespace cloudbus::detail
@@ -0,0 +1,307 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file tls_session.cpp
+ * @brief This file defines the TLS handshakes that hand the record layer
+ * to kernel TLS.
+ */
+#include "segment/detail/tls_session.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+namespace cloudbus::detail {
+namespace {
+/** @brief The TLS 1.2 ciphers that kernel TLS implements. */
+constexpr auto tls12_ciphers = "ECDHE-ECDSA-AES128-GCM-SHA256:"
+                               "ECDHE-RSA-AES128-GCM-SHA256:"
+                               "ECDHE-ECDSA-AES256-GCM-SHA384:"
+                               "ECDHE-RSA-AES256-GCM-SHA384:"
+                               "ECDHE-ECDSA-CHACHA20-POLY1305:"
+                               "ECDHE-RSA-CHACHA20-POLY1305";
+/** @brief The TLS 1.3 ciphers that kernel TLS implements. */
+constexpr auto tls13_ciphers = "TLS_AES_128_GCM_SHA256:"
+                               "TLS_AES_256_GCM_SHA384:"
+                               "TLS_CHACHA20_POLY1305_SHA256";
+
+/** @brief The bytes that a replay BIO reads before the next BIO. */
+struct replay {
+  /** @brief The bytes that were already read from the socket. */
+  std::vector<std::byte> bytes;
+  /** @brief How many of the bytes have been read again. */
+  std::size_t offset{0};
+};
+
+/**
+ * @brief Reads the replayed bytes, then from the next BIO.
+ * @param bio The replay BIO.
+ * @param out The buffer to read into.
+ * @param len The size of the buffer.
+ * @return The number of bytes read, or what the next BIO returned.
+ */
+auto replay_read(BIO *bio, char *out, int len) -> int
+{
+  auto *data = static_cast<replay *>(BIO_get_data(bio));
+  BIO_clear_retry_flags(bio);
+  if (auto left = data->bytes.size() - data->offset; left && len > 0)
+  {
+    auto size = std::min(left, static_cast<std::size_t>(len));
+    std::memcpy(out, data->bytes.data() + data->offset, size);
+    data->offset += size;
+    return static_cast<int>(size);
+  }
+
+  auto ret = BIO_read(BIO_next(bio), out, len);
+  BIO_copy_next_retry(bio);
+  return ret;
+}
+
+/**
+ * @brief Writes to the next BIO.
+ * @param bio The replay BIO.
+ * @param in The bytes to write.
+ * @param len The number of bytes to write.
+ * @return What the next BIO returned.
+ */
+auto replay_write(BIO *bio, const char *in, int len) -> int
+{
+  BIO_clear_retry_flags(bio);
+  auto ret = BIO_write(BIO_next(bio), in, len);
+  BIO_copy_next_retry(bio);
+  return ret;
+}
+
+/**
+ * @brief Passes controls on to the next BIO.
+ * @details This is what lets kernel TLS be installed on, and detected
+ * through, the socket BIO underneath.
+ * @param bio The replay BIO.
+ * @param cmd The control.
+ * @param larg The integer argument of the control.
+ * @param parg The pointer argument of the control.
+ * @return What the control returned.
+ */
+auto replay_ctrl(BIO *bio, int cmd, long larg, void *parg) -> long
+{
+  auto *data = static_cast<replay *>(BIO_get_data(bio));
+  auto ret = BIO_ctrl(BIO_next(bio), cmd, larg, parg);
+  if (cmd == BIO_CTRL_PENDING)
+    ret += static_cast<long>(data->bytes.size() - data->offset);
+  return ret;
+}
+
+/**
+ * @brief Frees the replayed bytes.
+ * @param bio The replay BIO.
+ * @return 1.
+ */
+auto replay_destroy(BIO *bio) -> int
+{
+  delete static_cast<replay *>(BIO_get_data(bio));
+  BIO_set_data(bio, nullptr);
+  return 1;
+}
+
+/**
+ * @brief Gets the method of the replay BIOs.
+ * @return The method, or nullptr if it could not be created.
+ */
+auto replay_method() noexcept -> const BIO_METHOD *
+{
+  static const auto *method = []() noexcept {
+    auto *method =
+        BIO_meth_new(BIO_get_new_index() | BIO_TYPE_FILTER, "replay");
+    if (method)
+    {
+      BIO_meth_set_read(method, replay_read);
+      BIO_meth_set_write(method, replay_write);
+      BIO_meth_set_ctrl(method, replay_ctrl);
+      BIO_meth_set_destroy(method, replay_destroy);
+    }
+    return method;
+  }();
+  return method;
+}
+
+/**
+ * @brief Makes the handshake read bytes again before the socket.
+ * @param ssl The connection, whose BIO is a socket BIO.
+ * @param received The bytes that were already read from the socket.
+ * @return False if the replay BIO could not be created.
+ */
+auto replay_received(SSL *ssl, std::span<const std::byte> received) noexcept
+    -> bool
+{
+  const auto *method = replay_method();
+  auto *data = new (std::nothrow) replay{};
+  auto *bio = method ? BIO_new(method) : nullptr;
+  if (!data || !bio)
+  {
+    delete data;
+    BIO_free(bio);
+    return false;
+  }
+
+  try
+  {
+    data->bytes.assign(received.begin(), received.end());
+  }
+  catch (const std::bad_alloc &)
+  {
+    delete data;
+    BIO_free(bio);
+    return false;
+  }
+  BIO_set_data(bio, data);
+  BIO_set_init(bio, 1);
+
+  // The socket BIO stays the write BIO, and the replay BIO takes over
+  // the reference that the read side held on it.
+  auto *socket = SSL_get_rbio(ssl);
+  BIO_up_ref(socket);
+  BIO_push(bio, socket);
+  SSL_set0_rbio(ssl, bio);
+  return true;
+}
+} // namespace
+
+tls_context::tls_context(side role) noexcept
+    : ctx_{SSL_CTX_new(role == side::server ? TLS_server_method()
+                                            : TLS_client_method())},
+      role_{role}
+{
+  if (!ctx_)
+    return;
+
+  SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+  SSL_CTX_set_cipher_list(ctx_, tls12_ciphers);
+  SSL_CTX_set_ciphersuites(ctx_, tls13_ciphers);
+  SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS | SSL_OP_NO_TICKET |
+                                SSL_OP_NO_RENEGOTIATION);
+  SSL_CTX_set_num_tickets(ctx_, 0);
+  SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+}
+
+tls_context::~tls_context() { SSL_CTX_free(ctx_); }
+
+auto tls_context::configure(const tls_settings &settings) -> std::error_code
+{
+  const auto invalid = std::make_error_code(std::errc::invalid_argument);
+  if (!ctx_)
+    return invalid;
+
+  if (!settings.certificate.empty() &&
+      (SSL_CTX_use_certificate_chain_file(ctx_,
+                                          settings.certificate.c_str()) != 1 ||
+       SSL_CTX_use_PrivateKey_file(ctx_, settings.private_key.c_str(),
+                                   SSL_FILETYPE_PEM) != 1 ||
+       SSL_CTX_check_private_key(ctx_) != 1))
+  {
+    ERR_clear_error();
+    return invalid;
+  }
+
+  if (!settings.ca_file.empty())
+  {
+    if (SSL_CTX_load_verify_locations(ctx_, settings.ca_file.c_str(),
+                                      nullptr) != 1)
+    {
+      ERR_clear_error();
+      return invalid;
+    }
+
+    auto mode = SSL_VERIFY_PEER;
+    if (role_ == side::server)
+      mode |= SSL_VERIFY_FAIL_IF_NO_PEER_CERT;
+    SSL_CTX_set_verify(ctx_, mode, nullptr);
+  }
+
+  server_name_ = settings.server_name;
+  return {};
+}
+
+tls_session::tls_session(const tls_context &ctx, int sock,
+                         std::span<const std::byte> received) noexcept
+    : ssl_{ctx.ctx_ ? SSL_new(ctx.ctx_) : nullptr}
+{
+  // The socket BIO does not close the socket when the session is freed.
+  if (!ssl_ || SSL_set_fd(ssl_, sock) != 1 ||
+      (!received.empty() && !replay_received(ssl_, received)))
+  {
+    error_ = std::make_error_code(std::errc::not_enough_memory);
+    return;
+  }
+
+  if (ctx.role() == tls_context::side::server)
+  {
+    SSL_set_accept_state(ssl_);
+    return;
+  }
+
+  SSL_set_connect_state(ssl_);
+  if (!ctx.server_name_.empty())
+  {
+    SSL_set_tlsext_host_name(ssl_, ctx.server_name_.c_str());
+    SSL_set1_host(ssl_, ctx.server_name_.c_str());
+  }
+}
+
+tls_session::~tls_session() { SSL_free(ssl_); }
+
+auto tls_session::handshake() noexcept -> status
+{
+  if (error_)
+    return status::failed;
+
+  if (int ret = SSL_do_handshake(ssl_); ret != 1)
+  {
+    switch (SSL_get_error(ssl_, ret))
+    {
+      case SSL_ERROR_WANT_READ:
+        return status::want_read;
+
+      case SSL_ERROR_WANT_WRITE:
+        return status::want_write;
+
+      case SSL_ERROR_SYSCALL:
+        error_ = errno ? std::error_code(errno, std::system_category())
+                       : std::make_error_code(std::errc::connection_reset);
+        break;
+
+      default:
+        error_ = std::make_error_code(std::errc::protocol_error);
+        break;
+    }
+    ERR_clear_error();
+    return status::failed;
+  }
+
+  // Records that OpenSSL would have to encrypt or decrypt itself would
+  // be lost, since the socket is used directly from here on.
+  if (!BIO_get_ktls_send(SSL_get_wbio(ssl_)) ||
+      !BIO_get_ktls_recv(SSL_get_rbio(ssl_)))
+  {
+    error_ = std::make_error_code(std::errc::operation_not_supported);
+    return status::failed;
+  }
+  return status::done;
+}
+} // namespace cloudbus::detail
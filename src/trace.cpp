@@ -0,0 +1,239 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file trace.cpp
+ * @brief This file defines per-thread trace rings of hot path events.
+ */
+#include "segment/detail/trace.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
+namespace cloudbus::detail {
+namespace {
+/** @brief The magic bytes at the start of a trace file. */
+constexpr auto magic = std::string_view{"CBTRACE1"};
+
+/** @brief The rings of all threads that have traced anything. */
+struct registry {
+  /** @brief Protects the rings and the output path. */
+  std::mutex mtx;
+  /** @brief The registered rings. */
+  std::vector<std::unique_ptr<trace::ring>> rings;
+  /** @brief The path that `flush()` writes to. */
+  std::string path;
+};
+
+/**
+ * @brief Gets the ring registry.
+ * @details The registry is never destroyed, so threads that exit after
+ * `main` returns can still trace.
+ * @return The registry.
+ */
+auto get_registry() -> registry &
+{
+  static auto *instance = new registry{};
+  return *instance;
+}
+
+/**
+ * @brief Writes an integer in host byte order.
+ * @param os The stream to write to.
+ * @param value The integer.
+ */
+template <typename T> auto put(std::ostream &os, T value) -> void
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * @brief Reads an integer in host byte order.
+ * @param is The stream to read from.
+ * @param value Set to the integer.
+ * @return False if the stream ended.
+ */
+template <typename T> auto get(std::istream &is, T &value) -> bool
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return static_cast<bool>(is.read(reinterpret_cast<char *>(&value),
+                                   sizeof(value)));
+}
+} // namespace
+
+auto trace::ring::snapshot() const -> std::vector<record>
+{
+  auto head = head_.load(std::memory_order_acquire);
+  auto first = head > capacity ? head - capacity : 0;
+
+  auto records = std::vector<record>{};
+  records.reserve(head - first);
+  for (auto i = first; i < head; ++i)
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    auto &slot = const_cast<std::array<std::uint64_t, 2> &>(
+        slots_[i & (capacity - 1)]);
+    auto word = std::atomic_ref(slot[1]).load(std::memory_order_relaxed);
+    records.push_back(
+        {.time = std::atomic_ref(slot[0]).load(std::memory_order_relaxed),
+         .fd = static_cast<std::uint32_t>(word >> 32U),
+         .info = static_cast<std::uint32_t>(word)});
+  }
+
+  // The writer may be overwriting the slot after its latest head, so
+  // the records that share a slot with it or an earlier head are stale.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  auto latest = head_.load(std::memory_order_relaxed);
+  if (auto stale = latest >= capacity ? latest - capacity + 1 : 0;
+      stale > first)
+  {
+    records.erase(records.begin(),
+                  records.begin() +
+                      static_cast<std::ptrdiff_t>(
+                          std::min(stale - first, records.size())));
+  }
+
+  return records;
+}
+
+auto trace::local() -> ring &
+{
+  static thread_local auto *local = [] {
+    auto &reg = get_registry();
+    auto lock = std::lock_guard{reg.mtx};
+    return reg.rings.emplace_back(std::make_unique<ring>()).get();
+  }();
+
+  return *local;
+}
+
+auto trace::dump(std::ostream &os) -> std::error_code
+{
+  auto &reg = get_registry();
+  auto lock = std::lock_guard{reg.mtx};
+
+  os.write(magic.data(), static_cast<std::streamsize>(magic.size()));
+  put(os, static_cast<std::uint32_t>(reg.rings.size()));
+  for (std::uint32_t i = 0; i < reg.rings.size(); ++i)
+  {
+    auto records = reg.rings[i]->snapshot();
+    put(os, i);
+    put(os, static_cast<std::uint32_t>(records.size()));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    os.write(reinterpret_cast<const char *>(records.data()),
+             static_cast<std::streamsize>(records.size() * sizeof(record)));
+  }
+
+  os.flush();
+  return os ? std::error_code{} : std::make_error_code(std::errc::io_error);
+}
+
+auto trace::output(std::string path) -> void
+{
+  auto &reg = get_registry();
+  auto lock = std::lock_guard{reg.mtx};
+  reg.path = std::move(path);
+}
+
+auto trace::flush() -> std::error_code
+{
+  auto path = std::string{};
+  {
+    auto &reg = get_registry();
+    auto lock = std::lock_guard{reg.mtx};
+    path = reg.path;
+  }
+  if (path.empty())
+    return {};
+
+  // The trace is renamed into place, so that a decoder never reads a
+  // half-written file.
+  auto temp = path + ".tmp";
+  {
+    auto file = std::ofstream(temp, std::ios::binary | std::ios::trunc);
+    if (!file)
+      return {errno, std::generic_category()};
+
+    if (auto error = dump(file))
+      return error;
+  }
+
+  if (std::rename(temp.c_str(), path.c_str()))
+    return {errno, std::generic_category()};
+
+  return {};
+}
+
+auto trace::decode(std::istream &is, std::ostream &os) -> std::error_code
+{
+  constexpr auto invalid = std::errc::invalid_argument;
+
+  auto header = std::array<char, magic.size()>{};
+  if (!is.read(header.data(), header.size()) ||
+      std::string_view(header.data(), header.size()) != magic)
+  {
+    return std::make_error_code(invalid);
+  }
+
+  auto rings = std::uint32_t{};
+  if (!get(is, rings))
+    return std::make_error_code(invalid);
+
+  for (auto i = 0U; i < rings; ++i)
+  {
+    auto index = std::uint32_t{};
+    auto count = std::uint32_t{};
+    if (!get(is, index) || !get(is, count))
+      return std::make_error_code(invalid);
+
+    for (auto n = 0U; n < count; ++n)
+    {
+      auto rec = record{};
+      if (!get(is, rec.time) || !get(is, rec.fd) || !get(is, rec.info))
+        return std::make_error_code(invalid);
+
+      os << rec.time << ' ' << index << ' ' << rec.fd << ' '
+         << name(rec.what()) << ' ' << rec.size() << '\n';
+    }
+  }
+
+  return {};
+}
+
+auto trace::name(event what) noexcept -> std::string_view
+{
+  using enum event;
+  switch (what)
+  {
+    case read:
+      return "read";
+    case service:
+      return "service";
+    case send_submit:
+      return "send_submit";
+    case send_complete:
+      return "send_complete";
+    case short_write:
+      return "short_write";
+    default:
+      return "unknown";
+  }
+}
+} // namespace cloudbus::detail
@@ -0,0 +1,470 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file udp_segment_service.cpp
+ * @brief This file defines the datagram segment service.
+ */
+#include "segment/udp_segment_service.hpp"
+#include "segment/detail/write_queue.hpp"
+#include "segment/segment_config.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+namespace cloudbus::segment {
+namespace {
+/** @brief The control buffer of a GRO receive or a GSO send. */
+struct alignas(cmsghdr) control_buffer {
+  /** @brief The bytes of the control message. */
+  std::array<std::byte, CMSG_SPACE(sizeof(int))> data;
+};
+
+/**
+ * @brief Checks whether two endpoints are the same peer.
+ * @param lhs The first endpoint.
+ * @param rhs The second endpoint.
+ * @return True if the addresses are byte for byte the same.
+ */
+auto same_peer(const udp_segment_service::endpoint &lhs,
+               const udp_segment_service::endpoint &rhs) noexcept -> bool
+{
+  return lhs.len == rhs.len &&
+         !std::memcmp(&lhs.address, &rhs.address, lhs.len);
+}
+
+/**
+ * @brief Checks whether an error means that the call would block.
+ * @param error The errno value.
+ * @return True if the call would block.
+ */
+auto would_block(int error) noexcept -> bool
+{
+  return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS;
+}
+} // namespace
+
+/** @brief The event loop state. */
+struct udp_segment_service::async_context {
+  /** @brief The most datagrams that are sent as one GSO message. */
+  static constexpr std::size_t max_segments = 64;
+  /** @brief The largest payload of a GSO message. */
+  static constexpr std::size_t max_gso_bytes = 65507;
+
+  /** @brief A datagram waiting to be sent. */
+  struct datagram {
+    /** @brief The peer to send the datagram to. */
+    endpoint to;
+    /** @brief The bytes of the datagram. */
+    detail::write_queue::buffer_type buf;
+    /** @brief The object that owns the bytes. */
+    detail::write_queue::owner_type owner;
+  };
+
+  /** @brief The socket. */
+  int sock{-1};
+  /** @brief Whether the socket coalesces received datagrams. */
+  bool gro{false};
+  /** @brief Whether sends may be segmented by the kernel. */
+  bool gso{false};
+  /** @brief The number of datagrams in a batch. */
+  std::size_t batch{0};
+  /** @brief The size of a receive slot. */
+  std::size_t slot{0};
+  /** @brief The memory budget that receive buffers are charged to. */
+  detail::memory_budget *budget{nullptr};
+  /** @brief The buffer of the current batch. */
+  std::shared_ptr<read_context> rctx;
+  /** @brief The number of datagrams of the last receive. */
+  std::size_t received{0};
+
+  /** @brief The headers of a batched receive. */
+  std::vector<mmsghdr> rmsgs;
+  /** @brief The slots of a batched receive. */
+  std::vector<iovec> riov;
+  /** @brief The senders of a batched receive. */
+  std::vector<endpoint> peers;
+  /** @brief The control messages of a batched receive. */
+  std::vector<control_buffer> rcontrol;
+
+  /** @brief The datagrams waiting to be sent. */
+  std::vector<datagram> pending;
+  /** @brief The number of pending datagrams that have been sent. */
+  std::size_t sent{0};
+  /** @brief The headers of a batched send. */
+  std::vector<mmsghdr> smsgs;
+  /** @brief The buffers of a batched send. */
+  std::vector<iovec> siov;
+  /** @brief The control messages of a batched send. */
+  std::vector<control_buffer> scontrol;
+  /** @brief The number of datagrams in each message of a batched send. */
+  std::vector<std::size_t> segments;
+};
+
+udp_segment_service::read_context::read_context(std::size_t size,
+                                                detail::memory_budget *budget)
+    : data_{std::make_unique_for_overwrite<std::byte[]>(size)}, size_{size},
+      budget_{budget}
+{
+  if (budget_)
+    budget_->charge(size_);
+}
+
+udp_segment_service::read_context::~read_context()
+{
+  if (budget_)
+    budget_->release(size_);
+}
+
+udp_segment_service::udp_segment_service(const sockaddr *address,
+                                         socklen_t len,
+                                         const segment_options &options)
+    : options_{options}
+{
+  std::memcpy(&address_.address, address, len);
+  address_.len = len;
+
+  for (const auto &upstream : options_.upstreams)
+  {
+    auto &peer = upstreams_.emplace_back();
+    peer.address = upstream;
+    peer.len = segment_config::address_size(upstream);
+  }
+}
+
+udp_segment_service::~udp_segment_service() = default;
+
+auto udp_segment_service::listener() const noexcept -> int
+{
+  return socket_.load(std::memory_order_acquire);
+}
+
+auto udp_segment_service::initialize(int sock) const noexcept
+    -> std::error_code
+{
+  if (auto error = options_.tuning.apply_listener(sock))
+    return error;
+
+  // Unlike SO_REUSEPORT, SO_REUSEADDR would let datagram sockets steal
+  // each other's traffic, so it is not set.
+  int enable = 1;
+  if (options_.reuse_port &&
+      setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)))
+  {
+    return {errno, std::system_category()};
+  }
+
+  if (int usecs = static_cast<int>(options_.busy_poll_usecs);
+      usecs &&
+      setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)))
+  {
+    return {errno, std::system_category()};
+  }
+
+  return {};
+}
+
+auto udp_segment_service::run(std::stop_token token) -> std::error_code
+{
+  auto ctx = async_context{};
+  ctx.batch = std::max<std::size_t>(options_.udp_batch_size, 1);
+  ctx.slot = std::max<std::size_t>(options_.udp_buffer_size, 1);
+  ctx.budget = options_.memory_budget.get();
+
+  auto family = address_.address.ss_family;
+  auto error = std::error_code{};
+  ctx.sock = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      family == AF_UNIX ? 0 : IPPROTO_UDP);
+  if (ctx.sock < 0)
+    return {errno, std::system_category()};
+
+  error = initialize(ctx.sock);
+  if (!error &&
+      ::bind(ctx.sock, reinterpret_cast<const sockaddr *>(&address_.address),
+             address_.len))
+  {
+    error = {errno, std::system_category()};
+  }
+
+  // GRO and GSO are optional: kernels without them serve one datagram
+  // per slot and per message.
+  if (!error && options_.udp_offload && family != AF_UNIX)
+  {
+    int enable = 1;
+    ctx.gro = !setsockopt(ctx.sock, SOL_UDP, UDP_GRO, &enable,
+                          sizeof(enable));
+
+    int size = 0;
+    auto len = socklen_t{sizeof(size)};
+    ctx.gso = !getsockopt(ctx.sock, SOL_UDP, UDP_SEGMENT, &size, &len);
+  }
+
+  if (!error)
+  {
+    ctx.rmsgs.resize(ctx.batch);
+    ctx.riov.resize(ctx.batch);
+    ctx.peers.resize(ctx.batch);
+    ctx.rcontrol.resize(ctx.batch);
+    ctx.smsgs.resize(ctx.batch);
+    ctx.siov.resize(ctx.batch * async_context::max_segments);
+    ctx.scontrol.resize(ctx.batch);
+    ctx.segments.resize(ctx.batch);
+    socket_.store(ctx.sock, std::memory_order_release);
+
+    // Wake up periodically to observe stop requests.
+    constexpr int timeout = 100;
+    while (!token.stop_requested())
+    {
+      // Received datagrams wait in the socket while the last batch is
+      // still being sent.
+      auto pfd = pollfd{.fd = ctx.sock,
+                        .events = static_cast<short>(
+                            ctx.pending.empty() ? POLLIN : POLLOUT),
+                        .revents = 0};
+      if (::poll(&pfd, 1, timeout) < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        error = {errno, std::system_category()};
+        break;
+      }
+      if (!pfd.revents)
+        continue;
+
+      if (!ctx.pending.empty())
+      {
+        flush(ctx);
+        continue;
+      }
+
+      // Keep receiving while full batches are waiting.
+      do
+      {
+        if ((error = receive(ctx)))
+          break;
+        flush(ctx);
+      } while (ctx.received == ctx.batch && ctx.pending.empty() &&
+               !token.stop_requested());
+      if (error)
+        break;
+    }
+  }
+
+  socket_.store(-1, std::memory_order_release);
+  ctx.pending.clear();
+  ctx.rctx.reset();
+  ::close(ctx.sock);
+
+  return error;
+}
+
+auto udp_segment_service::receive(async_context &ctx) -> std::error_code
+{
+  ctx.received = 0;
+
+  // The buffer is reused once none of its datagrams are waiting to be
+  // sent.
+  if (!ctx.rctx || ctx.rctx.use_count() > 1)
+    ctx.rctx = std::make_shared<read_context>(ctx.batch * ctx.slot, ctx.budget);
+
+  auto buffer = ctx.rctx->buffer();
+  for (std::size_t i = 0; i < ctx.batch; ++i)
+  {
+    ctx.riov[i] = {.iov_base = buffer.data() + (i * ctx.slot),
+                   .iov_len = ctx.slot};
+
+    auto &hdr = ctx.rmsgs[i].msg_hdr;
+    hdr = {};
+    hdr.msg_name = &ctx.peers[i].address;
+    hdr.msg_namelen = sizeof(ctx.peers[i].address);
+    hdr.msg_iov = &ctx.riov[i];
+    hdr.msg_iovlen = 1;
+    if (ctx.gro)
+    {
+      hdr.msg_control = ctx.rcontrol[i].data.data();
+      hdr.msg_controllen = ctx.rcontrol[i].data.size();
+    }
+  }
+
+  auto count = ::recvmmsg(ctx.sock, ctx.rmsgs.data(),
+                          static_cast<unsigned>(ctx.batch), 0, nullptr);
+  if (count < 0)
+  {
+    if (would_block(errno) || errno == EINTR)
+      return {};
+    return {errno, std::system_category()};
+  }
+
+  ctx.received = static_cast<std::size_t>(count);
+  for (std::size_t i = 0; i < ctx.received; ++i)
+  {
+    auto &hdr = ctx.rmsgs[i].msg_hdr;
+    if (hdr.msg_flags & MSG_TRUNC)
+      continue;
+
+    auto len = std::size_t{ctx.rmsgs[i].msg_len};
+    auto segment = len;
+    if (hdr.msg_controllen)
+    {
+      for (auto *cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+           cmsg = CMSG_NXTHDR(&hdr, cmsg))
+      {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+          int size = 0;
+          std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+          if (size > 0)
+            segment = static_cast<std::size_t>(size);
+        }
+      }
+    }
+
+    ctx.peers[i].len = hdr.msg_namelen;
+    auto slot = buffer.subspan(i * ctx.slot, len);
+    // A zero length datagram is still a message.
+    auto offset = std::size_t{0};
+    do
+    {
+      auto size = std::min(segment, len - offset);
+      (*this)(ctx, &ctx.peers[i], ctx.rctx, slot.subspan(offset, size));
+      offset += size;
+    } while (offset < len);
+  }
+
+  return {};
+}
+
+auto udp_segment_service::service(async_context &ctx, socket_dialog socket,
+                                  const std::shared_ptr<read_context> &rctx,
+                                  std::span<const std::byte> buf) -> void
+{
+  ctx.pending.push_back(
+      {.to = destination(*socket), .buf = buf, .owner = rctx});
+}
+
+auto udp_segment_service::operator()(
+    async_context &ctx, socket_dialog socket,
+    const std::shared_ptr<read_context> &rctx,
+    std::span<const std::byte> buf) -> void
+{
+  service(ctx, socket, rctx, buf);
+}
+
+auto udp_segment_service::flush(async_context &ctx) -> void
+{
+  while (ctx.sent < ctx.pending.size())
+  {
+    auto msgs = std::size_t{0};
+    auto iovs = std::size_t{0};
+    for (auto i = ctx.sent; msgs < ctx.batch && i < ctx.pending.size();
+         ++msgs)
+    {
+      // A GSO message is a train of datagrams to the same peer, all of
+      // the same size except for a shorter last one.
+      const auto &head = ctx.pending[i];
+      auto first = i;
+      auto start = iovs;
+      auto bytes = std::size_t{0};
+      do
+      {
+        const auto &buf = ctx.pending[i].buf;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        ctx.siov[iovs++] = {.iov_base = const_cast<std::byte *>(buf.data()),
+                            .iov_len = buf.size()};
+        bytes += buf.size();
+        ++i;
+      } while (ctx.gso && i < ctx.pending.size() &&
+               i - first < async_context::max_segments &&
+               !head.buf.empty() && !ctx.pending[i].buf.empty() &&
+               ctx.pending[i - 1].buf.size() == head.buf.size() &&
+               ctx.pending[i].buf.size() <= head.buf.size() &&
+               bytes + ctx.pending[i].buf.size() <=
+                   async_context::max_gso_bytes &&
+               same_peer(ctx.pending[i].to, head.to));
+
+      auto &hdr = ctx.smsgs[msgs].msg_hdr;
+      hdr = {};
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+      hdr.msg_name = const_cast<sockaddr_storage *>(&head.to.address);
+      hdr.msg_namelen = head.to.len;
+      hdr.msg_iov = &ctx.siov[start];
+      hdr.msg_iovlen = iovs - start;
+      ctx.segments[msgs] = i - first;
+
+      if (i - first > 1)
+      {
+        auto &control = ctx.scontrol[msgs].data;
+        hdr.msg_control = control.data();
+        hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+
+        auto *cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+        auto size = static_cast<std::uint16_t>(head.buf.size());
+        std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+      }
+    }
+
+    auto count = ::sendmmsg(ctx.sock, ctx.smsgs.data(),
+                            static_cast<unsigned>(msgs), MSG_NOSIGNAL);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (would_block(errno))
+        return;
+
+      // Devices without checksum offload reject segmented sends.
+      if (errno == EIO && ctx.gso)
+      {
+        ctx.gso = false;
+        continue;
+      }
+
+      // The datagrams of a message that the kernel rejects are dropped.
+      count = 1;
+    }
+
+    for (std::size_t k = 0; k < static_cast<std::size_t>(count); ++k)
+      ctx.sent += ctx.segments[k];
+  }
+
+  ctx.pending.clear();
+  ctx.sent = 0;
+}
+
+auto udp_segment_service::destination(const endpoint &sender) const noexcept
+    -> const endpoint &
+{
+  if (upstreams_.empty())
+    return sender;
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto key = std::string_view(reinterpret_cast<const char *>(&sender.address),
+                              sender.len);
+  return upstreams_[std::hash<std::string_view>{}(key) % upstreams_.size()];
+}
+} // namespace cloudbus::segment
@@ -0,0 +1,989 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file uring_segment_service.cpp
+ * @brief This file defines the io_uring backed segment service.
+ */
+#include "segment/uring_segment_service.hpp"
+#include "segment/detail/buffer_pool.hpp"
+#include "segment/detail/memory_budget.hpp"
+#include "segment/detail/metrics.hpp"
+#include "segment/detail/read_sizer.hpp"
+#include "segment/detail/timer_wheel.hpp"
+#include "segment/detail/trace.hpp"
+#ifdef CB_SEGMENT_HAS_KTLS
+#include "segment/detail/tls_session.hpp"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <liburing.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+namespace cloudbus::segment {
+
+/** @brief The io_uring event loop state. */
+struct uring_segment_service::async_context {
+  /** @brief The buffer group id of the small buffers. */
+  static constexpr std::uint16_t small_group = 0;
+  /** @brief The buffer group id of the large buffers. */
+  static constexpr std::uint16_t large_group = 1;
+  /** @brief The number of submission queue entries. */
+  static constexpr unsigned entries = 4096;
+  /** @brief How often the event loop wakes up without completions. */
+  static constexpr auto wakeup = std::chrono::milliseconds(100);
+
+  /** @brief A provided buffer ring. */
+  struct buffer_group {
+    /** @brief The buffer ring that is registered with the kernel. */
+    io_uring_buf_ring *ring{nullptr};
+    /** @brief The memory backing the provided buffers. */
+    std::vector<std::byte> storage;
+    /** @brief The size of each provided buffer. */
+    std::size_t size{0};
+    /** @brief The number of provided buffers. */
+    unsigned count{0};
+
+    /**
+     * @brief Gets the memory of a provided buffer.
+     * @param bid The id of the buffer.
+     * @return A pointer to the start of the buffer.
+     */
+    auto buffer(std::uint16_t bid) noexcept -> std::byte *
+    {
+      return storage.data() + (bid * size);
+    }
+  };
+
+  /** @brief The io_uring instance. */
+  io_uring ring{};
+  /** @brief The provided buffer rings indexed by their group id. */
+  std::array<buffer_group, 2> groups{};
+  /** @brief The memory budget that received buffers are charged to. */
+  detail::memory_budget *budget{nullptr};
+  /** @brief The listening socket. */
+  int listener{-1};
+  /** @brief Whether the event loop is draining. */
+  bool draining{false};
+  /** @brief When a failed accept is armed again, or the epoch. */
+  std::chrono::steady_clock::time_point accept_retry;
+  /** @brief Connections whose recv stopped for lack of buffers. */
+  std::vector<connection *> starved;
+  /** @brief Connections whose recv waits for their rate limits. */
+  std::vector<connection *> throttled;
+  /** @brief The timeouts of the connections. */
+  detail::timer_wheel timers;
+  /** @brief When the current batch of completions was reaped. */
+  std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+
+  /**
+   * @brief Gets a submission queue entry.
+   * @details Submits the pending entries first if the queue is full.
+   * @return A submission queue entry.
+   */
+  auto get_sqe() noexcept -> io_uring_sqe *
+  {
+    auto *sqe = io_uring_get_sqe(&ring);
+    while (!sqe)
+    {
+      io_uring_submit(&ring);
+      sqe = io_uring_get_sqe(&ring);
+    }
+    return sqe;
+  }
+
+  /**
+   * @brief Gets the buffer group that fits the recent reads of a connection.
+   * @param conn The connection.
+   * @return The id of the buffer group.
+   */
+  [[nodiscard]] auto group_of(const connection &conn) const noexcept
+      -> std::uint16_t;
+
+  /**
+   * @brief Returns a buffer to its provided buffer ring.
+   * @param group The id of the buffer group.
+   * @param bid The id of the buffer.
+   */
+  auto recycle(std::uint16_t group, std::uint16_t bid) noexcept -> void;
+};
+
+/** @brief The per-connection state of the service. */
+struct uring_segment_service::connection {
+  /** @brief The native socket handle. */
+  int fd{-1};
+  /** @brief The buffers waiting to be written to the socket. */
+  detail::write_queue queue;
+  /** @brief The gathered buffers of the send in flight. */
+  std::array<iovec, detail::write_queue::max_buffers> iov{};
+  /** @brief The message header of the send in flight. */
+  msghdr msg{};
+  /** @brief Sizes the buffers by the recent reads. */
+  detail::read_sizer sizer;
+  /** @brief The buffer group that the multishot recv selects from. */
+  std::uint16_t group{0};
+  /** @brief The rate limits of the connection. */
+  detail::rate_limiter limiter;
+  /** @brief The idle or write timeout of the connection. */
+  detail::timer_wheel::timer timeout;
+  /** @brief When the oldest read that waits behind the send was queued. */
+  std::chrono::steady_clock::time_point backlog_since;
+  /** @brief The number of bytes of the send in flight. */
+  std::size_t inflight{0};
+  /** @brief The source IP that the connection was admitted for. */
+  detail::admission_control::source_type source{};
+#ifdef CB_SEGMENT_HAS_KTLS
+  /** @brief The TLS handshake in progress on the connection. */
+  std::unique_ptr<detail::tls_session> tls;
+#endif
+  /** @brief Whether the connection counts against admission control. */
+  bool admitted{false};
+  /** @brief Whether the handshake waits for the socket to be ready. */
+  bool polling{false};
+  /** @brief Whether a send is in flight on the connection. */
+  bool sending{false};
+  /** @brief Whether the multishot recv is armed on the connection. */
+  bool receiving{false};
+  /** @brief Whether the multishot recv is being cancelled. */
+  bool cancelling{false};
+  /** @brief Whether the recv waits for the rate limits to refill. */
+  bool throttled{false};
+  /** @brief Whether the recv waits for the write queue to be written. */
+  bool paused{false};
+  /** @brief Whether anything has been received on the connection. */
+  bool served{false};
+  /** @brief Whether the connection has been closed by either side. */
+  bool closed{false};
+};
+
+namespace {
+/** @brief The operation that a completion belongs to. */
+enum operation : std::uint64_t {
+  accept = 1,
+  recv = 2,
+  send = 3,
+  cancel = 4,
+  poll = 5,
+};
+/** @brief The user data bits that encode the operation. */
+constexpr std::uint64_t operation_mask = 0x7;
+
+/**
+ * @brief Encodes the user data of a submission.
+ * @param conn The connection of the submission.
+ * @param op The operation of the submission.
+ * @return The encoded user data.
+ */
+auto encode(const void *conn, operation op) noexcept -> std::uint64_t
+{
+  return reinterpret_cast<std::uintptr_t>(conn) | op;
+}
+
+/**
+ * @brief Arms the multishot accept on the listening socket.
+ * @param sqe The submission queue entry to prepare.
+ * @param listener The listening socket.
+ */
+auto arm_accept(io_uring_sqe *sqe, int listener) noexcept -> void
+{
+  io_uring_prep_multishot_accept(sqe, listener, nullptr, nullptr, 0);
+  io_uring_sqe_set_data64(sqe, encode(nullptr, accept));
+}
+
+/**
+ * @brief Arms a multishot recv that selects from the provided buffers.
+ * @param sqe The submission queue entry to prepare.
+ * @param fd The socket to receive from.
+ * @param conn The connection state.
+ * @param group The buffer group to select from.
+ */
+auto arm_recv(io_uring_sqe *sqe, int fd, const void *conn,
+              std::uint16_t group) noexcept -> void
+{
+  io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = group;
+  io_uring_sqe_set_data64(sqe, encode(conn, recv));
+}
+
+/**
+ * @brief Sets up a provided buffer ring.
+ * @param ring The io_uring instance.
+ * @param group The buffer group to set up.
+ * @param bgid The id of the buffer group.
+ * @return An error code if the buffer ring could not be registered.
+ */
+auto setup_group(io_uring &ring,
+                 uring_segment_service::async_context::buffer_group &group,
+                 std::uint16_t bgid) -> std::error_code
+{
+  group.storage.resize(group.size * group.count);
+
+  int ret = 0;
+  group.ring = io_uring_setup_buf_ring(&ring, group.count, bgid, 0, &ret);
+  if (!group.ring)
+    return {-ret, std::system_category()};
+
+  for (unsigned bid = 0; bid < group.count; ++bid)
+  {
+    io_uring_buf_ring_add(group.ring,
+                          group.buffer(static_cast<std::uint16_t>(bid)),
+                          static_cast<unsigned>(group.size), bid,
+                          io_uring_buf_ring_mask(group.count),
+                          static_cast<int>(bid));
+  }
+  io_uring_buf_ring_advance(group.ring, static_cast<int>(group.count));
+  return {};
+}
+
+/**
+ * @brief Checks the size of a provided buffer ring.
+ * @param count The number of buffers.
+ * @return True if the kernel accepts a buffer ring of this size.
+ */
+constexpr auto valid_ring_size(std::size_t count) noexcept -> bool
+{
+  return count && count <= (1U << 15U) && !(count & (count - 1));
+}
+
+/**
+ * @brief Spins on the completion queue before the event loop blocks.
+ * @details The pending submissions are submitted first, since otherwise
+ * there may be nothing to complete.
+ * @param ring The ring to spin on.
+ * @param window How long to spin for.
+ * @param cqe Set to the first completion, or nullptr if none arrived.
+ */
+auto spin(io_uring &ring, std::chrono::microseconds window,
+          io_uring_cqe **cqe) noexcept -> void
+{
+  using clock_type = std::chrono::steady_clock;
+
+  io_uring_submit(&ring);
+  for (auto deadline = clock_type::now() + window;
+       io_uring_peek_cqe(&ring, cqe) && clock_type::now() < deadline;)
+  {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  if (io_uring_peek_cqe(&ring, cqe))
+    *cqe = nullptr;
+}
+} // namespace
+
+auto uring_segment_service::async_context::group_of(
+    const connection &conn) const noexcept -> std::uint16_t
+{
+  const auto &large = groups[large_group];
+  return large.count && conn.sizer.size() > groups[small_group].size
+             ? large_group
+             : small_group;
+}
+
+auto uring_segment_service::async_context::recycle(std::uint16_t group,
+                                                   std::uint16_t bid) noexcept
+    -> void
+{
+  auto &buffers = groups[group];
+  io_uring_buf_ring_add(buffers.ring, buffers.buffer(bid),
+                        static_cast<unsigned>(buffers.size), bid,
+                        io_uring_buf_ring_mask(buffers.count), 0);
+  io_uring_buf_ring_advance(buffers.ring, 1);
+  if (budget)
+    budget->release(buffers.size);
+
+  if (!starved.empty())
+  {
+    auto *conn = starved.back();
+    starved.pop_back();
+
+    if (!conn->receiving)
+    {
+      conn->receiving = true;
+      arm_recv(get_sqe(), conn->fd, conn, conn->group);
+    }
+  }
+}
+
+uring_segment_service::read_context::read_context(async_context &ctx,
+                                                  std::uint16_t group,
+                                                  std::uint16_t bid) noexcept
+    : ctx_{&ctx}, group_{group}, bid_{bid}
+{
+  if (ctx_->budget)
+    ctx_->budget->charge(ctx_->groups[group_].size);
+}
+
+uring_segment_service::read_context::~read_context()
+{
+  ctx_->recycle(group_, bid_);
+}
+
+uring_segment_service::uring_segment_service(
+    const sockaddr *address, socklen_t len,
+    const segment_options &options) noexcept
+    : options_{options},
+      admission_{options.admission
+                     ? options.admission
+                     : std::make_shared<detail::admission_control>(
+                           options.max_connections,
+                           options.max_connections_per_source)},
+      address_len_{len}
+{
+  std::memcpy(&address_, address, len);
+}
+
+uring_segment_service::~uring_segment_service() = default;
+
+auto uring_segment_service::initialize(int sock) const noexcept
+    -> std::error_code
+{
+  if (auto error = options_.tuning.apply_listener(sock))
+    return error;
+
+  int enable = 1;
+  if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)))
+    return {errno, std::system_category()};
+
+  if (options_.reuse_port &&
+      setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)))
+  {
+    return {errno, std::system_category()};
+  }
+
+  // Accepted sockets inherit the busy-polling window.
+  if (int usecs = static_cast<int>(options_.busy_poll_usecs);
+      usecs &&
+      setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)))
+  {
+    return {errno, std::system_category()};
+  }
+
+  return {};
+}
+
+auto uring_segment_service::adopt(int listener) noexcept -> void
+{
+  listener_.store(listener, std::memory_order_relaxed);
+}
+
+auto uring_segment_service::listener() const noexcept -> int
+{
+  return listener_.load(std::memory_order_acquire);
+}
+
+auto uring_segment_service::drain() noexcept -> void
+{
+  draining_.store(true, std::memory_order_relaxed);
+}
+
+auto uring_segment_service::run(std::stop_token token) -> std::error_code
+{
+  using clock_type = std::chrono::steady_clock;
+
+  auto large_count = options_.uring_large_buffer_count;
+  if (!valid_ring_size(options_.uring_buffer_count) ||
+      (large_count && !valid_ring_size(large_count)))
+  {
+    return std::make_error_code(std::errc::invalid_argument);
+  }
+
+  auto ctx = async_context{};
+  auto &small = ctx.groups[async_context::small_group];
+  small.size = options_.uring_buffer_size;
+  small.count = static_cast<unsigned>(options_.uring_buffer_count);
+  auto &large = ctx.groups[async_context::large_group];
+  large.size = options_.uring_large_buffer_size;
+  large.count = static_cast<unsigned>(large_count);
+  ctx.budget = options_.memory_budget.get();
+
+  auto params = io_uring_params{};
+  params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+
+  // Spinning on the completion queue only enters the kernel when it flags
+  // that there are completions to run.
+  if (options_.busy_poll_usecs)
+    params.flags |= IORING_SETUP_TASKRUN_FLAG;
+  if (int ret = io_uring_queue_init_params(async_context::entries, &ctx.ring,
+                                           &params);
+      ret < 0)
+  {
+    return {-ret, std::system_category()};
+  }
+  io_uring_register_ring_fd(&ctx.ring);
+
+  auto error = setup_group(ctx.ring, small, async_context::small_group);
+  if (!error && large.count)
+    error = setup_group(ctx.ring, large, async_context::large_group);
+
+  // An adopted listener is already bound and listening.
+  ctx.listener = listener_.exchange(-1, std::memory_order_relaxed);
+  auto adopted = ctx.listener >= 0;
+  if (!error && !adopted)
+  {
+    ctx.listener = ::socket(address_.ss_family, SOCK_STREAM,
+                            address_.ss_family == AF_UNIX ? 0 : IPPROTO_TCP);
+    if (ctx.listener < 0)
+      error = {errno, std::system_category()};
+  }
+
+  if (!error)
+    error = initialize(ctx.listener);
+
+  if (!error && !adopted &&
+      (::bind(ctx.listener, reinterpret_cast<const sockaddr *>(&address_),
+              address_len_) ||
+       ::listen(ctx.listener, SOMAXCONN)))
+  {
+    error = {errno, std::system_category()};
+  }
+
+  if (!error)
+  {
+    listener_.store(ctx.listener, std::memory_order_release);
+    arm_accept(ctx.get_sqe(), ctx.listener);
+
+    // Wake up periodically to observe stop and drain requests.
+    auto timeout = __kernel_timespec{
+        .tv_sec = 0,
+        .tv_nsec = std::chrono::nanoseconds(async_context::wakeup).count()};
+    auto deadline = clock_type::time_point::max();
+    while (!token.stop_requested())
+    {
+      if (!ctx.draining && draining_.load(std::memory_order_relaxed))
+      {
+        deadline = clock_type::now() + options_.drain_timeout;
+        drain(ctx);
+      }
+
+      // The listening socket is closed once the cancelled accept has
+      // completed, so that no accepted connection is left behind.
+      if (ctx.draining &&
+          ((connections_.empty() && ctx.listener < 0) ||
+           clock_type::now() >= deadline))
+      {
+        break;
+      }
+
+      io_uring_cqe *cqe = nullptr;
+      if (options_.busy_poll_usecs)
+      {
+        spin(ctx.ring, std::chrono::microseconds(options_.busy_poll_usecs),
+             &cqe);
+      }
+
+      if (!cqe)
+        io_uring_submit_and_wait_timeout(&ctx.ring, &cqe, 1, &timeout,
+                                         nullptr);
+
+      ctx.now = clock_type::now();
+      unsigned head = 0;
+      unsigned seen = 0;
+      io_uring_for_each_cqe(&ctx.ring, head, cqe)
+      {
+        complete(ctx, cqe->user_data, cqe->res, cqe->flags);
+        ++seen;
+      }
+      io_uring_cq_advance(&ctx.ring, seen);
+
+      ctx.timers.advance(ctx.now, [&](detail::timer_wheel::timer &timer) {
+        expire(ctx, static_cast<connection *>(timer.owner));
+      });
+
+      if (ctx.accept_retry != clock_type::time_point{} &&
+          ctx.now >= ctx.accept_retry)
+      {
+        ctx.accept_retry = {};
+        arm_accept(ctx.get_sqe(), ctx.listener);
+      }
+
+      // Throttled connections receive again once their limits refill.
+      if (!ctx.throttled.empty())
+      {
+        for (auto *conn : std::exchange(ctx.throttled, {}))
+        {
+          conn->throttled = false;
+          receive(ctx, conn);
+        }
+      }
+    }
+  }
+
+  // Released read contexts must not re-arm connections that are going away.
+  ctx.starved.clear();
+  ctx.throttled.clear();
+  for (auto &[fd, conn] : connections_)
+    ::close(fd);
+  connections_.clear();
+
+  listener_.store(-1, std::memory_order_release);
+  if (ctx.listener >= 0)
+    ::close(ctx.listener);
+  for (std::uint16_t bgid = 0; bgid < ctx.groups.size(); ++bgid)
+  {
+    if (auto &group = ctx.groups[bgid]; group.ring)
+      io_uring_free_buf_ring(&ctx.ring, group.ring, group.count, bgid);
+  }
+  io_uring_queue_exit(&ctx.ring);
+
+  return error;
+}
+
+auto uring_segment_service::service(async_context &ctx, socket_dialog socket,
+                                    const std::shared_ptr<read_context> &rctx,
+                                    std::span<const std::byte> buf) -> void
+{
+  detail::trace::emit(detail::trace::event::service, socket->fd, buf.size());
+
+  // Reads are not messages, so dropping the ones over the rate limits
+  // would corrupt the stream. They are charged instead, and the recv
+  // pauses until the limits have refilled.
+  socket->limiter.charge(buf.size(), ctx.now);
+
+  if (socket->sending &&
+      socket->backlog_since == std::chrono::steady_clock::time_point{})
+  {
+    socket->backlog_since = ctx.now;
+  }
+  socket->queue.push(rctx, buf);
+  if (!socket->sending)
+    flush(ctx, socket);
+}
+
+auto uring_segment_service::operator()(
+    async_context &ctx, socket_dialog socket,
+    const std::shared_ptr<read_context> &rctx,
+    std::span<const std::byte> buf) -> void
+{
+  if (!rctx)
+    return close(ctx, socket);
+
+  detail::trace::emit(detail::trace::event::read, socket->fd, buf.size());
+  service(ctx, socket, rctx, buf);
+}
+
+auto uring_segment_service::flush(async_context &ctx, socket_dialog socket)
+    -> void
+{
+  using buffer_type = detail::write_queue::buffer_type;
+
+  auto buffers = std::array<buffer_type, detail::write_queue::max_buffers>{};
+  auto limit = std::clamp<std::size_t>(options_.max_send_buffers, 1,
+                                       buffers.size());
+  auto count = socket->queue.gather(std::span(buffers).first(limit));
+
+  socket->inflight = 0;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    socket->iov[i] = {.iov_base = const_cast<std::byte *>(buffers[i].data()),
+                      .iov_len = buffers[i].size()};
+    socket->inflight += buffers[i].size();
+  }
+  // Nothing waits behind this send if it takes the whole queue.
+  if (count == socket->queue.size())
+    socket->backlog_since = {};
+  socket->msg = {};
+  socket->msg.msg_iov = socket->iov.data();
+  socket->msg.msg_iovlen = count;
+
+  // Cork the write if the rest of the queue follows immediately.
+  auto flags = MSG_NOSIGNAL | (socket->queue.size() > count ? MSG_MORE : 0);
+  socket->sending = true;
+  arm_timeout(ctx, socket);
+  detail::trace::emit(detail::trace::event::send_submit, socket->fd,
+                      socket->inflight);
+
+  // A recv that waits for the queue to be written is linked behind the
+  // send that takes all of it. A short send breaks the link, and the
+  // cancelled recv is re-armed once the rest has been written.
+  auto linked = socket->paused && !socket->receiving &&
+                count == socket->queue.size() && !socket->closed &&
+                !ctx.draining;
+  if (linked && io_uring_sq_space_left(&ctx.ring) < 2)
+    io_uring_submit(&ctx.ring);
+
+  auto *sqe = ctx.get_sqe();
+  io_uring_prep_sendmsg(sqe, socket->fd, &socket->msg,
+                        static_cast<unsigned>(flags));
+  io_uring_sqe_set_data64(sqe, encode(socket, send));
+  if (linked)
+  {
+    sqe->flags |= IOSQE_IO_LINK;
+    socket->paused = false;
+    socket->group = ctx.group_of(*socket);
+    socket->receiving = true;
+    arm_recv(ctx.get_sqe(), socket->fd, socket, socket->group);
+  }
+}
+
+auto uring_segment_service::complete(async_context &ctx,
+                                     std::uint64_t user_data, int res,
+                                     std::uint32_t flags) -> void
+{
+  auto op = static_cast<operation>(user_data & operation_mask);
+  // NOLINTNEXTLINE(performance-no-int-to-ptr)
+  auto *conn = reinterpret_cast<connection *>(user_data & ~operation_mask);
+
+  switch (op)
+  {
+    case accept:
+    {
+      // Only the per-source cap needs the peer address.
+      auto source = detail::admission_control::source_type{};
+      if (res >= 0 && options_.max_connections_per_source)
+        source = detail::admission_control::source(res);
+
+      if (res >= 0 && *admission_ && !admission_->admit(source))
+      {
+        detail::metrics::local().add(detail::metrics::counter::rejected);
+        ::close(res);
+      }
+      else if (res >= 0)
+      {
+        // Quickack mode is the only tuning option that is not inherited.
+        if (int enable = 1; options_.tuning.quickack)
+        {
+          ::setsockopt(res, IPPROTO_TCP, TCP_QUICKACK, &enable,
+                       sizeof(enable));
+        }
+
+        auto &state = connections_[res];
+        state = std::make_unique<connection>();
+        state->fd = res;
+        state->source = source;
+        state->admitted = static_cast<bool>(*admission_);
+        state->limiter = detail::rate_limiter(
+            options_.rate_limit_bytes, options_.rate_limit_messages,
+            options_.rate_limit_burst, ctx.now);
+        // The idle timeout also bounds the TLS handshake.
+        state->timeout.owner = state.get();
+        arm_timeout(ctx, state.get());
+        // Connections start on small buffers and grow into large ones.
+        const auto &large = ctx.groups[async_context::large_group];
+        auto size = ctx.groups[async_context::small_group].size;
+        state->sizer =
+            detail::read_sizer(size, large.count ? large.size : size);
+#ifdef CB_SEGMENT_HAS_KTLS
+        if (options_.tls)
+        {
+          state->tls =
+              std::make_unique<detail::tls_session>(*options_.tls, res);
+          handshake(ctx, state.get());
+        }
+        else
+#endif
+        {
+          receive(ctx, state.get());
+        }
+      }
+      // An accept that fails, e.g. with -EMFILE, fails again at once, so
+      // it is armed again on a later wake-up instead of spinning.
+      auto failed = res < 0 && res != -ECANCELED;
+      if (failed)
+        detail::metrics::local().add(detail::metrics::counter::errors);
+      if (!(flags & IORING_CQE_F_MORE))
+      {
+        // The accept of a draining event loop ends when it is cancelled.
+        if (ctx.draining)
+        {
+          if (ctx.listener >= 0)
+            ::close(std::exchange(ctx.listener, -1));
+        }
+        else if (failed)
+        {
+          ctx.accept_retry = ctx.now + async_context::wakeup;
+        }
+        else
+        {
+          arm_accept(ctx.get_sqe(), ctx.listener);
+        }
+      }
+      break;
+    }
+
+    case recv:
+    {
+      if (!(flags & IORING_CQE_F_MORE))
+        conn->receiving = false;
+
+      if (res > 0 && (flags & IORING_CQE_F_BUFFER))
+      {
+        auto len = static_cast<std::size_t>(res);
+        auto &group = ctx.groups[conn->group];
+        auto bid =
+            static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        auto rctx = std::allocate_shared<read_context>(
+            detail::pool_allocator<read_context>{}, ctx, conn->group, bid);
+        conn->sizer.record(len, group.size);
+        conn->served = true;
+        (*this)(ctx, conn, rctx, {group.buffer(bid), len});
+
+        // Re-arms a recv that stopped at the end of its buffer, or moves
+        // it to the buffer group that fits the reads. Reads do not hold
+        // off the write timeout of a stalled send.
+        if (!conn->closed)
+        {
+          if (!conn->sending)
+            arm_timeout(ctx, conn);
+          receive(ctx, conn);
+        }
+      }
+      else if (res == -ENOBUFS)
+      {
+        ctx.starved.push_back(conn);
+      }
+      else if (res == -ECANCELED && !conn->closed)
+      {
+        receive(ctx, conn);
+      }
+      else if (!conn->receiving)
+      {
+        (*this)(ctx, conn, nullptr, {});
+      }
+      break;
+    }
+
+    case send:
+    {
+      conn->sending = false;
+      if (res < 0)
+      {
+        conn->queue.clear();
+        return close(ctx, conn);
+      }
+
+      // A short write leaves the unwritten tail at the front of the queue.
+      auto written = static_cast<std::size_t>(res);
+      conn->queue.consume(written);
+      detail::trace::emit(detail::trace::event::send_complete, conn->fd,
+                          written);
+      if (written < conn->inflight)
+      {
+        detail::trace::emit(detail::trace::event::short_write, conn->fd,
+                            conn->inflight - written);
+      }
+
+      // Reads are not messages, so dropping the ones that waited behind
+      // the send past their deadline would corrupt the stream. The
+      // connection is closed instead of sending them late.
+      if (auto deadline = options_.message_deadline;
+          deadline.count() && !conn->queue.empty() &&
+          conn->backlog_since != std::chrono::steady_clock::time_point{} &&
+          ctx.now - conn->backlog_since >= deadline)
+      {
+        detail::metrics::local().add(detail::metrics::counter::expired,
+                                     conn->queue.size());
+        conn->queue.clear();
+        return close(ctx, conn);
+      }
+
+      if (!conn->queue.empty())
+        return flush(ctx, conn);
+
+      // A draining connection is closed as soon as it has nothing to write.
+      if (conn->closed || ctx.draining)
+      {
+        close(ctx, conn);
+      }
+      else
+      {
+        arm_timeout(ctx, conn);
+        receive(ctx, conn);
+      }
+      break;
+    }
+
+    case poll:
+    {
+      conn->polling = false;
+      if (conn->closed)
+        return close(ctx, conn);
+
+      handshake(ctx, conn);
+      break;
+    }
+
+    case cancel:
+      break;
+  }
+}
+
+auto uring_segment_service::arm_timeout(async_context &ctx,
+                                        socket_dialog socket) -> void
+{
+  auto timeout =
+      socket->sending ? options_.write_timeout : options_.idle_timeout;
+  if (timeout.count() && !socket->closed)
+    ctx.timers.schedule(socket->timeout, ctx.now + timeout);
+  else
+    ctx.timers.cancel(socket->timeout);
+}
+
+auto uring_segment_service::expire(async_context &ctx,
+                                   socket_dialog socket) -> void
+{
+  detail::metrics::local().add(detail::metrics::counter::timeouts);
+  // A send that the peer does not read only fails once the socket is
+  // shut down in both directions.
+  if (socket->sending)
+    ::shutdown(socket->fd, SHUT_RDWR);
+  close(ctx, socket);
+}
+
+auto uring_segment_service::handshake(async_context &ctx,
+                                      socket_dialog socket) -> void
+{
+#ifdef CB_SEGMENT_HAS_KTLS
+  using enum detail::tls_session::status;
+
+  // The kTLS socket is read and written like any other from here on.
+  auto status = socket->tls->handshake();
+  if (status == done)
+  {
+    socket->tls.reset();
+    return receive(ctx, socket);
+  }
+
+  if (status == failed)
+    return close(ctx, socket);
+
+  socket->polling = true;
+  auto *sqe = ctx.get_sqe();
+  io_uring_prep_poll_add(sqe, socket->fd,
+                         status == want_read ? POLLIN : POLLOUT);
+  io_uring_sqe_set_data64(sqe, encode(socket, poll));
+#else
+  receive(ctx, socket);
+#endif
+}
+
+auto uring_segment_service::receive(async_context &ctx, socket_dialog socket)
+    -> void
+{
+  // Over the memory budget, connections only receive once the bytes that
+  // they hold have been written, which is what releases the memory.
+  auto paused = ctx.budget && ctx.budget->exhausted() && !socket->queue.empty();
+  auto throttled = socket->limiter && !socket->limiter.ready(ctx.now);
+  auto group = ctx.group_of(*socket);
+
+  // The multishot recv is cancelled to pause it or to move it to another
+  // buffer group, and re-armed when its last completion arrives.
+  if (socket->receiving)
+  {
+    if ((paused || throttled || group != socket->group) &&
+        !socket->cancelling)
+    {
+      socket->cancelling = true;
+      auto *sqe = ctx.get_sqe();
+      io_uring_prep_cancel64(sqe, encode(socket, recv), 0);
+      io_uring_sqe_set_data64(sqe, encode(socket, cancel));
+    }
+    return;
+  }
+
+  socket->cancelling = false;
+  socket->paused = paused && !throttled;
+  if (throttled && !std::exchange(socket->throttled, true))
+  {
+    detail::metrics::local().add(detail::metrics::counter::throttled);
+    ctx.throttled.push_back(socket);
+  }
+  if (paused || throttled)
+    return;
+
+  socket->group = group;
+  socket->receiving = true;
+  arm_recv(ctx.get_sqe(), socket->fd, socket, group);
+}
+
+auto uring_segment_service::drain(async_context &ctx) -> void
+{
+  ctx.draining = true;
+
+  // The listening socket is closed when the multishot accept completes
+  // with -ECANCELED, so that the accept never refers to a closed socket.
+  // An accept that waits to be armed again refers to nothing yet.
+  if (ctx.accept_retry != std::chrono::steady_clock::time_point{})
+  {
+    ctx.accept_retry = {};
+    if (ctx.listener >= 0)
+      ::close(std::exchange(ctx.listener, -1));
+  }
+  else
+  {
+    auto *sqe = ctx.get_sqe();
+    io_uring_prep_cancel64(sqe, encode(nullptr, accept), 0);
+    io_uring_sqe_set_data64(sqe, encode(nullptr, cancel));
+  }
+
+  // A connection that has not sent anything yet may have been accepted
+  // just before the drain, so it is served once before it is closed.
+  auto idle = std::vector<connection *>{};
+  for (auto &[fd, conn] : connections_)
+  {
+    if (conn->served && !conn->sending && conn->queue.empty())
+      idle.push_back(conn.get());
+  }
+  for (auto *conn : idle)
+    close(ctx, conn);
+}
+
+auto uring_segment_service::close(async_context &ctx, socket_dialog socket)
+    -> void
+{
+  if (!socket->closed)
+  {
+    socket->closed = true;
+    // Terminates the multishot recv if it is still armed.
+    ::shutdown(socket->fd, SHUT_RD);
+  }
+
+  // A handshake that waits for the socket ends when its poll is
+  // cancelled.
+  if (socket->polling)
+  {
+    auto *sqe = ctx.get_sqe();
+    io_uring_prep_cancel64(sqe, encode(socket, poll), 0);
+    io_uring_sqe_set_data64(sqe, encode(socket, cancel));
+    return;
+  }
+
+  if (socket->sending || socket->receiving)
+    return;
+
+  std::erase(ctx.starved, socket);
+  std::erase(ctx.throttled, socket);
+  ctx.timers.cancel(socket->timeout);
+  if (socket->admitted)
+    admission_->release(socket->source);
+  ::close(socket->fd);
+  connections_.erase(socket->fd);
+}
+} // namespace cloudbus::segment
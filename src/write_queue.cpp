@@ -0,0 +1,147 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file write_queue.cpp
+ * @brief This file defines the per-connection output queue.
+ */
+#include "segment/detail/write_queue.hpp"
+
+#include <algorithm>
+#include <utility>
+namespace cloudbus::detail {
+
+auto write_queue::push(owner_type owner, buffer_type buf,
+                       clock_type::time_point queued) -> void
+{
+  if (buf.empty())
+    return;
+
+  entries_.push_back(
+      {.owner = std::move(owner), .buf = buf, .queued = queued});
+  bytes_ += buf.size();
+}
+
+auto write_queue::push_frame(owner_type owner, const frame_view &frame,
+                             clock_type::time_point queued) -> void
+{
+  // The message starts at the first buffer that is not empty.
+  auto start = [&](buffer_type buf) noexcept {
+    return buf.empty() ? clock_type::time_point{} : std::exchange(queued, {});
+  };
+
+  push(std::move(owner), frame.head(), start(frame.head()));
+  for (const auto &piece : frame.tail())
+    push(piece.owner, piece.buf, start(piece.buf));
+}
+
+auto write_queue::gather(std::span<buffer_type> out) const noexcept
+    -> std::size_t
+{
+  auto count = std::min(out.size(), entries_.size());
+  for (std::size_t i = 0; i < count; ++i)
+    out[i] = entries_[i].buf;
+
+  return count;
+}
+
+auto write_queue::consume(std::size_t len) noexcept -> void
+{
+  while (len && !entries_.empty())
+  {
+    auto &front = entries_.front();
+    if (len < front.buf.size())
+    {
+      // A partly written message can no longer be dropped.
+      front.buf = front.buf.subspan(len);
+      front.queued = {};
+      bytes_ -= len;
+      return;
+    }
+
+    len -= front.buf.size();
+    bytes_ -= front.buf.size();
+    entries_.pop_front();
+  }
+}
+
+auto write_queue::consume(std::size_t len, std::vector<owner_type> &released)
+    -> void
+{
+  while (len && !entries_.empty())
+  {
+    auto &front = entries_.front();
+    if (len < front.buf.size())
+    {
+      released.push_back(front.owner);
+      front.buf = front.buf.subspan(len);
+      front.queued = {};
+      bytes_ -= len;
+      return;
+    }
+
+    len -= front.buf.size();
+    bytes_ -= front.buf.size();
+    released.push_back(std::move(front.owner));
+    entries_.pop_front();
+  }
+}
+
+auto write_queue::expire(clock_type::time_point cutoff) noexcept
+    -> std::size_t
+{
+  auto count = std::size_t{0};
+  auto timed = [&]() noexcept {
+    return !entries_.empty() &&
+           entries_.front().queued != clock_type::time_point{};
+  };
+
+  while (timed() && entries_.front().queued <= cutoff)
+  {
+    // The rest of the message goes with its first buffer.
+    do
+    {
+      bytes_ -= entries_.front().buf.size();
+      entries_.pop_front();
+    } while (!entries_.empty() && !timed());
+    ++count;
+  }
+
+  return count;
+}
+
+auto write_queue::oldest() const noexcept -> clock_type::time_point
+{
+  auto it = std::ranges::find_if(entries_, [](const entry &entry) noexcept {
+    return entry.queued != clock_type::time_point{};
+  });
+  return it == entries_.end() ? clock_type::time_point{} : it->queued;
+}
+
+auto write_queue::size() const noexcept -> std::size_t
+{
+  return entries_.size();
+}
+
+auto write_queue::bytes() const noexcept -> std::size_t { return bytes_; }
+
+auto write_queue::empty() const noexcept -> bool { return entries_.empty(); }
+
+auto write_queue::clear() noexcept -> void
+{
+  entries_.clear();
+  bytes_ = 0;
+}
+} // namespace cloudbus::detail
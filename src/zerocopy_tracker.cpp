@@ -0,0 +1,94 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file zerocopy_tracker.cpp
+ * @brief This file defines the tracker for in-flight MSG_ZEROCOPY sends.
+ */
+#include "segment/detail/zerocopy_tracker.hpp"
+
+#include <array>
+#include <cstring>
+
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+namespace cloudbus::detail {
+namespace {
+/**
+ * @brief Checks whether a control message carries a socket error.
+ * @param cmsg The control message.
+ * @return True if the control message is an IPv4 or IPv6 socket error.
+ */
+auto is_recverr(const cmsghdr *cmsg) noexcept -> bool
+{
+  return (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+         (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+}
+} // namespace
+
+auto zerocopy_tracker::push(std::vector<owner_type> owners) -> void
+{
+  sends_.push_back({.id = next_++, .owners = std::move(owners)});
+}
+
+auto zerocopy_tracker::release(std::uint32_t lo, std::uint32_t hi) noexcept
+    -> void
+{
+  // Send numbers wrap around, so compare them by their distance from lo.
+  auto span = hi - lo;
+  std::erase_if(sends_,
+                [&](const send &send) { return send.id - lo <= span; });
+}
+
+auto zerocopy_tracker::reap(int fd) -> std::size_t
+{
+  std::size_t count = 0;
+  alignas(cmsghdr) auto control =
+      std::array<char, CMSG_SPACE(sizeof(sock_extended_err)) * 4>{};
+
+  while (!sends_.empty())
+  {
+    auto msg = msghdr{};
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      break;
+
+    for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if (!is_recverr(cmsg))
+        continue;
+
+      auto err = sock_extended_err{};
+      std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+      if (err.ee_errno || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+
+      release(err.ee_info, err.ee_data);
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+auto zerocopy_tracker::pending() const noexcept -> std::size_t
+{
+  return sends_.size();
+}
+} // namespace cloudbus::detail
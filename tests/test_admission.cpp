@@ -0,0 +1,186 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/admission.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cloudbus::detail;
+using namespace std::chrono_literals;
+
+class AdmissionTest : public ::testing::Test {
+protected:
+  using clock_type = token_bucket::clock_type;
+
+  static auto ipv4(const char *octets) -> sockaddr_storage
+  {
+    auto address = sockaddr_storage{};
+    auto *in = reinterpret_cast<sockaddr_in *>(&address);
+    in->sin_family = AF_INET;
+    std::memcpy(&in->sin_addr, octets, 4);
+    return address;
+  }
+
+  clock_type::time_point start = clock_type::now();
+};
+
+TEST_F(AdmissionTest, BucketRefillsAtItsRate)
+{
+  auto bucket = token_bucket(1000, 10, start);
+  ASSERT_TRUE(bucket);
+
+  EXPECT_TRUE(bucket.allows(10, start));
+  bucket.charge(10, start);
+  EXPECT_FALSE(bucket.allows(1, start));
+
+  // One token per millisecond, up to the burst.
+  EXPECT_FALSE(bucket.allows(5, start + 4ms));
+  EXPECT_TRUE(bucket.allows(5, start + 5ms));
+  bucket.charge(5, start + 5ms);
+  EXPECT_TRUE(bucket.allows(10, start + 1s));
+}
+
+TEST_F(AdmissionTest, LargeUnitsPassAFullBucket)
+{
+  auto bucket = token_bucket(1000, 10, start);
+
+  // A unit larger than the bucket leaves it in debt.
+  EXPECT_TRUE(bucket.allows(100, start));
+  bucket.charge(100, start);
+  EXPECT_FALSE(bucket.allows(1, start + 50ms));
+  EXPECT_FALSE(bucket.allows(100, start + 99ms));
+  EXPECT_TRUE(bucket.allows(100, start + 110ms));
+}
+
+TEST_F(AdmissionTest, UnlimitedBucket)
+{
+  auto bucket = token_bucket{};
+  EXPECT_FALSE(bucket);
+  for (int i = 0; i < 100; ++i)
+  {
+    bucket.charge(1UL << 30, start);
+    EXPECT_TRUE(bucket.allows(1UL << 30, start));
+  }
+}
+
+TEST_F(AdmissionTest, LimiterChargesReadsIntoDebt)
+{
+  auto limiter = rate_limiter(100, 0, 1000ms, start);
+  ASSERT_TRUE(limiter.ready(start));
+
+  // A read far larger than the bucket is charged in full.
+  limiter.charge(300, start);
+  EXPECT_FALSE(limiter.ready(start));
+  EXPECT_FALSE(limiter.ready(start + 2000ms));
+  EXPECT_TRUE(limiter.ready(start + 2010ms));
+
+  auto unlimited = rate_limiter{};
+  unlimited.charge(1UL << 30, start);
+  EXPECT_TRUE(unlimited.ready(start));
+}
+
+TEST_F(AdmissionTest, CapsConnections)
+{
+  auto admission = admission_control(2, 0);
+  ASSERT_TRUE(admission);
+
+  auto from = admission_control::source(ipv4("\x0a\x00\x00\x01"));
+  EXPECT_TRUE(admission.admit(from));
+  EXPECT_TRUE(admission.admit(from));
+  EXPECT_FALSE(admission.admit(from));
+  EXPECT_EQ(admission.connections(), 2);
+
+  admission.release(from);
+  EXPECT_TRUE(admission.admit(from));
+  EXPECT_FALSE(admission_control{});
+}
+
+TEST_F(AdmissionTest, CapsConnectionsPerSource)
+{
+  auto admission = admission_control(0, 1);
+  auto a = admission_control::source(ipv4("\x0a\x00\x00\x01"));
+  auto b = admission_control::source(ipv4("\x0a\x00\x00\x02"));
+
+  EXPECT_TRUE(admission.admit(a));
+  EXPECT_FALSE(admission.admit(a));
+  EXPECT_TRUE(admission.admit(b));
+  EXPECT_EQ(admission.connections(), 2);
+
+  admission.release(a);
+  EXPECT_TRUE(admission.admit(a));
+  EXPECT_FALSE(admission.admit(a));
+}
+
+TEST_F(AdmissionTest, CapsConnectionsAcrossThreads)
+{
+  auto admission = admission_control(10, 5);
+  auto a = admission_control::source(ipv4("\x0a\x00\x00\x01"));
+  auto b = admission_control::source(ipv4("\x0a\x00\x00\x02"));
+
+  // Reactors that share the admission control share its caps.
+  auto admitted = std::atomic<int>{0};
+  auto threads = std::vector<std::thread>{};
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([&, from = i % 2 ? a : b] {
+      for (int j = 0; j < 100; ++j)
+      {
+        if (admission.admit(from))
+          ++admitted;
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  EXPECT_EQ(admitted, 10);
+  EXPECT_EQ(admission.connections(), 10);
+}
+
+TEST_F(AdmissionTest, MapsIpv4IntoIpv6)
+{
+  auto mapped = sockaddr_storage{};
+  auto *in6 = reinterpret_cast<sockaddr_in6 *>(&mapped);
+  in6->sin6_family = AF_INET6;
+  in6->sin6_addr.s6_addr[10] = 0xff;
+  in6->sin6_addr.s6_addr[11] = 0xff;
+  in6->sin6_addr.s6_addr[12] = 10;
+  in6->sin6_addr.s6_addr[15] = 1;
+
+  EXPECT_EQ(admission_control::source(mapped),
+            admission_control::source(ipv4("\x0a\x00\x00\x01")));
+}
+
+TEST_F(AdmissionTest, UnixPeersShareASource)
+{
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  EXPECT_EQ(admission_control::source(fds[0]),
+            admission_control::source_type{});
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+// NOLINTEND
@@ -0,0 +1,98 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/buffer_pool.hpp"
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class BufferPoolTest : public ::testing::Test {};
+
+TEST_F(BufferPoolTest, SizeClass)
+{
+  EXPECT_EQ(buffer_pool::size_class(0), 0);
+  EXPECT_EQ(buffer_pool::size_class(1), 0);
+  EXPECT_EQ(buffer_pool::size_class(64), 0);
+  EXPECT_EQ(buffer_pool::size_class(65), 1);
+  EXPECT_EQ(buffer_pool::size_class(4096), 6);
+  EXPECT_EQ(buffer_pool::size_class(buffer_pool::max_size),
+            buffer_pool::classes - 1);
+  EXPECT_EQ(buffer_pool::size_class(buffer_pool::max_size + 1),
+            buffer_pool::classes);
+}
+
+TEST_F(BufferPoolTest, RecyclesBlocks)
+{
+  auto pool = buffer_pool{};
+
+  auto *first = pool.allocate(100);
+  pool.deallocate(first, 100);
+  EXPECT_EQ(pool.cached_bytes(), 128);
+
+  // Any size in the same size class reuses the cached block.
+  auto *second = pool.allocate(128);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(pool.cached_bytes(), 0);
+
+  pool.deallocate(second, 128);
+}
+
+TEST_F(BufferPoolTest, BoundsCachedBytes)
+{
+  auto pool = buffer_pool{};
+  auto blocks = std::vector<void *>{};
+  auto count = buffer_pool::max_cached_bytes / buffer_pool::max_size + 4;
+
+  for (std::size_t i = 0; i < count; ++i)
+    blocks.push_back(pool.allocate(buffer_pool::max_size));
+  for (auto *block : blocks)
+    pool.deallocate(block, buffer_pool::max_size);
+
+  EXPECT_EQ(pool.cached_bytes(), buffer_pool::max_cached_bytes);
+}
+
+TEST_F(BufferPoolTest, LargeAllocationsBypassPool)
+{
+  auto pool = buffer_pool{};
+
+  auto *block = pool.allocate(buffer_pool::max_size + 1);
+  ASSERT_NE(block, nullptr);
+  pool.deallocate(block, buffer_pool::max_size + 1);
+  EXPECT_EQ(pool.cached_bytes(), 0);
+}
+
+TEST_F(BufferPoolTest, AllocateShared)
+{
+  struct payload {
+    std::array<std::byte, 4096> buffer;
+  };
+
+  auto &pool = buffer_pool::local();
+  auto cached = pool.cached_bytes();
+  {
+    auto ptr = std::allocate_shared<payload>(pool_allocator<payload>{});
+    ASSERT_NE(ptr, nullptr);
+  }
+  EXPECT_GT(pool.cached_bytes(), cached);
+
+  auto other = std::thread([&] { EXPECT_NE(&buffer_pool::local(), &pool); });
+  other.join();
+}
+// NOLINTEND
@@ -0,0 +1,75 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/byte_scan.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class ByteScanTest : public ::testing::Test {};
+
+TEST_F(ByteScanTest, ReportsKernel)
+{
+  auto kernel = find_byte_kernel();
+  EXPECT_TRUE(kernel == "avx2" || kernel == "neon" || kernel == "memchr");
+}
+
+TEST_F(ByteScanTest, EmptyBuffer)
+{
+  EXPECT_EQ(find_byte({}, std::byte{'\n'}), 0);
+}
+
+TEST_F(ByteScanTest, MatchesScalarScan)
+{
+  constexpr auto needle = std::byte{'\n'};
+  auto storage = std::vector<std::byte>(512, std::byte{'a'});
+
+  // Cover every offset and tail length around the vector widths.
+  for (std::size_t offset = 0; offset < 64; ++offset)
+  {
+    for (std::size_t size = 0; size + offset <= 200; ++size)
+    {
+      auto buf = std::span<const std::byte>(storage).subspan(offset, size);
+      EXPECT_EQ(find_byte(buf, needle), size);
+
+      for (std::size_t pos = 0; pos < size; pos += 7)
+      {
+        storage[offset + pos] = needle;
+        if (pos + 3 < size)
+          storage[offset + pos + 3] = needle;
+
+        auto expected = static_cast<std::size_t>(
+            std::ranges::find(buf, needle) - buf.begin());
+        ASSERT_EQ(find_byte(buf, needle), expected)
+            << "offset " << offset << " size " << size << " pos " << pos;
+
+        std::ranges::fill(storage, std::byte{'a'});
+      }
+    }
+  }
+}
+
+TEST_F(ByteScanTest, FindsHighBytes)
+{
+  auto storage = std::vector<std::byte>(100, std::byte{0x7f});
+  storage[70] = std::byte{0xff};
+  EXPECT_EQ(find_byte(storage, std::byte{0xff}), 70);
+  EXPECT_EQ(find_byte(storage, std::byte{0x80}), storage.size());
+}
+// NOLINTEND
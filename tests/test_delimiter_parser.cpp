@@ -0,0 +1,159 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/delimiter_parser.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class DelimiterParserTest : public ::testing::Test {
+protected:
+  using buffer_type = delimiter_parser::buffer_type;
+
+  static auto to_buffer(std::string_view str) -> buffer_type
+  {
+    return std::as_bytes(std::span(str));
+  }
+
+  static auto to_string(buffer_type buf) -> std::string
+  {
+    return {reinterpret_cast<const char *>(buf.data()), buf.size()};
+  }
+
+  static auto to_string(const frame_view &frame) -> std::string
+  {
+    auto str = to_string(frame.head());
+    for (const auto &piece : frame.tail())
+      str += to_string(piece.buf);
+    return str;
+  }
+};
+
+TEST_F(DelimiterParserTest, ParsesCompleteFrames)
+{
+  auto parser = delimiter_parser{};
+  auto stream = std::string_view{"hello\n\nworld\n"};
+  auto buf = to_buffer(stream);
+
+  auto frames = std::vector<std::string>{};
+  for (auto frame : parser.parse(buf))
+  {
+    EXPECT_FALSE(frame.split());
+    EXPECT_GE(frame.head().data(), buf.data());
+    EXPECT_EQ(parser.owner(), nullptr);
+    frames.push_back(to_string(frame));
+  }
+
+  EXPECT_EQ(frames, (std::vector<std::string>{"hello\n", "\n", "world\n"}));
+  EXPECT_EQ(parser.pending(), 0);
+  EXPECT_FALSE(parser.error());
+}
+
+TEST_F(DelimiterParserTest, ReassemblesSplitFrames)
+{
+  auto parser = delimiter_parser{std::byte{';'}};
+  auto stream = std::string{"first;second;"};
+  auto buf = to_buffer(stream);
+
+  auto frames = std::vector<std::string>{};
+  for (std::size_t i = 0; i < buf.size(); i += 4)
+  {
+    for (auto frame :
+         parser.parse(buf.subspan(i, std::min<std::size_t>(4, buf.size() - i))))
+    {
+      frames.push_back(to_string(frame));
+    }
+  }
+
+  EXPECT_EQ(frames, (std::vector<std::string>{"first;", "second;"}));
+  EXPECT_EQ(parser.pending(), 0);
+}
+
+TEST_F(DelimiterParserTest, KeepsOnlyTheSplitTail)
+{
+  auto parser = delimiter_parser{};
+
+  auto count = 0;
+  for (auto frame : parser.parse(to_buffer("one\ntw")))
+  {
+    EXPECT_EQ(to_string(frame), "one\n");
+    ++count;
+  }
+  EXPECT_EQ(parser.pending(), 2);
+
+  for (auto frame : parser.parse(to_buffer("o\nthree\n")))
+  {
+    EXPECT_EQ(to_string(frame), count == 1 ? "two\n" : "three\n");
+    EXPECT_EQ(parser.owner() != nullptr, count == 1);
+    ++count;
+  }
+  EXPECT_EQ(count, 3);
+  EXPECT_EQ(parser.pending(), 0);
+}
+
+TEST_F(DelimiterParserTest, KeepsFramesSpanningReadsInPlace)
+{
+  auto parser = delimiter_parser{};
+  auto reads = std::vector<std::shared_ptr<std::string>>{
+      std::make_shared<std::string>("one\nspa"),
+      std::make_shared<std::string>("ns th"),
+      std::make_shared<std::string>("ree r"),
+      std::make_shared<std::string>("eads\n")};
+
+  auto frames = std::vector<std::string>{};
+  for (const auto &read : reads)
+  {
+    for (auto frame : parser.parse(to_buffer(*read), read))
+    {
+      if (frame.split())
+      {
+        // No byte of the frame was copied, every piece is a read buffer.
+        EXPECT_EQ(frame.head().data(), to_buffer(*reads[0]).data() + 4);
+        EXPECT_EQ(parser.owner(), reads[0]);
+        ASSERT_EQ(frame.tail().size(), 3);
+        for (std::size_t j = 0; j < 3; ++j)
+          EXPECT_EQ(frame.tail()[j].owner, reads[j + 1]);
+      }
+      frames.push_back(to_string(frame));
+    }
+  }
+
+  EXPECT_EQ(frames,
+            (std::vector<std::string>{"one\n", "spans three reads\n"}));
+  for (const auto &read : reads)
+    EXPECT_EQ(read.use_count(), 1);
+}
+
+TEST_F(DelimiterParserTest, RejectsOversizedFrames)
+{
+  auto parser = delimiter_parser{std::byte{'\n'}, 4};
+
+  auto count = 0;
+  for ([[maybe_unused]] auto frame : parser.parse(to_buffer("ok\ntoo")))
+    ++count;
+  EXPECT_EQ(count, 1);
+  EXPECT_FALSE(parser.error());
+
+  for ([[maybe_unused]] auto frame : parser.parse(to_buffer(" long\n")))
+    ++count;
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ(parser.error(), std::errc::message_size);
+}
+// NOLINTEND
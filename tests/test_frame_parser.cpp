@@ -0,0 +1,225 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/frame_parser.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class FrameParserTest : public ::testing::Test {
+protected:
+  using buffer_type = frame_parser::buffer_type;
+
+  static auto encode(const std::string &payload) -> std::vector<std::byte>
+  {
+    auto len = payload.size();
+    auto frame = std::vector<std::byte>{
+        std::byte(len >> 24U), std::byte(len >> 16U), std::byte(len >> 8U),
+        std::byte(len)};
+    for (auto c : payload)
+      frame.push_back(std::byte(c));
+    return frame;
+  }
+
+  static auto to_string(buffer_type buf) -> std::string
+  {
+    return {reinterpret_cast<const char *>(buf.data()), buf.size()};
+  }
+
+  static auto to_string(const frame_view &frame) -> std::string
+  {
+    auto str = to_string(frame.head());
+    for (const auto &piece : frame.tail())
+      str += to_string(piece.buf);
+    return str;
+  }
+};
+
+TEST_F(FrameParserTest, ParsesCompleteFrames)
+{
+  auto parser = frame_parser{};
+  auto stream = encode("hello");
+  auto second = encode("");
+  auto third = encode("world");
+  stream.insert(stream.end(), second.begin(), second.end());
+  stream.insert(stream.end(), third.begin(), third.end());
+
+  auto payloads = std::vector<std::string>{};
+  for (auto frame : parser.parse(stream))
+  {
+    // Frames within the read buffer are not copied.
+    EXPECT_FALSE(frame.split());
+    EXPECT_GE(frame.head().data(), stream.data());
+    EXPECT_LE(frame.head().data() + frame.size(),
+              stream.data() + stream.size());
+    EXPECT_EQ(parser.owner(), nullptr);
+    payloads.push_back(to_string(frame_parser::payload(frame)));
+  }
+
+  EXPECT_EQ(payloads, (std::vector<std::string>{"hello", "", "world"}));
+  EXPECT_EQ(parser.pending(), 0);
+  EXPECT_FALSE(parser.error());
+}
+
+TEST_F(FrameParserTest, ReassemblesSplitFrames)
+{
+  auto parser = frame_parser{};
+  auto stream = encode("hello");
+  auto second = encode("world");
+  stream.insert(stream.end(), second.begin(), second.end());
+
+  // Split every frame, including its header, across reads that have no
+  // owners, so the frames are copied.
+  auto payloads = std::vector<std::string>{};
+  auto buf = buffer_type(stream);
+  for (std::size_t i = 0; i < buf.size(); i += 3)
+  {
+    for (auto frame : parser.parse(buf.subspan(i, std::min<std::size_t>(
+                                                      3, buf.size() - i))))
+    {
+      EXPECT_NE(parser.owner(), nullptr);
+      payloads.push_back(to_string(frame_parser::payload(frame)));
+    }
+  }
+
+  EXPECT_EQ(payloads, (std::vector<std::string>{"hello", "world"}));
+  EXPECT_EQ(parser.pending(), 0);
+}
+
+TEST_F(FrameParserTest, KeepsOnlyTheSplitTail)
+{
+  auto parser = frame_parser{};
+  auto stream = encode("first");
+  auto second = encode("second");
+  stream.insert(stream.end(), second.begin(), second.end());
+
+  auto split = stream.size() - 2;
+  auto count = 0;
+  for (auto frame : parser.parse(buffer_type(stream).first(split)))
+  {
+    EXPECT_EQ(to_string(frame_parser::payload(frame)), "first");
+    ++count;
+  }
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ(parser.pending(), second.size() - 2);
+
+  auto owner = frame_parser::owner_type{};
+  for (auto frame : parser.parse(buffer_type(stream).subspan(split)))
+  {
+    owner = parser.owner();
+    EXPECT_EQ(to_string(frame_parser::payload(frame)), "second");
+    ++count;
+  }
+  EXPECT_EQ(count, 2);
+  EXPECT_NE(owner, nullptr);
+  EXPECT_EQ(parser.pending(), 0);
+}
+
+TEST_F(FrameParserTest, KeepsFramesSpanningReadsInPlace)
+{
+  auto parser = frame_parser{};
+  auto stream = encode("a frame that spans four reads");
+
+  // Each read buffer is owned by the read context that it was read into.
+  auto reads = std::vector<std::shared_ptr<std::vector<std::byte>>>{};
+  for (std::size_t i = 0; i < stream.size(); i += 8)
+  {
+    auto end = stream.begin() + std::min(i + 8, stream.size());
+    reads.push_back(std::make_shared<std::vector<std::byte>>(
+        stream.begin() + i, end));
+  }
+  ASSERT_GE(reads.size(), 4);
+
+  auto count = 0;
+  for (std::size_t i = 0; i < reads.size(); ++i)
+  {
+    for (auto frame : parser.parse(*reads[i], reads[i]))
+    {
+      EXPECT_EQ(i, reads.size() - 1);
+      EXPECT_EQ(to_string(frame_parser::payload(frame)),
+                "a frame that spans four reads");
+
+      // No byte of the frame was copied, every piece is a read buffer.
+      EXPECT_TRUE(frame.split());
+      EXPECT_EQ(frame.head().data(), reads[0]->data());
+      EXPECT_EQ(parser.owner(), reads[0]);
+      ASSERT_EQ(frame.tail().size(), reads.size() - 1);
+      for (std::size_t j = 0; j < frame.tail().size(); ++j)
+      {
+        EXPECT_EQ(frame.tail()[j].buf.data(), reads[j + 1]->data());
+        EXPECT_EQ(frame.tail()[j].owner, reads[j + 1]);
+      }
+      ++count;
+    }
+  }
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ(parser.pending(), 0);
+
+  // The read buffers are released once the frame has been handled.
+  for (const auto &read : reads)
+    EXPECT_EQ(read.use_count(), 1);
+}
+
+TEST_F(FrameParserTest, CopiesOnlyASplitHead)
+{
+  auto parser = frame_parser{frame_parser::header_size + 64, 8};
+  auto stream = encode("abcdefghijklmnop");
+
+  auto first = std::make_shared<std::vector<std::byte>>(stream.begin(),
+                                                        stream.begin() + 2);
+  auto second = std::make_shared<std::vector<std::byte>>(stream.begin() + 2,
+                                                         stream.end());
+
+  auto count = 0;
+  for ([[maybe_unused]] auto frame : parser.parse(*first, first))
+    ++count;
+  EXPECT_EQ(parser.pending(), 2);
+
+  for (auto frame : parser.parse(*second, second))
+  {
+    // The head is filled up to the head size, the rest stays in place.
+    EXPECT_EQ(frame.head().size(), 8);
+    EXPECT_NE(parser.owner(), first);
+    ASSERT_EQ(frame.tail().size(), 1);
+    EXPECT_EQ(frame.tail()[0].buf.data(), second->data() + 6);
+    EXPECT_EQ(to_string(frame_parser::payload(frame)), "abcdefghijklmnop");
+    ++count;
+  }
+  EXPECT_EQ(count, 1);
+}
+
+TEST_F(FrameParserTest, RejectsOversizedFrames)
+{
+  auto parser = frame_parser{frame_parser::header_size + 4};
+  auto stream = encode("ok");
+  auto second = encode("too long");
+  stream.insert(stream.end(), second.begin(), second.end());
+
+  auto count = 0;
+  for ([[maybe_unused]] auto frame : parser.parse(stream))
+    ++count;
+
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ(parser.error(), std::errc::message_size);
+
+  for ([[maybe_unused]] auto frame : parser.parse(encode("ok")))
+    ++count;
+  EXPECT_EQ(count, 1);
+}
+// NOLINTEND
@@ -16,13 +16,51 @@
 // NOLINTBEGIN
 #include "segment/detail/generator.hpp"
 #include <gtest/gtest.h>
+#include <array>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 using namespace cloudbus::detail;
 
 class GeneratorTest : public ::testing::Test {};
 
+struct allocation_counts {
+  int allocations = 0;
+  int deallocations = 0;
+};
+
+template <typename T> struct counting_allocator {
+  using value_type = T;
+
+  allocation_counts *counts;
+
+  explicit counting_allocator(allocation_counts *counts) : counts{counts} {}
+
+  template <typename U>
+  counting_allocator(const counting_allocator<U> &other) : counts{other.counts}
+  {}
+
+  auto allocate(std::size_t n) -> T *
+  {
+    ++counts->allocations;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  auto deallocate(T *ptr, std::size_t n) -> void
+  {
+    ++counts->deallocations;
+    std::allocator<T>{}.deallocate(ptr, n);
+  }
+
+  template <typename U>
+  auto operator==(const counting_allocator<U> &other) const -> bool
+  {
+    return counts == other.counts;
+  }
+};
+
 TEST_F(GeneratorTest, GeneratesCorrectSequence)
 {
   constexpr int count = 5;
@@ -160,4 +198,169 @@ TEST_F(GeneratorTest, ArrowException)
 
   EXPECT_THROW(++it, std::runtime_error);
 }
+// GCC < 13 mistakes templated promise operator new for a placement form
+// that doesn't match the usual operator delete (GCC bug 109224).
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+TEST_F(GeneratorTest, CustomAllocator)
+{
+  constexpr int count = 5;
+  constexpr auto iota = [](std::allocator_arg_t,
+                           const counting_allocator<std::byte> &,
+                           int count) -> generator<int> {
+    for (int i = 0; i < count; ++i)
+    {
+      co_yield i;
+    }
+  };
+
+  auto counts = allocation_counts{};
+  {
+    auto gen = iota(std::allocator_arg,
+                    counting_allocator<std::byte>{&counts}, count);
+    EXPECT_EQ(counts.allocations, 1);
+
+    int expected = 0;
+    for (int value : gen)
+    {
+      EXPECT_EQ(value, expected++);
+    }
+    EXPECT_EQ(expected, count);
+    EXPECT_EQ(counts.deallocations, 0);
+  }
+  EXPECT_EQ(counts.deallocations, 1);
+}
+
+TEST_F(GeneratorTest, MemberCustomAllocator)
+{
+  struct sequence {
+    int count;
+
+    auto values(std::allocator_arg_t,
+                const counting_allocator<int> &) const -> generator<int>
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        co_yield i;
+      }
+    }
+  };
+
+  auto counts = allocation_counts{};
+  {
+    auto seq = sequence{.count = 3};
+    auto gen = seq.values(std::allocator_arg, counting_allocator<int>{&counts});
+
+    std::vector<int> yielded_values;
+    for (int value : gen)
+    {
+      yielded_values.push_back(value);
+    }
+    EXPECT_EQ(yielded_values, (std::vector<int>{0, 1, 2}));
+  }
+  EXPECT_EQ(counts.allocations, 1);
+  EXPECT_EQ(counts.deallocations, 1);
+}
+
+TEST_F(GeneratorTest, RecyclesFrames)
+{
+  constexpr auto iota = [](int count) -> generator<int> {
+    for (int i = 0; i < count; ++i)
+    {
+      co_yield i;
+    }
+  };
+
+  auto &pool = buffer_pool::local();
+  {
+    auto gen = iota(1);
+  }
+  auto cached = pool.cached_bytes();
+  ASSERT_GT(cached, 0);
+  {
+    auto gen = iota(1);
+    EXPECT_LT(pool.cached_bytes(), cached);
+  }
+  EXPECT_EQ(pool.cached_bytes(), cached);
+}
+
+TEST_F(GeneratorTest, NextBatch)
+{
+  constexpr int count = 10;
+  int resumes = 0;
+  auto iota = [&](int count) -> generator<int> {
+    ++resumes;
+    for (int i = 0; i < count; ++i)
+    {
+      co_yield i;
+      ++resumes;
+    }
+  };
+
+  auto gen = iota(count);
+  auto batch = std::array<int, 4>{};
+  auto yielded_values = std::vector<int>{};
+
+  for (auto n = gen.next_batch(batch); n; n = gen.next_batch(batch))
+    yielded_values.insert(yielded_values.end(), batch.begin(),
+                          batch.begin() + n);
+
+  EXPECT_EQ(yielded_values,
+            (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  // Only the values at the end of each batch suspend the coroutine.
+  EXPECT_EQ(resumes, count + 1);
+  EXPECT_EQ(gen.next_batch(batch), 0);
+}
+
+TEST_F(GeneratorTest, NextBatchReferences)
+{
+  constexpr auto get_strings = []() -> generator<const std::string &> {
+    const auto first = std::string{"a"};
+    co_yield first;
+    const auto second = std::string{"b"};
+    co_yield second;
+  };
+
+  auto gen = get_strings();
+  auto batch = std::array<std::string, 4>{};
+
+  ASSERT_EQ(gen.next_batch(batch), 2);
+  EXPECT_EQ(batch[0], "a");
+  EXPECT_EQ(batch[1], "b");
+  EXPECT_EQ(gen.next_batch(batch), 0);
+}
+
+TEST_F(GeneratorTest, NextBatchException)
+{
+  constexpr auto iota_with_exception = []() -> generator<int> {
+    co_yield 1;
+    throw std::runtime_error("Test exception");
+  };
+
+  auto gen = iota_with_exception();
+  auto batch = std::array<int, 1>{};
+
+  ASSERT_EQ(gen.next_batch(batch), 1);
+  EXPECT_EQ(batch[0], 1);
+  EXPECT_THROW(gen.next_batch(batch), std::runtime_error);
+}
+
+TEST_F(GeneratorTest, MoveOnlyValues)
+{
+  constexpr auto get_pointers = []() -> generator<std::unique_ptr<int>> {
+    for (int i = 0; i < 3; ++i)
+    {
+      auto ptr = std::make_unique<int>(i);
+      co_yield ptr;
+    }
+  };
+
+  auto sum = 0;
+  for (auto &ptr : get_pointers())
+    sum += *ptr;
+
+  EXPECT_EQ(sum, 3);
+}
 // NOLINTEND
@@ -0,0 +1,116 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/hash_ring.hpp"
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+using namespace cloudbus::detail;
+
+class HashRingTest : public ::testing::Test {
+protected:
+  static auto make_address(std::uint16_t port) -> sockaddr_storage
+  {
+    auto address = sockaddr_storage{};
+    auto *addr = reinterpret_cast<sockaddr_in *>(&address);
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    return address;
+  }
+
+  static auto make_members(std::uint16_t count) -> std::vector<sockaddr_storage>
+  {
+    auto members = std::vector<sockaddr_storage>{};
+    for (std::uint16_t i = 0; i < count; ++i)
+      members.push_back(make_address(9000 + i));
+    return members;
+  }
+
+  static auto key_hash(int key) -> std::uint64_t
+  {
+    auto str = std::to_string(key);
+    return hash_ring::hash(std::as_bytes(std::span(str)));
+  }
+};
+
+TEST_F(HashRingTest, EmptyRing)
+{
+  auto ring = hash_ring{};
+  EXPECT_TRUE(ring.empty());
+  EXPECT_TRUE(ring.members().empty());
+}
+
+TEST_F(HashRingTest, FindsMembers)
+{
+  auto ring = hash_ring{make_members(3)};
+  EXPECT_EQ(ring.find(make_address(9001)), 1);
+  EXPECT_FALSE(ring.find(make_address(9999)));
+}
+
+TEST_F(HashRingTest, SpreadsKeys)
+{
+  constexpr int keys = 20000;
+  auto ring = hash_ring{make_members(4)};
+
+  auto counts = std::vector<int>(4);
+  for (int key = 0; key < keys; ++key)
+    ++counts[ring.lookup(key_hash(key))];
+
+  for (auto count : counts)
+  {
+    EXPECT_GT(count, keys / 4 / 2);
+    EXPECT_LT(count, keys / 4 * 2);
+  }
+}
+
+TEST_F(HashRingTest, MovesFewKeysOnMembershipChange)
+{
+  constexpr int keys = 20000;
+  auto before = hash_ring{make_members(4)};
+  auto after = hash_ring{make_members(5)};
+
+  auto moved = 0;
+  for (int key = 0; key < keys; ++key)
+  {
+    auto hash = key_hash(key);
+    auto owner = after.lookup(hash);
+    if (owner != before.lookup(hash))
+    {
+      // Only the new member takes over keys.
+      EXPECT_EQ(owner, 4);
+      ++moved;
+    }
+  }
+
+  // About a fifth of the keys move to the new member.
+  EXPECT_GT(moved, keys / 5 / 2);
+  EXPECT_LT(moved, keys / 5 * 2);
+}
+
+TEST_F(HashRingTest, WrapsAround)
+{
+  auto ring = hash_ring{make_members(2)};
+  auto first = ring.lookup(0);
+  EXPECT_EQ(ring.lookup(~std::uint64_t{0}), first);
+}
+// NOLINTEND
@@ -0,0 +1,147 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/listener_handoff.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace cloudbus::detail;
+
+class ListenerHandoffTest : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel.data()), 0);
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ASSERT_GE(listener, 0);
+
+    address = {};
+    auto &inet = reinterpret_cast<sockaddr_in &>(address);
+    inet.sin_family = AF_INET;
+    inet.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr *>(&inet),
+                   sizeof(inet)),
+              0);
+    ASSERT_EQ(listen(listener, 16), 0);
+
+    // Pick up the ephemeral port that the listener was bound to.
+    auto len = socklen_t{sizeof(inet)};
+    ASSERT_EQ(getsockname(listener, reinterpret_cast<sockaddr *>(&inet), &len),
+              0);
+  }
+
+  void TearDown() override
+  {
+    for (auto fd : channel)
+      close(fd);
+    close(listener);
+  }
+
+  std::array<int, 2> channel{};
+  int listener{-1};
+  sockaddr_storage address{};
+};
+
+TEST_F(ListenerHandoffTest, HandsOffListeners)
+{
+  auto fds = std::array{listener, listener};
+  ASSERT_FALSE(send_listeners(channel[0], fds));
+
+  auto received = std::vector<int>{};
+  ASSERT_FALSE(receive_listeners(channel[1], received));
+  ASSERT_EQ(received.size(), 2);
+
+  for (auto fd : received)
+  {
+    EXPECT_NE(fd, listener);
+    EXPECT_TRUE(is_bound_to(fd, address));
+    EXPECT_TRUE(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+  }
+
+  // A connection that is queued on the original listener is accepted
+  // from the handed off one, since they share the accept queue.
+  int client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT_GE(client, 0);
+  ASSERT_EQ(connect(client, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(sockaddr_in)),
+            0);
+  close(listener);
+  listener = -1;
+
+  int accepted = accept(received.front(), nullptr, nullptr);
+  EXPECT_GE(accepted, 0);
+
+  close(accepted);
+  close(client);
+  for (auto fd : received)
+    close(fd);
+}
+
+TEST_F(ListenerHandoffTest, HandsOffNothing)
+{
+  ASSERT_FALSE(send_listeners(channel[0], {}));
+
+  auto received = std::vector<int>{-1};
+  EXPECT_FALSE(receive_listeners(channel[1], received));
+  EXPECT_TRUE(received.empty());
+}
+
+TEST_F(ListenerHandoffTest, FailsAtEndOfStream)
+{
+  shutdown(channel[0], SHUT_WR);
+
+  auto received = std::vector<int>{};
+  EXPECT_EQ(receive_listeners(channel[1], received),
+            std::make_error_code(std::errc::protocol_error));
+}
+
+TEST_F(ListenerHandoffTest, MatchesBoundAddresses)
+{
+  EXPECT_TRUE(is_bound_to(listener, address));
+
+  auto other = address;
+  reinterpret_cast<sockaddr_in &>(other).sin_port ^= 1;
+  EXPECT_FALSE(is_bound_to(listener, other));
+
+  int local = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(local, 0);
+
+  auto path = sockaddr_storage{};
+  auto &un = reinterpret_cast<sockaddr_un &>(path);
+  un.sun_family = AF_UNIX;
+  std::memcpy(un.sun_path, "\0handoff-test", 13);
+  ASSERT_EQ(bind(local, reinterpret_cast<sockaddr *>(&un),
+                 offsetof(sockaddr_un, sun_path) + 13),
+            0);
+
+  EXPECT_TRUE(is_bound_to(local, path));
+  EXPECT_FALSE(is_bound_to(local, address));
+
+  un.sun_path[12] = 'x';
+  EXPECT_FALSE(is_bound_to(local, path));
+  close(local);
+}
+// NOLINTEND
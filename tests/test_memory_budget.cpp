@@ -0,0 +1,63 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/memory_budget.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+using namespace cloudbus::detail;
+
+class MemoryBudgetTest : public ::testing::Test {};
+
+TEST_F(MemoryBudgetTest, Exhausts)
+{
+  auto budget = memory_budget(100);
+  EXPECT_FALSE(budget.exhausted());
+
+  budget.charge(99);
+  EXPECT_FALSE(budget.exhausted());
+  budget.charge(1);
+  EXPECT_TRUE(budget.exhausted());
+
+  budget.release(50);
+  EXPECT_FALSE(budget.exhausted());
+  EXPECT_EQ(budget.used(), 50);
+}
+
+TEST_F(MemoryBudgetTest, AccountsChargeTheBudget)
+{
+  auto budget = std::make_shared<memory_budget>(1500);
+  auto first = memory_account(budget);
+  auto second = memory_account(budget);
+
+  first.charge(1000);
+  EXPECT_EQ(first.used(), 1000);
+  EXPECT_EQ(budget->used(), 1000);
+  EXPECT_FALSE(budget->exhausted());
+
+  second.charge(1000);
+  EXPECT_TRUE(budget->exhausted());
+
+  first.release(1000);
+  EXPECT_EQ(first.used(), 0);
+  EXPECT_FALSE(budget->exhausted());
+
+  second.release(1000);
+  EXPECT_EQ(budget->used(), 0);
+}
+// NOLINTEND
@@ -0,0 +1,112 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/metrics.hpp"
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class MetricsTest : public ::testing::Test {};
+
+TEST_F(MetricsTest, BucketsAreContiguous)
+{
+  EXPECT_EQ(histogram::index(0), 0);
+  EXPECT_EQ(histogram::index(2 * histogram::sub_buckets - 1),
+            2 * histogram::sub_buckets - 1);
+  EXPECT_EQ(histogram::index(std::numeric_limits<std::uint64_t>::max()),
+            histogram::buckets - 1);
+  EXPECT_EQ(histogram::highest(histogram::buckets - 1),
+            std::numeric_limits<std::uint64_t>::max());
+
+  for (std::size_t i = 1; i < histogram::buckets; ++i)
+  {
+    EXPECT_EQ(histogram::index(histogram::highest(i - 1) + 1), i);
+    EXPECT_EQ(histogram::index(histogram::highest(i)), i);
+  }
+}
+
+TEST_F(MetricsTest, BucketsAreAccurate)
+{
+  for (std::uint64_t value = 1; value < (1UL << 40U); value = value * 3 + 1)
+  {
+    auto high = histogram::highest(histogram::index(value));
+    EXPECT_GE(high, value);
+    EXPECT_LE(high - value, value / histogram::sub_buckets);
+  }
+}
+
+TEST_F(MetricsTest, Percentiles)
+{
+  auto hist = std::make_unique<histogram>();
+  EXPECT_EQ(hist->percentile(0.5), 0);
+
+  for (std::uint64_t value = 1; value <= 1000; ++value)
+    hist->record(value);
+
+  EXPECT_EQ(hist->count(), 1000);
+  EXPECT_NEAR(hist->percentile(0.5), 500, 500 / histogram::sub_buckets);
+  EXPECT_NEAR(hist->percentile(0.99), 990, 990 / histogram::sub_buckets);
+  EXPECT_GE(hist->percentile(1.0), 1000);
+  EXPECT_EQ(hist->percentile(0.0), 1);
+
+  auto other = std::make_unique<histogram>();
+  other->merge(*hist);
+  other->merge(*hist);
+  EXPECT_EQ(other->count(), 2000);
+  EXPECT_EQ(other->percentile(0.5), hist->percentile(0.5));
+}
+
+TEST_F(MetricsTest, CollectsAllThreads)
+{
+  using enum metrics::counter;
+  auto before = metrics::collect();
+
+  auto threads = std::vector<std::thread>{};
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([] {
+      auto &slot = metrics::local();
+      EXPECT_EQ(&slot, &metrics::local());
+      EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&slot) % 64, 0);
+
+      for (int j = 0; j < 100; ++j)
+      {
+        slot.add(messages);
+        slot.add(bytes_read, 10);
+        slot.record(std::chrono::microseconds(j));
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  auto after = metrics::collect();
+  EXPECT_EQ(after[messages] - before[messages], 400);
+  EXPECT_EQ(after[bytes_read] - before[bytes_read], 4000);
+  EXPECT_EQ(after.latency.count() - before.latency.count(), 400);
+
+  auto os = std::ostringstream{};
+  after.print(os);
+  EXPECT_NE(os.str().find("messages "), std::string::npos);
+  EXPECT_NE(os.str().find("latency_p99_ns "), std::string::npos);
+}
+// NOLINTEND
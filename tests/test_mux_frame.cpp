@@ -0,0 +1,70 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/mux_frame.hpp"
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class MuxFrameTest : public ::testing::Test {};
+
+TEST_F(MuxFrameTest, EncodesHeader)
+{
+  auto header = mux_frame::header(0x01020304, 5);
+  auto expected = mux_frame::header_type{
+      std::byte{0}, std::byte{0}, std::byte{0}, std::byte{9},
+      std::byte{1}, std::byte{2}, std::byte{3}, std::byte{4}};
+  EXPECT_EQ(header, expected);
+}
+
+TEST_F(MuxFrameTest, RoundTrips)
+{
+  using namespace std::string_view_literals;
+  auto message = "\0\0\0\x03" "abc"sv;
+  auto header = mux_frame::header(42, message.size());
+
+  auto stream = std::vector<std::byte>(header.begin(), header.end());
+  for (auto c : message)
+    stream.push_back(std::byte(c));
+
+  auto parser = frame_parser{};
+  auto count = 0;
+  for (auto frame : parser.parse(stream))
+  {
+    auto mux = mux_frame::parse(frame);
+    ASSERT_TRUE(mux);
+    EXPECT_EQ(mux->stream, 42);
+    ASSERT_EQ(mux->payload.size(), message.size());
+    EXPECT_EQ(std::memcmp(mux->payload.head().data(), message.data(),
+                          message.size()),
+              0);
+    ++count;
+  }
+  EXPECT_EQ(count, 1);
+}
+
+TEST_F(MuxFrameTest, RejectsShortFrames)
+{
+  auto frame = std::array<std::byte, 6>{std::byte{0}, std::byte{0},
+                                        std::byte{0}, std::byte{2}};
+  EXPECT_FALSE(mux_frame::parse(std::span<const std::byte>(frame)));
+}
+// NOLINTEND
@@ -0,0 +1,195 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/pipeline.hpp"
+#include "segment/detail/delimiter_parser.hpp"
+#include "segment/detail/frame_parser.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+namespace {
+auto bytes(std::string_view str) -> std::span<const std::byte>
+{
+  return std::as_bytes(std::span(str.data(), str.size()));
+}
+
+auto text(std::span<const std::byte> buf) -> std::string
+{
+  return {reinterpret_cast<const char *>(buf.data()), buf.size()};
+}
+} // namespace
+
+class PipelineTest : public ::testing::Test {};
+
+TEST_F(PipelineTest, RunsStagesInOrder)
+{
+  auto calls = std::vector<int>{};
+  auto handle = pipeline(
+      [&](auto &&next, int value) {
+        calls.push_back(1);
+        next(value * 2);
+      },
+      [&](auto &&next, int value) {
+        calls.push_back(2);
+        next(value + 1);
+      },
+      [&](auto &&, int value) { calls.push_back(value); });
+  static_assert(decltype(handle)::size == 3);
+
+  handle(5);
+  EXPECT_EQ(calls, (std::vector<int>{1, 2, 11}));
+}
+
+TEST_F(PipelineTest, StagesChooseWhetherToContinue)
+{
+  auto seen = std::vector<int>{};
+  auto handle = pipeline(
+      [](auto &&next, int value) {
+        for (int i = 0; i < value; ++i)
+          next(i);
+      },
+      [](auto &&next, int value) {
+        if (value % 2)
+          next(value);
+      },
+      [&](auto &&, int value) { seen.push_back(value); });
+
+  handle(6);
+  EXPECT_EQ(seen, (std::vector<int>{1, 3, 5}));
+}
+
+TEST_F(PipelineTest, ReturnsWhatTheFirstStageReturns)
+{
+  auto handle = pipeline([](auto &&next, int value) { return next(value); },
+                         [](auto &&, int value) { return value * 3; });
+  EXPECT_EQ(handle(4), 12);
+
+  // Past the last stage, the message is dropped.
+  auto open = pipeline([](auto &&next, int value) { next(value); });
+  open(1);
+}
+
+TEST_F(PipelineTest, FramesCountsAndQueues)
+{
+  auto owner = std::make_shared<int>();
+  auto parser = delimiter_parser(std::byte{'\n'});
+  auto queue = write_queue{};
+  auto before = metrics::collect()[metrics::counter::messages];
+
+  auto handle = pipeline(framing_stage(parser),
+                         counting_stage(metrics::counter::messages),
+                         enqueue_stage(queue));
+  EXPECT_FALSE(handle(owner, bytes("one\ntwo\nthr")));
+  EXPECT_EQ(queue.size(), 2);
+  EXPECT_EQ(metrics::collect()[metrics::counter::messages] - before, 2);
+
+  // The split frame is queued as its pieces in both read buffers.
+  auto next = std::make_shared<int>();
+  EXPECT_FALSE(handle(next, bytes("ee\n")));
+  EXPECT_EQ(queue.size(), 4);
+  EXPECT_EQ(owner.use_count(), 4);
+  EXPECT_EQ(next.use_count(), 2);
+  EXPECT_EQ(metrics::collect()[metrics::counter::messages] - before, 3);
+}
+
+TEST_F(PipelineTest, ReturnsParseErrors)
+{
+  auto owner = std::make_shared<int>();
+  auto parser = frame_parser(8);
+  auto frames = std::vector<std::string>{};
+  auto handle =
+      pipeline(framing_stage(parser),
+               [&](auto &&, const write_queue::owner_type &,
+                   const frame_view &frame) {
+                 frames.push_back(text(frame_parser::payload(frame).head()));
+               });
+
+  const char buf[] = {0, 0, 0, 2, 'o', 'k', 0, 0, 0, 9, 'x'};
+  auto error = handle(owner, std::as_bytes(std::span(buf)));
+  EXPECT_TRUE(error);
+  EXPECT_EQ(frames, (std::vector<std::string>{"ok"}));
+}
+
+TEST_F(PipelineTest, PassesUnframedBuffersOn)
+{
+  auto owner = std::make_shared<int>();
+  auto queue = write_queue{};
+  auto handle = pipeline(unframed_stage{}, enqueue_stage(queue));
+
+  EXPECT_FALSE(handle(owner, bytes("abc")));
+  EXPECT_EQ(queue.size(), 1);
+  EXPECT_EQ(queue.bytes(), 3);
+}
+
+TEST_F(PipelineTest, ChargesThrottledMessages)
+{
+  using namespace std::chrono_literals;
+
+  auto owner = std::make_shared<int>();
+  auto parser = delimiter_parser(std::byte{'\n'});
+  auto queue = write_queue{};
+  auto now = rate_limiter::clock_type::now();
+  auto limiter = rate_limiter(0, 2, 1000ms, now);
+
+  // Messages over the limits are still passed on, and hold off the next
+  // read instead.
+  auto handle =
+      pipeline(framing_stage(parser), limiting_stage(limiter, now),
+               enqueue_stage(queue));
+  EXPECT_FALSE(handle(owner, bytes("a\nb\nc\n")));
+  EXPECT_EQ(queue.size(), 3);
+  EXPECT_FALSE(limiter.ready(now));
+  EXPECT_TRUE(limiter.ready(now + 1s));
+}
+
+TEST_F(PipelineTest, BuildsMessagePaths)
+{
+  using namespace std::chrono_literals;
+
+  auto owner = std::make_shared<int>();
+  auto parser = delimiter_parser(std::byte{'\n'});
+  auto queue = write_queue{};
+  auto now = rate_limiter::clock_type::now();
+  auto limiter = rate_limiter(0, 2, 1000ms, now);
+  const auto stages = stage_context{.limiter = limiter, .now = now};
+
+  // Without a limiting stage, the messages are not charged.
+  using counted_path = message_path<counting_stage>;
+  auto counted = counted_path::compose(stages, framing_stage(parser),
+                                       enqueue_stage(queue));
+  static_assert(decltype(counted)::size == 3);
+  EXPECT_FALSE(counted(owner, bytes("a\nb\nc\n")));
+  EXPECT_EQ(queue.size(), 3);
+  EXPECT_TRUE(limiter.ready(now));
+
+  using limited_path = message_path<counting_stage, limiting_stage>;
+  auto limited = limited_path::compose(stages, framing_stage(parser),
+                                       enqueue_stage(queue));
+  static_assert(decltype(limited)::size == 4);
+  EXPECT_FALSE(limited(owner, bytes("d\ne\nf\n")));
+  EXPECT_EQ(queue.size(), 6);
+  EXPECT_FALSE(limiter.ready(now));
+}
+// NOLINTEND
@@ -0,0 +1,62 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/read_sizer.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace cloudbus::detail;
+
+class ReadSizerTest : public ::testing::Test {};
+
+TEST_F(ReadSizerTest, GrowsOnFullReads)
+{
+  auto sizer = read_sizer(4096, 256 * 1024);
+  EXPECT_EQ(sizer.size(), 4096);
+
+  sizer.record(4096, 4096);
+  EXPECT_EQ(sizer.size(), 16 * 1024);
+  sizer.record(16 * 1024, 16 * 1024);
+  sizer.record(64 * 1024, 64 * 1024);
+  EXPECT_EQ(sizer.size(), 256 * 1024);
+  sizer.record(256 * 1024, 256 * 1024);
+  EXPECT_EQ(sizer.size(), 256 * 1024);
+}
+
+TEST_F(ReadSizerTest, ShrinksOnSmallReads)
+{
+  auto sizer = read_sizer(4096, 256 * 1024);
+  sizer.record(64 * 1024, 64 * 1024);
+  ASSERT_EQ(sizer.size(), 256 * 1024);
+
+  for (unsigned i = 1; i < read_sizer::shrink_after; ++i)
+    sizer.record(100, 256 * 1024);
+  EXPECT_EQ(sizer.size(), 256 * 1024);
+
+  // A read of more than a quarter of the size starts the count over.
+  sizer.record(128 * 1024, 256 * 1024);
+  for (unsigned i = 1; i < read_sizer::shrink_after; ++i)
+    sizer.record(100, 256 * 1024);
+  EXPECT_EQ(sizer.size(), 256 * 1024);
+
+  sizer.record(100, 256 * 1024);
+  EXPECT_EQ(sizer.size(), 128 * 1024);
+
+  for (int i = 0; i < 1000; ++i)
+    sizer.record(100, 256 * 1024);
+  EXPECT_EQ(sizer.size(), 4096);
+}
+// NOLINTEND
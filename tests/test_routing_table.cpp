@@ -0,0 +1,79 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/routing_table.hpp"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+using namespace cloudbus::detail;
+
+class RoutingTableTest : public ::testing::Test {
+protected:
+  static auto make_members(std::uint16_t count) -> std::vector<sockaddr_storage>
+  {
+    auto members = std::vector<sockaddr_storage>(count);
+    for (std::uint16_t i = 0; i < count; ++i)
+    {
+      auto *addr = reinterpret_cast<sockaddr_in *>(&members[i]);
+      addr->sin_family = AF_INET;
+      addr->sin_port = htons(9000 + i);
+    }
+    return members;
+  }
+};
+
+TEST_F(RoutingTableTest, SnapshotsOutliveUpdates)
+{
+  auto table = routing_table{make_members(2)};
+  auto snapshot = table.load();
+  auto version = table.version();
+  ASSERT_EQ(snapshot->members().size(), 2);
+
+  table.update(make_members(3));
+  EXPECT_NE(table.version(), version);
+  EXPECT_EQ(snapshot->members().size(), 2);
+  EXPECT_EQ(table.load()->members().size(), 3);
+}
+
+TEST_F(RoutingTableTest, ConcurrentReaders)
+{
+  auto table = routing_table{make_members(1)};
+  auto stop = std::atomic<bool>{false};
+
+  auto readers = std::vector<std::jthread>{};
+  for (int i = 0; i < 4; ++i)
+  {
+    readers.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        auto ring = table.load();
+        ASSERT_FALSE(ring->empty());
+        EXPECT_LT(ring->lookup(12345), ring->members().size());
+      }
+    });
+  }
+
+  for (std::uint16_t count = 1; count <= 32; ++count)
+    table.update(make_members(count));
+
+  stop = true;
+}
+// NOLINTEND
@@ -0,0 +1,159 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/segment_config.hpp"
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+using namespace cloudbus::segment;
+
+class SegmentConfigTest : public ::testing::Test {};
+
+TEST_F(SegmentConfigTest, ParsesAddresses)
+{
+  auto address = sockaddr_storage{};
+
+  ASSERT_EQ(segment_config::parse_address("127.0.0.1:8080", address),
+            sizeof(sockaddr_in));
+  auto *in = reinterpret_cast<sockaddr_in *>(&address);
+  EXPECT_EQ(in->sin_family, AF_INET);
+  EXPECT_EQ(ntohs(in->sin_port), 8080);
+  EXPECT_EQ(in->sin_addr.s_addr, inet_addr("127.0.0.1"));
+
+  ASSERT_EQ(segment_config::parse_address("*:9000", address),
+            sizeof(sockaddr_in));
+  EXPECT_EQ(in->sin_addr.s_addr, htonl(INADDR_ANY));
+
+  ASSERT_EQ(segment_config::parse_address("[::1]:8080", address),
+            sizeof(sockaddr_in6));
+  auto *in6 = reinterpret_cast<sockaddr_in6 *>(&address);
+  EXPECT_EQ(in6->sin6_family, AF_INET6);
+  EXPECT_EQ(ntohs(in6->sin6_port), 8080);
+  EXPECT_TRUE(IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr));
+
+  auto len = segment_config::parse_address("unix:/run/segment.sock", address);
+  auto *un = reinterpret_cast<sockaddr_un *>(&address);
+  EXPECT_EQ(un->sun_family, AF_UNIX);
+  EXPECT_STREQ(un->sun_path, "/run/segment.sock");
+  EXPECT_EQ(len, offsetof(sockaddr_un, sun_path) + 18);
+  EXPECT_EQ(segment_config::address_size(address), len);
+
+  len = segment_config::parse_address("unix:@segment", address);
+  EXPECT_EQ(un->sun_path[0], '\0');
+  EXPECT_EQ(std::memcmp(un->sun_path + 1, "segment", 7), 0);
+  EXPECT_EQ(len, offsetof(sockaddr_un, sun_path) + 8);
+  EXPECT_EQ(segment_config::address_size(address), len);
+
+  for (auto bad : {"127.0.0.1", "127.0.0.1:0", "127.0.0.1:65536", "[::1:80",
+                   "localhost:80", "unix:"})
+  {
+    EXPECT_EQ(segment_config::parse_address(bad, address), 0) << bad;
+  }
+}
+
+TEST_F(SegmentConfigTest, LoadsFile)
+{
+  auto file = std::istringstream{R"(
+# Two listeners on four CPUs.
+listen = [::]:8080
+listen = unix:/tmp/segment.sock   # trailing comment
+workers = 4
+cpus = 0-2, 5
+io_uring = on
+tuning = latency
+send_buffer = 256K
+framing = length
+max_frame_size = 1M
+pipeline = true
+route = 10.0.0.1:9000
+route = 10.0.0.2:9000
+upstream_pool_size = 2
+handoff = /run/segment.handoff
+drain_timeout = 250
+idle_timeout = 30000
+message_deadline = 50
+memory_limit = 64M
+max_connections_per_source = 8
+rate_limit_bytes = 1M
+rate_limit_burst = 100
+udp_batch_size = 16
+upstream_tls = on
+tls_ca_file = /etc/segment/ca.pem
+trace_file = /tmp/segment.trace
+)"};
+
+  auto config = segment_config{};
+  auto line = std::size_t{0};
+  ASSERT_FALSE(config.load(file, line));
+
+  EXPECT_EQ(config.listen.size(), 2);
+  EXPECT_EQ(config.listen[0].ss_family, AF_INET6);
+  EXPECT_EQ(config.listen[1].ss_family, AF_UNIX);
+  EXPECT_EQ(config.workers, 4);
+  EXPECT_EQ(config.cpus, (std::vector<int>{0, 1, 2, 5}));
+  EXPECT_TRUE(config.io_uring);
+  EXPECT_TRUE(config.options.tuning.nodelay);
+  EXPECT_EQ(config.options.tuning.send_buffer, 256 * 1024);
+  EXPECT_EQ(config.options.framing, framing_mode::length_prefixed);
+  EXPECT_EQ(config.options.max_frame_size, 1024 * 1024);
+  EXPECT_TRUE(config.options.pipeline);
+  ASSERT_NE(config.options.routes, nullptr);
+  EXPECT_EQ(config.options.routes->load()->members().size(), 2);
+  EXPECT_EQ(config.options.upstream_pool_size, 2);
+  EXPECT_EQ(config.handoff, "/run/segment.handoff");
+  EXPECT_EQ(config.options.drain_timeout, std::chrono::milliseconds(250));
+  EXPECT_EQ(config.options.idle_timeout, std::chrono::seconds(30));
+  EXPECT_EQ(config.options.write_timeout, std::chrono::milliseconds(0));
+  EXPECT_EQ(config.options.message_deadline, std::chrono::milliseconds(50));
+  EXPECT_EQ(config.options.udp_batch_size, 16);
+  EXPECT_EQ(config.options.max_connections, 0);
+  EXPECT_EQ(config.options.max_connections_per_source, 8);
+  EXPECT_EQ(config.options.rate_limit_bytes, 1024 * 1024);
+  EXPECT_EQ(config.options.rate_limit_burst, std::chrono::milliseconds(100));
+  EXPECT_TRUE(config.upstream_tls);
+  EXPECT_FALSE(config.accept_tls);
+  EXPECT_EQ(config.tls.ca_file, "/etc/segment/ca.pem");
+  EXPECT_EQ(config.trace_file, "/tmp/segment.trace");
+  ASSERT_NE(config.options.memory_budget, nullptr);
+  EXPECT_EQ(config.options.memory_budget->limit(), 64 * 1024 * 1024);
+}
+
+TEST_F(SegmentConfigTest, ReportsBadLines)
+{
+  auto config = segment_config{};
+  auto line = std::size_t{0};
+
+  auto unknown = std::istringstream{"workers = 2\n\nbogus = 1\n"};
+  EXPECT_EQ(config.load(unknown, line), std::errc::invalid_argument);
+  EXPECT_EQ(line, 3);
+
+  auto malformed = std::istringstream{"workers 2\n"};
+  EXPECT_EQ(config.load(malformed, line), std::errc::invalid_argument);
+  EXPECT_EQ(line, 1);
+
+  EXPECT_EQ(config.set("workers", "-1"), std::errc::invalid_argument);
+  EXPECT_EQ(config.set("pipeline", "maybe"), std::errc::invalid_argument);
+  EXPECT_EQ(config.set("max_frame_size", "99999999999G"),
+            std::errc::invalid_argument);
+  EXPECT_EQ(config.workers, 2);
+}
+// NOLINTEND
@@ -20,14 +20,38 @@
 #include <gtest/gtest.h>
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <list>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <arpa/inet.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
 using namespace cloudbus::service;
 using namespace cloudbus::segment;
 
 class SegmentServiceTest : public ::testing::Test {};
 
+/**
+ * @brief Finds a free loopback port by binding to port 0.
+ * @return The port that the kernel picked.
+ */
+static auto free_port() -> std::uint16_t
+{
+  int sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  auto addr = sockaddr_in{.sin_family = AF_INET};
+  auto len = socklen_t{sizeof(addr)};
+  ::bind(sock, reinterpret_cast<sockaddr *>(&addr), len);
+  ::getsockname(sock, reinterpret_cast<sockaddr *>(&addr), &len);
+  ::close(sock);
+  return ntohs(addr.sin_port);
+}
+
 TEST_F(SegmentServiceTest, StartTest)
 {
   using namespace io::socket;
@@ -69,4 +93,977 @@ TEST_F(SegmentServiceTest, StartTest)
     }
   }
 }
+
+TEST_F(SegmentServiceTest, ReusePortTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &first = list.emplace_back();
+  auto &second = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto options = segment_options{.reuse_port = true};
+  for (auto *service : {&first, &second})
+  {
+    service->start(mtx, cvar, addr, options);
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service->interrupt || service->stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(first.interrupt));
+  ASSERT_TRUE(static_cast<bool>(second.interrupt));
+  {
+    using namespace io;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    for (int i = 0; i < 8; ++i)
+    {
+      auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      ASSERT_EQ(connect(sock, addr), 0);
+
+      auto buf = std::array<char, 1>{};
+      auto msg = socket_message{.buffers = buf};
+      ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span("x", 1)}, 0),
+                1);
+      ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+      EXPECT_EQ(buf[0], 'x');
+    }
+  }
+}
+
+TEST_F(SegmentServiceTest, PipelineTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto options =
+      segment_options{.pipeline = true, .max_outstanding_bytes = 16};
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    ASSERT_EQ(connect(sock, addr), 0);
+    auto before = cloudbus::detail::metrics::collect();
+
+    const char *alphabet = "abcdefghijklmnopqrstuvwxyz";
+    auto *end = alphabet + 26;
+
+    for (auto *it = alphabet; it != end; ++it)
+    {
+      ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span(it, 1)}, 0),
+                1);
+    }
+
+    auto buf = std::array<char, 26>{};
+    for (std::size_t received = 0; received < buf.size();)
+    {
+      auto msg =
+          socket_message{.buffers = std::span(buf).subspan(received)};
+      auto len = recvmsg(sock, msg, 0);
+      ASSERT_GT(len, 0);
+      received += len;
+    }
+    EXPECT_EQ(std::string_view(buf.data(), buf.size()),
+              std::string_view(alphabet, end));
+
+    // Bytes are counted as read before they are echoed.
+    using enum cloudbus::detail::metrics::counter;
+    auto after = cloudbus::detail::metrics::collect();
+    EXPECT_EQ(after[bytes_read] - before[bytes_read], 26);
+    EXPECT_GE(after[messages] - before[messages], 1);
+  }
+}
+
+TEST_F(SegmentServiceTest, ForwardTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &upstream = list.emplace_back();
+  auto &forwarder = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto upstream_addr = socket_address<sockaddr_in>();
+  upstream_addr->sin_family = AF_INET;
+  upstream_addr->sin_port = htons(free_port());
+  upstream_addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto peer = sockaddr_storage{};
+  std::memcpy(&peer, upstream_addr.operator->(), sizeof(sockaddr_in));
+  auto options = segment_options{};
+  options.upstreams.push_back(peer);
+
+  upstream.start(mtx, cvar, upstream_addr);
+  forwarder.start(mtx, cvar, addr, options);
+  for (auto *service : {&upstream, &forwarder})
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service->interrupt || service->stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(upstream.interrupt));
+  ASSERT_TRUE(static_cast<bool>(forwarder.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    // Bytes are relayed to the upstream echo and back again, the first
+    // byte through userspace and the rest through the splice pipe.
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+    const char *alphabet = "abcdefghijklmnopqrstuvwxyz";
+    auto *end = alphabet + 26;
+
+    for (auto *it = alphabet; it != end; ++it)
+    {
+      ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span(it, 1)}, 0),
+                1);
+      ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+      EXPECT_EQ(buf[0], *it);
+    }
+  }
+}
+
+TEST_F(SegmentServiceTest, HalfCloseTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &upstream = list.emplace_back();
+  auto &forwarder = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto upstream_addr = socket_address<sockaddr_in>();
+  upstream_addr->sin_family = AF_INET;
+  upstream_addr->sin_port = htons(free_port());
+  upstream_addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto peer = sockaddr_storage{};
+  std::memcpy(&peer, upstream_addr.operator->(), sizeof(sockaddr_in));
+  auto options = segment_options{};
+  options.upstreams.push_back(peer);
+
+  upstream.start(mtx, cvar, upstream_addr);
+  forwarder.start(mtx, cvar, addr, options);
+  for (auto *service : {&upstream, &forwarder})
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service->interrupt || service->stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(upstream.interrupt));
+  ASSERT_TRUE(static_cast<bool>(forwarder.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    // The first byte sets up the upstream connection, the rest is spliced.
+    auto buf = std::array<char, 26>{};
+    auto msg = socket_message{.buffers = std::span(buf).first(1)};
+    const char *alphabet = "abcdefghijklmnopqrstuvwxyz";
+    ASSERT_EQ(
+        sendmsg(sock, socket_message{.buffers = std::span(alphabet, 1)}, 0),
+        1);
+    ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+
+    // The replies to the bytes sent before a half-close still arrive, and
+    // the end of the upstream's output is passed back down.
+    ASSERT_EQ(sendmsg(sock,
+                      socket_message{.buffers = std::span(alphabet + 1, 25)},
+                      0),
+              25);
+    ASSERT_EQ(::shutdown(static_cast<native_socket_type>(sock), SHUT_WR), 0);
+
+    for (std::size_t received = 1; received < buf.size();)
+    {
+      msg = socket_message{.buffers = std::span(buf).subspan(received)};
+      auto len = recvmsg(sock, msg, 0);
+      ASSERT_GT(len, 0);
+      received += len;
+    }
+    EXPECT_EQ(std::string_view(buf.data(), buf.size()),
+              std::string_view(alphabet, 26));
+
+    msg = socket_message{.buffers = std::span(buf)};
+    EXPECT_EQ(recvmsg(sock, msg, 0), 0);
+  }
+}
+
+TEST_F(SegmentServiceTest, UpstreamPoolTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &upstream = list.emplace_back();
+  auto &forwarder = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto upstream_addr = socket_address<sockaddr_in>();
+  upstream_addr->sin_family = AF_INET;
+  upstream_addr->sin_port = htons(free_port());
+  upstream_addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto peer = sockaddr_storage{};
+  std::memcpy(&peer, upstream_addr.operator->(), sizeof(sockaddr_in));
+  auto options = segment_options{.framing = framing_mode::length_prefixed,
+                                 .upstream_pool_size = 1};
+  options.upstreams.push_back(peer);
+
+  upstream.start(mtx, cvar, upstream_addr);
+  forwarder.start(mtx, cvar, addr, options);
+  for (auto *service : {&upstream, &forwarder})
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service->interrupt || service->stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(upstream.interrupt));
+  ASSERT_TRUE(static_cast<bool>(forwarder.interrupt));
+  {
+    using namespace io;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    // Both clients share the one pooled upstream connection.
+    auto clients = std::array<socket_handle, 2>{
+        socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP),
+        socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP)};
+    for (auto &sock : clients)
+      ASSERT_EQ(connect(sock, addr), 0);
+
+    for (char c = 'a'; c < 'k'; ++c)
+    {
+      for (std::size_t i = 0; i < clients.size(); ++i)
+      {
+        auto frame = std::array<char, 5>{0, 0, 0, 1,
+                                         static_cast<char>(c + i)};
+        ASSERT_EQ(sendmsg(clients[i], socket_message{.buffers = frame}, 0),
+                  frame.size());
+      }
+
+      for (std::size_t i = 0; i < clients.size(); ++i)
+      {
+        auto buf = std::array<char, 5>{};
+        for (std::size_t received = 0; received < buf.size();)
+        {
+          auto msg =
+              socket_message{.buffers = std::span(buf).subspan(received)};
+          auto len = recvmsg(clients[i], msg, 0);
+          ASSERT_GT(len, 0);
+          received += len;
+        }
+        EXPECT_EQ(buf[3], 1);
+        EXPECT_EQ(buf[4], static_cast<char>(c + i));
+      }
+    }
+  }
+}
+
+TEST_F(SegmentServiceTest, SharedPoolTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &upstream = list.emplace_back();
+  auto &first = list.emplace_back();
+  auto &second = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto upstream_addr = socket_address<sockaddr_in>();
+  upstream_addr->sin_family = AF_INET;
+  upstream_addr->sin_port = htons(free_port());
+  upstream_addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  // Each reactor owns one of the two pooled connections, and its streams
+  // use both of them.
+  auto peer = sockaddr_storage{};
+  std::memcpy(&peer, upstream_addr.operator->(), sizeof(sockaddr_in));
+  auto options = segment_options{
+      .reuse_port = true,
+      .framing = framing_mode::length_prefixed,
+      .upstream_pool_size = 2,
+      .exchange = std::make_shared<cloudbus::detail::shard_exchange>(2)};
+  options.upstreams.push_back(peer);
+  auto second_options = options;
+  second_options.shard = 1;
+
+  upstream.start(mtx, cvar, upstream_addr);
+  first.start(mtx, cvar, addr, options);
+  second.start(mtx, cvar, addr, second_options);
+  for (auto *service : {&upstream, &first, &second})
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service->interrupt || service->stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(first.interrupt));
+  ASSERT_TRUE(static_cast<bool>(second.interrupt));
+  {
+    using namespace io;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    auto clients = std::vector<socket_handle>{};
+    for (int i = 0; i < 8; ++i)
+    {
+      auto &sock = clients.emplace_back(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      ASSERT_EQ(connect(sock, addr), 0);
+    }
+
+    // Every reply comes back to its own client, whichever reactor wrote
+    // its message upstream.
+    for (char c = 'a'; c < 'k'; ++c)
+    {
+      for (auto &sock : clients)
+      {
+        auto frame = std::array<char, 5>{0, 0, 0, 1, c};
+        ASSERT_EQ(sendmsg(sock, socket_message{.buffers = frame}, 0),
+                  frame.size());
+      }
+
+      for (auto &sock : clients)
+      {
+        auto buf = std::array<char, 5>{};
+        for (std::size_t received = 0; received < buf.size();)
+        {
+          auto msg =
+              socket_message{.buffers = std::span(buf).subspan(received)};
+          auto len = recvmsg(sock, msg, 0);
+          ASSERT_GT(len, 0);
+          received += len;
+        }
+        EXPECT_EQ(buf[3], 1);
+        EXPECT_EQ(buf[4], c);
+      }
+    }
+  }
+}
+
+TEST_F(SegmentServiceTest, RoutingTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &first = list.emplace_back();
+  auto &second = list.emplace_back();
+  auto &router = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto members = std::vector<sockaddr_storage>{};
+  auto upstream_addrs = std::array<socket_address<sockaddr_in>, 2>{};
+  for (std::uint16_t i = 0; i < upstream_addrs.size(); ++i)
+  {
+    auto &upstream_addr = upstream_addrs[i];
+    upstream_addr->sin_family = AF_INET;
+    upstream_addr->sin_port = htons(free_port());
+    upstream_addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    auto &member = members.emplace_back();
+    std::memcpy(&member, upstream_addr.operator->(), sizeof(sockaddr_in));
+  }
+
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto options = segment_options{
+      .framing = framing_mode::length_prefixed,
+      .upstream_pool_size = 1,
+      .routes = std::make_shared<cloudbus::detail::routing_table>(members),
+      .routing_key_size = 1};
+
+  first.start(mtx, cvar, upstream_addrs[0]);
+  second.start(mtx, cvar, upstream_addrs[1]);
+  router.start(mtx, cvar, addr, options);
+  for (auto *service : {&first, &second, &router})
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service->interrupt || service->stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(router.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    // Messages with different keys are spread over both members, and
+    // membership changes apply while the connection is open.
+    for (char c = 'a'; c <= 'z'; ++c)
+    {
+      if (c == 'n')
+        options.routes->update({members[1]});
+
+      auto frame = std::array<char, 6>{0, 0, 0, 2, c, '!'};
+      ASSERT_EQ(sendmsg(sock, socket_message{.buffers = frame}, 0),
+                frame.size());
+
+      auto buf = std::array<char, 6>{};
+      for (std::size_t received = 0; received < buf.size();)
+      {
+        auto msg = socket_message{.buffers = std::span(buf).subspan(received)};
+        auto len = recvmsg(sock, msg, 0);
+        ASSERT_GT(len, 0);
+        received += len;
+      }
+      EXPECT_EQ(buf, frame);
+    }
+  }
+}
+
+TEST_F(SegmentServiceTest, BusyPollTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  service.start(mtx, cvar, addr, segment_options{.busy_poll_usecs = 50});
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  if (!service.interrupt)
+    GTEST_SKIP() << "SO_BUSY_POLL is not permitted";
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    auto out = std::array<char, 4>{'p', 'i', 'n', 'g'};
+    ASSERT_EQ(sendmsg(sock, socket_message{.buffers = out}, 0), out.size());
+
+    auto buf = std::array<char, 4>{};
+    for (std::size_t received = 0; received < buf.size();)
+    {
+      auto msg = socket_message{.buffers = std::span(buf).subspan(received)};
+      auto len = recvmsg(sock, msg, 0);
+      ASSERT_GT(len, 0);
+      received += len;
+    }
+    EXPECT_EQ(buf, out);
+  }
+}
+
+TEST_F(SegmentServiceTest, MemoryBudgetTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  // An exhausted budget turns pipelining off, but never stops a reply.
+  auto budget = std::make_shared<cloudbus::detail::memory_budget>(1);
+  auto options = segment_options{.pipeline = true};
+  options.memory_budget = budget;
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    const char *alphabet = "abcdefghijklmnopqrstuvwxyz";
+    auto *end = alphabet + 26;
+    for (auto *it = alphabet; it != end; ++it)
+    {
+      ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span(it, 1)}, 0),
+                1);
+    }
+
+    auto buf = std::array<char, 26>{};
+    for (std::size_t received = 0; received < buf.size();)
+    {
+      auto msg = socket_message{.buffers = std::span(buf).subspan(received)};
+      auto len = recvmsg(sock, msg, 0);
+      ASSERT_GT(len, 0);
+      received += len;
+    }
+    EXPECT_EQ(std::string_view(buf.data(), buf.size()),
+              std::string_view(alphabet, end));
+
+    // The idle connection holds no read buffer.
+    for (int i = 0; i < 100 && budget->used(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(budget->used(), 0);
+  }
+}
+
+TEST_F(SegmentServiceTest, IdleBufferTest)
+{
+  using namespace io::socket;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto budget = std::make_shared<cloudbus::detail::memory_budget>(1UL << 30);
+  auto options = segment_options{};
+  options.memory_budget = budget;
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    constexpr auto connections = 32;
+    auto socks = std::vector<socket_handle>{};
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+    for (int i = 0; i < connections; ++i)
+    {
+      auto &sock = socks.emplace_back(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      ASSERT_EQ(connect(sock, addr), 0);
+      ASSERT_EQ(
+          sendmsg(sock, socket_message{.buffers = std::span("x", 1)}, 0), 1);
+      ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+    }
+
+    // The idle connections wait for input without any read buffers out
+    // of the pool, each of which would be charged to the budget.
+    for (int i = 0; i < 100 && budget->used(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(budget->used(), 0);
+
+    // And take one when they are read from again.
+    for (auto &sock : socks)
+    {
+      ASSERT_EQ(
+          sendmsg(sock, socket_message{.buffers = std::span("y", 1)}, 0), 1);
+      ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+      EXPECT_EQ(buf[0], 'y');
+    }
+  }
+}
+
+TEST_F(SegmentServiceTest, IdleTimeoutTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto options = segment_options{.idle_timeout = 100ms};
+  options.ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+    ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span("x", 1)}, 0),
+              1);
+    ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+    EXPECT_EQ(buf[0], 'x');
+
+    // The idle connection is closed by the reactor's timer.
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(recvmsg(sock, msg, 0), 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+  }
+}
+
+TEST_F(SegmentServiceTest, SilentConnectionTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto options = segment_options{.idle_timeout = 100ms};
+  options.max_connections = 2;
+  options.ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    // None of the connections ever sends anything.
+    auto socks = std::vector<socket_handle>{};
+    for (int i = 0; i < 3; ++i)
+    {
+      auto &sock = socks.emplace_back(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      auto timeout = timeval{.tv_sec = 2, .tv_usec = 0};
+      ASSERT_EQ(setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                           sizeof(timeout)),
+                0);
+      ASSERT_EQ(connect(sock, addr), 0);
+    }
+
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+
+    // The connection over the cap is closed as soon as it is accepted.
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(recvmsg(socks[2], msg, 0), 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 100ms);
+
+    // The admitted ones are closed by their idle timeouts.
+    EXPECT_EQ(recvmsg(socks[0], msg, 0), 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+    EXPECT_EQ(recvmsg(socks[1], msg, 0), 0);
+  }
+}
+
+TEST_F(SegmentServiceTest, ZerocopyReapTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto budget = std::make_shared<cloudbus::detail::memory_budget>(1UL << 20);
+  auto options = segment_options{.zerocopy_threshold = 1};
+  options.memory_budget = budget;
+  options.ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+    ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span("x", 1)}, 0),
+              1);
+    ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+    EXPECT_EQ(buf[0], 'x');
+
+    // Without any more traffic, the sent read buffer is released once
+    // the kernel completes the send, and the idle connection holds none.
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (budget->used() && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(10ms);
+    EXPECT_EQ(budget->used(), 0);
+  }
+}
+
+TEST_F(SegmentServiceTest, UnixZerocopyTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_un>();
+  addr->sun_family = AF_UNIX;
+  auto path = "/tmp/cloudbus-zerocopy-" + std::to_string(::getpid());
+  std::strncpy(addr->sun_path, path.c_str(), sizeof(addr->sun_path) - 1);
+  ::unlink(path.c_str());
+
+  // Unix-domain sockets have no SO_ZEROCOPY, so their sends are copied.
+  auto budget = std::make_shared<cloudbus::detail::memory_budget>(1UL << 20);
+  auto options = segment_options{.zerocopy_threshold = 1};
+  options.memory_budget = budget;
+  options.ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+    ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span("x", 1)}, 0),
+              1);
+    ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+    EXPECT_EQ(buf[0], 'x');
+
+    // The copied send releases its read buffer as soon as it completes.
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (budget->used() && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(10ms);
+    EXPECT_EQ(budget->used(), 0);
+  }
+  ::unlink(path.c_str());
+}
+
+TEST_F(SegmentServiceTest, DrainTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  auto options = segment_options{};
+  options.ticker = ticker;
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    auto buf = std::array<char, 1>{};
+    auto msg = socket_message{.buffers = buf};
+    ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span("x", 1)}, 0),
+              1);
+    ASSERT_EQ(recvmsg(sock, msg, 0), 1);
+
+    // The reactor drains once the reply has been written.
+    ticker->drain();
+    EXPECT_TRUE(ticker->wait_drained({}, 2s));
+
+    // The drained reactor has left the SO_REUSEPORT group, so new
+    // connections go to the other listeners, of which there are none.
+    auto late = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    EXPECT_NE(connect(late, addr), 0);
+  }
+}
+
+TEST_F(SegmentServiceTest, ThrottledStreamTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  // A 100 byte burst at 1000 bytes per second.
+  auto options = segment_options{.rate_limit_bytes = 1000,
+                                 .rate_limit_burst = 100ms};
+  options.ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    // Three times the burst is delayed, not dropped.
+    using cloudbus::detail::metrics;
+    auto throttled = metrics::collect()[metrics::counter::throttled];
+    auto sent = std::string{};
+    const auto alphabet = std::string_view("abcdefghijklmnopqrstuvwxyz");
+    for (int i = 0; i < 12; ++i)
+    {
+      ASSERT_EQ(sendmsg(sock, socket_message{.buffers = std::span(alphabet)},
+                        0),
+                alphabet.size());
+      sent += alphabet;
+    }
+
+    auto buf = std::string(sent.size(), '\0');
+    for (std::size_t received = 0; received < buf.size();)
+    {
+      auto msg =
+          socket_message{.buffers = std::span(buf).subspan(received)};
+      auto len = recvmsg(sock, msg, 0);
+      ASSERT_GT(len, 0);
+      received += len;
+    }
+    EXPECT_EQ(buf, sent);
+
+    // The pause is counted when the reactor goes back to reading.
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (metrics::collect()[metrics::counter::throttled] <= throttled &&
+           std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_GT(metrics::collect()[metrics::counter::throttled], throttled);
+  }
+}
+
+TEST_F(SegmentServiceTest, MessageDeadlineTest)
+{
+  using namespace io::socket;
+  using namespace std::chrono_literals;
+
+  auto list = std::list<async_service<segment_service>>{};
+  auto &service = list.emplace_back();
+
+  std::mutex mtx;
+  std::condition_variable cvar;
+  auto addr = socket_address<sockaddr_in>();
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(free_port());
+
+  auto options = segment_options{.pipeline = true,
+                                 .message_deadline = 50ms};
+  options.ticker = std::make_shared<cloudbus::detail::ticker>(10ms);
+  service.start(mtx, cvar, addr, options);
+  {
+    auto lock = std::unique_lock{mtx};
+    cvar.wait(lock, [&] { return service.interrupt || service.stopped; });
+  }
+  ASSERT_TRUE(static_cast<bool>(service.interrupt));
+  {
+    using namespace io;
+    using cloudbus::detail::metrics;
+    auto expired = metrics::collect()[metrics::counter::expired];
+
+    auto sock = socket_handle(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    auto fd = static_cast<native_socket_type>(sock);
+    int size = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(sock, addr), 0);
+
+    // The echo stalls on the unread replies while more reads queue up.
+    auto chunk = std::vector<char>(64UL * 1024UL, 'x');
+    auto sent = std::size_t{0};
+    auto until = std::chrono::steady_clock::now() + 200ms;
+    while (std::chrono::steady_clock::now() < until)
+    {
+      auto len = ::send(fd, chunk.data(), chunk.size(), MSG_DONTWAIT);
+      if (len > 0)
+        sent += static_cast<std::size_t>(len);
+      else
+        std::this_thread::sleep_for(1ms);
+    }
+
+    // Reading late completes the stalled send, and the stream whose
+    // backlog is past its deadline is closed instead of echoed.
+    auto received = std::size_t{0};
+    while (true)
+    {
+      auto len = ::recv(fd, chunk.data(), chunk.size(), 0);
+      if (len <= 0)
+        break;
+      received += static_cast<std::size_t>(len);
+    }
+    EXPECT_LT(received, sent);
+    EXPECT_GT(metrics::collect()[metrics::counter::expired], expired);
+  }
+}
 // NOLINTEND
@@ -0,0 +1,187 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/shard_exchange.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cloudbus::detail;
+
+class ShardExchangeTest : public ::testing::Test {
+protected:
+  auto SetUp() -> void override
+  {
+    for (auto &fd : doorbells)
+    {
+      fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      ASSERT_GE(fd, 0);
+    }
+  }
+
+  auto TearDown() -> void override
+  {
+    for (auto fd : doorbells)
+      ::close(fd);
+  }
+
+  static auto readable(int fd, int timeout = 0) -> bool
+  {
+    auto pfd = pollfd{.fd = fd, .events = POLLIN, .revents = 0};
+    return ::poll(&pfd, 1, timeout) == 1;
+  }
+
+  static auto ring(int fd) -> ssize_t
+  {
+    auto buf = std::array<char, 8>{};
+    return ::recv(fd, buf.data(), buf.size(), 0);
+  }
+
+  static auto make_message(std::uint32_t stream) -> shard_message
+  {
+    auto owner = std::make_shared<std::array<std::byte, 16>>();
+    auto buf = std::span<const std::byte>(*owner);
+    return {.owner = std::move(owner),
+            .buf = buf,
+            .queued = write_queue::clock_type::now(),
+            .stream = stream,
+            .pieces = 1};
+  }
+
+  auto attach(shard_exchange &exchange) -> void
+  {
+    for (std::size_t i = 0; i < doorbells.size(); ++i)
+      ASSERT_FALSE(exchange.attach(i, doorbells[i]));
+  }
+
+  std::array<int, 2> doorbells{-1, -1};
+};
+
+TEST_F(ShardExchangeTest, MovesOwnership)
+{
+  auto exchange = shard_exchange(2, 4);
+  ASSERT_TRUE(exchange);
+  EXPECT_FALSE(exchange.attached(1));
+  attach(exchange);
+  EXPECT_TRUE(exchange.attached(1));
+
+  auto msg = make_message(7);
+  auto owner = msg.owner;
+  const auto *data = msg.buf.data();
+  ASSERT_TRUE(exchange.send(0, 1, std::span(&msg, 1)));
+  EXPECT_FALSE(msg.owner);
+  EXPECT_TRUE(exchange.pending(1));
+  EXPECT_FALSE(exchange.pending(0));
+
+  auto received = exchange.receive(1, [&](shard_message &&msg) {
+    EXPECT_EQ(msg.stream, 7);
+    EXPECT_EQ(msg.buf.data(), data);
+    EXPECT_EQ(msg.owner, owner);
+  });
+  EXPECT_EQ(received, 1);
+  EXPECT_EQ(owner.use_count(), 1);
+  EXPECT_EQ(exchange.receive(0, [](shard_message &&) {}), 0);
+}
+
+TEST_F(ShardExchangeTest, SendsPiecesTogether)
+{
+  auto exchange = shard_exchange(2, 4);
+  ASSERT_TRUE(exchange);
+  attach(exchange);
+
+  auto pieces = std::vector<shard_message>{};
+  for (std::uint32_t i = 0; i < 3; ++i)
+    pieces.push_back(make_message(i));
+  ASSERT_TRUE(exchange.send(0, 1, pieces));
+
+  // A message that does not fit is not sent at all.
+  auto more = std::vector{make_message(3), make_message(4)};
+  EXPECT_FALSE(exchange.send(0, 1, more));
+  EXPECT_TRUE(more.front().owner);
+
+  // The other direction has its own ring.
+  EXPECT_TRUE(exchange.send(1, 0, more));
+  EXPECT_EQ(exchange.receive(1, [](shard_message &&) {}), 3);
+}
+
+TEST_F(ShardExchangeTest, BatchesWakeups)
+{
+  auto exchange = shard_exchange(2, 8);
+  ASSERT_TRUE(exchange);
+  attach(exchange);
+
+  // A reactor that is not parked is never woken.
+  auto msg = make_message(0);
+  ASSERT_TRUE(exchange.send(0, 1, std::span(&msg, 1)));
+  EXPECT_FALSE(readable(doorbells[1]));
+
+  // Parking fails while messages are waiting.
+  EXPECT_FALSE(exchange.park(1));
+  EXPECT_EQ(exchange.receive(1, [](shard_message &&) {}), 1);
+  ASSERT_TRUE(exchange.park(1));
+
+  for (std::uint32_t i = 0; i < 4; ++i)
+  {
+    auto msg = make_message(i);
+    ASSERT_TRUE(exchange.send(0, 1, std::span(&msg, 1)));
+  }
+  ASSERT_TRUE(readable(doorbells[1]));
+  EXPECT_EQ(ring(doorbells[1]), 1);
+  EXPECT_FALSE(readable(doorbells[1]));
+  EXPECT_EQ(exchange.receive(1, [](shard_message &&) {}), 4);
+}
+
+TEST_F(ShardExchangeTest, CrossThread)
+{
+  constexpr std::uint32_t count = 20000;
+  auto exchange = shard_exchange(2, 64);
+  ASSERT_TRUE(exchange);
+  attach(exchange);
+
+  auto producer = std::thread([&] {
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+      auto msg = make_message(i);
+      while (!exchange.send(0, 1, std::span(&msg, 1)))
+        std::this_thread::yield();
+    }
+  });
+
+  auto expected = std::uint32_t{0};
+  while (expected < count)
+  {
+    exchange.receive(1, [&](shard_message &&msg) {
+      EXPECT_EQ(msg.stream, expected++);
+    });
+    if (expected < count && exchange.park(1))
+    {
+      ASSERT_TRUE(readable(doorbells[1], 5000));
+      ring(doorbells[1]);
+    }
+  }
+  producer.join();
+}
+// NOLINTEND
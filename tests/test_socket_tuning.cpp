@@ -0,0 +1,96 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/socket_tuning.hpp"
+#include <gtest/gtest.h>
+
+#include <fstream>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cloudbus::segment;
+
+class SocketTuningTest : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ASSERT_GE(sock, 0);
+  }
+
+  void TearDown() override { ::close(sock); }
+
+  auto get(int level, int name) const -> int
+  {
+    int value = 0;
+    auto len = socklen_t{sizeof(value)};
+    EXPECT_EQ(::getsockopt(sock, level, name, &value, &len), 0);
+    return value;
+  }
+
+  int sock = -1;
+};
+
+TEST_F(SocketTuningTest, AppliesListener)
+{
+  auto tuning = socket_tuning::low_latency();
+  tuning.send_buffer = 64 * 1024;
+  tuning.defer_accept = 1;
+  tuning.incoming_cpu = 0;
+
+  EXPECT_FALSE(tuning.apply_listener(sock));
+  EXPECT_EQ(get(IPPROTO_TCP, TCP_NODELAY), 1);
+  EXPECT_EQ(get(IPPROTO_TCP, TCP_NOTSENT_LOWAT), 16 * 1024);
+  EXPECT_GE(get(SOL_SOCKET, SO_SNDBUF), 64 * 1024);
+  EXPECT_GE(get(IPPROTO_TCP, TCP_DEFER_ACCEPT), 1);
+  EXPECT_EQ(get(SOL_SOCKET, SO_INCOMING_CPU), 0);
+}
+
+TEST_F(SocketTuningTest, DefaultsAreUntouched)
+{
+  auto sndbuf = get(SOL_SOCKET, SO_SNDBUF);
+  EXPECT_FALSE(socket_tuning{}.apply_listener(sock));
+  EXPECT_FALSE(socket_tuning{}.apply_connection(sock));
+  EXPECT_EQ(get(IPPROTO_TCP, TCP_NODELAY), 0);
+  EXPECT_EQ(get(SOL_SOCKET, SO_SNDBUF), sndbuf);
+}
+
+TEST_F(SocketTuningTest, RejectsClampedBuffers)
+{
+  auto rmem_max = 0;
+  std::ifstream("/proc/sys/net/core/rmem_max") >> rmem_max;
+  if (rmem_max <= 0 || rmem_max > (1 << 29))
+    GTEST_SKIP() << "net.core.rmem_max is unavailable";
+
+  auto tuning = socket_tuning{.receive_buffer = rmem_max * 2};
+  EXPECT_EQ(tuning.apply_connection(sock), std::errc::result_out_of_range);
+}
+
+TEST_F(SocketTuningTest, SkipsTcpOptionsOnUnixSockets)
+{
+  auto unix_sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(unix_sock, 0);
+
+  auto tuning = socket_tuning::low_latency();
+  tuning.defer_accept = 1;
+  EXPECT_FALSE(tuning.apply_listener(unix_sock));
+  EXPECT_FALSE(tuning.apply_connection(unix_sock));
+  ::close(unix_sock);
+}
+// NOLINTEND
@@ -0,0 +1,104 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/splice_pipe.hpp"
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cloudbus::detail;
+
+class SplicePipeTest : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, in.data()),
+              0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, out.data()),
+              0);
+  }
+
+  void TearDown() override
+  {
+    for (auto fd : {in[0], in[1], out[0], out[1]})
+      close(fd);
+  }
+
+  // Bytes are written to in[0] and spliced from in[1] to out[0].
+  std::array<int, 2> in{-1, -1};
+  std::array<int, 2> out{-1, -1};
+};
+
+TEST_F(SplicePipeTest, TransfersBytes)
+{
+  auto pipe = splice_pipe{};
+  ASSERT_TRUE(pipe);
+
+  auto data = std::array<char, 5>{'h', 'e', 'l', 'l', 'o'};
+  ASSERT_EQ(write(in[0], data.data(), data.size()), data.size());
+
+  EXPECT_FALSE(pipe.transfer(in[1], out[0]));
+  EXPECT_EQ(pipe.size(), 0);
+  EXPECT_FALSE(pipe.eof());
+
+  auto buf = std::array<char, 16>{};
+  ASSERT_EQ(read(out[1], buf.data(), buf.size()), data.size());
+  EXPECT_EQ(std::memcmp(buf.data(), data.data(), data.size()), 0);
+}
+
+TEST_F(SplicePipeTest, KeepsBytesTheDestinationCannotTake)
+{
+  auto pipe = splice_pipe{};
+  ASSERT_TRUE(pipe);
+
+  // Fill the destination until it would block.
+  auto filler = std::vector<char>(64UL * 1024UL);
+  while (write(out[0], filler.data(), filler.size()) > 0)
+    ;
+
+  auto data = std::array<char, 5>{'h', 'e', 'l', 'l', 'o'};
+  ASSERT_EQ(write(in[0], data.data(), data.size()), data.size());
+
+  EXPECT_FALSE(pipe.transfer(in[1], out[0]));
+  ASSERT_EQ(pipe.size(), data.size());
+
+  auto buf = std::array<std::byte, 16>{};
+  ASSERT_EQ(pipe.read(buf), data.size());
+  EXPECT_EQ(pipe.size(), 0);
+  EXPECT_EQ(std::memcmp(buf.data(), data.data(), data.size()), 0);
+}
+
+TEST_F(SplicePipeTest, DetectsEndOfFile)
+{
+  auto pipe = splice_pipe{};
+  ASSERT_TRUE(pipe);
+
+  ASSERT_EQ(write(in[0], "x", 1), 1);
+  ASSERT_EQ(shutdown(in[0], SHUT_WR), 0);
+
+  EXPECT_FALSE(pipe.transfer(in[1], out[0]));
+  EXPECT_TRUE(pipe.eof());
+
+  auto buf = std::array<char, 2>{};
+  EXPECT_EQ(read(out[1], buf.data(), buf.size()), 1);
+}
+// NOLINTEND
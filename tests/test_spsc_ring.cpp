@@ -0,0 +1,126 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/spsc_ring.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class SpscRingTest : public ::testing::Test {};
+
+TEST_F(SpscRingTest, RoundsUpCapacity)
+{
+  EXPECT_EQ(spsc_ring<int>(5).capacity(), 8);
+  EXPECT_EQ(spsc_ring<int>(8).capacity(), 8);
+  EXPECT_EQ(spsc_ring<int>(0).capacity(), 1);
+}
+
+TEST_F(SpscRingTest, PushPop)
+{
+  auto ring = spsc_ring<int>(4);
+  EXPECT_TRUE(ring.empty());
+
+  for (int i = 0; i < 4; ++i)
+  {
+    auto value = i;
+    EXPECT_TRUE(ring.try_push(value));
+  }
+  auto value = 4;
+  EXPECT_FALSE(ring.try_push(value));
+  EXPECT_EQ(value, 4);
+
+  for (int i = 0; i < 4; ++i)
+  {
+    ASSERT_TRUE(ring.try_pop(value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(ring.try_pop(value));
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(SpscRingTest, PushesBatches)
+{
+  auto ring = spsc_ring<int>(4);
+  auto values = std::array<int, 3>{1, 2, 3};
+  ASSERT_TRUE(ring.try_push(std::span(values)));
+
+  // A batch that does not fit is not pushed at all.
+  auto more = std::array<int, 2>{4, 5};
+  EXPECT_FALSE(ring.try_push(std::span(more)));
+  EXPECT_EQ(more[0], 4);
+
+  auto popped = std::vector<int>{};
+  EXPECT_EQ(ring.drain([&](int &&value) { popped.push_back(value); }), 3);
+  EXPECT_EQ(popped, (std::vector<int>{1, 2, 3}));
+  EXPECT_TRUE(ring.try_push(std::span(more)));
+  EXPECT_EQ(ring.drain([](int &&) {}), 2);
+}
+
+TEST_F(SpscRingTest, DrainReleasesSlots)
+{
+  auto ring = spsc_ring<std::shared_ptr<int>>(4);
+  auto owner = std::make_shared<int>(1);
+
+  for (int i = 0; i < 3; ++i)
+  {
+    auto copy = owner;
+    ASSERT_TRUE(ring.try_push(copy));
+    EXPECT_FALSE(copy);
+  }
+  EXPECT_EQ(owner.use_count(), 4);
+
+  auto count = ring.drain([](std::shared_ptr<int> &&value) {
+    EXPECT_EQ(*value, 1);
+  });
+  EXPECT_EQ(count, 3);
+  EXPECT_EQ(owner.use_count(), 1);
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(SpscRingTest, CrossThread)
+{
+  constexpr std::size_t count = 100000;
+  auto ring = spsc_ring<std::size_t>(64);
+
+  auto producer = std::thread([&] {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      auto value = i;
+      while (!ring.try_push(value))
+        std::this_thread::yield();
+    }
+  });
+
+  auto expected = std::size_t{0};
+  while (expected < count)
+  {
+    auto drained = ring.drain(
+        [&](std::size_t &&value) { EXPECT_EQ(value, expected++); });
+    if (!drained)
+      std::this_thread::yield();
+  }
+  producer.join();
+  EXPECT_TRUE(ring.empty());
+}
+// NOLINTEND
@@ -0,0 +1,132 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/ticker.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using namespace cloudbus::detail;
+using namespace std::chrono_literals;
+
+class TickerTest : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    for (auto &fd : sockets)
+    {
+      fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+      ASSERT_GE(fd, 0);
+    }
+  }
+
+  void TearDown() override
+  {
+    for (auto fd : sockets)
+    {
+      if (fd >= 0)
+        close(fd);
+    }
+  }
+
+  static auto wait_tick(int fd, int timeout_ms) -> bool
+  {
+    auto pfd = pollfd{.fd = fd, .events = POLLIN, .revents = 0};
+    if (poll(&pfd, 1, timeout_ms) != 1)
+      return false;
+
+    auto buf = std::array<std::byte, 16>{};
+    return recv(fd, buf.data(), buf.size(), 0) == 1;
+  }
+
+  std::array<int, 2> sockets{-1, -1};
+};
+
+TEST_F(TickerTest, SendsTicks)
+{
+  auto clock = ticker(10ms);
+  auto id = std::uint64_t{};
+  ASSERT_FALSE(clock.subscribe(sockets[0], id));
+  EXPECT_NE(id, 0);
+
+  for (int i = 0; i < 3; ++i)
+    EXPECT_TRUE(wait_tick(sockets[0], 1000));
+}
+
+TEST_F(TickerTest, DrainWakesSubscribers)
+{
+  // The interval is long enough that only the drain sends a tick.
+  auto clock = ticker(1h);
+  auto id = std::uint64_t{};
+  ASSERT_FALSE(clock.subscribe(sockets[0], id));
+  EXPECT_FALSE(wait_tick(sockets[0], 50));
+
+  EXPECT_FALSE(clock.draining());
+  clock.drain();
+  EXPECT_TRUE(clock.draining());
+  EXPECT_TRUE(wait_tick(sockets[0], 1000));
+}
+
+TEST_F(TickerTest, WaitsForEverySubscriberToDrain)
+{
+  auto clock = ticker(10ms);
+  auto first = std::uint64_t{};
+  auto second = std::uint64_t{};
+  ASSERT_FALSE(clock.subscribe(sockets[0], first));
+  ASSERT_FALSE(clock.subscribe(sockets[1], second));
+  EXPECT_NE(first, second);
+
+  clock.drain();
+  clock.drained(first);
+  EXPECT_FALSE(clock.wait_drained({}, 50ms));
+
+  clock.drained(second);
+  EXPECT_TRUE(clock.wait_drained({}, 1s));
+}
+
+TEST_F(TickerTest, UnsubscribesClosedSockets)
+{
+  auto clock = ticker(10ms);
+  auto first = std::uint64_t{};
+  auto second = std::uint64_t{};
+  ASSERT_FALSE(clock.subscribe(sockets[0], first));
+  ASSERT_FALSE(clock.subscribe(sockets[1], second));
+
+  // The closed subscriber no longer holds up the drain.
+  close(std::exchange(sockets[1], -1));
+  clock.drain();
+  clock.drained(first);
+  EXPECT_TRUE(clock.wait_drained({}, 1s));
+}
+
+TEST_F(TickerTest, RejectsSocketsOfOtherFamilies)
+{
+  auto clock = ticker(10ms);
+  auto fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+
+  auto id = std::uint64_t{};
+  EXPECT_TRUE(clock.subscribe(fd, id));
+  close(fd);
+}
+// NOLINTEND
@@ -0,0 +1,134 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/timer_wheel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace cloudbus::detail;
+using namespace std::chrono_literals;
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+  using clock_type = timer_wheel::clock_type;
+
+  clock_type::time_point start =
+      clock_type::time_point(std::chrono::duration_cast<clock_type::duration>(
+          std::chrono::hours(1000)));
+  timer_wheel wheel{start};
+};
+
+TEST_F(TimerWheelTest, ExpiresAtTheDeadline)
+{
+  auto t = timer_wheel::timer{};
+  wheel.schedule(t, start + 5ms);
+  EXPECT_TRUE(t.armed());
+  EXPECT_EQ(wheel.size(), 1);
+
+  auto fired = std::vector<timer_wheel::timer *>{};
+  auto collect = [&](timer_wheel::timer &expired) {
+    EXPECT_FALSE(expired.armed());
+    fired.push_back(&expired);
+  };
+  EXPECT_EQ(wheel.advance(start + 4ms, collect), 0);
+  EXPECT_EQ(wheel.advance(start + 5ms, collect), 1);
+  EXPECT_EQ(fired, std::vector<timer_wheel::timer *>{&t});
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST_F(TimerWheelTest, PastDeadlinesExpireAtTheNextTick)
+{
+  auto t = timer_wheel::timer{};
+  wheel.schedule(t, start - 1s);
+  EXPECT_EQ(wheel.advance(start, [](auto &) {}), 0);
+  EXPECT_EQ(wheel.advance(start + 1ms, [](auto &) {}), 1);
+}
+
+TEST_F(TimerWheelTest, CancelsAndReschedules)
+{
+  auto a = timer_wheel::timer{};
+  auto b = timer_wheel::timer{};
+  wheel.schedule(a, start + 10ms);
+  wheel.schedule(b, start + 10ms);
+  wheel.cancel(a);
+  wheel.cancel(a);
+  EXPECT_FALSE(a.armed());
+  EXPECT_EQ(wheel.size(), 1);
+
+  // Rescheduling an armed timer moves it.
+  wheel.schedule(b, start + 2s);
+  EXPECT_EQ(wheel.size(), 1);
+  EXPECT_EQ(wheel.advance(start + 1s, [](auto &) {}), 0);
+  EXPECT_EQ(wheel.advance(start + 2s, [](auto &) {}), 1);
+}
+
+TEST_F(TimerWheelTest, CallbackMayReschedule)
+{
+  auto t = timer_wheel::timer{};
+  auto count = 0;
+  auto now = start;
+  wheel.schedule(t, now + 10ms);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    now += 5ms;
+    wheel.advance(now, [&](timer_wheel::timer &expired) {
+      ++count;
+      wheel.schedule(expired, now + 10ms);
+    });
+  }
+  EXPECT_EQ(count, 50);
+  EXPECT_EQ(wheel.size(), 1);
+}
+
+TEST_F(TimerWheelTest, ExpiresEveryLevelOnTime)
+{
+  auto rng = std::mt19937_64(42);
+  auto timers = std::vector<timer_wheel::timer>(2000);
+  auto deadlines = std::vector<std::uint64_t>(timers.size());
+  for (std::size_t i = 0; i < timers.size(); ++i)
+  {
+    // Spread the deadlines over all the levels and past the top.
+    auto shift = rng() % 27;
+    deadlines[i] = 1 + (rng() % (1ULL << shift));
+    timers[i].owner = &deadlines[i];
+    wheel.schedule(timers[i], start + std::chrono::milliseconds(deadlines[i]));
+  }
+
+  // Advance in uneven steps, checking that nothing fires early or late.
+  auto now = std::uint64_t{0};
+  auto fired = std::size_t{0};
+  while (fired < timers.size())
+  {
+    auto step = now < 100'000 ? 1 + (rng() % 7) : 1 + (rng() % 100'000);
+    auto previous = now;
+    now += step;
+    fired += wheel.advance(
+        start + std::chrono::milliseconds(now),
+        [&](timer_wheel::timer &t) {
+          auto deadline = *static_cast<std::uint64_t *>(t.owner);
+          EXPECT_GT(deadline, previous);
+          EXPECT_LE(deadline, now);
+        });
+  }
+  EXPECT_TRUE(wheel.empty());
+}
+// NOLINTEND
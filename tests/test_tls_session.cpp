@@ -0,0 +1,268 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/tls_session.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cloudbus::detail;
+
+class TlsSessionTest : public ::testing::Test {
+protected:
+  /** @brief Writes a self-signed certificate and its key for a name. */
+  static auto make_identity(const std::string &name) -> tls_settings
+  {
+    auto dir = std::filesystem::temp_directory_path();
+    auto settings = tls_settings{
+        .certificate = dir / ("cloudbus-" + name + ".crt"),
+        .private_key = dir / ("cloudbus-" + name + ".key"),
+    };
+
+    auto *key = EVP_EC_gen("P-256");
+    auto *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    auto *subject = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(
+        subject, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char *>(name.c_str()), -1, -1, 0);
+    X509_set_issuer_name(cert, subject);
+    X509_sign(cert, key, EVP_sha256());
+
+    auto *file = std::fopen(settings.certificate.c_str(), "w");
+    PEM_write_X509(file, cert);
+    std::fclose(file);
+    file = std::fopen(settings.private_key.c_str(), "w");
+    PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr);
+    std::fclose(file);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return settings;
+  }
+
+  /** @brief Connects a pair of non-blocking TCP sockets over loopback. */
+  static auto connected_pair(std::array<int, 2> &fds) -> bool
+  {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    auto addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    auto len = socklen_t{sizeof(addr)};
+    auto *address = reinterpret_cast<sockaddr *>(&addr);
+    if (bind(listener, address, len) || listen(listener, 1) ||
+        getsockname(listener, address, &len))
+    {
+      return false;
+    }
+
+    fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fds[1], address, len))
+      return false;
+    fds[0] = accept(listener, nullptr, nullptr);
+    close(listener);
+
+    for (int fd : fds)
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fds[0] >= 0;
+  }
+
+  /** @brief Runs both sides of a handshake until neither makes progress. */
+  static auto handshake(tls_session &server, tls_session &client,
+                        const std::array<int, 2> &fds)
+      -> std::array<tls_session::status, 2>
+  {
+    using enum tls_session::status;
+    auto sessions = std::array<tls_session *, 2>{&server, &client};
+    auto result = std::array{want_read, want_read};
+    for (int round = 0; round < 100; ++round)
+    {
+      auto pfds = std::array<pollfd, 2>{};
+      for (int i = 0; i < 2; ++i)
+      {
+        if (result[i] == want_read || result[i] == want_write)
+          result[i] = sessions[i]->handshake();
+
+        pfds[i] = {.fd = fds[i],
+                   .events = static_cast<short>(
+                       result[i] == want_write ? POLLOUT : POLLIN),
+                   .revents = 0};
+        if (result[i] == done || result[i] == failed)
+          pfds[i].fd = -1;
+      }
+      if (pfds[0].fd < 0 && pfds[1].fd < 0)
+        break;
+      poll(pfds.data(), pfds.size(), 1000);
+    }
+    return result;
+  }
+
+  static auto TearDownTestSuite() -> void
+  {
+    for (const auto *name : {"server", "client", "stranger"})
+    {
+      auto dir = std::filesystem::temp_directory_path();
+      std::filesystem::remove(dir / (std::string("cloudbus-") + name + ".crt"));
+      std::filesystem::remove(dir / (std::string("cloudbus-") + name + ".key"));
+    }
+  }
+};
+
+TEST_F(TlsSessionTest, RejectsMissingCredentials)
+{
+  auto ctx = tls_context(tls_context::side::server);
+  ASSERT_TRUE(ctx);
+  EXPECT_EQ(ctx.configure({.certificate = "/nonexistent.crt",
+                           .private_key = "/nonexistent.key"}),
+            std::errc::invalid_argument);
+}
+
+TEST_F(TlsSessionTest, HandsRecordsToKernel)
+{
+  using enum tls_session::status;
+  auto identity = make_identity("server");
+  auto server_ctx = tls_context(tls_context::side::server);
+  ASSERT_FALSE(server_ctx.configure(identity));
+
+  auto client_ctx = tls_context(tls_context::side::client);
+  ASSERT_FALSE(client_ctx.configure(
+      {.ca_file = identity.certificate, .server_name = "server"}));
+
+  auto fds = std::array{-1, -1};
+  ASSERT_TRUE(connected_pair(fds));
+  auto server = tls_session(server_ctx, fds[0]);
+  auto client = tls_session(client_ctx, fds[1]);
+
+  auto result = handshake(server, client, fds);
+  if (result[0] == failed &&
+      server.error() == std::errc::operation_not_supported)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    GTEST_SKIP() << "kernel TLS is unavailable";
+  }
+  ASSERT_EQ(result[0], done) << server.error().message();
+  ASSERT_EQ(result[1], done) << client.error().message();
+
+  // The sockets carry plaintext once the sessions are gone.
+  const auto message = std::string_view("encrypted link");
+  ASSERT_EQ(send(fds[1], message.data(), message.size(), 0), message.size());
+
+  auto buf = std::array<char, 32>{};
+  auto pfd = pollfd{.fd = fds[0], .events = POLLIN, .revents = 0};
+  ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+  auto len = recv(fds[0], buf.data(), buf.size(), 0);
+  ASSERT_EQ(len, message.size());
+  EXPECT_EQ(std::string_view(buf.data(), len), message);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(TlsSessionTest, ReplaysReceivedBytes)
+{
+  using enum tls_session::status;
+  auto identity = make_identity("server");
+  auto server_ctx = tls_context(tls_context::side::server);
+  ASSERT_FALSE(server_ctx.configure(identity));
+
+  auto client_ctx = tls_context(tls_context::side::client);
+  ASSERT_FALSE(client_ctx.configure(
+      {.ca_file = identity.certificate, .server_name = "server"}));
+
+  auto fds = std::array{-1, -1};
+  ASSERT_TRUE(connected_pair(fds));
+  auto client = tls_session(client_ctx, fds[1]);
+  ASSERT_EQ(client.handshake(), want_read);
+
+  // The server has already read the client hello when it starts.
+  auto hello = std::array<std::byte, 4096>{};
+  auto pfd = pollfd{.fd = fds[0], .events = POLLIN, .revents = 0};
+  ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+  auto len = recv(fds[0], hello.data(), hello.size(), 0);
+  ASSERT_GT(len, 0);
+  auto server = tls_session(server_ctx, fds[0], std::span(hello).first(len));
+
+  // Kernel TLS is only set up once the handshake itself has succeeded.
+  auto result = handshake(server, client, fds);
+  if (result[0] == failed &&
+      server.error() == std::errc::operation_not_supported)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    GTEST_SKIP() << "kernel TLS is unavailable";
+  }
+  ASSERT_EQ(result[0], done) << server.error().message();
+  ASSERT_EQ(result[1], done) << client.error().message();
+
+  const auto message = std::string_view("replayed hello");
+  ASSERT_EQ(send(fds[1], message.data(), message.size(), 0), message.size());
+
+  auto buf = std::array<char, 32>{};
+  ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+  len = recv(fds[0], buf.data(), buf.size(), 0);
+  ASSERT_EQ(len, message.size());
+  EXPECT_EQ(std::string_view(buf.data(), len), message);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(TlsSessionTest, RejectsUntrustedServer)
+{
+  using enum tls_session::status;
+  auto identity = make_identity("server");
+  auto server_ctx = tls_context(tls_context::side::server);
+  ASSERT_FALSE(server_ctx.configure(identity));
+
+  // The client trusts a different CA.
+  auto stranger = make_identity("stranger");
+  auto client_ctx = tls_context(tls_context::side::client);
+  ASSERT_FALSE(client_ctx.configure({.ca_file = stranger.certificate}));
+
+  auto fds = std::array{-1, -1};
+  ASSERT_TRUE(connected_pair(fds));
+  auto server = tls_session(server_ctx, fds[0]);
+  auto client = tls_session(client_ctx, fds[1]);
+
+  auto result = handshake(server, client, fds);
+  EXPECT_EQ(result[1], failed);
+  EXPECT_EQ(client.error(), std::errc::protocol_error);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+// NOLINTEND
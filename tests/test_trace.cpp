@@ -0,0 +1,127 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/trace.hpp"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace cloudbus::detail;
+
+class TraceTest : public ::testing::Test {};
+
+TEST_F(TraceTest, RecordsEvents)
+{
+  auto ring = std::make_unique<trace::ring>();
+  auto now = std::chrono::steady_clock::now();
+
+  ring->push(trace::event::read, 7, 100, now);
+  ring->push(trace::event::short_write, 8, std::size_t{1} << 30U, now);
+
+  auto records = ring->snapshot();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].time, now.time_since_epoch().count());
+  EXPECT_EQ(records[0].fd, 7);
+  EXPECT_EQ(records[0].what(), trace::event::read);
+  EXPECT_EQ(records[0].size(), 100);
+  EXPECT_EQ(records[1].what(), trace::event::short_write);
+  EXPECT_EQ(records[1].size(), 0xFFFFFF);
+}
+
+TEST_F(TraceTest, KeepsNewestEvents)
+{
+  auto ring = std::make_unique<trace::ring>();
+  auto now = std::chrono::steady_clock::now();
+  auto total = trace::ring::capacity + 10;
+
+  for (std::size_t i = 0; i < total; ++i)
+    ring->push(trace::event::service, static_cast<int>(i), 0, now);
+
+  // The slot after the head may be overwritten at any time, so it is
+  // dropped even if the writer is idle.
+  auto records = ring->snapshot();
+  ASSERT_EQ(records.size(), trace::ring::capacity - 1);
+  EXPECT_EQ(records.front().fd, total - trace::ring::capacity + 1);
+  EXPECT_EQ(records.back().fd, total - 1);
+}
+
+TEST_F(TraceTest, SnapshotsWhileWriting)
+{
+  auto ring = std::make_unique<trace::ring>();
+  auto stop = std::atomic<bool>{false};
+
+  auto writer = std::thread([&] {
+    auto now = std::chrono::steady_clock::now();
+    for (std::uint32_t i = 0; !stop.load(std::memory_order_relaxed); ++i)
+      ring->push(trace::event::read, static_cast<int>(i), i & 0xFFFFU, now);
+  });
+
+  for (int n = 0; n < 100; ++n)
+  {
+    auto records = ring->snapshot();
+    for (std::size_t i = 1; i < records.size(); ++i)
+    {
+      ASSERT_EQ(records[i].fd, records[i - 1].fd + 1);
+      ASSERT_EQ(records[i].size(), records[i].fd & 0xFFFFU);
+    }
+  }
+
+  stop = true;
+  writer.join();
+}
+
+TEST_F(TraceTest, DecodesDump)
+{
+  auto thread = std::thread([] {
+    auto now = std::chrono::steady_clock::now();
+    auto &ring = trace::local();
+    ring.push(trace::event::send_submit, 42, 512, now);
+    ring.push(trace::event::send_complete, 42, 500, now);
+  });
+  thread.join();
+
+  auto file = std::stringstream{};
+  ASSERT_FALSE(trace::dump(file));
+
+  auto text = std::ostringstream{};
+  ASSERT_FALSE(trace::decode(file, text));
+  EXPECT_NE(text.str().find(" 42 send_submit 512\n"), std::string::npos);
+  EXPECT_NE(text.str().find(" 42 send_complete 500\n"), std::string::npos);
+}
+
+TEST_F(TraceTest, RejectsMalformedFiles)
+{
+  auto text = std::ostringstream{};
+
+  auto magic = std::istringstream{"CBTRACE0\0\0\0\0"};
+  EXPECT_EQ(trace::decode(magic, text), std::errc::invalid_argument);
+
+  auto truncated = std::istringstream{std::string{"CBTRACE1\1\0\0\0", 12}};
+  EXPECT_EQ(trace::decode(truncated, text), std::errc::invalid_argument);
+}
+
+TEST_F(TraceTest, EmitFollowsBuild)
+{
+  auto before = trace::local().snapshot().size();
+  trace::emit(trace::event::read, 3, 1);
+  EXPECT_EQ(trace::local().snapshot().size(), before + trace::enabled);
+}
+// NOLINTEND
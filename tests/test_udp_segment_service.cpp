@@ -0,0 +1,158 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/udp_segment_service.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <unistd.h>
+using namespace cloudbus::segment;
+
+class UdpSegmentServiceTest : public ::testing::Test {
+protected:
+  static auto loopback(std::uint16_t port) -> sockaddr_in
+  {
+    auto addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    return addr;
+  }
+
+  static auto client() -> int
+  {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    auto timeout = timeval{.tv_sec = 5, .tv_usec = 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+  }
+
+  static auto wait_bound(const udp_segment_service &service) -> bool
+  {
+    for (int i = 0; i < 100 && service.listener() < 0; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return service.listener() >= 0;
+  }
+
+  static auto send_to(int sock, const sockaddr_in &addr,
+                      std::string_view message) -> void
+  {
+    ASSERT_EQ(sendto(sock, message.data(), message.size(), 0,
+                     reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)),
+              message.size());
+  }
+
+  static auto receive(int sock) -> std::string
+  {
+    auto buf = std::array<char, 2048>{};
+    auto len = recv(sock, buf.data(), buf.size(), 0);
+    return len < 0 ? std::string{} : std::string(buf.data(), len);
+  }
+};
+
+TEST_F(UdpSegmentServiceTest, EchoTest)
+{
+  auto addr = loopback(8093);
+  auto service = udp_segment_service(addr, {.udp_batch_size = 4});
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+  ASSERT_TRUE(wait_bound(service)) << error.message();
+
+  int sock = client();
+  ASSERT_GE(sock, 0);
+
+  // More datagrams than fit in a batch, of several sizes.
+  constexpr int count = 10;
+  for (int i = 0; i < count; ++i)
+    send_to(sock, addr, std::string(i + 1, static_cast<char>('a' + i)));
+
+  for (int i = 0; i < count; ++i)
+    EXPECT_EQ(receive(sock), std::string(i + 1, static_cast<char>('a' + i)));
+
+  close(sock);
+  thread.request_stop();
+}
+
+TEST_F(UdpSegmentServiceTest, SegmentedEchoTest)
+{
+  auto addr = loopback(8094);
+  auto service = udp_segment_service(addr, {.udp_batch_size = 64});
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+  ASSERT_TRUE(wait_bound(service)) << error.message();
+
+  int sock = client();
+  ASSERT_GE(sock, 0);
+
+  // Equally sized datagrams to the same peer are sent as one GSO train
+  // where the kernel supports it, and still arrive one by one.
+  constexpr int count = 32;
+  const auto message = std::string(100, 'x');
+  for (int i = 0; i < count; ++i)
+    send_to(sock, addr, message);
+  send_to(sock, addr, "tail");
+
+  for (int i = 0; i < count; ++i)
+    ASSERT_EQ(receive(sock), message);
+  EXPECT_EQ(receive(sock), "tail");
+
+  close(sock);
+  thread.request_stop();
+}
+
+TEST_F(UdpSegmentServiceTest, ForwardTest)
+{
+  int upstream = client();
+  ASSERT_GE(upstream, 0);
+  auto upstream_addr = loopback(8095);
+  ASSERT_EQ(bind(upstream, reinterpret_cast<sockaddr *>(&upstream_addr),
+                 sizeof(upstream_addr)),
+            0);
+
+  auto options = segment_options{};
+  std::memcpy(&options.upstreams.emplace_back(), &upstream_addr,
+              sizeof(upstream_addr));
+
+  auto addr = loopback(8096);
+  auto service = udp_segment_service(addr, options);
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+  ASSERT_TRUE(wait_bound(service)) << error.message();
+
+  int sock = client();
+  ASSERT_GE(sock, 0);
+  send_to(sock, addr, "telemetry");
+  EXPECT_EQ(receive(upstream), "telemetry");
+
+  close(sock);
+  close(upstream);
+  thread.request_stop();
+}
+// NOLINTEND
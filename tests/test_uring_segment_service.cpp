@@ -0,0 +1,409 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// NOLINTBEGIN
+#include "segment/uring_segment_service.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+using namespace cloudbus::segment;
+
+class UringSegmentServiceTest : public ::testing::Test {};
+
+/**
+ * @brief Finds a free loopback port by binding to port 0.
+ * @return The port that the kernel picked.
+ */
+static auto free_port() -> std::uint16_t
+{
+  int sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  auto addr = sockaddr_in{.sin_family = AF_INET};
+  auto len = socklen_t{sizeof(addr)};
+  ::bind(sock, reinterpret_cast<sockaddr *>(&addr), len);
+  ::getsockname(sock, reinterpret_cast<sockaddr *>(&addr), &len);
+  ::close(sock);
+  return ntohs(addr.sin_port);
+}
+
+TEST_F(UringSegmentServiceTest, EchoTest)
+{
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(free_port());
+
+  auto service = uring_segment_service(
+      addr, segment_options{.uring_buffer_count = 64, .uring_buffer_size = 4});
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT_GE(sock, 0);
+
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  auto *address = reinterpret_cast<sockaddr *>(&addr);
+
+  int connected = -1;
+  for (int i = 0; i < 100 && connected; ++i)
+  {
+    connected = connect(sock, address, sizeof(addr));
+    if (connected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (connected)
+  {
+    thread.request_stop();
+    thread.join();
+    GTEST_SKIP() << "io_uring is unavailable: " << error.message();
+  }
+
+  // Messages that are longer than the provided buffers span several recvs.
+  const auto alphabet = std::string_view("abcdefghijklmnopqrstuvwxyz");
+  ASSERT_EQ(send(sock, alphabet.data(), alphabet.size(), 0), alphabet.size());
+
+  auto buf = std::array<char, 26>{};
+  for (std::size_t received = 0; received < buf.size();)
+  {
+    auto len = recv(sock, buf.data() + received, buf.size() - received, 0);
+    ASSERT_GT(len, 0);
+    received += len;
+  }
+  EXPECT_EQ(std::string_view(buf.data(), buf.size()), alphabet);
+
+  close(sock);
+  thread.request_stop();
+}
+
+TEST_F(UringSegmentServiceTest, DrainTest)
+{
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(free_port());
+
+  auto service = uring_segment_service(
+      addr, segment_options{.uring_buffer_count = 64});
+  auto error = std::error_code{};
+  auto done = std::atomic<bool>{false};
+  auto thread = std::jthread([&](std::stop_token token) {
+    error = service.run(std::move(token));
+    done = true;
+  });
+
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT_GE(sock, 0);
+
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  auto *address = reinterpret_cast<sockaddr *>(&addr);
+
+  int connected = -1;
+  for (int i = 0; i < 100 && connected; ++i)
+  {
+    connected = connect(sock, address, sizeof(addr));
+    if (connected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (connected)
+  {
+    thread.request_stop();
+    thread.join();
+    GTEST_SKIP() << "io_uring is unavailable: " << error.message();
+  }
+  EXPECT_GE(service.listener(), 0);
+
+  const auto message = std::string_view("drain");
+  ASSERT_EQ(send(sock, message.data(), message.size(), 0), message.size());
+  auto buf = std::array<char, 5>{};
+  ASSERT_EQ(recv(sock, buf.data(), buf.size(), MSG_WAITALL), buf.size());
+
+  // The idle connection is closed and the event loop ends by itself.
+  service.drain();
+  EXPECT_EQ(recv(sock, buf.data(), buf.size(), 0), 0);
+
+  for (int i = 0; i < 100 && !done; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_TRUE(done);
+  EXPECT_FALSE(error);
+  EXPECT_EQ(service.listener(), -1);
+
+  close(sock);
+}
+
+TEST_F(UringSegmentServiceTest, HandoffTest)
+{
+  using namespace std::chrono_literals;
+
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+  const auto options = segment_options{.uring_buffer_count = 64};
+  auto previous = uring_segment_service(addr, options);
+  auto error = std::error_code{};
+  auto done = std::atomic<bool>{false};
+  auto thread = std::jthread([&](std::stop_token token) {
+    error = previous.run(std::move(token));
+    done = true;
+  });
+
+  for (int i = 0; i < 100 && previous.listener() < 0 && !done; ++i)
+    std::this_thread::sleep_for(10ms);
+  if (previous.listener() < 0)
+  {
+    thread.request_stop();
+    thread.join();
+    GTEST_SKIP() << "io_uring is unavailable: " << error.message();
+  }
+
+  auto len = socklen_t{sizeof(addr)};
+  ASSERT_EQ(getsockname(previous.listener(),
+                        reinterpret_cast<sockaddr *>(&addr), &len),
+            0);
+
+  // The next segment serves on the same listening socket.
+  auto next = uring_segment_service(addr, options);
+  next.adopt(dup(previous.listener()));
+  auto next_error = std::error_code{};
+  auto next_thread = std::jthread([&](std::stop_token token) {
+    next_error = next.run(std::move(token));
+  });
+
+  auto echo = [&] {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    auto timeout = timeval{.tv_sec = 2, .tv_usec = 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    auto buf = 'x';
+    auto ok = connect(sock, reinterpret_cast<sockaddr *>(&addr),
+                      sizeof(addr)) == 0 &&
+              send(sock, &buf, 1, MSG_NOSIGNAL) == 1 &&
+              recv(sock, &buf, 1, 0) == 1 && buf == 'x';
+    close(sock);
+    return ok;
+  };
+
+  // Connections keep being made while the previous segment drains.
+  auto failures = std::atomic<int>{0};
+  auto stop = std::atomic<bool>{false};
+  auto client = std::thread([&] {
+    while (!stop)
+    {
+      if (!echo())
+        ++failures;
+      std::this_thread::sleep_for(1ms);
+    }
+  });
+
+  std::this_thread::sleep_for(50ms);
+  previous.drain();
+  for (int i = 0; i < 100 && !done; ++i)
+    std::this_thread::sleep_for(10ms);
+  std::this_thread::sleep_for(50ms);
+  stop = true;
+  client.join();
+
+  EXPECT_TRUE(done);
+  EXPECT_FALSE(error);
+  EXPECT_EQ(failures, 0);
+  EXPECT_TRUE(echo());
+
+  next_thread.request_stop();
+  next_thread.join();
+  EXPECT_FALSE(next_error);
+}
+
+TEST_F(UringSegmentServiceTest, IdleTimeoutTest)
+{
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(free_port());
+
+  auto service = uring_segment_service(
+      addr, segment_options{.idle_timeout = std::chrono::milliseconds(100),
+                            .uring_buffer_count = 64});
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT_GE(sock, 0);
+
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  auto *address = reinterpret_cast<sockaddr *>(&addr);
+
+  int connected = -1;
+  for (int i = 0; i < 100 && connected; ++i)
+  {
+    connected = connect(sock, address, sizeof(addr));
+    if (connected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (connected)
+  {
+    thread.request_stop();
+    thread.join();
+    GTEST_SKIP() << "io_uring is unavailable: " << error.message();
+  }
+
+  // Traffic holds off the timeout.
+  const auto message = std::string_view("ping");
+  auto buf = std::array<char, 4>{};
+  for (int i = 0; i < 3; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(send(sock, message.data(), message.size(), 0), message.size());
+    ASSERT_EQ(recv(sock, buf.data(), buf.size(), MSG_WAITALL), buf.size());
+  }
+
+  // Then the idle connection is closed.
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(recv(sock, buf.data(), buf.size(), 0), 0);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+  close(sock);
+  thread.request_stop();
+}
+
+TEST_F(UringSegmentServiceTest, ThrottledStreamTest)
+{
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(free_port());
+
+  // A 100 byte burst at 1000 bytes per second.
+  using namespace std::chrono_literals;
+  auto service = uring_segment_service(
+      addr, segment_options{.uring_buffer_count = 64,
+                            .rate_limit_bytes = 1000,
+                            .rate_limit_burst = 100ms});
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT_GE(sock, 0);
+
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  auto *address = reinterpret_cast<sockaddr *>(&addr);
+
+  int connected = -1;
+  for (int i = 0; i < 100 && connected; ++i)
+  {
+    connected = connect(sock, address, sizeof(addr));
+    if (connected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (connected)
+  {
+    thread.request_stop();
+    thread.join();
+    GTEST_SKIP() << "io_uring is unavailable: " << error.message();
+  }
+
+  // Three times the burst is delayed, not dropped.
+  auto sent = std::string{};
+  const auto alphabet = std::string_view("abcdefghijklmnopqrstuvwxyz");
+  for (int i = 0; i < 12; ++i)
+  {
+    ASSERT_EQ(send(sock, alphabet.data(), alphabet.size(), 0),
+              alphabet.size());
+    sent += alphabet;
+  }
+
+  auto buf = std::string(sent.size(), '\0');
+  ASSERT_EQ(recv(sock, buf.data(), buf.size(), MSG_WAITALL), buf.size());
+  EXPECT_EQ(buf, sent);
+
+  close(sock);
+  thread.request_stop();
+}
+
+TEST_F(UringSegmentServiceTest, MemoryBudgetTest)
+{
+  using namespace std::chrono_literals;
+
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(free_port());
+
+  // Any buffer exhausts the budget, so the recv pauses behind every send.
+  auto budget = std::make_shared<cloudbus::detail::memory_budget>(1);
+  auto service = uring_segment_service(
+      addr, segment_options{.uring_buffer_count = 64,
+                            .uring_buffer_size = 4,
+                            .memory_budget = budget});
+  auto error = std::error_code{};
+  auto thread = std::jthread(
+      [&](std::stop_token token) { error = service.run(std::move(token)); });
+
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT_GE(sock, 0);
+
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  auto *address = reinterpret_cast<sockaddr *>(&addr);
+
+  int connected = -1;
+  for (int i = 0; i < 100 && connected; ++i)
+  {
+    connected = connect(sock, address, sizeof(addr));
+    if (connected)
+      std::this_thread::sleep_for(10ms);
+  }
+  if (connected)
+  {
+    thread.request_stop();
+    thread.join();
+    GTEST_SKIP() << "io_uring is unavailable: " << error.message();
+  }
+
+  auto tv = timeval{.tv_sec = 5, .tv_usec = 0};
+  ASSERT_EQ(setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)), 0);
+
+  // The recvs that are linked behind the sends keep the stream going.
+  auto sent = std::string{};
+  const auto alphabet = std::string_view("abcdefghijklmnopqrstuvwxyz");
+  for (int i = 0; i < 40; ++i)
+  {
+    ASSERT_EQ(send(sock, alphabet.data(), alphabet.size(), 0),
+              alphabet.size());
+    sent += alphabet;
+  }
+
+  auto buf = std::string(sent.size(), '\0');
+  ASSERT_EQ(recv(sock, buf.data(), buf.size(), MSG_WAITALL), buf.size());
+  EXPECT_EQ(buf, sent);
+
+  // The buffers return to their ring once their sends have completed.
+  for (int i = 0; i < 100 && budget->used(); ++i)
+    std::this_thread::sleep_for(10ms);
+  EXPECT_EQ(budget->used(), 0);
+
+  close(sock);
+  thread.request_stop();
+}
+// NOLINTEND
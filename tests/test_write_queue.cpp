@@ -0,0 +1,195 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/write_queue.hpp"
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <span>
+#include <vector>
+
+using namespace cloudbus::detail;
+
+class WriteQueueTest : public ::testing::Test {
+protected:
+  using buffer_type = write_queue::buffer_type;
+
+  auto make_buffer(std::size_t size) -> std::shared_ptr<std::vector<std::byte>>
+  {
+    return std::make_shared<std::vector<std::byte>>(size);
+  }
+};
+
+TEST_F(WriteQueueTest, PushAndGather)
+{
+  auto queue = write_queue{};
+  auto first = make_buffer(3);
+  auto second = make_buffer(5);
+
+  queue.push(first, *first);
+  queue.push(second, *second);
+  queue.push(second, {});
+
+  EXPECT_EQ(queue.size(), 2);
+  EXPECT_EQ(queue.bytes(), 8);
+
+  auto buffers = std::array<buffer_type, write_queue::max_buffers>{};
+  ASSERT_EQ(queue.gather(buffers), 2);
+  EXPECT_EQ(buffers[0].data(), first->data());
+  EXPECT_EQ(buffers[0].size(), 3);
+  EXPECT_EQ(buffers[1].data(), second->data());
+  EXPECT_EQ(buffers[1].size(), 5);
+}
+
+TEST_F(WriteQueueTest, GatherIsBounded)
+{
+  auto queue = write_queue{};
+  auto buf = make_buffer(1);
+
+  for (int i = 0; i < 4; ++i)
+    queue.push(buf, *buf);
+
+  auto buffers = std::array<buffer_type, 2>{};
+  EXPECT_EQ(queue.gather(buffers), 2);
+  EXPECT_EQ(queue.size(), 4);
+}
+
+TEST_F(WriteQueueTest, ConsumeReleasesOwners)
+{
+  auto queue = write_queue{};
+  auto buf = make_buffer(4);
+  auto weak = std::weak_ptr{buf};
+
+  queue.push(buf, *buf);
+  queue.push(buf, *buf);
+  buf.reset();
+  EXPECT_FALSE(weak.expired());
+
+  queue.consume(4);
+  EXPECT_EQ(queue.size(), 1);
+  EXPECT_EQ(queue.bytes(), 4);
+  EXPECT_FALSE(weak.expired());
+
+  queue.consume(16);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.bytes(), 0);
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST_F(WriteQueueTest, ConsumePartialWrite)
+{
+  auto queue = write_queue{};
+  auto first = make_buffer(4);
+  auto second = make_buffer(6);
+
+  queue.push(first, *first);
+  queue.push(second, *second);
+
+  queue.consume(7);
+  EXPECT_EQ(queue.size(), 1);
+  EXPECT_EQ(queue.bytes(), 3);
+  EXPECT_EQ(first.use_count(), 1);
+
+  auto buffers = std::array<buffer_type, write_queue::max_buffers>{};
+  ASSERT_EQ(queue.gather(buffers), 1);
+  EXPECT_EQ(buffers[0].data(), second->data() + 3);
+  EXPECT_EQ(buffers[0].size(), 3);
+
+  queue.consume(0);
+  EXPECT_EQ(queue.bytes(), 3);
+}
+
+TEST_F(WriteQueueTest, ConsumeRetainsOwners)
+{
+  auto queue = write_queue{};
+  auto first = make_buffer(4);
+  auto second = make_buffer(6);
+
+  queue.push(first, *first);
+  queue.push(second, *second);
+
+  auto released = std::vector<write_queue::owner_type>{};
+  queue.consume(6, released);
+
+  ASSERT_EQ(released.size(), 2);
+  EXPECT_EQ(released[0], first);
+  EXPECT_EQ(released[1], second);
+  EXPECT_EQ(queue.size(), 1);
+  EXPECT_EQ(queue.bytes(), 4);
+  EXPECT_EQ(first.use_count(), 2);
+  EXPECT_EQ(second.use_count(), 3);
+}
+
+TEST_F(WriteQueueTest, Clear)
+{
+  auto queue = write_queue{};
+  auto buf = make_buffer(4);
+
+  queue.push(buf, *buf);
+  queue.clear();
+
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.bytes(), 0);
+  EXPECT_EQ(buf.use_count(), 1);
+}
+
+TEST_F(WriteQueueTest, ExpireDropsWholeMessages)
+{
+  using clock_type = write_queue::clock_type;
+
+  auto queue = write_queue{};
+  auto buf = make_buffer(16);
+  auto bytes = std::span<const std::byte>(*buf);
+  auto now = clock_type::now();
+
+  // Two messages of two buffers each, and a newer message.
+  queue.push(buf, bytes.subspan(0, 2), now);
+  queue.push(buf, bytes.subspan(2, 2));
+  queue.push(buf, bytes.subspan(4, 2), now);
+  queue.push(buf, bytes.subspan(6, 2));
+  queue.push(buf, bytes.subspan(8, 8), now + std::chrono::seconds(1));
+  EXPECT_EQ(queue.oldest(), now);
+
+  EXPECT_EQ(queue.expire(now), 2);
+  EXPECT_EQ(queue.size(), 1);
+  EXPECT_EQ(queue.bytes(), 8);
+  EXPECT_EQ(queue.oldest(), now + std::chrono::seconds(1));
+}
+
+TEST_F(WriteQueueTest, ExpireKeepsPartlyWrittenMessages)
+{
+  using clock_type = write_queue::clock_type;
+
+  auto queue = write_queue{};
+  auto buf = make_buffer(8);
+  auto bytes = std::span<const std::byte>(*buf);
+  auto now = clock_type::now();
+
+  queue.push(buf, bytes.subspan(0, 4), now);
+  queue.push(buf, bytes.subspan(4, 4), now);
+  queue.consume(1);
+
+  // The partly written message holds back the one behind it.
+  EXPECT_EQ(queue.expire(now), 0);
+  EXPECT_EQ(queue.bytes(), 7);
+
+  queue.consume(3);
+  EXPECT_EQ(queue.expire(now), 1);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.oldest(), clock_type::time_point{});
+}
+// NOLINTEND
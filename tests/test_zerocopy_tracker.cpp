@@ -0,0 +1,97 @@
+/* Copyright (C) 2025 Kevin Exton (kevin.exton@pm.me)
+ *
+ * Cloudbus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cloudbus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Cloudbus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+// NOLINTBEGIN
+#include "segment/detail/zerocopy_tracker.hpp"
+#include <gtest/gtest.h>
+
+#include <array>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cloudbus::detail;
+
+class ZerocopyTrackerTest : public ::testing::Test {};
+
+TEST_F(ZerocopyTrackerTest, ReleaseRange)
+{
+  auto tracker = zerocopy_tracker{};
+  auto owners = std::array<std::shared_ptr<int>, 4>{};
+
+  for (auto &owner : owners)
+  {
+    owner = std::make_shared<int>();
+    tracker.push({owner});
+  }
+  EXPECT_EQ(tracker.pending(), 4);
+
+  tracker.release(1, 2);
+  EXPECT_EQ(tracker.pending(), 2);
+  EXPECT_EQ(owners[0].use_count(), 2);
+  EXPECT_EQ(owners[1].use_count(), 1);
+  EXPECT_EQ(owners[2].use_count(), 1);
+  EXPECT_EQ(owners[3].use_count(), 2);
+
+  tracker.release(0, 3);
+  EXPECT_EQ(tracker.pending(), 0);
+}
+
+TEST_F(ZerocopyTrackerTest, ReapLoopback)
+{
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+
+  auto addr = sockaddr_in{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  auto len = socklen_t{sizeof(addr)};
+  auto *address = reinterpret_cast<sockaddr *>(&addr);
+  ASSERT_EQ(bind(listener, address, len), 0);
+  ASSERT_EQ(listen(listener, 1), 0);
+  ASSERT_EQ(getsockname(listener, address, &len), 0);
+
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  int enable = 1;
+  if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)))
+  {
+    close(sock);
+    close(listener);
+    GTEST_SKIP() << "SO_ZEROCOPY is unsupported.";
+  }
+  ASSERT_EQ(connect(sock, address, len), 0);
+  int peer = accept(listener, nullptr, nullptr);
+  ASSERT_GE(peer, 0);
+
+  auto tracker = zerocopy_tracker{};
+  auto owner = std::make_shared<std::array<char, 4096>>();
+  ASSERT_EQ(send(sock, owner->data(), owner->size(), MSG_ZEROCOPY),
+            owner->size());
+  tracker.push({owner});
+
+  auto pfd = pollfd{.fd = sock, .events = 0, .revents = 0};
+  ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+  EXPECT_EQ(tracker.reap(sock), 1);
+  EXPECT_EQ(tracker.pending(), 0);
+  EXPECT_EQ(owner.use_count(), 1);
+
+  close(peer);
+  close(sock);
+  close(listener);
+}
+// NOLINTEND